@@ -0,0 +1,223 @@
+"""Adaptive step-density IV sweep runner (KXCI compatible).
+
+This script wraps the `EX A_Iv_Sweep smu_adaptive_ivsweep(...)` command. The
+sweep follows the same (0V → Vhigh → 0V → Vlow → 0V) × NumCycles path as
+`smu_ivsweep`, but only uses fine voltage steps around switching events:
+
+- Flat regions are swept at the coarse step (cycle path length / CoarseSteps)
+- When the chord conductance I/V changes by more than --rel-threshold (or
+  |dI/dV| exceeds --slope-threshold) the step is divided by --refine-factor
+- The step grows back after --calm-points quiet points
+- Voltages that switched in one cycle are refined ahead of time in the next
+
+The number of points actually measured varies from run to run, so the module
+reports it through the NumPointsOut output (GP 12); the Imeas/Vforce arrays
+(GP 8 / GP 10) are zero beyond that count.
+
+Usage examples:
+
+    # 2 V loop, 40 coarse steps/cycle, refine down to 10 mV around SET/RESET
+    python run_smu_adaptive_ivsweep.py --vhigh 2 --vlow -2 --coarse-steps 40 --min-step 0.01
+
+    # Several cycles with predictive ranging and a tighter point budget
+    python run_smu_adaptive_ivsweep.py --num-cycles 5 --budget 400 --range-mode 1
+
+Pass `--dry-run` to print the generated EX command without contacting the instrument.
+"""
+
+from __future__ import annotations
+
+import argparse
+import time
+from typing import List
+
+from run_smu_vi_sweep import KXCIClient, format_param
+
+
+# GP parameter positions (1-based) in smu_adaptive_ivsweep
+GP_IMEAS = 8
+GP_VFORCE = 10
+GP_NUM_POINTS_OUT = 12
+
+
+def min_budget(coarse_steps: int, num_cycles: int) -> int:
+    """Smallest NumIPoints the module accepts (coarse sweep plus clipped leg ends)."""
+    return (coarse_steps + 4) * num_cycles + 1
+
+
+def build_ex_command(
+    vhigh: float,
+    vlow: float,
+    coarse_steps: int,
+    num_cycles: int,
+    min_step: float,
+    rel_threshold: float,
+    slope_threshold: float,
+    budget: int,
+    step_delay: float,
+    ilimit: float,
+    irange: float,
+    integration_time: float,
+    range_mode: int = 0,
+    refine_factor: int = 4,
+    calm_points: int = 2,
+    clarius_debug: int = 0,
+) -> str:
+    """Build EX command for smu_adaptive_ivsweep.
+
+    Parameters (20 total):
+    1. Vhigh, 2. Vlow, 3. CoarseSteps, 4. NumCycles, 5. MinStep,
+    6. RelThreshold, 7. SlopeThreshold,
+    8. Imeas (output), 9. NumIPoints (point budget),
+    10. Vforce (output), 11. NumVPoints (= NumIPoints),
+    12. NumPointsOut (int output),
+    13. StepDelay, 14. Ilimit, 15. IRange, 16. IntegrationTime,
+    17. RangeMode, 18. RefineFactor, 19. CalmPoints, 20. ClariusDebug
+    """
+    params = [
+        format_param(vhigh),                      # 1: Vhigh
+        format_param(vlow),                       # 2: Vlow
+        format_param(int(coarse_steps)),          # 3: CoarseSteps
+        format_param(int(num_cycles)),            # 4: NumCycles
+        format_param(min_step),                   # 5: MinStep
+        format_param(rel_threshold),              # 6: RelThreshold
+        format_param(slope_threshold),            # 7: SlopeThreshold
+        "",                                       # 8: Imeas output array
+        format_param(int(budget)),                # 9: NumIPoints
+        "",                                       # 10: Vforce output array
+        format_param(int(budget)),                # 11: NumVPoints
+        "",                                       # 12: NumPointsOut output
+        format_param(step_delay),                 # 13: StepDelay
+        format_param(ilimit),                     # 14: Ilimit
+        format_param(irange),                     # 15: IRange
+        format_param(integration_time),           # 16: IntegrationTime
+        format_param(1 if int(range_mode) == 1 else 0),  # 17: RangeMode
+        format_param(int(refine_factor)),         # 18: RefineFactor
+        format_param(int(calm_points)),           # 19: CalmPoints
+        format_param(int(bool(clarius_debug))),   # 20: ClariusDebug
+    ]
+    return f"EX A_Iv_Sweep smu_adaptive_ivsweep({','.join(params)})"
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description="Adaptive step-density IV sweep for Keithley 4200A-SCS",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog=__doc__,
+    )
+    parser.add_argument("--gpib-address", type=str, default="GPIB0::17::INSTR")
+    parser.add_argument("--timeout", type=float, default=60.0)
+    parser.add_argument("--vhigh", type=float, default=2.0, help="Positive vertex (V)")
+    parser.add_argument("--vlow", type=float, default=-2.0, help="Negative vertex (V)")
+    parser.add_argument("--coarse-steps", type=int, default=40, help="Steps per cycle at the coarse step (4-10000)")
+    parser.add_argument("--num-cycles", type=int, default=1, help="Number of cycles (1-1000)")
+    parser.add_argument("--min-step", type=float, default=0.01, help="Smallest refined voltage step (V)")
+    parser.add_argument("--rel-threshold", type=float, default=0.5,
+                        help="Refine when I/V changes by more than this fraction between points (0 = off)")
+    parser.add_argument("--slope-threshold", type=float, default=0.0,
+                        help="Refine when |dI/dV| exceeds this value in A/V (0 = off)")
+    parser.add_argument("--refine-factor", type=int, default=4, help="Step divisor on a detected transition (2-64)")
+    parser.add_argument("--calm-points", type=int, default=2, help="Quiet points before the step grows again")
+    parser.add_argument("--budget", type=int, default=0,
+                        help="Point budget / array size (default: 2x the coarse sweep)")
+    parser.add_argument("--step-delay", type=float, default=0.01, help="Delay per step (s, >= 0.001)")
+    parser.add_argument("--ilimit", type=float, default=0.1, help="Current compliance (A)")
+    parser.add_argument("--irange", type=float, default=0.0, help="Current range (A), 0 = auto")
+    parser.add_argument("--integration-time", type=float, default=0.01, help="Integration time (PLC)")
+    parser.add_argument("--range-mode", type=int, choices=(0, 1), default=0,
+                        help="0 = --irange as given, 1 = predictive range (see smu_ivsweep)")
+    parser.add_argument("--debug", action="store_true", help="Enable ClariusDebug output")
+    parser.add_argument("--dry-run", action="store_true", help="Print EX command without executing")
+    parser.add_argument("--no-plot", action="store_true", help="Skip plotting results")
+    args = parser.parse_args()
+
+    if args.vhigh < 0 or args.vlow > 0:
+        parser.error("vhigh must be >= 0 and vlow <= 0")
+    if not (4 <= args.coarse_steps <= 10000):
+        parser.error("coarse-steps must be in range [4, 10000]")
+    if not (1 <= args.num_cycles <= 1000):
+        parser.error("num-cycles must be in range [1, 1000]")
+
+    floor_budget = min_budget(args.coarse_steps, args.num_cycles)
+    budget = args.budget if args.budget > 0 else 2 * floor_budget
+    if budget < floor_budget:
+        parser.error(f"budget={budget} must be >= {floor_budget} for this coarse sweep")
+
+    command = build_ex_command(
+        vhigh=args.vhigh,
+        vlow=args.vlow,
+        coarse_steps=args.coarse_steps,
+        num_cycles=args.num_cycles,
+        min_step=args.min_step,
+        rel_threshold=args.rel_threshold,
+        slope_threshold=args.slope_threshold,
+        budget=budget,
+        step_delay=args.step_delay,
+        ilimit=args.ilimit,
+        irange=args.irange,
+        integration_time=args.integration_time,
+        range_mode=args.range_mode,
+        refine_factor=args.refine_factor,
+        calm_points=args.calm_points,
+        clarius_debug=1 if args.debug else 0,
+    )
+
+    if args.dry_run:
+        print(command)
+        return
+
+    controller = KXCIClient(gpib_address=args.gpib_address, timeout=args.timeout)
+    if not controller.connect():
+        print("[ERROR] Failed to connect to instrument")
+        return
+
+    try:
+        if not controller._enter_ul_mode():  # pylint: disable=protected-access
+            raise RuntimeError("Failed to enter UL mode")
+
+        # Worst case every point of the budget is measured
+        wait_seconds = budget * (args.step_delay + 0.01)
+        print(f"[KXCI] Adaptive sweep, budget {budget} points (coarse sweep alone: {floor_budget})")
+        return_value, error = controller._execute_ex_command(command, wait_seconds=wait_seconds)  # pylint: disable=protected-access
+        if error:
+            raise RuntimeError(f"EX command failed: {error}")
+        if return_value is not None and return_value < 0:
+            raise RuntimeError(f"EX command returned error code: {return_value}")
+
+        time.sleep(0.2)
+        count_values = controller._query_gp(GP_NUM_POINTS_OUT, 1)  # pylint: disable=protected-access
+        num_points = int(count_values[0]) if count_values else budget
+        current: List[float] = controller._query_gp(GP_IMEAS, num_points)  # pylint: disable=protected-access
+        voltage: List[float] = controller._query_gp(GP_VFORCE, num_points)  # pylint: disable=protected-access
+        n = min(num_points, len(current), len(voltage))
+        voltage, current = voltage[:n], current[:n]
+
+        print(f"[RESULTS] {n} points measured (budget {budget})")
+        print(f"{'Idx':>4} {'Voltage (V)':>14} {'Current (A)':>14}")
+        for idx in range(min(n, 50)):
+            print(f"{idx:>4} {voltage[idx]:>14.6f} {current[idx]:>14.6e}")
+        if n > 50:
+            print(f"... ({n - 50} more points)")
+
+        if not args.no_plot and n:
+            try:
+                import matplotlib.pyplot as plt
+
+                plt.semilogy(voltage, [abs(i) for i in current], "b-o", markersize=3)
+                plt.xlabel("Voltage (V)")
+                plt.ylabel("|Current| (A)")
+                plt.title("Adaptive IV sweep")
+                plt.grid(True, alpha=0.3)
+                plt.show()
+            except ImportError:
+                print("\n[INFO] matplotlib not available, skipping plot")
+    finally:
+        try:
+            controller._exit_ul_mode()  # pylint: disable=protected-access
+        except Exception:
+            pass
+        controller.disconnect()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,203 @@
+"""Multi-SMU parallel sweep runner (KXCI compatible).
+
+This script wraps the `EX A_Iv_Sweep smu_multi_sweep(...)` command. One device
+is connected to each SMU; every step forces all channels, waits one dwell and
+measures all channels, so N devices take roughly the time of one.
+
+The sweep path is a vertex list as in run_smu_plan_sweep.py. Give one list
+for all channels, or one list per channel with --channel-vertices.
+
+Usage examples:
+
+    # Same 0 → 2 V → 0 → -2 V → 0 loop on four devices
+    python run_smu_multi_sweep.py --smus SMU1 SMU2 SMU3 SMU4 --vertices "0;2;0;-2;0" --leg-points 20
+
+    # Different amplitude per device (same number of vertices)
+    python run_smu_multi_sweep.py --smus SMU1 SMU2 --channel-vertices "0;2;0" "0;1;0" --leg-points 25
+
+Pass `--dry-run` to print the generated EX command without contacting the instrument.
+"""
+
+from __future__ import annotations
+
+import argparse
+import time
+from typing import Dict, List, Sequence
+
+from run_smu_plan_sweep import _as_list, _format_list, plan_point_count
+from run_smu_vi_sweep import KXCIClient, format_param
+
+
+# GP parameter positions (1-based) in smu_multi_sweep
+GP_IMEAS = 8
+GP_VFORCE = 10
+GP_TMEAS = 12
+GP_NUM_POINTS_OUT = 14
+
+
+def split_channels(values: Sequence[float], num_channels: int) -> List[List[float]]:
+    """Point-major interleaved array (value[point * channels + channel]) -> one list per channel."""
+    return [list(values[c::num_channels]) for c in range(num_channels)]
+
+
+def build_ex_command(
+    smus: Sequence[str],
+    vertices: str | Sequence[str] | Sequence[float],
+    leg_points: str | int | Sequence[float],
+    num_points: int,
+    num_cycles: int = 1,
+    leg_dwell: str | float | Sequence[float] = "",
+    leg_ilimit: str | float | Sequence[float] = "",
+    leg_irange: str | float | Sequence[float] = "",
+    integration_time: float = 0.01,
+    clarius_debug: int = 0,
+) -> str:
+    """Build EX command for smu_multi_sweep.
+
+    `vertices` is one vertex list (string or numbers) or a list of per-channel
+    strings. `num_points` is the number of points per channel.
+
+    Parameters (16 total):
+    1. SMUList, 2. Vertices ('|' between channels), 3. LegPoints, 4. LegDwell,
+    5. LegIlimit, 6. LegIRange, 7. NumCycles, 8. Imeas (output), 9. NumIPoints,
+    10. Vforce (output), 11. NumVPoints, 12. Tmeas (output), 13. NumTPoints,
+    14. NumPointsOut (int output), 15. IntegrationTime, 16. ClariusDebug
+    """
+    if isinstance(vertices, (list, tuple)) and vertices and isinstance(vertices[0], str):
+        vertex_text = "|".join(_format_list(v) for v in vertices)
+    else:
+        vertex_text = _format_list(vertices)  # type: ignore[arg-type]
+    array_size = int(num_points) * len(smus)
+    params = [
+        ";".join(smus),                        # 1: SMUList
+        vertex_text,                           # 2: Vertices
+        _format_list(leg_points),              # 3: LegPoints
+        _format_list(leg_dwell),               # 4: LegDwell
+        _format_list(leg_ilimit),              # 5: LegIlimit
+        _format_list(leg_irange),              # 6: LegIRange
+        format_param(int(num_cycles)),         # 7: NumCycles
+        "",                                    # 8: Imeas output array
+        format_param(array_size),              # 9: NumIPoints
+        "",                                    # 10: Vforce output array
+        format_param(array_size),              # 11: NumVPoints
+        "",                                    # 12: Tmeas output array
+        format_param(int(num_points)),         # 13: NumTPoints
+        "",                                    # 14: NumPointsOut output
+        format_param(integration_time),        # 15: IntegrationTime
+        format_param(int(bool(clarius_debug))),  # 16: ClariusDebug
+    ]
+    return f"EX A_Iv_Sweep smu_multi_sweep({','.join(params)})"
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description="Multi-SMU parallel sweep for Keithley 4200A-SCS",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog=__doc__,
+    )
+    parser.add_argument("--gpib-address", type=str, default="GPIB0::17::INSTR")
+    parser.add_argument("--timeout", type=float, default=60.0)
+    parser.add_argument("--smus", nargs="+", default=["SMU1", "SMU2"], help="SMUs to drive (1-8)")
+    parser.add_argument("--vertices", type=str, default="0;2;0;-2;0", help="Vertex list shared by all channels")
+    parser.add_argument("--channel-vertices", nargs="+", default=None, help="One vertex list per channel")
+    parser.add_argument("--leg-points", type=str, default="10", help="Points per leg, one value or one per leg")
+    parser.add_argument("--leg-dwell", type=str, default="0.001", help="Dwell per step (s)")
+    parser.add_argument("--leg-ilimit", type=str, default="0.1", help="Compliance (A)")
+    parser.add_argument("--leg-irange", type=str, default="0", help="Current range (A, 0 = auto)")
+    parser.add_argument("--num-cycles", type=int, default=1, help="Number of cycles (1-1000)")
+    parser.add_argument("--integration-time", type=float, default=0.01, help="Integration time (PLC)")
+    parser.add_argument("--debug", action="store_true", help="Enable ClariusDebug output")
+    parser.add_argument("--dry-run", action="store_true", help="Print EX command without executing")
+    parser.add_argument("--no-plot", action="store_true", help="Skip plotting results")
+    args = parser.parse_args()
+
+    if not (1 <= len(args.smus) <= 8):
+        parser.error("between 1 and 8 SMUs")
+    vertices: str | List[str] = args.vertices
+    if args.channel_vertices:
+        if len(args.channel_vertices) != len(args.smus):
+            parser.error("--channel-vertices needs one list per SMU")
+        counts = {len(_as_list(v)) for v in args.channel_vertices}
+        if len(counts) != 1:
+            parser.error("every channel needs the same number of vertices")
+        vertices = args.channel_vertices
+
+    first = vertices[0] if isinstance(vertices, list) else vertices
+    try:
+        num_points = plan_point_count(first, args.leg_points, args.num_cycles)
+    except ValueError as exc:
+        parser.error(str(exc))
+
+    command = build_ex_command(
+        smus=args.smus,
+        vertices=vertices,
+        leg_points=args.leg_points,
+        num_points=num_points,
+        num_cycles=args.num_cycles,
+        leg_dwell=args.leg_dwell,
+        leg_ilimit=args.leg_ilimit,
+        leg_irange=args.leg_irange,
+        integration_time=args.integration_time,
+        clarius_debug=1 if args.debug else 0,
+    )
+
+    if args.dry_run:
+        print(f"[DRY RUN] {num_points} points × {len(args.smus)} channels")
+        print(command)
+        return
+
+    controller = KXCIClient(gpib_address=args.gpib_address, timeout=args.timeout)
+    if not controller.connect():
+        print("[ERROR] Failed to connect to instrument")
+        return
+
+    try:
+        if not controller._enter_ul_mode():  # pylint: disable=protected-access
+            raise RuntimeError("Failed to enter UL mode")
+
+        dwell = max(_as_list(args.leg_dwell) or [0.001])
+        wait_seconds = max(1.0, num_points * (dwell + 0.01 * len(args.smus)))
+        print(f"[KXCI] {len(args.smus)} channels × {num_points} points")
+        return_value, error = controller._execute_ex_command(command, wait_seconds=wait_seconds)  # pylint: disable=protected-access
+        if error:
+            raise RuntimeError(f"EX command failed: {error}")
+        if return_value is not None and return_value < 0:
+            raise RuntimeError(f"EX command returned error code: {return_value}")
+
+        time.sleep(0.2)
+        total = num_points * len(args.smus)
+        current = split_channels(controller._query_gp(GP_IMEAS, total), len(args.smus))  # pylint: disable=protected-access
+        voltage = split_channels(controller._query_gp(GP_VFORCE, total), len(args.smus))  # pylint: disable=protected-access
+        timestamps = controller._query_gp(GP_TMEAS, num_points)  # pylint: disable=protected-access
+
+        results: Dict[str, Dict[str, List[float]]] = {}
+        for idx, smu in enumerate(args.smus):
+            results[smu] = {"voltage": voltage[idx], "current": current[idx], "time": timestamps}
+            valid = [abs(i) for i in current[idx] if abs(i) > 1e-12]
+            summary = f"|I| {min(valid):.3e} .. {max(valid):.3e} A" if valid else "no current above 1 pA"
+            print(f"[RESULTS] {smu}: {len(current[idx])} points, {summary}")
+
+        if not args.no_plot:
+            try:
+                import matplotlib.pyplot as plt
+
+                for smu, data in results.items():
+                    plt.semilogy(data["voltage"], [abs(i) for i in data["current"]], "-o", markersize=3, label=smu)
+                plt.xlabel("Voltage (V)")
+                plt.ylabel("|Current| (A)")
+                plt.title("Multi-SMU sweep")
+                plt.legend()
+                plt.grid(True, alpha=0.3)
+                plt.show()
+            except ImportError:
+                print("\n[INFO] matplotlib not available, skipping plot")
+    finally:
+        try:
+            controller._exit_ul_mode()  # pylint: disable=protected-access
+        except Exception:
+            pass
+        controller.disconnect()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,287 @@
+"""Piecewise-linear SMU sweep runner (KXCI compatible).
+
+This script wraps the `EX A_Iv_Sweep smu_plan_sweep(...)` command. The module
+sweeps SMU1 along any vertex list, repeated NumCycles times, with per-leg
+points, dwell, compliance and current range. The fixed sweep shapes of the
+older modules are presets that build a vertex list:
+
+    --shape loop    0 → Vhigh → 0 → Vlow → 0        (smu_ivsweep / SMU_FullIVsweep)
+    --shape linear  Vstart → Vstop                  (SMU_VIsweep)
+    --shape dc      0 → Vamp, hold, Vamp → 0        (ACraig12_DC_Sweep)
+    --vertices      any list, e.g. "0;1;-0.5;2;0"
+
+By default every leg is run as one hardware sweepv() on the SMU (SweepMode 0),
+so there is no LPTLib round trip per point. Use --stepped for the software
+timed forcev()/measi() path.
+
+Usage examples:
+
+    # Standard loop, 10 points per leg, 3 cycles
+    python run_smu_plan_sweep.py --shape loop --vhigh 2 --vlow -2 --leg-points 10 --num-cycles 3
+
+    # Forming leg with tight compliance, RESET leg with a higher one
+    python run_smu_plan_sweep.py --vertices "0;3;0;-1.5;0" --leg-points "30;30;15;15" \\
+        --leg-ilimit "1e-4;1e-4;1e-2;1e-2"
+
+    # Ramp to 1.5 V, hold 0.5 s, ramp down
+    python run_smu_plan_sweep.py --shape dc --vamp 1.5 --leg-points 50 --hold 0.5
+
+Pass `--dry-run` to print the generated EX command without contacting the instrument.
+"""
+
+from __future__ import annotations
+
+import argparse
+import time
+from typing import List, Sequence
+
+from run_smu_vi_sweep import KXCIClient, format_param
+
+
+# GP parameter positions (1-based) in smu_plan_sweep
+GP_IMEAS = 7
+GP_VFORCE = 9
+GP_TMEAS = 11
+GP_NUM_POINTS_OUT = 13
+
+MAX_VERTICES = 64
+V_EPS = 1e-9
+
+
+def _as_list(values: str | float | int | Sequence[float]) -> List[float]:
+    """Accept "1;2;3", "1,2,3", a single number or a sequence."""
+    if isinstance(values, str):
+        return [float(tok) for tok in values.replace(",", ";").replace(" ", ";").split(";") if tok]
+    if isinstance(values, (int, float)):
+        return [float(values)]
+    return [float(v) for v in values]
+
+
+def _format_list(values: str | float | int | Sequence[float]) -> str:
+    """';'-joined list (KXCI splits EX parameters on ',')."""
+    return ";".join(format_param(v) for v in _as_list(values))
+
+
+def _expand(values: Sequence[float], num_legs: int, fallback: float) -> List[float]:
+    """Per-leg list rules of smu_sweep_plan_expand()."""
+    if not values:
+        return [fallback] * num_legs
+    if len(values) == 1:
+        return [values[0]] * num_legs
+    if len(values) != num_legs:
+        raise ValueError(f"per-leg list has {len(values)} values, need 1 or {num_legs}")
+    return list(values)
+
+
+def sweep_plan_voltages(
+    vertices: str | Sequence[float],
+    leg_points: str | int | Sequence[float],
+    num_cycles: int = 1,
+) -> List[float]:
+    """Forced voltage of every point (Python mirror of smu_sweep_plan_voltages)."""
+    vx = _as_list(vertices)
+    if not (2 <= len(vx) <= MAX_VERTICES):
+        raise ValueError(f"need 2 to {MAX_VERTICES} vertices, got {len(vx)}")
+    steps = [int(p + 0.5) for p in _expand(_as_list(leg_points), len(vx) - 1, 0.0)]
+    if any(s < 1 for s in steps):
+        raise ValueError("every leg needs at least 1 point")
+    closed = abs(vx[-1] - vx[0]) < V_EPS
+
+    def leg(v_start: float, v_stop: float, n_steps: int) -> List[float]:
+        return [v_stop if n == n_steps else v_start + (v_stop - v_start) * n / n_steps for n in range(1, n_steps + 1)]
+
+    points = [vx[0]]
+    for cycle in range(max(1, int(num_cycles))):
+        if cycle > 0 and not closed:
+            points.append(vx[0])
+        for k, n_steps in enumerate(steps):
+            points.extend(leg(vx[k], vx[k + 1], n_steps))
+    return points
+
+
+def plan_point_count(vertices: str | Sequence[float], leg_points: str | int | Sequence[float], num_cycles: int = 1) -> int:
+    """Number of points smu_plan_sweep measures (array size to pass)."""
+    return len(sweep_plan_voltages(vertices, leg_points, num_cycles))
+
+
+def shape_vertices(shape: str, *, vhigh: float = 2.0, vlow: float = -2.0, vstart: float = -1.0,
+                   vstop: float = 1.0, vamp: float = 1.0) -> List[float]:
+    """Vertex list for the fixed shapes of the older sweep modules."""
+    if shape == "loop":
+        return [0.0, vhigh, 0.0, vlow, 0.0]
+    if shape == "linear":
+        return [vstart, vstop]
+    if shape == "dc":
+        return [0.0, vamp, vamp, 0.0]
+    raise ValueError(f"unknown shape '{shape}'")
+
+
+def build_ex_command(
+    vertices: str | Sequence[float],
+    leg_points: str | int | Sequence[float],
+    num_points: int,
+    num_cycles: int = 1,
+    leg_dwell: str | float | Sequence[float] = "",
+    leg_ilimit: str | float | Sequence[float] = "",
+    leg_irange: str | float | Sequence[float] = "",
+    integration_time: float = 0.01,
+    sweep_mode: int = 0,
+    clarius_debug: int = 0,
+) -> str:
+    """Build EX command for smu_plan_sweep.
+
+    Parameters (16 total):
+    1. Vertices, 2. LegPoints, 3. LegDwell, 4. LegIlimit, 5. LegIRange (';' lists),
+    6. NumCycles, 7. Imeas (output), 8. NumIPoints, 9. Vforce (output), 10. NumVPoints,
+    11. Tmeas (output), 12. NumTPoints, 13. NumPointsOut (int output),
+    14. IntegrationTime, 15. SweepMode (0=hardware sweepv, 1=stepped), 16. ClariusDebug
+    """
+    params = [
+        _format_list(vertices),                # 1: Vertices
+        _format_list(leg_points),              # 2: LegPoints
+        _format_list(leg_dwell),               # 3: LegDwell ("" = 1 ms)
+        _format_list(leg_ilimit),              # 4: LegIlimit ("" = 0.1 A)
+        _format_list(leg_irange),              # 5: LegIRange ("" = auto)
+        format_param(int(num_cycles)),         # 6: NumCycles
+        "",                                    # 7: Imeas output array
+        format_param(int(num_points)),         # 8: NumIPoints
+        "",                                    # 9: Vforce output array
+        format_param(int(num_points)),         # 10: NumVPoints
+        "",                                    # 11: Tmeas output array
+        format_param(int(num_points)),         # 12: NumTPoints
+        "",                                    # 13: NumPointsOut output
+        format_param(integration_time),        # 14: IntegrationTime
+        format_param(1 if int(sweep_mode) == 1 else 0),  # 15: SweepMode
+        format_param(int(bool(clarius_debug))),  # 16: ClariusDebug
+    ]
+    return f"EX A_Iv_Sweep smu_plan_sweep({','.join(params)})"
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description="Piecewise-linear SMU sweep for Keithley 4200A-SCS",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog=__doc__,
+    )
+    parser.add_argument("--gpib-address", type=str, default="GPIB0::17::INSTR")
+    parser.add_argument("--timeout", type=float, default=60.0)
+    parser.add_argument("--vertices", type=str, default="", help="Vertex list, e.g. \"0;2;0;-2;0\" (overrides --shape)")
+    parser.add_argument("--shape", choices=("loop", "linear", "dc"), default="loop")
+    parser.add_argument("--vhigh", type=float, default=2.0, help="loop: positive vertex (V)")
+    parser.add_argument("--vlow", type=float, default=-2.0, help="loop: negative vertex (V)")
+    parser.add_argument("--vstart", type=float, default=-1.0, help="linear: start voltage (V)")
+    parser.add_argument("--vstop", type=float, default=1.0, help="linear: stop voltage (V)")
+    parser.add_argument("--vamp", type=float, default=1.0, help="dc: peak voltage (V)")
+    parser.add_argument("--hold", type=float, default=0.0, help="dc: hold time at the peak (s)")
+    parser.add_argument("--leg-points", type=str, default="10", help="Points per leg, one value or one per leg")
+    parser.add_argument("--leg-dwell", type=str, default="0.001", help="Dwell per point (s), one value or one per leg")
+    parser.add_argument("--leg-ilimit", type=str, default="0.1", help="Compliance (A), one value or one per leg")
+    parser.add_argument("--leg-irange", type=str, default="0", help="Current range (A, 0 = auto), one value or one per leg")
+    parser.add_argument("--num-cycles", type=int, default=1, help="Number of cycles (1-1000)")
+    parser.add_argument("--integration-time", type=float, default=0.01, help="Integration time (PLC)")
+    parser.add_argument("--stepped", action="store_true", help="Use forcev()/measi() per point instead of sweepv()")
+    parser.add_argument("--debug", action="store_true", help="Enable ClariusDebug output")
+    parser.add_argument("--dry-run", action="store_true", help="Print EX command without executing")
+    parser.add_argument("--no-plot", action="store_true", help="Skip plotting results")
+    args = parser.parse_args()
+
+    leg_points: str | List[float] = args.leg_points
+    leg_dwell: str | List[float] = args.leg_dwell
+    if args.vertices:
+        vertices = _as_list(args.vertices)
+    else:
+        vertices = shape_vertices(args.shape, vhigh=args.vhigh, vlow=args.vlow, vstart=args.vstart,
+                                  vstop=args.vstop, vamp=args.vamp)
+        if args.shape == "dc":
+            # Hold leg: one point at the peak, dwell = hold time
+            points = _as_list(args.leg_points)[0]
+            dwell = _as_list(args.leg_dwell)[0]
+            leg_points = [points, 1, points]
+            leg_dwell = [dwell, max(args.hold, dwell), dwell]
+
+    if not (1 <= args.num_cycles <= 1000):
+        parser.error("num-cycles must be in range [1, 1000]")
+    try:
+        voltages = sweep_plan_voltages(vertices, leg_points, args.num_cycles)
+        for values in (leg_dwell, args.leg_ilimit, args.leg_irange):
+            _expand(_as_list(values), len(vertices) - 1, 0.0)
+    except ValueError as exc:
+        parser.error(str(exc))
+    num_points = len(voltages)
+
+    command = build_ex_command(
+        vertices=vertices,
+        leg_points=leg_points,
+        num_points=num_points,
+        num_cycles=args.num_cycles,
+        leg_dwell=leg_dwell,
+        leg_ilimit=args.leg_ilimit,
+        leg_irange=args.leg_irange,
+        integration_time=args.integration_time,
+        sweep_mode=1 if args.stepped else 0,
+        clarius_debug=1 if args.debug else 0,
+    )
+
+    if args.dry_run:
+        print(f"[DRY RUN] {num_points} points")
+        print(command)
+        return
+
+    controller = KXCIClient(gpib_address=args.gpib_address, timeout=args.timeout)
+    if not controller.connect():
+        print("[ERROR] Failed to connect to instrument")
+        return
+
+    try:
+        if not controller._enter_ul_mode():  # pylint: disable=protected-access
+            raise RuntimeError("Failed to enter UL mode")
+
+        dwell_total = sum(
+            n * d for n, d in zip(
+                [int(p + 0.5) for p in _expand(_as_list(leg_points), len(vertices) - 1, 0.0)],
+                _expand(_as_list(leg_dwell), len(vertices) - 1, 0.001),
+            )
+        ) * args.num_cycles
+        wait_seconds = max(1.0, dwell_total + num_points * 0.005)
+        print(f"[KXCI] Plan: {len(vertices)} vertices × {args.num_cycles} cycles = {num_points} points")
+        return_value, error = controller._execute_ex_command(command, wait_seconds=wait_seconds)  # pylint: disable=protected-access
+        if error:
+            raise RuntimeError(f"EX command failed: {error}")
+        if return_value is not None and return_value < 0:
+            raise RuntimeError(f"EX command returned error code: {return_value}")
+
+        time.sleep(0.2)
+        current: List[float] = controller._query_gp(GP_IMEAS, num_points)  # pylint: disable=protected-access
+        voltage: List[float] = controller._query_gp(GP_VFORCE, num_points)  # pylint: disable=protected-access
+        timestamps: List[float] = controller._query_gp(GP_TMEAS, num_points)  # pylint: disable=protected-access
+        n = min(len(current), len(voltage), len(timestamps))
+
+        print(f"[RESULTS] {n} points")
+        print(f"{'Idx':>4} {'Time (s)':>12} {'Voltage (V)':>14} {'Current (A)':>14}")
+        for idx in range(min(n, 50)):
+            print(f"{idx:>4} {timestamps[idx]:>12.6f} {voltage[idx]:>14.6f} {current[idx]:>14.6e}")
+        if n > 50:
+            print(f"... ({n - 50} more points)")
+
+        if not args.no_plot and n:
+            try:
+                import matplotlib.pyplot as plt
+
+                plt.semilogy(voltage[:n], [abs(i) for i in current[:n]], "b-o", markersize=3)
+                plt.xlabel("Voltage (V)")
+                plt.ylabel("|Current| (A)")
+                plt.title("Sweep plan")
+                plt.grid(True, alpha=0.3)
+                plt.show()
+            except ImportError:
+                print("\n[INFO] matplotlib not available, skipping plot")
+    finally:
+        try:
+            controller._exit_ul_mode()  # pylint: disable=protected-access
+        except Exception:
+            pass
+        controller.disconnect()
+
+
+if __name__ == "__main__":
+    main()
@@ -37,6 +37,9 @@ Parameters:
              Total points = (NumSteps + 1) × NumCycles
 - StepDelay: Delay at each step before measurement (seconds, default: 0.001 s = 1 ms)
 - Ilimit: Current compliance limit (A, default: 0.1 A)
+- RangeMode: 0 = IRange as given (0 = auto), 1 = predictive range per point
+- TurnMode: 0 = off, 1 = reverse at compliance/TurnCurrent, 2 = skip to 0V
+            (only the points actually swept are returned, see NumPointsOut)
 
 Usage examples:
 
@@ -55,6 +58,12 @@ Usage examples:
     # Custom current limit for high-resistance devices
     python run_smu_vi_sweep.py --vhigh 5 --vlow -5 --num-steps 20 --ilimit 1e-6
 
+    # Wide dynamic range (HRS/LRS loop) without per-point auto-range search
+    python run_smu_vi_sweep.py --vhigh 2 --vlow -2 --num-steps 100 --ilimit 1e-2 --range-mode 1
+
+    # Forming/SET: turn round as soon as |I| reaches 100 µA instead of sweeping on at compliance
+    python run_smu_vi_sweep.py --vhigh 4 --vlow -2 --num-steps 80 --ilimit 1e-4 --turn-mode 1
+
 Pass `--dry-run` to print the generated EX command without contacting the instrument.
 """
 
@@ -250,15 +259,20 @@ def build_ex_command(
     irange: float,
     integration_time: float,
     clarius_debug: int,
+    range_mode: int = 0,
+    turn_mode: int = 0,
+    turn_current: float = 0.0,
+    num_turn_points: Optional[int] = None,
 ) -> str:
     """Build EX command for smu_ivsweep.
     
     Function signature:
     int smu_ivsweep(double Vhigh, double Vlow, int NumSteps, int NumCycles, double *Imeas, int NumIPoints,
                     double *Vforce, int NumVPoints, double StepDelay, double Ilimit,
-                    double IRange, double IntegrationTime, int ClariusDebug)
+                    double IRange, double IntegrationTime, int RangeMode, int TurnMode, double TurnCurrent,
+                    double *TurnIdx, int NumTurnPoints, int *NumPointsOut, int ClariusDebug)
     
-    Parameters (13 total):
+    Parameters (19 total):
     1. Vhigh (double, Input) - Positive voltage limit (V), must be >= 0
     2. Vlow (double, Input) - Negative voltage limit (V), must be <= 0
     3. NumSteps (int, Input) - Total steps across full sweep path (4-10000)
@@ -270,8 +284,15 @@ def build_ex_command(
     9. StepDelay (double, Input) - Delay per step (seconds)
     10. Ilimit (double, Input) - Current compliance limit (A)
     11. IRange (double, Input) - Current measurement range (A), 0 = auto range
+        (with RangeMode=1: lowest range the predictor may select, 0 = 1 nA)
     12. IntegrationTime (double, Input) - PLC (Power Line Cycles)
-    13. ClariusDebug (int, Input) - 0=off, 1=on
+    13. RangeMode (int, Input) - 0=IRange as given, 1=predictive range from previous point
+    14. TurnMode (int, Input) - 0=off, 1=reverse, 2=skip to 0V when an outgoing segment hits the threshold
+    15. TurnCurrent (double, Input) - |I| threshold (A), 0 = compliance (99% of Ilimit)
+    16. TurnIdx (D_ARRAY_T, Output) - GP parameter 16, global index of each turn (-1 = unused)
+    17. NumTurnPoints (int, Input) - size of TurnIdx (default 2 × NumCycles)
+    18. NumPointsOut (int *, Output) - GP parameter 18, points actually stored
+    19. ClariusDebug (int, Input) - 0=off, 1=on
     
     Pattern: (0V → Vhigh → 0V → Vlow → 0V) × NumCycles
     Total points = (NumSteps + 1) × NumCycles
@@ -282,6 +303,10 @@ def build_ex_command(
     
     # Ensure clarius_debug is an integer (0 or 1)
     clarius_debug = int(bool(clarius_debug))  # Convert to 0 or 1
+    range_mode = 1 if int(range_mode) == 1 else 0
+    turn_mode = int(turn_mode) if int(turn_mode) in (1, 2) else 0
+    if num_turn_points is None:
+        num_turn_points = 2 * int(num_cycles)
     
     params = [
         format_param(vhigh),            # 1: Vhigh
@@ -296,11 +321,17 @@ def build_ex_command(
         format_param(ilimit),           # 10: Ilimit
         format_param(irange),           # 11: IRange
         format_param(integration_time), # 12: IntegrationTime
-        format_param(clarius_debug),    # 13: ClariusDebug
+        format_param(range_mode),       # 13: RangeMode
+        format_param(turn_mode),        # 14: TurnMode
+        format_param(turn_current),     # 15: TurnCurrent
+        "",                             # 16: TurnIdx output array (empty string)
+        format_param(num_turn_points),  # 17: NumTurnPoints
+        "",                             # 18: NumPointsOut output (empty string)
+        format_param(clarius_debug),    # 19: ClariusDebug
     ]
     
     # Debug: verify the debug flag is correctly formatted
-    debug_param = params[12]  # 13th parameter (0-indexed: 12)
+    debug_param = params[18]  # 19th parameter (0-indexed: 18)
     if clarius_debug == 1 and debug_param != "1":
         print(f"[WARNING] Debug flag mismatch: clarius_debug={clarius_debug}, formatted='{debug_param}'")
     
@@ -372,7 +403,27 @@ def main() -> None:
         "--irange",
         type=float,
         default=0.0,
-        help="Current measurement range (A). Use 0.0 for auto range (default: 0.0)."
+        help="Current measurement range (A). Use 0.0 for auto range (default: 0.0). With --range-mode 1 this is the lowest range the predictor may select."
+    )
+    parser.add_argument(
+        "--range-mode",
+        type=int,
+        choices=(0, 1),
+        default=0,
+        help="0 = use --irange as given, 1 = predictive range: pre-select each point's range from the previous reading and fall back to auto only on over/under-range (default: 0)"
+    )
+    parser.add_argument(
+        "--turn-mode",
+        type=int,
+        choices=(0, 1, 2),
+        default=0,
+        help="Reaction when an outgoing segment reaches compliance/--turn-current: 0 = continue to the vertex, 1 = reverse and retrace to 0V, 2 = skip straight to 0V and the next segment (default: 0)"
+    )
+    parser.add_argument(
+        "--turn-current",
+        type=float,
+        default=0.0,
+        help="|I| (A) that triggers --turn-mode. 0.0 = compliance threshold (99%% of --ilimit) (default: 0.0)"
     )
     parser.add_argument(
         "--integration-time",
@@ -444,6 +495,9 @@ def main() -> None:
         irange=args.irange,
         integration_time=args.integration_time,
         clarius_debug=clarius_debug,
+        range_mode=args.range_mode,
+        turn_mode=args.turn_mode,
+        turn_current=args.turn_current,
     )
     
     if args.dry_run:
@@ -501,7 +555,13 @@ def main() -> None:
         print(f"[KXCI] Total points: {num_points} (({args.num_steps} + 1) × {args.num_cycles})")
         print(f"[KXCI] Step delay: {args.step_delay*1000:.1f} ms per step")
         print(f"[KXCI] Current limit: {args.ilimit:.2e} A")
-        print(f"[KXCI] Current range: {args.irange:.2e} A ({'AUTO' if args.irange == 0.0 else 'FIXED'})")
+        if args.range_mode == 1:
+            print(f"[KXCI] Current range: PREDICTIVE (lowest {args.irange if args.irange > 0.0 else 1e-9:.2e} A)")
+        else:
+            print(f"[KXCI] Current range: {args.irange:.2e} A ({'AUTO' if args.irange == 0.0 else 'FIXED'})")
+        if args.turn_mode != 0:
+            threshold = args.turn_current if args.turn_current > 0.0 else 0.99 * args.ilimit
+            print(f"[KXCI] Turn policy: {'REVERSE' if args.turn_mode == 1 else 'SKIP'} at |I| >= {threshold:.2e} A")
         print(f"[KXCI] Integration time: {args.integration_time:.6f} PLC")
         print(f"[KXCI] Debug output: {'ON' if args.debug else 'OFF'}")
         
@@ -533,7 +593,8 @@ def main() -> None:
         # Based on function signature: 
         # 1=Vhigh, 2=Vlow, 3=NumSteps, 4=NumCycles, 5=Imeas (output), 6=NumIPoints,
         # 7=Vforce (output), 8=NumVPoints, 9=StepDelay, 10=Ilimit, 11=IRange,
-        # 12=IntegrationTime, 13=ClariusDebug
+        # 12=IntegrationTime, 13=RangeMode, 14=TurnMode, 15=TurnCurrent,
+        # 16=TurnIdx (output), 17=NumTurnPoints, 18=NumPointsOut (output), 19=ClariusDebug
         def safe_query(param: int, count: int, name: str = "") -> List[float]:
             """Query GP parameter with retry."""
             for attempt in range(3):
@@ -551,6 +612,14 @@ def main() -> None:
                         return []
             return []
         
+        if args.turn_mode != 0:
+            # The sweep may have turned early: only NumPointsOut points are valid
+            count = safe_query(18, 1, "NumPointsOut")
+            if count:
+                num_points = min(num_points, int(count[0]))
+            turns = [int(t) for t in safe_query(16, 2 * args.num_cycles, "TurnIdx") if t >= 0]
+            print(f"[KXCI] Sweep turned {len(turns)} time(s) at indices {turns}")
+        
         print(f"[KXCI] Requesting {num_points} points")
         # GP parameter 7 = Vforce (7th parameter in function signature, after NumIPoints)
         # GP parameter 5 = Imeas (5th parameter in function signature, after NumCycles)
@@ -0,0 +1,454 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: smu_adaptive_ivsweep
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 20
+	ARGUMENTS:
+		Vhigh,	double,	Input,	2,	0,	200
+		Vlow,	double,	Input,	-2,	-200,	0
+		CoarseSteps,	int,	Input,	20,	4,	10000
+		NumCycles,	int,	Input,	1,	1,	1000
+		MinStep,	double,	Input,	0.01,	1e-6,	10
+		RelThreshold,	double,	Input,	0.5,	0,	100
+		SlopeThreshold,	double,	Input,	0,	0,	1000
+		Imeas,	D_ARRAY_T,	Output,	,	,
+		NumIPoints,	int,	Input,	200,	5,	100000
+		Vforce,	D_ARRAY_T,	Output,	,	,
+		NumVPoints,	int,	Input,	200,	5,	100000
+		NumPointsOut,	int *,	Output,	,	,
+		StepDelay,	double,	Input,	0.001,	0.0001,	10.0
+		Ilimit,	double,	Input,	0.1,	1e-9,	1.0
+		IRange,	double,	Input,	0.0,	0.0,	1.0
+		IntegrationTime,	double,	Input,	0.01,	0.0001,	1.0
+		RangeMode,	int,	Input,	0,	0,	1
+		RefineFactor,	int,	Input,	4,	2,	64
+		CalmPoints,	int,	Input,	2,	1,	100
+		ClariusDebug,	int,	Input,	0,	0,	1
+	INCLUDES:
+#include "keithley.h"
+#include <math.h>
+#include <stdio.h>
+#include "smu_range_hint.h"
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+
+SMU Adaptive Step-Density IV Sweep
+==================================
+
+Same path as smu_ivsweep: (0 → Vhigh → 0 → Vlow → 0) × NumCycles, but the
+voltage step is not uniform. Flat regions are swept at the coarse step and the
+step shrinks automatically around switching events (SET/RESET), so a loop
+needs far fewer points for the same transition resolution.
+
+The sweep is strictly causal: a memristor cannot be stepped backwards to fill
+in a transition it has already made, so refinement works forwards.
+- After every point the change from the previous point is tested.
+- If it exceeds a threshold, the following points use a fine step
+  (current step / RefineFactor, never below MinStep).
+- After CalmPoints consecutive quiet points the step doubles back towards
+  the coarse step.
+- Voltages where a cycle had to refine are remembered, and the next cycle
+  switches to the fine step one coarse step BEFORE reaching them. From cycle 2
+  onwards the SET/RESET onset is therefore captured at full resolution.
+
+PARAMETERS:
+- Vhigh, Vlow: Sweep vertices (V). Vhigh >= 0, Vlow <= 0
+- CoarseSteps: Steps per cycle at the coarse step. The coarse step is the
+               cycle path length (2*Vhigh + 2*|Vlow|) / CoarseSteps
+- NumCycles: Number of cycles (1 to 1000)
+- MinStep: Smallest voltage step used when refining (V)
+- RelThreshold: Refine when the chord conductance I/V changes by more than
+                this fraction between neighbouring points (|ΔI/I| with the
+                ohmic V-scaling removed). 0 disables the test
+- SlopeThreshold: Refine when |ΔI/ΔV| exceeds this value (A/V). 0 disables
+- Imeas, NumIPoints: Output current array; its size is the point budget
+- Vforce, NumVPoints: Output forced-voltage array (size must equal NumIPoints)
+- NumPointsOut: Number of points actually measured (rest of arrays are 0)
+- StepDelay, Ilimit, IRange, IntegrationTime, RangeMode: as smu_ivsweep
+- RefineFactor: Step divisor when a transition is detected (2 to 64)
+- CalmPoints: Quiet points required before the step grows again
+- ClariusDebug: 0 = off, 1 = print progress
+
+POINT BUDGET:
+The module never refines if doing so would leave too few points to finish the
+remaining path at the coarse step, so the sweep always completes. NumIPoints
+must hold at least (CoarseSteps + 4) × NumCycles + 1 points. A budget of 1.5-2×
+that is typically enough for every transition to be fully refined.
+
+ERROR CODES:
+- -1: Invalid Vhigh/Vlow
+- -2: NumIPoints != NumVPoints
+- -3: Point budget smaller than the coarse sweep
+- -5: Invalid CoarseSteps or NumCycles
+- -6: limiti() failed
+- -7: measi() failed
+- -8: rangei() failed
+- -100-i: forcev() failed at point i
+
+END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include <math.h>  /* For fabs(), ceil() */
+#include <stdio.h>  /* For printf() function */
+#include <Windows.h>  /* For Sleep() and timing functions */
+#include "smu_range_hint.h"  /* Predictive current range (RangeMode = 1) */
+
+/* Currents below this are treated as noise when forming relative changes */
+#define ADAPT_I_FLOOR 1e-10
+
+/* Voltages where refinement was needed, remembered for the next cycle */
+#define ADAPT_MAX_HOT 256
+
+/* Number of vertices in the (0 → Vhigh → 0 → Vlow → 0) path */
+#define ADAPT_NUM_VERTICES 5
+
+/* USRLIB MODULE MAIN FUNCTION */
+int smu_adaptive_ivsweep( double Vhigh, double Vlow, int CoarseSteps, int NumCycles, double MinStep,
+                          double RelThreshold, double SlopeThreshold, double *Imeas, int NumIPoints,
+                          double *Vforce, int NumVPoints, int *NumPointsOut, double StepDelay,
+                          double Ilimit, double IRange, double IntegrationTime, int RangeMode,
+                          int RefineFactor, int CalmPoints, int ClariusDebug )
+{
+/* USRLIB MODULE CODE */
+/* Adaptive step-density IV sweep: 0 → Vhigh → 0 → Vlow → 0V, repeated NumCycles times
+
+--------------
+Features:
+- Coarse steps in flat regions, fine steps around switching events
+- Cycle-to-cycle memory of transition voltages (refines ahead of them)
+- Hard point budget (NumIPoints), sweep always reaches the final 0 V
+- Optional predictive current ranging (RangeMode = 1)
+
+*/
+
+double vertices[ADAPT_NUM_VERTICES]; /* Path vertices for one cycle */
+double hot_v[ADAPT_MAX_HOT];         /* Refinement voltages from the previous cycle */
+int hot_dir[ADAPT_MAX_HOT];          /* Leg direction (+1/-1) for each hot voltage */
+double new_hot_v[ADAPT_MAX_HOT];     /* Refinement voltages collected this cycle */
+int new_hot_dir[ADAPT_MAX_HOT];
+int num_hot = 0, num_new_hot = 0;
+double coarse_step;      /* Coarse voltage step (V) */
+double step;             /* Current voltage step magnitude (V) */
+double cycle_length;     /* |V| path length of one cycle (V) */
+double remaining_length; /* |V| path length still to sweep (V) */
+double v, v_prev, v_target;
+double i_prev;
+double dir;
+int have_prev;
+int i, k, cycle, leg;
+int calm;
+int status;
+int debug;
+int refined_points = 0;
+int needed;
+int delay_ms;
+smu_range_hint_t range_hint;
+
+/* ============================================================
+   INITIALIZE VARIABLES
+   ============================================================ */
+
+debug = (ClariusDebug == 1) ? 1 : 0;
+if ( NumPointsOut != NULL ) *NumPointsOut = 0;
+
+/* ============================================================
+   INPUT VALIDATION
+   ============================================================ */
+
+if ( Vhigh < 0.0 || Vlow > 0.0 || (Vhigh == 0.0 && Vlow == 0.0) )
+{
+    if(debug) printf("smu_adaptive_ivsweep ERROR: need Vhigh >= 0, Vlow <= 0 and a non-zero range\n");
+    return( -1 );
+}
+
+if ( NumIPoints != NumVPoints )
+{
+    if(debug) printf("smu_adaptive_ivsweep ERROR: Array size mismatch - NumIPoints=%d, NumVPoints=%d\n", NumIPoints, NumVPoints);
+    return( -2 );
+}
+
+if ( (CoarseSteps < 4) || (CoarseSteps > 10000) || (NumCycles < 1) || (NumCycles > 1000) )
+{
+    if(debug) printf("smu_adaptive_ivsweep ERROR: CoarseSteps (%d) must be 4-10000 and NumCycles (%d) 1-1000\n", CoarseSteps, NumCycles);
+    return( -5 );
+}
+
+cycle_length = 2.0 * Vhigh + 2.0 * fabs(Vlow);
+coarse_step = cycle_length / (double)CoarseSteps;
+
+/* Budget must at least cover the coarse sweep (each leg may add one point
+   where the last coarse step is clipped to land on the vertex) */
+needed = (CoarseSteps + 4) * NumCycles + 1;
+if ( NumIPoints < needed )
+{
+    if(debug) printf("smu_adaptive_ivsweep ERROR: NumIPoints=%d too small, need >= %d for the coarse sweep\n", NumIPoints, needed);
+    return( -3 );
+}
+
+if ( MinStep <= 0.0 || MinStep > coarse_step ) MinStep = coarse_step;
+if ( RefineFactor < 2 ) RefineFactor = 2;
+if ( CalmPoints < 1 ) CalmPoints = 1;
+if ( RelThreshold < 0.0 ) RelThreshold = 0.0;
+if ( SlopeThreshold < 0.0 ) SlopeThreshold = 0.0;
+if ( StepDelay < 0.001 ) StepDelay = 0.001;
+if ( Ilimit < 1e-9 ) Ilimit = 1e-9;
+if ( IRange < 0.0 ) IRange = 0.0;
+if ( IntegrationTime < 0.0001 ) IntegrationTime = 0.0001;
+if ( RangeMode != 1 ) RangeMode = 0;
+
+delay_ms = (int)(StepDelay * 1000.0 + 0.5);
+if ( delay_ms < 1 ) delay_ms = 1;
+
+for ( i = 0; i < NumIPoints; i++ )
+{
+    Imeas[i] = 0.0;
+    Vforce[i] = 0.0;
+}
+
+/* ============================================================
+   CONFIGURE SMU (INTEGRATION TIME, CURRENT LIMIT, RANGE)
+   ============================================================ */
+
+status = setmode(SMU1, KI_INTGPLC, IntegrationTime);
+if ( status != 0 && debug )
+    printf("smu_adaptive_ivsweep WARNING: setmode(KI_INTGPLC) failed: %d (continuing with default)\n", status);
+
+status = limiti(SMU1, Ilimit);
+if ( status != 0 )
+{
+    if(debug) printf("smu_adaptive_ivsweep ERROR: limiti() failed with status: %d\n", status);
+    return( -6 );
+}
+
+if ( RangeMode == 1 )
+{
+    smu_range_hint_init(&range_hint, IRange, Ilimit);
+    setauto(SMU1);
+}
+else if ( IRange > 0.0 )
+{
+    status = rangei(SMU1, IRange);
+    if ( status != 0 )
+    {
+        if(debug) printf("smu_adaptive_ivsweep ERROR: rangei() failed with status: %d\n", status);
+        return( -8 );
+    }
+}
+
+vertices[0] = 0.0;
+vertices[1] = Vhigh;
+vertices[2] = 0.0;
+vertices[3] = Vlow;
+vertices[4] = 0.0;
+
+if(debug)
+{
+    printf("\n========================================\n");
+    printf("smu_adaptive_ivsweep: Starting adaptive IV sweep\n");
+    printf("========================================\n");
+    printf("  Pattern: (0V → +%.6fV → 0V → %.6fV → 0V) × %d cycles\n", Vhigh, Vlow, NumCycles);
+    printf("  Coarse step: %.6f V (%d steps/cycle), min step: %.6f V\n", coarse_step, CoarseSteps, MinStep);
+    printf("  RelThreshold: %.3f, SlopeThreshold: %.3e A/V\n", RelThreshold, SlopeThreshold);
+    printf("  RefineFactor: %d, CalmPoints: %d\n", RefineFactor, CalmPoints);
+    printf("  Point budget: %d\n", NumIPoints);
+    printf("========================================\n\n");
+}
+
+/* ============================================================
+   ADAPTIVE SWEEP LOOP
+   ============================================================ */
+
+remaining_length = cycle_length * (double)NumCycles;
+i = 0;
+v = 0.0;
+v_prev = 0.0;
+i_prev = 0.0;
+have_prev = 0;
+step = coarse_step;
+calm = 0;
+
+for ( cycle = 0; cycle < NumCycles; cycle++ )
+{
+    num_new_hot = 0;
+
+    for ( leg = 0; leg < ADAPT_NUM_VERTICES - 1; leg++ )
+    {
+        v_target = vertices[leg + 1];
+        if ( v_target == vertices[leg] ) continue;
+        dir = (v_target > vertices[leg]) ? 1.0 : -1.0;
+
+        /* The very first point of the sweep is the 0 V start; every later
+           point is a step along the current leg */
+        while ( (i == 0) || (dir * (v_target - v) > 1e-12) )
+        {
+            double this_step = step;
+            int near_hot = 0;
+            int remaining_coarse;
+            double vm_abs;
+
+            if ( i > 0 )
+            {
+                /* Refine ahead of voltages that switched last cycle */
+                for ( k = 0; k < num_hot; k++ )
+                {
+                    if ( hot_dir[k] == (int)dir &&
+                         dir * (hot_v[k] - v) > 0.0 && dir * (hot_v[k] - v) <= coarse_step )
+                    {
+                        near_hot = 1;
+                        break;
+                    }
+                }
+                if ( near_hot )
+                {
+                    double fine = coarse_step / (double)RefineFactor;
+                    if ( fine < MinStep ) fine = MinStep;
+                    if ( this_step > fine ) this_step = fine;
+                }
+
+                /* Budget guard: refining must still leave enough points to
+                   finish the remaining path at the coarse step */
+                remaining_coarse = (int)ceil(remaining_length / coarse_step - 1e-9) + 4 * (NumCycles - cycle);
+                if ( this_step < coarse_step && (NumIPoints - i - 1) <= remaining_coarse )
+                {
+                    this_step = coarse_step;
+                    step = coarse_step;
+                }
+
+                if ( this_step > dir * (v_target - v) ) this_step = dir * (v_target - v);
+                v = v + dir * this_step;
+                if ( dir * (v - v_target) > 0.0 || fabs(v - v_target) < 1e-12 ) v = v_target;
+                remaining_length -= this_step;
+            }
+
+            if ( i >= NumIPoints )
+            {
+                /* Budget guard above makes this unreachable; stop safely */
+                if(debug) printf("smu_adaptive_ivsweep WARNING: point budget exhausted at V=%.6f\n", v);
+                cycle = NumCycles;
+                leg = ADAPT_NUM_VERTICES;
+                break;
+            }
+
+            status = forcev(SMU1, v);
+            if ( status != 0 )
+            {
+                if(debug) printf("smu_adaptive_ivsweep ERROR: forcev() failed at point %d (voltage=%.6f V) with status: %d\n", i, v, status);
+                forcev(SMU1, 0.0);
+                if ( NumPointsOut != NULL ) *NumPointsOut = i;
+                return( -100 - i );
+            }
+
+            if ( RangeMode == 1 ) smu_range_hint_prepare(&range_hint, SMU1, v);
+
+            Sleep(delay_ms);
+
+            if ( RangeMode == 1 )
+                status = smu_range_hint_measi(&range_hint, SMU1, v, &Imeas[i]);
+            else
+                status = measi(SMU1, &Imeas[i]);
+            if ( status != 0 )
+            {
+                if(debug) printf("smu_adaptive_ivsweep ERROR: measi() failed at point %d (voltage=%.6f V) with status: %d\n", i, v, status);
+                forcev(SMU1, 0.0);
+                if ( NumPointsOut != NULL ) *NumPointsOut = i;
+                return( -7 );
+            }
+
+            Vforce[i] = v;
+            if ( this_step < coarse_step ) refined_points++;
+
+            /* ------------------------------------------------------------
+               Transition detection: decide the step for the next point
+               ------------------------------------------------------------ */
+            if ( have_prev && v != v_prev )
+            {
+                int trigger = 0;
+                double di = Imeas[i] - i_prev;
+
+                if ( SlopeThreshold > 0.0 && fabs(di / (v - v_prev)) > SlopeThreshold )
+                    trigger = 1;
+
+                /* Relative change of I/V, so ohmic scaling alone never triggers */
+                vm_abs = fabs(v);
+                if ( RelThreshold > 0.0 && vm_abs >= MinStep && fabs(v_prev) >= MinStep )
+                {
+                    double g_now = fabs(Imeas[i]) / vm_abs;
+                    double g_prev = fabs(i_prev) / fabs(v_prev);
+                    double g_ref = (g_now > g_prev) ? g_now : g_prev;
+                    double g_floor = ADAPT_I_FLOOR / vm_abs;
+                    if ( g_ref < g_floor ) g_ref = g_floor;
+                    if ( fabs(g_now - g_prev) / g_ref > RelThreshold )
+                        trigger = 1;
+                }
+
+                if ( trigger )
+                {
+                    step = step / (double)RefineFactor;
+                    if ( step < MinStep ) step = MinStep;
+                    calm = 0;
+                    if ( num_new_hot < ADAPT_MAX_HOT )
+                    {
+                        new_hot_v[num_new_hot] = v;
+                        new_hot_dir[num_new_hot] = (int)dir;
+                        num_new_hot++;
+                    }
+                    if(debug) printf("  Cycle %2d, point %4d: transition at V=%.6f V (I %.3e → %.3e A), step → %.6f V\n",
+                                     cycle + 1, i, v, i_prev, Imeas[i], step);
+                }
+                else if ( step < coarse_step )
+                {
+                    calm++;
+                    if ( calm >= CalmPoints )
+                    {
+                        step = step * 2.0;
+                        if ( step > coarse_step ) step = coarse_step;
+                        calm = 0;
+                    }
+                }
+            }
+
+            v_prev = v;
+            i_prev = Imeas[i];
+            have_prev = 1;
+            i++;
+        }
+    }
+
+    /* Voltages that switched this cycle are refined ahead of next cycle */
+    for ( k = 0; k < num_new_hot; k++ )
+    {
+        hot_v[k] = new_hot_v[k];
+        hot_dir[k] = new_hot_dir[k];
+    }
+    num_hot = num_new_hot;
+
+    if(debug) printf("  Cycle %2d complete: %d points so far, %d transition(s) flagged\n", cycle + 1, i, num_new_hot);
+}
+
+/* ============================================================
+   CLEANUP: RETURN TO ZERO VOLTAGE
+   ============================================================ */
+
+forcev(SMU1, 0.0);
+if ( RangeMode == 1 ) setauto(SMU1);
+
+if ( NumPointsOut != NULL ) *NumPointsOut = i;
+
+if(debug)
+{
+    printf("\n========================================\n");
+    printf("smu_adaptive_ivsweep: Sweep complete\n");
+    printf("  Points measured: %d of %d budget (%d at refined step)\n", i, NumIPoints, refined_points);
+    printf("  Uniform sweep at MinStep would need: %d points\n",
+           (int)ceil(cycle_length * (double)NumCycles / MinStep) + 1);
+    if ( RangeMode == 1 )
+        printf("  Range changes: %d, auto-range fallbacks: %d\n", range_hint.range_changes, range_hint.fallbacks);
+    printf("  Returned to 0 V\n");
+    printf("========================================\n");
+}
+
+return( 0 ); /* Returns zero if execution OK */
+
+/* USRLIB MODULE END  */
+} 		/* End smu_adaptive_ivsweep.c */
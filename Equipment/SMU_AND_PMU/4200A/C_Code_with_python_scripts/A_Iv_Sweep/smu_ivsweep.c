@@ -2,7 +2,7 @@
 
 	MODULE NAME: smu_ivsweep
 	MODULE RETURN TYPE: int 
-	NUMBER OF PARMS: 13
+	NUMBER OF PARMS: 19
 	ARGUMENTS:
 		Vhigh,	double,	Input,	5,	0,	200
 		Vlow,	double,	Input,	-5,	-200,	0
@@ -16,11 +16,18 @@
 		Ilimit,	double,	Input,	0.1,	1e-9,	1.0
 		IRange,	double,	Input,	0.0,	0.0,	1.0
 		IntegrationTime,	double,	Input,	0.01,	0.0001,	1.0
+		RangeMode,	int,	Input,	0,	0,	1
+		TurnMode,	int,	Input,	0,	0,	2
+		TurnCurrent,	double,	Input,	0.0,	0.0,	1.0
+		TurnIdx,	D_ARRAY_T,	Output,	,	,
+		NumTurnPoints,	int,	Input,	2,	1,	2000
+		NumPointsOut,	int *,	Output,	,	,
 		ClariusDebug,	int,	Input,	0,	0,	1
 	INCLUDES:
 #include "keithley.h"
 #include <math.h>
 #include <stdio.h>
+#include "smu_range_hint.h"
 	END USRLIB MODULE INFORMATION
 */
 /* USRLIB MODULE HELP DESCRIPTION
@@ -86,6 +93,25 @@ PARAMETERS:
 - IntegrationTime: Measurement integration time (PLC - Power Line Cycles)
                    Default: 0.01 PLC (fast), range: 0.0001 to 1.0 PLC
                    Lower = faster but noisier, Higher = slower but more accurate
+- RangeMode: Current range selection (0 or 1), default: 0
+             0 = IRange as given (0.0 = auto range, > 0 = fixed range)
+             1 = Predictive range: each point is measured on a fixed range
+                 chosen from the previous reading, see RANGE PREDICTION below.
+                 IRange (if > 0) sets the lowest range the predictor may use.
+- TurnMode: Reaction to compliance / TurnCurrent on the outgoing segments
+            (0 → Vhigh and 0 → Vlow), default: 0. See TURN POLICY below.
+            0 = Off: log compliance only and sweep to the vertex (original behaviour)
+            1 = Reverse: turn round at the trigger point and retrace the same
+                voltages back to 0 V (return branch is still measured)
+            2 = Skip: go straight back to 0 V (one point) and start the next segment
+- TurnCurrent: |I| (A) that triggers the turn, default: 0.0
+               0.0 = use the compliance threshold (99% of Ilimit)
+- TurnIdx: Output array, global point index of each turn (-1 = unused entry)
+           Vforce[TurnIdx[k]] is the voltage where the sweep turned.
+- NumTurnPoints: Size of TurnIdx array (2 × NumCycles records every possible turn)
+- NumPointsOut: Output, number of points actually stored in Imeas/Vforce.
+                Equals (NumSteps + 1) × NumCycles with TurnMode = 0; with a turn
+                policy the sweep finishes early and the arrays are zero after it.
 - ClariusDebug: Debug output flag (0=off, 1=on), default: 0
                 When enabled, prints progress and measurement values
 
@@ -156,23 +182,53 @@ This can reveal:
 - Compliance effects (voltage drops when current limit is reached)
 - Connection issues
 
+RANGE PREDICTION (RangeMode = 1):
+In auto range every measi() searches for the range, which on a 1 nA to 10 mA
+memristor loop often costs more than the integration itself. With RangeMode=1
+the module scales the previous reading by the voltage ratio (never letting it
+shrink while |V| is increasing), adds 2x headroom and programs that decade
+with rangei() right after forcev(), so the range settles during StepDelay.
+- Over-range (reading at/over full scale, e.g. at a SET jump) or under-range
+  (reading < 0.1% of full scale, e.g. at a RESET drop) points are measured
+  again in auto range, so resolution is never worse than RangeMode=0.
+- Points following a 0 V point, and the first point, use auto range.
+- The predictor never selects a range above the one holding Ilimit.
+- Ranges the SMU rejects (e.g. pA ranges without a preamp) are skipped for
+  the rest of the sweep.
+
 COMPLIANCE CHECKING:
 The module checks if the measured current is near the compliance limit (>= 99% of Ilimit).
 If compliance is detected, this indicates the device may be drawing more current than
 the limit allows, and the voltage may be clamped. The module will continue but may
 produce warnings if debug output is enabled.
 
+TURN POLICY (TurnMode = 1 or 2):
+Forming and SET sweeps usually only need to reach the voltage where the device
+switches; sweeping on to Vhigh with the current clamped at compliance wastes
+time and stresses the device. With a turn policy, the first point of an
+outgoing segment (0 → Vhigh or 0 → Vlow) whose |I| reaches TurnCurrent (or the
+compliance threshold) ends that segment:
+- Reverse (1): the return segment starts from the trigger voltage and retraces
+  the outgoing voltages back to 0 V, so the hysteresis loop stays closed.
+- Skip (2): a single point at 0 V, then the next segment/cycle starts.
+Return segments (Vhigh → 0, Vlow → 0) never turn. Each cycle starts again from
+the full Vhigh/Vlow. Data stays contiguous: points after a turn are stored
+straight after the turn point, NumPointsOut gives the count and TurnIdx the
+indices where the sweep turned. Arrays must still be sized for the full sweep.
+
 END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
 #include <math.h>  /* For fabs() function */
 #include <stdio.h>  /* For printf() function */
 #include <Windows.h>  /* For Sleep() and timing functions */
+#include "smu_range_hint.h"  /* Predictive current range (RangeMode = 1) */
 
 /* USRLIB MODULE MAIN FUNCTION */
 int smu_ivsweep( double Vhigh, double Vlow, int NumSteps, int NumCycles, double *Imeas, int NumIPoints, 
                  double *Vforce, int NumVPoints, double StepDelay, double Ilimit,
-                 double IRange, double IntegrationTime, int ClariusDebug )
+                 double IRange, double IntegrationTime, int RangeMode, int TurnMode, double TurnCurrent,
+                 double *TurnIdx, int NumTurnPoints, int *NumPointsOut, int ClariusDebug )
 {
 /* USRLIB MODULE CODE */
 /* Step-based IV sweep module: 0 → Vhigh → 0 → Vlow → 0V, repeated NumCycles times
@@ -188,6 +244,8 @@ Features:
 - Measured voltage storage (intgv) for comparison
 - Compliance checking
 - Debug output option
+- Optional predictive current ranging (RangeMode = 1)
+- Optional compliance-triggered reverse/skip (TurnMode = 1/2)
 
 */
 
@@ -209,6 +267,14 @@ int delay_ms;          /* Pre-calculated delay in milliseconds (consistent for a
 DWORD step_start_time; /* Start time for current step (for constant step duration) */
 DWORD step_elapsed_ms;  /* Elapsed time for current step */
 DWORD target_step_ms;   /* Target step duration in milliseconds */
+smu_range_hint_t range_hint; /* Predictive range state (RangeMode = 1) */
+double turn_threshold; /* |I| that ends an outgoing segment (TurnMode != 0) */
+int turned;            /* 1 if the last outgoing segment turned early */
+int turn_step;         /* Steps taken on the outgoing segment before turning */
+double turn_v;         /* Voltage where the outgoing segment turned */
+int turn_count;        /* Number of turns recorded (also beyond NumTurnPoints) */
+int run_steps;         /* Steps actually swept on a return segment */
+double v_start;        /* Start voltage of a return segment */
 
 /* ============================================================
    INITIALIZE VARIABLES
@@ -312,6 +378,14 @@ if ( IntegrationTime < 0.0001 )
     IntegrationTime = 0.0001; /* Minimum integration time: 0.0001 PLC */
 }
 
+/* Validate turn policy (anything out of range disables it) */
+if ( (TurnMode < 0) || (TurnMode > 2) )
+{
+    if(debug) printf("smu_ivsweep WARNING: TurnMode (%d) invalid, turn policy disabled\n", TurnMode);
+    TurnMode = 0;
+}
+turn_threshold = (TurnCurrent > 0.0) ? TurnCurrent : compliance_threshold;
+
 /* ============================================================
    INITIALIZE OUTPUT ARRAYS
    ============================================================ */
@@ -322,6 +396,12 @@ for(i = 0; i < NumIPoints; i++)
     Imeas[i] = 0.0;
     Vforce[i] = 0.0;
 }
+for(i = 0; i < NumTurnPoints; i++)
+{
+    TurnIdx[i] = -1.0;
+}
+*NumPointsOut = 0;
+turn_count = 0;
 
 /* ============================================================
    CONFIGURE SMU (INTEGRATION TIME, CURRENT LIMIT)
@@ -344,8 +424,20 @@ if ( status != 0 )
     return( -6 ); /* Failed to set current limit */
 }
 
+/* Validate range mode (anything but 1 keeps the IRange behaviour) */
+if ( RangeMode != 1 )
+{
+    RangeMode = 0;
+}
+
+/* Predictive ranging starts in auto range; IRange becomes the lowest range */
+if ( RangeMode == 1 )
+{
+    smu_range_hint_init(&range_hint, IRange, Ilimit);
+    setauto(SMU1);
+}
 /* Optional fixed current measurement range (0.0 keeps auto range) */
-if ( IRange > 0.0 )
+else if ( IRange > 0.0 )
 {
     status = rangei(SMU1, IRange);
     if ( status != 0 )
@@ -374,6 +466,12 @@ if(debug)
     printf("  StepDelay: %.6f s (%.3f ms)\n", StepDelay, StepDelay * 1000.0);
     printf("  Ilimit: %.6e A (%.3f µA)\n", Ilimit, Ilimit * 1e6);
     printf("  IntegrationTime: %.6f PLC\n", IntegrationTime);
+    if ( RangeMode == 1 )
+        printf("  Current range: predictive (%.1e A to %.1e A)\n", range_hint.floor, range_hint.ceiling);
+    else
+        printf("  Current range: %s\n", (IRange > 0.0) ? "fixed" : "auto");
+    if ( TurnMode != 0 )
+        printf("  Turn policy: %s at |I| >= %.3e A\n", (TurnMode == 1) ? "reverse" : "skip", turn_threshold);
     printf("========================================\n\n");
 }
 
@@ -393,6 +491,8 @@ for(cycle = 0; cycle < NumCycles; cycle++)
         int seg_steps = steps_per_segment + (remainder_steps > 0 ? 1 : 0);
         if (remainder_steps > 0) remainder_steps--;
         
+        turned = 0;  /* Set if the turn policy ends this segment early */
+        
         /* Start at 0V (first point of segment) */
         v = 0.0;
         
@@ -407,11 +507,17 @@ for(cycle = 0; cycle < NumCycles; cycle++)
             return( -100 - i );
         }
         
+        /* Pre-select the predicted range so it settles with the device */
+        if ( RangeMode == 1 ) smu_range_hint_prepare(&range_hint, SMU1, v);
+        
         /* Wait for minimum settling time */
         Sleep(delay_ms);
         
         /* Measure current (variable time depending on integration time and auto-ranging) */
-        status = measi(SMU1, &Imeas[i]);
+        if ( RangeMode == 1 )
+            status = smu_range_hint_measi(&range_hint, SMU1, v, &Imeas[i]);
+        else
+            status = measi(SMU1, &Imeas[i]);
         if ( status != 0 )
         {
             if(debug) printf("smu_ivsweep ERROR: measi() failed at point %d (voltage=%.6f V) with status: %d\n", i, v, status);
@@ -471,11 +577,17 @@ for(cycle = 0; cycle < NumCycles; cycle++)
                     return( -100 - i );
                 }
                 
+                /* Pre-select the predicted range so it settles with the device */
+                if ( RangeMode == 1 ) smu_range_hint_prepare(&range_hint, SMU1, v);
+                
                 /* Wait for minimum settling time */
                 Sleep(delay_ms);
                 
                 /* Measure current (variable time depending on integration time and auto-ranging) */
-                status = measi(SMU1, &Imeas[i]);
+                if ( RangeMode == 1 )
+                    status = smu_range_hint_measi(&range_hint, SMU1, v, &Imeas[i]);
+                else
+                    status = measi(SMU1, &Imeas[i]);
                 if ( status != 0 )
                 {
                     if(debug) printf("smu_ivsweep ERROR: measi() failed at point %d (voltage=%.6f V) with status: %d\n", i, v, status);
@@ -508,6 +620,19 @@ for(cycle = 0; cycle < NumCycles; cycle++)
                            cycle + 1, step + 1, seg_steps + 1, i + 1, NumIPoints, v, Imeas[i], resistance);
                 }
                 i++;
+                
+                /* Turn policy: end the outgoing segment at compliance / TurnCurrent */
+                if ( (TurnMode != 0) && (fabs(Imeas[i - 1]) >= turn_threshold) )
+                {
+                    if ( turn_count < NumTurnPoints ) TurnIdx[turn_count] = (double)(i - 1);
+                    turn_count++;
+                    turned = 1;
+                    turn_step = step;
+                    turn_v = v;
+                    if(debug) printf("smu_ivsweep: Turn at point %d (V=%.6f V, I=%.6e A), %s to 0V\n",
+                                     i - 1, v, Imeas[i - 1], (TurnMode == 1) ? "retracing" : "skipping");
+                    break;
+                }
             }
             /* Ensure we end exactly at Vhigh (fix any floating point rounding) */
             if (v != Vhigh) v = Vhigh;
@@ -523,10 +648,15 @@ for(cycle = 0; cycle < NumCycles; cycle++)
         {
             /* Use exact same formula as SMU_VIsweep: vstep = (Vstop-Vstart) / (NumPoints - 1)
                For this segment: Vstart=Vhigh, Vstop=0V, NumPoints=seg_steps+1, so vstep is negative */
-            double vstep = (0.0 - Vhigh) / ((double)(seg_steps + 1) - 1.0);  /* Same as SMU_VIsweep formula */
-            v = Vhigh;  /* Start from Vhigh (Segment 1 ended here) */
+            double vstep;
             
-            for(step = 1; step <= seg_steps; step++)
+            /* After a turn, start from the turn voltage: retrace segment 1 (reverse) or one step to 0V (skip) */
+            v_start = turned ? turn_v : Vhigh;
+            run_steps = turned ? ((TurnMode == 1) ? turn_step : 1) : seg_steps;
+            vstep = (0.0 - v_start) / ((double)(run_steps + 1) - 1.0);  /* Same as SMU_VIsweep formula */
+            v = v_start;  /* Start from Vhigh (Segment 1 ended here) */
+            
+            for(step = 1; step <= run_steps; step++)
             {
                 v = v + vstep;  /* Incremental approach (vstep is negative, so this decreases v) */
                 
@@ -543,11 +673,17 @@ for(cycle = 0; cycle < NumCycles; cycle++)
                     return( -100 - i );
                 }
                 
+                /* Pre-select the predicted range so it settles with the device */
+                if ( RangeMode == 1 ) smu_range_hint_prepare(&range_hint, SMU1, v);
+                
                 /* Wait for minimum settling time */
                 Sleep(delay_ms);
                 
                 /* Measure current (variable time depending on integration time and auto-ranging) */
-                status = measi(SMU1, &Imeas[i]);
+                if ( RangeMode == 1 )
+                    status = smu_range_hint_measi(&range_hint, SMU1, v, &Imeas[i]);
+                else
+                    status = measi(SMU1, &Imeas[i]);
                 if ( status != 0 )
                 {
                     if(debug) printf("smu_ivsweep ERROR: measi() failed at point %d (voltage=%.6f V) with status: %d\n", i, v, status);
@@ -573,11 +709,11 @@ for(cycle = 0; cycle < NumCycles; cycle++)
                 }
                 /* If elapsed time exceeds target, move immediately (no negative sleep) */
                 
-                if(debug && (step == seg_steps || step == 1))
+                if(debug && (step == run_steps || step == 1))
                 {
                     double resistance = (fabs(Imeas[i]) > 1e-12) ? (v_measured / Imeas[i]) : 1e12;
                     printf("  Cycle %2d, Seg 2, Point %d/%d, Global %3d/%d: V=%.6f V, I=%.6e A, R=%.3e Ohm\n",
-                           cycle + 1, step, seg_steps, i + 1, NumIPoints, v, Imeas[i], resistance);
+                           cycle + 1, step, run_steps, i + 1, NumIPoints, v, Imeas[i], resistance);
                 }
                 i++;
             }
@@ -591,6 +727,8 @@ for(cycle = 0; cycle < NumCycles; cycle++)
         int seg_steps = steps_per_segment + (remainder_steps > 0 ? 1 : 0);
         if (remainder_steps > 0) remainder_steps--;
         
+        turned = 0;  /* Set if the turn policy ends this segment early */
+        
         /* Note: Segment 2 already ended at 0V, so we skip the duplicate 0V measurement
            and go directly to sweeping from 0V to Vlow for continuous waveform */
         
@@ -618,11 +756,17 @@ for(cycle = 0; cycle < NumCycles; cycle++)
                     return( -100 - i );
                 }
                 
+                /* Pre-select the predicted range so it settles with the device */
+                if ( RangeMode == 1 ) smu_range_hint_prepare(&range_hint, SMU1, v);
+                
                 /* Wait for minimum settling time */
                 Sleep(delay_ms);
                 
                 /* Measure current (variable time depending on integration time and auto-ranging) */
-                status = measi(SMU1, &Imeas[i]);
+                if ( RangeMode == 1 )
+                    status = smu_range_hint_measi(&range_hint, SMU1, v, &Imeas[i]);
+                else
+                    status = measi(SMU1, &Imeas[i]);
                 if ( status != 0 )
                 {
                     if(debug) printf("smu_ivsweep ERROR: measi() failed at point %d (voltage=%.6f V) with status: %d\n", i, v, status);
@@ -655,6 +799,19 @@ for(cycle = 0; cycle < NumCycles; cycle++)
                            cycle + 1, step + 1, seg_steps + 1, i + 1, NumIPoints, v, Imeas[i], resistance);
                 }
                 i++;
+                
+                /* Turn policy: end the outgoing segment at compliance / TurnCurrent */
+                if ( (TurnMode != 0) && (fabs(Imeas[i - 1]) >= turn_threshold) )
+                {
+                    if ( turn_count < NumTurnPoints ) TurnIdx[turn_count] = (double)(i - 1);
+                    turn_count++;
+                    turned = 1;
+                    turn_step = step;
+                    turn_v = v;
+                    if(debug) printf("smu_ivsweep: Turn at point %d (V=%.6f V, I=%.6e A), %s to 0V\n",
+                                     i - 1, v, Imeas[i - 1], (TurnMode == 1) ? "retracing" : "skipping");
+                    break;
+                }
             }
             /* Ensure we end exactly at Vlow (fix any floating point rounding) */
             if (v != Vlow) v = Vlow;
@@ -670,10 +827,15 @@ for(cycle = 0; cycle < NumCycles; cycle++)
         {
             /* Use exact same formula as SMU_VIsweep: vstep = (Vstop-Vstart) / (NumPoints - 1)
                For this segment: Vstart=Vlow (negative), Vstop=0V, NumPoints=seg_steps+1, so vstep is positive */
-            double vstep = (0.0 - Vlow) / ((double)(seg_steps + 1) - 1.0);  /* Same as SMU_VIsweep formula */
-            v = Vlow;  /* Start from Vlow */
+            double vstep;
             
-            for(step = 1; step <= seg_steps; step++)
+            /* After a turn, start from the turn voltage: retrace segment 3 (reverse) or one step to 0V (skip) */
+            v_start = turned ? turn_v : Vlow;
+            run_steps = turned ? ((TurnMode == 1) ? turn_step : 1) : seg_steps;
+            vstep = (0.0 - v_start) / ((double)(run_steps + 1) - 1.0);  /* Same as SMU_VIsweep formula */
+            v = v_start;  /* Start from Vlow */
+            
+            for(step = 1; step <= run_steps; step++)
             {
                 v = v + vstep;  /* Incremental approach (vstep is positive, moving toward 0V) */
                 
@@ -690,11 +852,17 @@ for(cycle = 0; cycle < NumCycles; cycle++)
                     return( -100 - i );
                 }
                 
+                /* Pre-select the predicted range so it settles with the device */
+                if ( RangeMode == 1 ) smu_range_hint_prepare(&range_hint, SMU1, v);
+                
                 /* Wait for minimum settling time */
                 Sleep(delay_ms);
                 
                 /* Measure current (variable time depending on integration time and auto-ranging) */
-                status = measi(SMU1, &Imeas[i]);
+                if ( RangeMode == 1 )
+                    status = smu_range_hint_measi(&range_hint, SMU1, v, &Imeas[i]);
+                else
+                    status = measi(SMU1, &Imeas[i]);
                 if ( status != 0 )
                 {
                     if(debug) printf("smu_ivsweep ERROR: measi() failed at point %d (voltage=%.6f V) with status: %d\n", i, v, status);
@@ -720,11 +888,11 @@ for(cycle = 0; cycle < NumCycles; cycle++)
                 }
                 /* If elapsed time exceeds target, move immediately (no negative sleep) */
                 
-                if(debug && (step == seg_steps || step == 1))
+                if(debug && (step == run_steps || step == 1))
                 {
                     double resistance = (fabs(Imeas[i]) > 1e-12) ? (v_measured / Imeas[i]) : 1e12;
                     printf("  Cycle %2d, Seg 4, Point %d/%d, Global %3d/%d: V=%.6f V, I=%.6e A, R=%.3e Ohm\n",
-                           cycle + 1, step, seg_steps, i + 1, NumIPoints, v, Imeas[i], resistance);
+                           cycle + 1, step, run_steps, i + 1, NumIPoints, v, Imeas[i], resistance);
                 }
                 i++;
             }
@@ -742,11 +910,21 @@ for(cycle = 0; cycle < NumCycles; cycle++)
 /* This is good practice to avoid leaving voltage on device */
 forcev(SMU1, 0.0);
 
+/* Points actually stored (fewer than NumIPoints if the sweep turned early) */
+*NumPointsOut = i;
+
+/* Leave the SMU in auto range rather than on the last predicted range */
+if ( RangeMode == 1 ) setauto(SMU1);
+
 if(debug)
 {
     printf("\n========================================\n");
     printf("smu_ivsweep: Sweep complete\n");
-    printf("  Total points measured: %d\n", NumIPoints);
+    printf("  Total points measured: %d of %d\n", i, NumIPoints);
+    if ( TurnMode != 0 )
+        printf("  Turns: %d (%d recorded in TurnIdx)\n", turn_count, (turn_count < NumTurnPoints) ? turn_count : NumTurnPoints);
+    if ( RangeMode == 1 )
+        printf("  Range changes: %d, auto-range fallbacks: %d\n", range_hint.range_changes, range_hint.fallbacks);
     printf("  Returned to 0 V\n");
     printf("========================================\n");
 }
@@ -0,0 +1,354 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: smu_multi_sweep
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 16
+	ARGUMENTS:
+		SMUList,	char *,	Input,	"SMU1;SMU2",	,
+		Vertices,	char *,	Input,	"0;2;0;-2;0",	,
+		LegPoints,	char *,	Input,	"10",	,
+		LegDwell,	char *,	Input,	"0.001",	,
+		LegIlimit,	char *,	Input,	"0.1",	,
+		LegIRange,	char *,	Input,	"0",	,
+		NumCycles,	int,	Input,	1,	1,	1000
+		Imeas,	D_ARRAY_T,	Output,	,	,
+		NumIPoints,	int,	Input,	82,	,
+		Vforce,	D_ARRAY_T,	Output,	,	,
+		NumVPoints,	int,	Input,	82,	,
+		Tmeas,	D_ARRAY_T,	Output,	,	,
+		NumTPoints,	int,	Input,	41,	,
+		NumPointsOut,	int *,	Output,	,	,
+		IntegrationTime,	double,	Input,	0.01,	0.0001,	1.0
+		ClariusDebug,	int,	Input,	0,	0,	1
+	INCLUDES:
+#include "keithley.h"
+#include <math.h>
+#include <stdio.h>
+#include "smu_sweep_plan.h"
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+
+SMU Multi-Channel Sweep Module
+==============================
+
+Sweeps several SMUs at the same time, one device per SMU. At every step all
+channels are forced, share one dwell, and are then measured, so N devices are
+characterised in roughly the wall time of one (plus one measi() per extra
+channel).
+
+The sweep path is a vertex list as in smu_plan_sweep. All channels use the
+same LegPoints/LegDwell/LegIlimit/LegIRange, so they always step together.
+
+PARAMETERS:
+- SMUList: Instruments to drive, separated by ';', e.g. "SMU1;SMU2;SMU3;SMU4"
+           (1 to 8 channels, each must be in the system configuration).
+- Vertices: Vertex list (V) separated by ';'. One list is used for every
+            channel; separate per-channel lists with '|', e.g.
+            "0;2;0;-2;0|0;1;0;-1;0". Every list needs the same vertex count.
+- LegPoints, LegDwell, LegIlimit, LegIRange: Per-leg settings, see smu_plan_sweep
+- NumCycles: Number of times the vertex list is swept (1 to 1000)
+- Imeas: Output array for measured current (A), point-major:
+         Imeas[point × channels + channel]
+- NumIPoints: Size of Imeas (>= points × channels)
+- Vforce: Output array for forced voltage (V), same layout as Imeas
+- NumVPoints: Size of Vforce (must equal NumIPoints)
+- Tmeas: Output array, time of each step (s from sweep start), one per point
+- NumTPoints: Size of Tmeas (>= points)
+- NumPointsOut: Output, number of points per channel
+- IntegrationTime: Measurement integration time (PLC), default 0.01
+- ClariusDebug: Debug output flag (0=off, 1=on), default: 0
+
+ERROR CODES:
+- -1 to -4: Invalid plan (see smu_plan_sweep)
+- -5: Invalid NumCycles
+- -6: Array size mismatch (NumIPoints != NumVPoints)
+- -7: Arrays too small for points × channels
+- -8: limiti()/rangei() failed
+- -10: measi() failed
+- -11: SMUList empty, too long, or an SMU is not in the system configuration
+- -12: Per-channel vertex lists have different vertex counts
+- -100-i: forcev() failed at point i
+
+END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include <math.h>  /* For fabs() function */
+#include <stdio.h>  /* For printf() function */
+#include <string.h>  /* For strchr(), strncpy() */
+#include <Windows.h>  /* For Sleep() and GetTickCount() */
+#include "smu_sweep_plan.h"  /* Vertex list parsing and point generation */
+
+#define SMU_MULTI_MAX_CHANNELS 8
+#define SMU_MULTI_MAX_TEXT 1024
+
+BOOL LPTIsInCurrentConfiguration(char* hrid);
+
+/* Copy field `index` of a `sep`-separated list into out. Returns 0 if the list
+ * has no such field. */
+static int smu_multi_field(const char *list, char sep, int index, char *out, int out_size)
+{
+    const char *start = list;
+    const char *end;
+    int len;
+
+    if (list == NULL)
+        return 0;
+    while (index-- > 0)
+    {
+        start = strchr(start, sep);
+        if (start == NULL)
+            return 0;
+        start++;
+    }
+    end = strchr(start, sep);
+    len = (end != NULL) ? (int)(end - start) : (int)strlen(start);
+    if (len >= out_size)
+        len = out_size - 1;
+    strncpy(out, start, len);
+    out[len] = '\0';
+    return 1;
+}
+
+/* USRLIB MODULE MAIN FUNCTION */
+int smu_multi_sweep( char *SMUList, char *Vertices, char *LegPoints, char *LegDwell, char *LegIlimit,
+                     char *LegIRange, int NumCycles, double *Imeas, int NumIPoints, double *Vforce,
+                     int NumVPoints, double *Tmeas, int NumTPoints, int *NumPointsOut,
+                     double IntegrationTime, int ClariusDebug )
+{
+/* USRLIB MODULE CODE */
+/* Multi-channel sweep: the same step sequence on SMU1..SMUn in parallel
+
+--------------
+Features:
+- 1 to 8 SMUs, one device each
+- Shared or per-channel vertex lists
+- One dwell per step for all channels
+- Point list generated once before the sweep
+
+*/
+
+static smu_sweep_plan_t plan[SMU_MULTI_MAX_CHANNELS];  /* One plan per channel */
+smu_sweep_plan_state_t state[SMU_MULTI_MAX_CHANNELS]; /* Settings programmed per channel */
+smu_sweep_leg_t leg[SMU_MULTI_MAX_CHANNELS];          /* Current leg per channel */
+int instr[SMU_MULTI_MAX_CHANNELS];                    /* Instrument IDs */
+char name[SMU_MULTI_MAX_TEXT];                        /* One SMUList / Vertices field */
+int num_channels;      /* Channels in SMUList */
+int num_lists;         /* Vertex lists given (1 = shared) */
+int total_points;      /* Points per channel */
+int leg_index;         /* Leg counter (0 = start point) */
+int c;                 /* Channel index */
+int i;                 /* Point index */
+int n;                 /* Point counter within leg */
+int status;            /* Status code from LPTLib functions */
+int debug;             /* Debug flag */
+int dwell_ms;          /* Dwell for the current leg (ms) */
+DWORD t0;              /* Sweep start time */
+
+debug = (ClariusDebug == 1) ? 1 : 0;
+
+/* ============================================================
+   INPUT VALIDATION
+   ============================================================ */
+
+if ( (NumCycles < 1) || (NumCycles > 1000) )
+{
+    if(debug) printf("smu_multi_sweep ERROR: NumCycles (%d) must be between 1 and 1000\n", NumCycles);
+    return( -5 );
+}
+
+/* Resolve SMUList */
+num_channels = 0;
+while ( smu_multi_field(SMUList, ';', num_channels, name, SMU_MULTI_MAX_TEXT) && name[0] != '\0' )
+{
+    if ( num_channels >= SMU_MULTI_MAX_CHANNELS )
+    {
+        if(debug) printf("smu_multi_sweep ERROR: at most %d SMUs\n", SMU_MULTI_MAX_CHANNELS);
+        return( -11 );
+    }
+    getinstid(name, &instr[num_channels]);
+    if ( !LPTIsInCurrentConfiguration(name) )
+    {
+        if(debug) printf("smu_multi_sweep ERROR: %s is not in system configuration\n", name);
+        return( -11 );
+    }
+    num_channels++;
+}
+if ( num_channels == 0 )
+{
+    if(debug) printf("smu_multi_sweep ERROR: SMUList is empty\n");
+    return( -11 );
+}
+
+/* One plan per channel; a single vertex list is shared by all channels */
+num_lists = 0;
+while ( smu_multi_field(Vertices, '|', num_lists, name, SMU_MULTI_MAX_TEXT) )
+    num_lists++;
+
+for(c = 0; c < num_channels; c++)
+{
+    smu_multi_field(Vertices, '|', (num_lists > 1) ? c : 0, name, SMU_MULTI_MAX_TEXT);
+    if ( (num_lists > 1) && (c >= num_lists) )
+        name[0] = '\0';
+    status = smu_sweep_plan_init(&plan[c], name, LegPoints, LegDwell, LegIlimit, LegIRange, NumCycles);
+    if ( status != 0 )
+    {
+        if(debug) printf("smu_multi_sweep ERROR: invalid plan (%d) for channel %d, Vertices=\"%s\"\n", status, c + 1, name);
+        return( status );
+    }
+    /* Open/closed lists change the point count, so compare the whole plan */
+    if ( (plan[c].num_vertices != plan[0].num_vertices) || (plan[c].closed != plan[0].closed) )
+    {
+        if(debug) printf("smu_multi_sweep ERROR: channel %d vertex list does not match channel 1\n", c + 1);
+        return( -12 );
+    }
+}
+
+if ( NumIPoints != NumVPoints )
+{
+    if(debug) printf("smu_multi_sweep ERROR: Array size mismatch - NumIPoints=%d, NumVPoints=%d\n", NumIPoints, NumVPoints);
+    return( -6 );
+}
+
+total_points = smu_sweep_plan_count(&plan[0]);
+if ( (NumIPoints < total_points * num_channels) || (NumTPoints < total_points) )
+{
+    if(debug) printf("smu_multi_sweep ERROR: Arrays too small - need %d (I/V) and %d (T), got %d and %d\n",
+                     total_points * num_channels, total_points, NumIPoints, NumTPoints);
+    return( -7 );
+}
+
+if ( IntegrationTime < 0.0001 )
+{
+    if(debug) printf("smu_multi_sweep WARNING: IntegrationTime (%.6f) too small, using minimum 0.0001 PLC\n", IntegrationTime);
+    IntegrationTime = 0.0001;
+}
+
+/* ============================================================
+   GENERATE POINT LIST (point-major, all channels)
+   ============================================================ */
+
+for(i = 0; i < NumIPoints; i++)
+{
+    Imeas[i] = 0.0;
+    Vforce[i] = 0.0;
+}
+for(i = 0; i < NumTPoints; i++)
+{
+    Tmeas[i] = 0.0;
+}
+*NumPointsOut = 0;
+
+i = 0;
+for(leg_index = 0; smu_sweep_plan_leg(&plan[0], leg_index, &leg[0]); leg_index++)
+{
+    for(c = 1; c < num_channels; c++)
+        smu_sweep_plan_leg(&plan[c], leg_index, &leg[c]);
+    for(n = 1; n <= leg[0].steps; n++, i++)
+    {
+        for(c = 0; c < num_channels; c++)
+            Vforce[i * num_channels + c] = smu_sweep_leg_voltage(&leg[c], n);
+    }
+}
+
+if(debug)
+{
+    printf("\n========================================\n");
+    printf("smu_multi_sweep: %d channels, %d points each, %d cycles\n", num_channels, total_points, NumCycles);
+    for(c = 0; c < num_channels; c++)
+    {
+        smu_multi_field(SMUList, ';', c, name, SMU_MULTI_MAX_TEXT);
+        printf("  Channel %d: %s, vertices %.6f V ... %.6f V\n", c + 1, name,
+               plan[c].vertex[0], plan[c].vertex[plan[c].num_vertices - 1]);
+    }
+    printf("========================================\n\n");
+}
+
+/* ============================================================
+   CONFIGURE SMUs
+   ============================================================ */
+
+for(c = 0; c < num_channels; c++)
+{
+    status = setmode(instr[c], KI_INTGPLC, IntegrationTime);
+    if ( status != 0 )
+    {
+        if(debug) printf("smu_multi_sweep WARNING: setmode(KI_INTGPLC) failed on channel %d: %d\n", c + 1, status);
+    }
+    state[c].valid = 0;
+    state[c].ilimit = 0.0;
+    state[c].irange = 0.0;
+}
+
+/* ============================================================
+   SWEEP: force all, one dwell, measure all
+   ============================================================ */
+
+t0 = GetTickCount();
+i = 0;
+for(leg_index = 0; smu_sweep_plan_leg(&plan[0], leg_index, &leg[0]); leg_index++)
+{
+    for(c = 0; c < num_channels; c++)
+    {
+        if ( c > 0 ) smu_sweep_plan_leg(&plan[c], leg_index, &leg[c]);
+        status = smu_sweep_plan_apply(instr[c], &leg[c], &state[c]);
+        if ( status != 0 )
+        {
+            if(debug) printf("smu_multi_sweep ERROR: limiti()/rangei() failed on channel %d, leg %d: %d\n", c + 1, leg_index, status);
+            for(c = 0; c < num_channels; c++) forcev(instr[c], 0.0);
+            return( -8 );
+        }
+    }
+    dwell_ms = (int)(leg[0].dwell * 1000.0 + 0.5);
+
+    for(n = 1; n <= leg[0].steps; n++, i++)
+    {
+        for(c = 0; c < num_channels; c++)
+        {
+            status = forcev(instr[c], Vforce[i * num_channels + c]);
+            if ( status != 0 )
+            {
+                if(debug) printf("smu_multi_sweep ERROR: forcev() failed on channel %d at point %d with status: %d\n", c + 1, i, status);
+                for(c = 0; c < num_channels; c++) forcev(instr[c], 0.0);
+                return( -100 - i );
+            }
+        }
+
+        /* One settle for every channel */
+        if ( dwell_ms > 0 ) Sleep(dwell_ms);
+
+        for(c = 0; c < num_channels; c++)
+        {
+            status = measi(instr[c], &Imeas[i * num_channels + c]);
+            if ( status != 0 )
+            {
+                if(debug) printf("smu_multi_sweep ERROR: measi() failed on channel %d at point %d with status: %d\n", c + 1, i, status);
+                for(c = 0; c < num_channels; c++) forcev(instr[c], 0.0);
+                return( -10 );
+            }
+        }
+        Tmeas[i] = (double)(GetTickCount() - t0) / 1000.0;
+    }
+}
+
+/* ============================================================
+   CLEANUP
+   ============================================================ */
+
+for(c = 0; c < num_channels; c++)
+{
+    forcev(instr[c], 0.0);
+    setauto(instr[c]);
+}
+
+*NumPointsOut = i;
+
+if(debug)
+{
+    printf("smu_multi_sweep: Sweep complete, %d points × %d channels, %.3f s\n", i, num_channels, (i > 0) ? Tmeas[i - 1] : 0.0);
+}
+
+return( 0 ); /* Returns zero if execution OK */
+
+/* USRLIB MODULE END  */
+} 		/* End smu_multi_sweep.c */
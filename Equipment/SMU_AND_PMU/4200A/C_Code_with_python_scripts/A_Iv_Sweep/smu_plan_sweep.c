@@ -0,0 +1,345 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: smu_plan_sweep
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 16
+	ARGUMENTS:
+		Vertices,	char *,	Input,	"0;2;0;-2;0",	,
+		LegPoints,	char *,	Input,	"10",	,
+		LegDwell,	char *,	Input,	"0.001",	,
+		LegIlimit,	char *,	Input,	"0.1",	,
+		LegIRange,	char *,	Input,	"0",	,
+		NumCycles,	int,	Input,	1,	1,	1000
+		Imeas,	D_ARRAY_T,	Output,	,	,
+		NumIPoints,	int,	Input,	41,	,
+		Vforce,	D_ARRAY_T,	Output,	,	,
+		NumVPoints,	int,	Input,	41,	,
+		Tmeas,	D_ARRAY_T,	Output,	,	,
+		NumTPoints,	int,	Input,	41,	,
+		NumPointsOut,	int *,	Output,	,	,
+		IntegrationTime,	double,	Input,	0.01,	0.0001,	1.0
+		SweepMode,	int,	Input,	0,	0,	1
+		ClariusDebug,	int,	Input,	0,	0,	1
+	INCLUDES:
+#include "keithley.h"
+#include <math.h>
+#include <stdio.h>
+#include "smu_sweep_plan.h"
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+
+SMU Piecewise-Linear Sweep Module (Sweep Plan)
+==============================================
+
+Sweeps SMU1 along an arbitrary vertex list, repeated NumCycles times. Every
+sweep shape of SMU_VIsweep, SMU_FullIVsweep, smu_ivsweep and ACraig12_DC_Sweep
+is one vertex list:
+
+  Vertices="0;2;0;-2;0"   LegPoints="10"    -> 0 → 2 → 0 → -2 → 0 loop (41 points)
+  Vertices="-1;1"         LegPoints="100"   -> linear sweep (101 points)
+  Vertices="0;1.5;1.5;0"  LegPoints="50;1;50" LegDwell="0.001;0.5;0.001"
+                                            -> ramp, 0.5 s hold, ramp back
+
+The point list is generated once from the plan before the SMU is touched and
+returned in Vforce; the measurement loop only forces, waits and measures.
+
+PARAMETERS:
+- Vertices: Voltages (V) separated by ';' (',' and ' ' also accepted).
+            At least 2, at most 64. Leg k runs from vertex k to vertex k+1.
+- LegPoints: Points measured on each leg (>= 1), one value per leg, or a single
+             value used for every leg. A leg with N points steps in N equal
+             steps and ends exactly on its stop vertex.
+- LegDwell: Delay before each measurement on the leg (s), default 0.001.
+- LegIlimit: Current compliance on the leg (A), default 0.1.
+- LegIRange: Current range on the leg (A), 0 = auto range (default).
+             LegDwell/LegIlimit/LegIRange accept one value per leg, a single
+             value, or "" for the default. Compliance and range are only
+             reprogrammed when they change between legs.
+- NumCycles: Number of times the vertex list is swept (1 to 1000).
+- Imeas: Output array for measured current (A)
+- NumIPoints: Size of Imeas array (>= points in the plan, see below)
+- Vforce: Output array for forced voltage (V)
+- NumVPoints: Size of Vforce array (must equal NumIPoints)
+- Tmeas: Output array for the time of each measurement (s from sweep start)
+- NumTPoints: Size of Tmeas array (must equal NumIPoints)
+- NumPointsOut: Output, number of points in the plan (valid entries)
+- IntegrationTime: Measurement integration time (PLC), default 0.01
+- SweepMode: Measurement path, default 0
+             0 = Hardware: one sweepv() per leg, the SMU steps and buffers the
+                 readings itself (smeasi/smeast), no round trip per point.
+                 One-point legs (the start point, restart points, holds)
+                 use forcev()/measi(). Timestamps come from TIMER1.
+             1 = Stepped: forcev()/Sleep()/measi() per point. Use when each
+                 point needs software timing; dwell is rounded to 1 ms.
+- ClariusDebug: Debug output flag (0=off, 1=on), default: 0
+
+POINT COUNT:
+The first vertex is measured once. Each leg then adds LegPoints points. If the
+last vertex differs from the first, each cycle after the first starts with one
+point back at the first vertex.
+  closed list: 1 + NumCycles × sum(LegPoints)
+  open list:   1 + NumCycles × sum(LegPoints) + (NumCycles - 1)
+
+ERROR CODES:
+- -1: Fewer than 2 vertices
+- -2: A per-leg list has neither 1 value nor one value per leg
+- -3: A leg has fewer than 1 point
+- -4: Negative dwell/range or non-positive compliance
+- -5: Invalid NumCycles (must be >= 1 and <= 1000)
+- -6: Array size mismatch (NumIPoints, NumVPoints and NumTPoints must match)
+- -7: Arrays too small for the plan
+- -8: limiti()/rangei() failed
+- -9: sweepv() failed (hardware path)
+- -10: measi() failed (stepped path or one-point leg)
+- -100-i: forcev() failed at point i (stepped path or one-point leg)
+
+END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include <math.h>  /* For fabs() function */
+#include <stdio.h>  /* For printf() function */
+#include <Windows.h>  /* For Sleep() and GetTickCount() */
+#include "smu_sweep_plan.h"  /* Vertex list parsing and point generation */
+
+/* USRLIB MODULE MAIN FUNCTION */
+int smu_plan_sweep( char *Vertices, char *LegPoints, char *LegDwell, char *LegIlimit, char *LegIRange,
+                    int NumCycles, double *Imeas, int NumIPoints, double *Vforce, int NumVPoints,
+                    double *Tmeas, int NumTPoints, int *NumPointsOut, double IntegrationTime,
+                    int SweepMode, int ClariusDebug )
+{
+/* USRLIB MODULE CODE */
+/* Piecewise-linear sweep: arbitrary vertex list × NumCycles
+
+--------------
+Features:
+- One engine for linear, triangle, loop and ramp-hold-ramp sweeps
+- Per-leg points, dwell, compliance and current range
+- Point list generated once before the sweep
+- Hardware sweepv() path (default) or stepped forcev()/measi() path
+- Timestamp per point
+
+*/
+
+smu_sweep_plan_t plan;        /* Parsed vertex list and per-leg settings */
+smu_sweep_plan_state_t state; /* Compliance/range currently programmed */
+smu_sweep_leg_t leg;          /* Leg being swept */
+int leg_index;                /* Leg counter (0 = start point) */
+int total_points;             /* Points in the plan */
+int i;                        /* Global point index */
+int n;                        /* Point counter within leg */
+int status;                   /* Status code from LPTLib functions */
+int debug;                    /* Debug flag */
+int dwell_ms;                 /* Stepped path dwell (ms) */
+DWORD t0;                     /* Stepped path start time */
+
+debug = (ClariusDebug == 1) ? 1 : 0;
+
+/* ============================================================
+   INPUT VALIDATION
+   ============================================================ */
+
+if ( (NumCycles < 1) || (NumCycles > 1000) )
+{
+    if(debug) printf("smu_plan_sweep ERROR: NumCycles (%d) must be between 1 and 1000\n", NumCycles);
+    return( -5 );
+}
+
+status = smu_sweep_plan_init(&plan, Vertices, LegPoints, LegDwell, LegIlimit, LegIRange, NumCycles);
+if ( status != 0 )
+{
+    if(debug) printf("smu_plan_sweep ERROR: invalid plan (%d) - Vertices=\"%s\" LegPoints=\"%s\"\n",
+                     status, Vertices ? Vertices : "", LegPoints ? LegPoints : "");
+    return( status );
+}
+
+if ( (NumIPoints != NumVPoints) || (NumIPoints != NumTPoints) )
+{
+    if(debug) printf("smu_plan_sweep ERROR: Array size mismatch - NumIPoints=%d, NumVPoints=%d, NumTPoints=%d\n",
+                     NumIPoints, NumVPoints, NumTPoints);
+    return( -6 );
+}
+
+total_points = smu_sweep_plan_count(&plan);
+if ( NumIPoints < total_points )
+{
+    if(debug) printf("smu_plan_sweep ERROR: Arrays hold %d points, plan needs %d\n", NumIPoints, total_points);
+    return( -7 );
+}
+
+if ( IntegrationTime < 0.0001 )
+{
+    if(debug) printf("smu_plan_sweep WARNING: IntegrationTime (%.6f) too small, using minimum 0.0001 PLC\n", IntegrationTime);
+    IntegrationTime = 0.0001;
+}
+
+if ( SweepMode != SMU_SWEEP_PLAN_STEPPED )
+{
+    SweepMode = SMU_SWEEP_PLAN_HARDWARE;
+}
+
+/* ============================================================
+   GENERATE POINT LIST
+   ============================================================ */
+
+for(i = 0; i < NumIPoints; i++)
+{
+    Imeas[i] = 0.0;
+    Vforce[i] = 0.0;
+    Tmeas[i] = 0.0;
+}
+*NumPointsOut = 0;
+
+smu_sweep_plan_voltages(&plan, Vforce, total_points);
+
+if(debug)
+{
+    printf("\n========================================\n");
+    printf("smu_plan_sweep: %d vertices, %d legs, %d cycles (%s)\n",
+           plan.num_vertices, plan.num_vertices - 1, plan.cycles, plan.closed ? "closed" : "open");
+    for(n = 0; n < plan.num_vertices - 1; n++)
+    {
+        printf("  Leg %d: %.6f V -> %.6f V, %d points, dwell %.6f s, Ilimit %.3e A, range %s\n",
+               n + 1, plan.vertex[n], plan.vertex[n + 1], plan.steps[n], plan.dwell[n], plan.ilimit[n],
+               (plan.irange[n] > 0.0) ? "fixed" : "auto");
+    }
+    printf("  Total points: %d, path: %s\n", total_points, (SweepMode == SMU_SWEEP_PLAN_HARDWARE) ? "hardware sweepv" : "stepped");
+    printf("========================================\n\n");
+}
+
+/* ============================================================
+   CONFIGURE SMU
+   ============================================================ */
+
+status = setmode(SMU1, KI_INTGPLC, IntegrationTime);
+if ( status != 0 )
+{
+    if(debug) printf("smu_plan_sweep WARNING: setmode(KI_INTGPLC) failed: %d (continuing with default)\n", status);
+}
+
+state.valid = 0;
+state.ilimit = 0.0;
+state.irange = 0.0;
+
+/* ============================================================
+   SWEEP
+   ============================================================ */
+
+i = 0;
+if ( SweepMode == SMU_SWEEP_PLAN_HARDWARE )
+{
+    enable(TIMER1);
+
+    for(leg_index = 0; smu_sweep_plan_leg(&plan, leg_index, &leg); leg_index++)
+    {
+        status = smu_sweep_plan_apply(SMU1, &leg, &state);
+        if ( status != 0 )
+        {
+            if(debug) printf("smu_plan_sweep ERROR: limiti()/rangei() failed on leg %d with status: %d\n", leg_index, status);
+            forcev(SMU1, 0.0);
+            clrscn();
+            return( -8 );
+        }
+
+        if ( leg.steps == 1 )
+        {
+            /* sweepv() needs at least one step: force and measure the single
+               point (start point, restart point, hold) directly */
+            status = forcev(SMU1, Vforce[i]);
+            if ( status != 0 )
+            {
+                if(debug) printf("smu_plan_sweep ERROR: forcev() failed at point %d (voltage=%.6f V) with status: %d\n", i, Vforce[i], status);
+                forcev(SMU1, 0.0);
+                clrscn();
+                return( -100 - i );
+            }
+            if ( leg.dwell > 0.0 ) rdelay(leg.dwell);
+            status = measi(SMU1, &Imeas[i]);
+            if ( status != 0 )
+            {
+                if(debug) printf("smu_plan_sweep ERROR: measi() failed at point %d (voltage=%.6f V) with status: %d\n", i, Vforce[i], status);
+                forcev(SMU1, 0.0);
+                clrscn();
+                return( -10 );
+            }
+            meast(TIMER1, &Tmeas[i]);
+            i++;
+            continue;
+        }
+
+        /* Point the scan buffers at this leg's slots, then leg.steps points
+           from v_start's first point to v_stop */
+        clrscn();
+        smeasi(SMU1, &Imeas[i]);
+        smeast(TIMER1, &Tmeas[i]);
+        status = sweepv(SMU1, Vforce[i], leg.v_stop, leg.steps - 1, leg.dwell);
+        if ( status != 0 )
+        {
+            if(debug) printf("smu_plan_sweep ERROR: sweepv() failed on leg %d (%.6f V -> %.6f V) with status: %d\n",
+                             leg_index, Vforce[i], leg.v_stop, status);
+            forcev(SMU1, 0.0);
+            clrscn();
+            return( -9 );
+        }
+        i += leg.steps;
+    }
+
+    forcev(SMU1, 0.0);
+    clrscn();  /* Release the scan buffers registered above */
+}
+else
+{
+    t0 = GetTickCount();
+    for(leg_index = 0; smu_sweep_plan_leg(&plan, leg_index, &leg); leg_index++)
+    {
+        status = smu_sweep_plan_apply(SMU1, &leg, &state);
+        if ( status != 0 )
+        {
+            if(debug) printf("smu_plan_sweep ERROR: limiti()/rangei() failed on leg %d with status: %d\n", leg_index, status);
+            forcev(SMU1, 0.0);
+            return( -8 );
+        }
+        dwell_ms = (int)(leg.dwell * 1000.0 + 0.5);
+
+        for(n = 1; n <= leg.steps; n++)
+        {
+            status = forcev(SMU1, Vforce[i]);
+            if ( status != 0 )
+            {
+                if(debug) printf("smu_plan_sweep ERROR: forcev() failed at point %d (voltage=%.6f V) with status: %d\n", i, Vforce[i], status);
+                forcev(SMU1, 0.0);
+                return( -100 - i );
+            }
+
+            if ( dwell_ms > 0 ) Sleep(dwell_ms);
+
+            status = measi(SMU1, &Imeas[i]);
+            if ( status != 0 )
+            {
+                if(debug) printf("smu_plan_sweep ERROR: measi() failed at point %d (voltage=%.6f V) with status: %d\n", i, Vforce[i], status);
+                forcev(SMU1, 0.0);
+                return( -10 );
+            }
+            Tmeas[i] = (double)(GetTickCount() - t0) / 1000.0;
+            i++;
+        }
+    }
+
+    forcev(SMU1, 0.0);
+}
+
+/* Leave the SMU in auto range */
+setauto(SMU1);
+
+*NumPointsOut = i;
+
+if(debug)
+{
+    printf("smu_plan_sweep: Sweep complete, %d points, %.3f s\n", i, (i > 0) ? Tmeas[i - 1] : 0.0);
+    printf("  Returned to 0 V\n");
+}
+
+return( 0 ); /* Returns zero if execution OK */
+
+/* USRLIB MODULE END  */
+} 		/* End smu_plan_sweep.c */
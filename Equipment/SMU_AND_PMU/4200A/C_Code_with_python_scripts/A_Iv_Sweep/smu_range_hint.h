@@ -0,0 +1,178 @@
+/* Predictive current-range selection for stepped SMU sweeps.
+ * Include from USRLIB modules only (smu_ivsweep.c, etc.).
+ *
+ * Auto-range searches on every measi() call. On a memristor loop the current
+ * only moves by a decade or two between neighbouring points, so the previous
+ * reading (scaled by the voltage ratio) is a good guess for the next one. The
+ * predictor programs a fixed range before the settle delay and only falls back
+ * to auto-range when the reading comes back over-range or buried at the bottom
+ * of the range. */
+
+#ifndef SMU_RANGE_HINT_H
+#define SMU_RANGE_HINT_H
+
+#include <math.h>
+
+/* 4200A SMU current ranges are decades from 1 pA (with preamp) to 1 A. */
+#define SMU_RANGE_HINT_MIN_RANGE 1e-12
+#define SMU_RANGE_HINT_MAX_RANGE 1.0
+#define SMU_RANGE_HINT_DEFAULT_FLOOR 1e-9
+
+/* Predicted current is multiplied by this before picking the decade, so a
+ * reading that grows a little faster than ohmic still lands on-range. */
+#define SMU_RANGE_HINT_HEADROOM 2.0
+
+/* measi() returns 1E+22 on overflow; anything this large is not a reading. */
+#define SMU_RANGE_HINT_OVERFLOW 1e21
+
+/* Readings below this fraction of full scale have lost too many digits. */
+#define SMU_RANGE_HINT_UNDER_FRAC 1e-3
+
+/* Below this |V| the voltage ratio is meaningless (sweep passing 0 V). */
+#define SMU_RANGE_HINT_MIN_VOLTS 1e-6
+
+typedef struct
+{
+  double floor;       /* Lowest range the predictor may select (A) */
+  double ceiling;     /* Highest range the predictor may select (A) */
+  double range;       /* Range currently programmed, 0.0 = auto */
+  double v_prev;      /* Forced voltage of the last good reading */
+  double i_prev;      /* Current of the last good reading */
+  int have_prev;      /* 1 once a good reading has been stored */
+  int range_changes;  /* rangei() calls issued (debug statistics) */
+  int fallbacks;      /* Points re-measured in auto-range (debug statistics) */
+} smu_range_hint_t;
+
+/* Smallest decade range that holds |current| (clamped to the hint limits). */
+static inline double smu_range_hint_decade(const smu_range_hint_t *hint, double current)
+{
+  double mag = fabs(current);
+  double range;
+
+  if (mag <= hint->floor)
+    return hint->floor;
+  range = pow(10.0, ceil(log10(mag) - 1e-9));
+  if (range < hint->floor)
+    range = hint->floor;
+  if (range > hint->ceiling)
+    range = hint->ceiling;
+  return range;
+}
+
+static inline void smu_range_hint_init(smu_range_hint_t *hint, double min_range, double ilimit)
+{
+  if (min_range <= 0.0)
+    min_range = SMU_RANGE_HINT_DEFAULT_FLOOR;
+  if (min_range < SMU_RANGE_HINT_MIN_RANGE)
+    min_range = SMU_RANGE_HINT_MIN_RANGE;
+  hint->floor = pow(10.0, floor(log10(min_range) + 1e-9));
+  hint->ceiling = SMU_RANGE_HINT_MAX_RANGE;
+  /* Never select a range above the one that holds the compliance limit */
+  hint->ceiling = smu_range_hint_decade(hint, ilimit);
+  if (hint->ceiling < hint->floor)
+    hint->ceiling = hint->floor;
+  hint->range = 0.0;
+  hint->v_prev = 0.0;
+  hint->i_prev = 0.0;
+  hint->have_prev = 0;
+  hint->range_changes = 0;
+  hint->fallbacks = 0;
+}
+
+/* Expected |I| at v_next: ohmic scaling of the previous point. When the sweep
+ * moves towards 0 V the ratio shrinks the estimate; when it moves away the
+ * previous reading is kept as a lower bound so the range never lags a rising
+ * current. Returns -1 when there is nothing to scale from (no history, or the
+ * previous point sat at 0 V where the reading is just offset/noise). */
+static inline double smu_range_hint_predict(const smu_range_hint_t *hint, double v_next)
+{
+  double predicted;
+
+  if (!hint->have_prev || fabs(hint->v_prev) < SMU_RANGE_HINT_MIN_VOLTS)
+    return -1.0;
+
+  predicted = fabs(hint->i_prev) * fabs(v_next) / fabs(hint->v_prev);
+  if (fabs(v_next) > fabs(hint->v_prev) && predicted < fabs(hint->i_prev))
+    predicted = fabs(hint->i_prev);
+  return predicted;
+}
+
+/* Program the predicted range for the point about to be measured. Call right
+ * after forcev() so the range relay settles during the step delay. */
+static inline void smu_range_hint_prepare(smu_range_hint_t *hint, int instr, double v_next)
+{
+  double predicted = smu_range_hint_predict(hint, v_next);
+  double range;
+
+  if (predicted < 0.0)
+  {
+    /* Nothing to predict from: let auto-range find this point */
+    if (hint->range != 0.0)
+    {
+      setauto(instr);
+      hint->range = 0.0;
+    }
+    return;
+  }
+
+  range = smu_range_hint_decade(hint, predicted * SMU_RANGE_HINT_HEADROOM);
+  if (range == hint->range)
+    return;
+
+  if (rangei(instr, range) != 0)
+  {
+    /* Range not available on this SMU (e.g. no preamp): never ask again */
+    hint->floor = range * 10.0;
+    if (hint->floor > hint->ceiling)
+      hint->floor = hint->ceiling;
+    setauto(instr);
+    hint->range = 0.0;
+    return;
+  }
+  hint->range = range;
+  hint->range_changes++;
+}
+
+/* Measure current on the prepared range. Over-range or under-range readings
+ * are repeated once in auto-range, so resolution is never worse than plain
+ * auto-range. v_forced is the voltage programmed for this point. */
+static inline int smu_range_hint_measi(smu_range_hint_t *hint, int instr, double v_forced, double *current)
+{
+  int status;
+  int redo = 0;
+  double mag;
+
+  status = measi(instr, current);
+  if (status != 0)
+    return status;
+
+  mag = fabs(*current);
+  if (hint->range > 0.0)
+  {
+    if (mag >= SMU_RANGE_HINT_OVERFLOW || mag >= hint->range)
+      redo = 1;
+    else if (mag < hint->range * SMU_RANGE_HINT_UNDER_FRAC && hint->range > hint->floor)
+      redo = 1;
+  }
+
+  if (redo)
+  {
+    setauto(instr);
+    hint->range = 0.0;
+    hint->fallbacks++;
+    status = measi(instr, current);
+    if (status != 0)
+      return status;
+    mag = fabs(*current);
+  }
+
+  if (mag < SMU_RANGE_HINT_OVERFLOW)
+  {
+    hint->v_prev = v_forced;
+    hint->i_prev = *current;
+    hint->have_prev = 1;
+  }
+  return 0;
+}
+
+#endif /* SMU_RANGE_HINT_H */
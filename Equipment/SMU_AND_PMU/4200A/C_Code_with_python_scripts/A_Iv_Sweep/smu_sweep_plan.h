@@ -0,0 +1,268 @@
+/* Piecewise-linear sweep plans for SMU IV sweeps.
+ * Include from USRLIB modules only (smu_plan_sweep.c, etc.).
+ *
+ * A plan is a vertex list (V0, V1, ... Vn) swept NumCycles times. Leg k runs
+ * from vertex k to vertex k+1 in LegPoints[k] equal steps, with its own dwell,
+ * compliance and current range. The first vertex is measured once at the
+ * start; every leg then measures LegPoints[k] points ending exactly on its
+ * stop vertex, so shared vertices are never measured twice. If the list does
+ * not end where it starts, each new cycle begins with one point back at V0.
+ *
+ *   0,2,0,-2,0  (LegPoints 10)  -> smu_ivsweep / SMU_FullIVsweep loop
+ *   -1,1        (LegPoints 100) -> SMU_VIsweep linear sweep
+ *   0,1.5,1.5,0 (dwell on the flat leg) -> ACraig12_DC_Sweep ramp-hold-ramp
+ *
+ * The same plan can be driven point by point (forcev/measi, software timed)
+ * or as one hardware sweepv() per leg, where the SMU steps and measures on
+ * its own and no LPTLib round trip is made per point. */
+
+#ifndef SMU_SWEEP_PLAN_H
+#define SMU_SWEEP_PLAN_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SMU_SWEEP_PLAN_MAX_VERTICES 64
+#define SMU_SWEEP_PLAN_MAX_LEGS (SMU_SWEEP_PLAN_MAX_VERTICES - 1)
+
+/* Defaults for per-leg lists left empty */
+#define SMU_SWEEP_PLAN_DEFAULT_DWELL 0.001
+#define SMU_SWEEP_PLAN_DEFAULT_ILIMIT 0.1
+
+/* Execution paths */
+#define SMU_SWEEP_PLAN_HARDWARE 0  /* sweepv() per leg, measurements buffered by the SMU */
+#define SMU_SWEEP_PLAN_STEPPED 1   /* forcev()/measi() per point */
+
+/* Two vertices closer than this are treated as the same voltage */
+#define SMU_SWEEP_PLAN_V_EPS 1e-9
+
+typedef struct
+{
+  double vertex[SMU_SWEEP_PLAN_MAX_VERTICES];
+  int num_vertices;
+  int steps[SMU_SWEEP_PLAN_MAX_LEGS];     /* Points measured on each leg */
+  double dwell[SMU_SWEEP_PLAN_MAX_LEGS];  /* Delay before each measurement (s) */
+  double ilimit[SMU_SWEEP_PLAN_MAX_LEGS]; /* Compliance for each leg (A) */
+  double irange[SMU_SWEEP_PLAN_MAX_LEGS]; /* 0.0 = auto, > 0 = fixed range (A) */
+  int cycles;
+  int closed;                             /* 1 if the last vertex equals the first */
+} smu_sweep_plan_t;
+
+typedef struct
+{
+  double v_start;
+  double v_stop;
+  int steps;
+  double dwell;
+  double ilimit;
+  double irange;
+} smu_sweep_leg_t;
+
+/* Settings currently programmed on the SMU, so legs only touch what changes */
+typedef struct
+{
+  double ilimit;
+  double irange;
+  int valid;
+} smu_sweep_plan_state_t;
+
+/* Parse a comma/semicolon/space separated list into array. Returns the number
+ * of values read. KXCI splits EX parameters on commas, so runners send ';'. */
+static inline int smu_sweep_plan_parse(const char *str, double *array, int max_size)
+{
+  char *copy;
+  char *token;
+  int count = 0;
+
+  if (str == NULL || array == NULL || max_size <= 0)
+    return 0;
+
+  copy = (char *)calloc(strlen(str) + 1, sizeof(char));
+  if (copy == NULL)
+    return 0;
+  strcpy(copy, str);
+
+  token = strtok(copy, ",; ");
+  while (token != NULL && count < max_size)
+  {
+    array[count++] = strtod(token, NULL);
+    token = strtok(NULL, ",; ");
+  }
+
+  free(copy);
+  return count;
+}
+
+/* Per-leg list: n values are used as given, a single value applies to every
+ * leg, an empty list gives fallback. Returns -1 for any other length. */
+static inline int smu_sweep_plan_expand(const double *values, int n, int num_legs, double fallback, double *out)
+{
+  int k;
+
+  if (n != 0 && n != 1 && n != num_legs)
+    return -1;
+  for (k = 0; k < num_legs; k++)
+    out[k] = (n == 0) ? fallback : values[(n == 1) ? 0 : k];
+  return 0;
+}
+
+/* Build a plan from the string inputs of a USRLIB module. Returns 0 or:
+ * -1 fewer than 2 vertices, -2 a per-leg list has the wrong length,
+ * -3 a leg has < 1 point, -4 a leg has a negative dwell or limit. */
+static inline int smu_sweep_plan_init(smu_sweep_plan_t *plan, const char *vertices, const char *leg_points,
+                                      const char *leg_dwell, const char *leg_ilimit, const char *leg_irange, int cycles)
+{
+  double values[SMU_SWEEP_PLAN_MAX_LEGS];
+  double expanded[SMU_SWEEP_PLAN_MAX_LEGS];
+  int num_legs, n, k;
+
+  plan->num_vertices = smu_sweep_plan_parse(vertices, plan->vertex, SMU_SWEEP_PLAN_MAX_VERTICES);
+  if (plan->num_vertices < 2)
+    return -1;
+  num_legs = plan->num_vertices - 1;
+  plan->cycles = (cycles < 1) ? 1 : cycles;
+  plan->closed = fabs(plan->vertex[num_legs] - plan->vertex[0]) < SMU_SWEEP_PLAN_V_EPS;
+
+  n = smu_sweep_plan_parse(leg_points, values, SMU_SWEEP_PLAN_MAX_LEGS);
+  if (n == 0 || smu_sweep_plan_expand(values, n, num_legs, 0.0, expanded) != 0)
+    return -2;
+  for (k = 0; k < num_legs; k++)
+  {
+    plan->steps[k] = (int)(expanded[k] + 0.5);
+    if (plan->steps[k] < 1)
+      return -3;
+  }
+
+  n = smu_sweep_plan_parse(leg_dwell, values, SMU_SWEEP_PLAN_MAX_LEGS);
+  if (smu_sweep_plan_expand(values, n, num_legs, SMU_SWEEP_PLAN_DEFAULT_DWELL, plan->dwell) != 0)
+    return -2;
+  n = smu_sweep_plan_parse(leg_ilimit, values, SMU_SWEEP_PLAN_MAX_LEGS);
+  if (smu_sweep_plan_expand(values, n, num_legs, SMU_SWEEP_PLAN_DEFAULT_ILIMIT, plan->ilimit) != 0)
+    return -2;
+  n = smu_sweep_plan_parse(leg_irange, values, SMU_SWEEP_PLAN_MAX_LEGS);
+  if (smu_sweep_plan_expand(values, n, num_legs, 0.0, plan->irange) != 0)
+    return -2;
+
+  for (k = 0; k < num_legs; k++)
+  {
+    if (plan->dwell[k] < 0.0 || plan->ilimit[k] <= 0.0 || plan->irange[k] < 0.0)
+      return -4;
+  }
+  return 0;
+}
+
+/* Leg number `index` of the flattened plan (0 = the single start point).
+ * Returns 0 past the last leg. Cycles after the first begin with a one-point
+ * leg back to V0 when the vertex list is open. */
+static inline int smu_sweep_plan_leg(const smu_sweep_plan_t *plan, int index, smu_sweep_leg_t *leg)
+{
+  int num_legs = plan->num_vertices - 1;
+  int per_cycle = num_legs + (plan->closed ? 0 : 1);
+  int cycle, k;
+
+  if (index == 0)
+  {
+    leg->v_start = plan->vertex[0];
+    leg->v_stop = plan->vertex[0];
+    leg->steps = 1;
+    leg->dwell = plan->dwell[0];
+    leg->ilimit = plan->ilimit[0];
+    leg->irange = plan->irange[0];
+    return 1;
+  }
+
+  /* First cycle has no restart leg: shift it so every cycle has per_cycle legs */
+  index -= 1;
+  if (!plan->closed)
+    index += 1;
+  cycle = index / per_cycle;
+  k = index % per_cycle;
+  if (cycle >= plan->cycles)
+    return 0;
+
+  if (!plan->closed)
+  {
+    if (k == 0)
+    {
+      /* Restart leg: jump back to V0 and measure it once */
+      leg->v_start = plan->vertex[num_legs];
+      leg->v_stop = plan->vertex[0];
+      leg->steps = 1;
+      leg->dwell = plan->dwell[0];
+      leg->ilimit = plan->ilimit[0];
+      leg->irange = plan->irange[0];
+      return 1;
+    }
+    k -= 1;
+  }
+
+  leg->v_start = plan->vertex[k];
+  leg->v_stop = plan->vertex[k + 1];
+  leg->steps = plan->steps[k];
+  leg->dwell = plan->dwell[k];
+  leg->ilimit = plan->ilimit[k];
+  leg->irange = plan->irange[k];
+  return 1;
+}
+
+/* Voltage of point n (1..steps) of a leg. Computed from the endpoints rather
+ * than accumulated, so long legs land exactly on their stop vertex. */
+static inline double smu_sweep_leg_voltage(const smu_sweep_leg_t *leg, int n)
+{
+  if (n >= leg->steps)
+    return leg->v_stop;
+  return leg->v_start + (leg->v_stop - leg->v_start) * (double)n / (double)leg->steps;
+}
+
+/* Total number of points the plan measures */
+static inline int smu_sweep_plan_count(const smu_sweep_plan_t *plan)
+{
+  smu_sweep_leg_t leg;
+  int index, total = 0;
+
+  for (index = 0; smu_sweep_plan_leg(plan, index, &leg); index++)
+    total += leg.steps;
+  return total;
+}
+
+/* Write the forced voltage of every point into vforce (generated once, before
+ * the sweep starts). Returns the number of points written. */
+static inline int smu_sweep_plan_voltages(const smu_sweep_plan_t *plan, double *vforce, int max_points)
+{
+  smu_sweep_leg_t leg;
+  int index, n, i = 0;
+
+  for (index = 0; smu_sweep_plan_leg(plan, index, &leg); index++)
+  {
+    for (n = 1; n <= leg.steps && i < max_points; n++)
+      vforce[i++] = smu_sweep_leg_voltage(&leg, n);
+  }
+  return i;
+}
+
+/* Program compliance and range for a leg, skipping calls when nothing changed.
+ * Returns 0, or the failing LPTLib status. */
+static inline int smu_sweep_plan_apply(int instr, const smu_sweep_leg_t *leg, smu_sweep_plan_state_t *state)
+{
+  int status;
+
+  if (!state->valid || leg->ilimit != state->ilimit)
+  {
+    status = limiti(instr, leg->ilimit);
+    if (status != 0)
+      return status;
+    state->ilimit = leg->ilimit;
+  }
+  if (!state->valid || leg->irange != state->irange)
+  {
+    status = (leg->irange > 0.0) ? rangei(instr, leg->irange) : setauto(instr);
+    if (status != 0)
+      return status;
+    state->irange = leg->irange;
+  }
+  state->valid = 1;
+  return 0;
+}
+
+#endif /* SMU_SWEEP_PLAN_H */
@@ -0,0 +1,40 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: rpm_pathway_reset
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 0
+	INCLUDES:
+#include "keithley.h"
+#include "rpm_pathway.h"
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+
+RPM Pathway Cache Reset
+=======================
+
+Clears the RPM pathway cache kept by rpm_pathway.h in the KXCI process, so
+the next module that calls rpm_pathway_set() actuates the relays again.
+
+Run it (EX A_RPM_Pathway rpm_pathway_reset()) whenever the relays may have
+moved without going through rpm_pathway_set(): after devint() from the LPT
+server, after a test run from Clarius, or after a module that still calls
+rpm_config() directly. The relays themselves are not touched.
+
+Return codes: 0 = OK
+
+END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include "rpm_pathway.h"
+
+/* USRLIB MODULE MAIN FUNCTION */
+int rpm_pathway_reset( )
+{
+/* USRLIB MODULE CODE */
+
+rpm_pathway_invalidate();
+return( 0 );
+
+/* USRLIB MODULE END  */
+} 		/* End rpm_pathway_reset.c */
@@ -2,7 +2,7 @@
 
 	MODULE NAME: ACraig11_PMU_Waveform_Binary
 	MODULE RETURN TYPE: int 
-	NUMBER OF PARMS: 41
+	NUMBER OF PARMS: 48
 	ARGUMENTS:
 		width,	double,	Input,	500e-9,	40e-9,	.999999
 		rise,	double,	Input,	100e-9,	20e-9,	.033
@@ -34,7 +34,7 @@
 		size_T_Stamp,	int,	Input,	3000,	100,	32767
 		Ch2Enable,	int,	Input,	0,	0,	1
 		Ch2VRange,	double,	Input,	10,	5,	40
-		Ch2PatternSize,	int,	Input,	8,	1,	2048
+		Ch2PatternSize,	int,	Input,	8,	1,	100000
 		Ch2Pattern,	char *,	Input,	"10110100",	,	
 		Ch2Delay,	double,	Input,	0.0,	0,	.999999
 		Ch2Width,	double,	Input,	500e-9,	20e-9,	.999999
@@ -45,8 +45,19 @@
 		Ch2Vhigh,	double,	Input,	1.0,	-40,	40
 		Ch2LoopCount,	double,	Input,	1.0,	1.0,	100000.0
 		ClariusDebug,	int,	Input,	0,	0,	1
+		Features,	D_ARRAY_T,	Output,	,	,	
+		size_Features,	int,	Input,	1,	1,	500000
+		NumAverages,	int,	Input,	1,	1,	10000
+		I_Var,	D_ARRAY_T,	Output,	,	,	
+		size_I_Var,	int,	Input,	1,	1,	32767
+		SweepStep,	D_ARRAY_T,	Output,	,	,	
+		size_SweepStep,	int,	Input,	1,	1,	32767
 INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
+#include "pmu_pulse_extract.h"
+#include "binary_pattern_seq.h"
+#include "pmu_exec_wait.h"
 	END USRLIB MODULE INFORMATION
 */
 /* USRLIB MODULE HELP DESCRIPTION
@@ -61,6 +72,23 @@ Uses pulse_fetch() instead of pulse_measrt() for KXCI compatibility.
 CH1: Measures DUT voltage and current with waveform capture using simple pulse commands
 CH2: Binary pulse train (no measurement) - generates sequence of high/low pulses based on pattern
 
+AMPLITUDE SWEEP (startV / stopV / stepV):
+=========================================
+With stopV != startV the CH1 amplitude steps from startV towards stopV in
+|stepV| increments, never past stopV (0 -> 5 V by 2 V is 0, 2, 4 V). Each
+step is its own 6-segment seg_arb sequence looped burstCount times, and all
+steps run back to back in one pulse_exec, so a 20-step amplitude study is
+one EX call with one PMU setup.
+- V_Meas / I_Meas / T_Stamp hold numSteps * burstCount per-pulse averages,
+  step by step (size the arrays for the total)
+- With size_SweepStep > 1, SweepStep[k] is the 0-based step of result k
+  (-1 past the last result)
+- Pulses are located by time (threshold detection is skipped, as steps
+  near 0 V never cross it), from the programmed length of one step loop,
+  which is longer than period when the period is at its minimum
+- At most 341 steps and 100000 pulses in total (else -831)
+- startV == stopV with stepV = 0 is the single-amplitude burst as before
+
 MEASUREMENT WINDOW (40-80% of Pulse Width):
 ===========================================
 When acqType=1 (average mode), the module extracts one averaged measurement per pulse
@@ -85,6 +113,45 @@ The measurement window is hardcoded in the C code at:
   measurementStartFrac = 0.4  (40% of pulse width)
   measurementEndFrac = 0.8    (80% of pulse width)
 
+Pulses are located in one pass over the fetched samples (pmu_pulse_extract.h):
+- Threshold: a pulse starts where |V| rises above |startV|/2; its window is
+  40-80% of the programmed width measured from that edge
+- Time-based: pulse k starts k * T after the first sample, where T is the
+  programmed length of one CH1 loop (the sum of its segment times; equal to
+  period unless the min_seg_time padding could not be absorbed), so each
+  sample maps straight to its pulse and window; used when the threshold
+  path finds fewer than burstCount pulses
+The waveform is fetched in blocks of 10000 samples and each block is reduced
+before the next is fetched, so burstCount * period is not limited by memory.
+
+PER-PULSE FEATURES (Features / size_Features):
+==============================================
+With size_Features >= 5 the same pass also fills Features with one row of
+5 values per pulse (row k = Features[5*k .. 5*k+4], time-based pulse index):
+  [0] t_start   time of the pulse's first sample (s)
+  [1] I_peak    current of largest magnitude (A, signed)
+  [2] t_switch  time of the steepest current step on the flat top,
+                measured from the start of the flat top (s)
+  [3] Q         charge, integral of I dt over rise + width + fall (C)
+  [4] t_rise    10-90% rise time of |I| up to the peak (s)
+Rows = min(burstCount, size_Features / 5); unused rows are 0. Reading back
+Features instead of a waveform costs 5 values per pulse. size_Features = 1
+(default) disables the table.
+
+COHERENT AVERAGING (NumAverages / I_Var):
+=========================================
+For noisy low-current captures (e.g. 100 nA range) NumAverages = M > 1
+executes the armed test M times and averages the M waveforms sample by
+sample before extraction (pmu_wave_avg in pmu_pulse_extract.h). Each run
+starts on the same trigger, so sample i is the same point of the waveform
+in every run; noise drops by sqrt(M) and V_Meas / I_Meas / T_Stamp and
+Features come from the averaged trace, with no extra data sent back.
+- The averaged capture is held in memory: period * burstCount * SampleRate
+  must not exceed 1000000 samples when NumAverages > 1 (else -831)
+- With size_I_Var > 1, I_Var[k] is the variance of a single run's current
+  (A^2) averaged over pulse k's window; I_Var[k] / NumAverages is the
+  variance of the averaged samples. Needs NumAverages > 1, else zeros.
+
 CH2 BINARY PATTERN PARAMETERS:
 ==============================
 CH2 generates a binary pulse train based on a pattern array of 0s and 1s.
@@ -92,7 +159,7 @@ CH2 generates a binary pulse train based on a pattern array of 0s and 1s.
 Parameters:
 - Ch2Pattern: Array of integers (0s and 1s) defining the binary pattern
   Example: [1,0,1,1,0,1,0,0] generates: HIGH-LOW-HIGH-HIGH-LOW-HIGH-LOW-LOW
-- Ch2PatternSize: Length of pattern array (1-2048 bits)
+- Ch2PatternSize: Length of pattern array (1-100000 bits)
 - Ch2Delay: Delay before pattern starts in seconds (0 = no delay) - holds at 0V during delay
 - Ch2Width: Pulse width for '1' bits in seconds (minimum 20ns) - duration of flat high
 - Ch2Rise: Rise time in seconds (minimum 20ns) - transition time from low to high
@@ -100,7 +167,9 @@ Parameters:
 - Ch2Spacing: Spacing between bits in seconds (minimum 20ns) - flat low time after fall
 - Ch2Vlow: Voltage level for '0' bits (typically 0V)
 - Ch2Vhigh: Voltage level for '1' bits (typically 1V, 3.3V, or 5V)
-- Ch2LoopCount: Number of times to repeat the entire pattern (default 1.0)
+- Ch2LoopCount: Number of times to repeat the entire pattern (default 1.0).
+  Must be an integer when the compiled pattern has more than one sequence
+  (else -122)
 
 How it works:
 - Delay segment: Hold at 0V for Ch2Delay (if > 0)
@@ -109,6 +178,15 @@ How it works:
 - Each bit creates 2-4 segments depending on voltage transitions
 - Pattern repeats Ch2LoopCount times
 
+Pattern compression (binary_pattern_seq.h):
+- A '1' and the '0's after it share one low segment, leading '0's are one
+  segment, so "1000" costs 4 segments instead of 7
+- Blocks of bits that repeat back to back (e.g. "1100" x 500) become a
+  separate seg_arb sequence with a loop count; identical blocks share it
+- The limit is 2048 segments and 512 sequences after compression, not the
+  pattern length, so 10^4-10^5 bit patterns with structure fit in one call
+- The waveform is identical to the bit-by-bit one
+
 Example: Pattern [1,0,1] with Ch2Delay=5µs, Ch2Width=500ns, Ch2Rise=100ns, Ch2Fall=100ns, Ch2Spacing=500ns, Ch2Vlow=0V, Ch2Vhigh=1.5V:
 - Delay: 0V flat (5µs)
 - Bit 1: 0V->1.5V (100ns rise) + 1.5V flat (500ns) + 1.5V->0V (100ns fall) + 0V flat (500ns spacing)
@@ -116,15 +194,28 @@ Example: Pattern [1,0,1] with Ch2Delay=5µs, Ch2Width=500ns, Ch2Rise=100ns, Ch2F
 - Bit 1: 0V->1.5V (100ns rise) + 1.5V flat (500ns) + 1.5V->0V (100ns fall) + 0V flat (500ns spacing)
 - Total pattern duration: ~7.2µs (5µs delay + 2.2µs pattern)
 
+COMPLETION WAIT (pmu_exec_wait.h):
+==================================
+- The module sleeps through ~90% of the programmed run time (the longer of
+  CH1 loop length * pulses and the CH2 sequence duration), then polls
+  pulse_exec_status() at 1-20 ms; short captures return in milliseconds
+- Timeout (-998) is 2 x the programmed run time + 2 s, not a fixed 20 s
+
 NOTE: CH2 should be enabled (Ch2Enable=1) even if not using it - disabling CH2 may cause pulse_exec to fail.
 
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
+#include "pmu_pulse_extract.h"
+#include "binary_pattern_seq.h"
+#include "pmu_exec_wait.h"
 #include <math.h>  // For fmod, floor, ceil
 #include <stdlib.h>  // For calloc, free
 #include <string.h>  // For strlen
 
+#define ACRAIG11_MAX_SWEEP_STEPS 341  /* 2048 CH1 segments / 6 per step */
+
 BOOL LPTIsInCurrentConfiguration(char* hrid);
 
 /* USRLIB MODULE MAIN FUNCTION */
@@ -141,7 +232,10 @@ int ACraig11_PMU_Waveform_Binary(
     int Ch2Enable, double Ch2VRange, 
     int Ch2PatternSize, char *Ch2Pattern,
     double Ch2Delay, double Ch2Width, double Ch2Rise, double Ch2Fall, double Ch2Spacing, double Ch2Vlow, double Ch2Vhigh, double Ch2LoopCount,
-    int ClariusDebug )
+    int ClariusDebug,
+    double *Features, int size_Features,
+    int NumAverages, double *I_Var, int size_I_Var,
+    double *SweepStep, int size_SweepStep )
 {
 /* USRLIB MODULE CODE */
     int debug = 0;
@@ -151,21 +245,22 @@ int ACraig11_PMU_Waveform_Binary(
     int TestMode;
     int sweepType = PULSE_AMPLITUDE_SP;
     double dSweeps;
-    double pointsPerWfm;
     double DIFF = 1.0e-9;
-    int i, j;
-    
-    double *waveformV = NULL;
-    double *waveformI = NULL;
-    double *waveformT = NULL;
+    int i;
 
     if (ClariusDebug == 1) { debug = 1; } else { debug = 0; }
     if(debug) printf("\n\nACraig11_PMU_Waveform_Binary: starts\n");
     
+    if (NumAverages < 1 || NumAverages > 10000)
+    {
+        if(debug) printf("ERROR: NumAverages (%d) must be between 1 and 10000\n", NumAverages);
+        return -122;
+    }
+    
     // Validate Ch2PatternSize
-    if (Ch2PatternSize < 1 || Ch2PatternSize > 2048)
+    if (Ch2PatternSize < 1 || Ch2PatternSize > 100000)
     {
-        if(debug) printf("ERROR: Ch2PatternSize (%d) must be between 1 and 2048\n", Ch2PatternSize);
+        if(debug) printf("ERROR: Ch2PatternSize (%d) must be between 1 and 100000\n", Ch2PatternSize);
         return -122;
     }
     
@@ -289,26 +384,33 @@ int ACraig11_PMU_Waveform_Binary(
             if(debug) printf("Invalid sweep parameters: startV!=stopV but stepV==0\n");
             return -844;
         }
-        dSweeps = (fabs((stopV - startV) / stepV) + 0.5) + 1;
-        if (dSweeps > 65536)
+        // Whole steps only, so the last amplitude never goes past stopV
+        dSweeps = floor(fabs((stopV - startV) / stepV) + 1e-9) + 1;
+        // One 6-segment CH1 sequence per step (2048 segments per channel);
+        // the capture is streamed, so samples per step are not limited
+        if (dSweeps > ACRAIG11_MAX_SWEEP_STEPS)
         {
-            if(debug) printf("Too many sweep points: %g\n", dSweeps);
-            return -831;
-        }
-        pointsPerWfm = period * SampleRate + 1;
-        if (pointsPerWfm*dSweeps > 65536)
-        {
-            if(debug) printf("Total samples exceed maximum\n");
+            if(debug) printf("Too many sweep points: %g (max %d)\n", dSweeps, ACRAIG11_MAX_SWEEP_STEPS);
             return -831;
         }
     }
 
-    if(debug) printf("Number of sweep points: %g\n", dSweeps);
+    // Amplitude sweep: step s pulses at startV + s * sweepStep (towards stopV)
+    int numSteps = (int)dSweeps;
+    double sweepStep = (stopV >= startV) ? fabs(stepV) : -fabs(stepV);
+    int totalPulses = numSteps * burstCount;
+    if (numSteps > 1 && (double)numSteps * burstCount > 100000)
+    {
+        if(debug) printf("Too many pulses: %d steps x %d = %.0f (max 100000)\n", numSteps, burstCount, (double)numSteps * burstCount);
+        return -831;
+    }
+
+    if(debug) printf("Number of sweep points: %d (%d pulses in total)\n", numSteps, totalPulses);
 
     // Ensure that 4225-RPMs (if attached) are in pulse mode for CH1
-    status = rpm_config(pulserId, chan, KI_RPM_PATHWAY, KI_RPM_PULSE);
+    status = rpm_pathway_set(pulserId, chan, KI_RPM_PULSE);
     if ( status && debug )
-       printf("rpm_config CH1 returned: %d\n", status);
+       printf("rpm_pathway_set CH1 returned: %d\n", status);
 
     // Put card into pulse mode
     // NOTE: Both CH1 and CH2 now use seg_arb, so we MUST use PULSE_MODE_SARB
@@ -497,8 +599,11 @@ int ACraig11_PMU_Waveform_Binary(
     }
     
     // Build CH1 segments: preDelay (delay) + rise + width + fall + postDelay + final 0V segment
-    // Need 6 segments to ensure we end at 0V with relays closed
-    int ch1_num_segments = 6;
+    // Need 6 segments per pulse to ensure we end at 0V with relays closed.
+    // An amplitude sweep (numSteps > 1) gets one such sequence per step, each
+    // looped burstCount times, all in one seg_arb_waveform
+    int ch1_seq_segments = 6;
+    int ch1_num_segments = ch1_seq_segments * numSteps;
     double *ch1_startv = (double *)calloc(ch1_num_segments, sizeof(double));
     double *ch1_stopv = (double *)calloc(ch1_num_segments, sizeof(double));
     double *ch1_segtime = (double *)calloc(ch1_num_segments, sizeof(double));
@@ -507,9 +612,12 @@ int ACraig11_PMU_Waveform_Binary(
     long *ch1_meastype = (long *)calloc(ch1_num_segments, sizeof(long));
     double *ch1_measstart = (double *)calloc(ch1_num_segments, sizeof(double));
     double *ch1_measstop = (double *)calloc(ch1_num_segments, sizeof(double));
+    long *ch1_seqList = (long *)calloc(numSteps, sizeof(long));
+    double *ch1_loopCount = (double *)calloc(numSteps, sizeof(double));
     
     if (!ch1_startv || !ch1_stopv || !ch1_segtime || !ch1_ssrctrl || 
-        !ch1_segtrigout || !ch1_meastype || !ch1_measstart || !ch1_measstop)
+        !ch1_segtrigout || !ch1_meastype || !ch1_measstart || !ch1_measstop ||
+        !ch1_seqList || !ch1_loopCount)
     {
         if(debug) printf("ERROR: Failed to allocate memory for CH1 segments\n");
         if (ch1_startv) free(ch1_startv);
@@ -520,64 +628,89 @@ int ACraig11_PMU_Waveform_Binary(
         if (ch1_meastype) free(ch1_meastype);
         if (ch1_measstart) free(ch1_measstart);
         if (ch1_measstop) free(ch1_measstop);
+        if (ch1_seqList) free(ch1_seqList);
+        if (ch1_loopCount) free(ch1_loopCount);
         return -999;
     }
     
+    // Segment 5 (and segment 0 when delay is 0) adds min_seg_time the period
+    // does not include; take it out of the post-delay where it fits, so one
+    // loop of the sequence is exactly one period
+    double seg0_time = (delay > 0) ? delay : min_seg_time;
+    double seg4_time = (ch1_post_delay > 0) ? ch1_post_delay : min_seg_time;
+    double seq_extra = (seg0_time - delay) + min_seg_time;
+    if (seg4_time - seq_extra >= min_seg_time)
+        seg4_time -= seq_extra;
+    
+    // Actual length of one loop: pulse k starts k * ch1_loop_time after the
+    // first one. Near the minimum period the padding does not fit and the
+    // loop is longer than period, so timing below uses this, never period.
+    double ch1_loop_time = seg0_time + rise + width + fall + seg4_time + min_seg_time;
+    if(debug && fabs(ch1_loop_time - period) > 1e-12)
+        printf("NOTE: CH1 loop is %.6g s, %.6g s longer than period\n", ch1_loop_time, ch1_loop_time - period);
+    
     // Build CH1 segments
     // For seg_arb waveform measurement, use meastype=2 and measure full segment duration
     // Following working example: measstart=0, measstop=segtime for each segment
     int idx = 0;
-    
-    // Segment 0: Pre-delay (at baseV) - no measurement
-    // If delay is 0, use minimum segment time to avoid invalid parameter
-    double seg0_time = (delay > 0) ? delay : min_seg_time;
-    ch1_startv[idx] = baseV; ch1_stopv[idx] = baseV; ch1_segtime[idx] = seg0_time;
-    ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 1;  // First segment triggers
-    ch1_meastype[idx] = 0; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;  // No measurement
-    idx++;
-    
-    // Segment 1: Rise (baseV -> startV) - measure full segment
-    ch1_startv[idx] = baseV; ch1_stopv[idx] = startV; ch1_segtime[idx] = rise;
-    ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;
-    ch1_meastype[idx] = 2;  // Waveform measurement (type 2, not 3!)
-    ch1_measstart[idx] = 0.0;  // Start of segment
-    ch1_measstop[idx] = rise;  // End of segment (full duration)
-    idx++;
-    
-    // Segment 2: Width (at startV) - measure full segment (this is where 40-80% window will be extracted)
-    ch1_startv[idx] = startV; ch1_stopv[idx] = startV; ch1_segtime[idx] = width;
-    ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;
-    ch1_meastype[idx] = 2;  // Waveform measurement (type 2, not 3!)
-    ch1_measstart[idx] = 0.0;  // Start of segment
-    ch1_measstop[idx] = width;  // End of segment (full duration)
-    idx++;
-    
-    // Segment 3: Fall (startV -> baseV) - measure full segment
-    ch1_startv[idx] = startV; ch1_stopv[idx] = baseV; ch1_segtime[idx] = fall;
-    ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;
-    ch1_meastype[idx] = 2;  // Waveform measurement (type 2, not 3!)
-    ch1_measstart[idx] = 0.0;  // Start of segment
-    ch1_measstop[idx] = fall;  // End of segment (full duration)
-    idx++;
-    
-    // Segment 4: Post-delay (at baseV)
-    // Ensure post_delay is at least minimum segment time (or 0 if period exactly matches pulse time)
-    double seg4_time = (ch1_post_delay > 0) ? ch1_post_delay : min_seg_time;
-    ch1_startv[idx] = baseV; ch1_stopv[idx] = baseV; ch1_segtime[idx] = seg4_time;
-    ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;  // Relays closed
-    ch1_meastype[idx] = 0; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;
-    idx++;
-    
-    // Segment 5: Final segment - ensure we end at 0V with relays closed
-    ch1_startv[idx] = baseV; ch1_stopv[idx] = 0.0; ch1_segtime[idx] = min_seg_time;
-    ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;  // Relays closed
-    ch1_meastype[idx] = 0; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;
+    int step;
+    for (step = 0; step < numSteps; step++)
+    {
+        double stepAmplitude = startV + step * sweepStep;
+        
+        // Segment 0: Pre-delay (at baseV) - no measurement
+        // If delay is 0, use minimum segment time to avoid invalid parameter
+        ch1_startv[idx] = baseV; ch1_stopv[idx] = baseV; ch1_segtime[idx] = seg0_time;
+        ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = (step == 0) ? 1 : 0;  // First segment triggers
+        ch1_meastype[idx] = 0; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;  // No measurement
+        idx++;
+        
+        // Segment 1: Rise (baseV -> amplitude) - measure full segment
+        ch1_startv[idx] = baseV; ch1_stopv[idx] = stepAmplitude; ch1_segtime[idx] = rise;
+        ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;
+        ch1_meastype[idx] = 2;  // Waveform measurement (type 2, not 3!)
+        ch1_measstart[idx] = 0.0;  // Start of segment
+        ch1_measstop[idx] = rise;  // End of segment (full duration)
+        idx++;
+        
+        // Segment 2: Width (at amplitude) - measure full segment (this is where 40-80% window will be extracted)
+        ch1_startv[idx] = stepAmplitude; ch1_stopv[idx] = stepAmplitude; ch1_segtime[idx] = width;
+        ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;
+        ch1_meastype[idx] = 2;  // Waveform measurement (type 2, not 3!)
+        ch1_measstart[idx] = 0.0;  // Start of segment
+        ch1_measstop[idx] = width;  // End of segment (full duration)
+        idx++;
+        
+        // Segment 3: Fall (amplitude -> baseV) - measure full segment
+        ch1_startv[idx] = stepAmplitude; ch1_stopv[idx] = baseV; ch1_segtime[idx] = fall;
+        ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;
+        ch1_meastype[idx] = 2;  // Waveform measurement (type 2, not 3!)
+        ch1_measstart[idx] = 0.0;  // Start of segment
+        ch1_measstop[idx] = fall;  // End of segment (full duration)
+        idx++;
+        
+        // Segment 4: Post-delay (at baseV)
+        ch1_startv[idx] = baseV; ch1_stopv[idx] = baseV; ch1_segtime[idx] = seg4_time;
+        ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;  // Relays closed
+        ch1_meastype[idx] = 0; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;
+        idx++;
+        
+        // Segment 5: Final segment - ensure we end at 0V with relays closed
+        ch1_startv[idx] = baseV; ch1_stopv[idx] = 0.0; ch1_segtime[idx] = min_seg_time;
+        ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;  // Relays closed
+        ch1_meastype[idx] = 0; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;
+        idx++;
+        
+        // Step s is sequence s+1, played burstCount times
+        ch1_seqList[step] = step + 1;
+        ch1_loopCount[step] = (double)burstCount;
+    }
     
     if(debug) 
     {
-        printf("Built %d segments for CH1:\n", ch1_num_segments);
+        printf("Built %d segments for CH1 (%d amplitude step%s):\n", ch1_num_segments, numSteps, (numSteps > 1) ? "s" : "");
         printf("  Validating segment times (min=%.6g s):\n", min_seg_time);
-        for (i = 0; i < ch1_num_segments; i++)
+        for (i = 0; i < ch1_num_segments && i < 12; i++)
         {
             printf("  Seg %d: %.6g V -> %.6g V, time=%.6g s", 
                    i, ch1_startv[i], ch1_stopv[i], ch1_segtime[i]);
@@ -590,6 +723,7 @@ int ACraig11_PMU_Waveform_Binary(
             printf(", meas=%ld (%.6g-%.6g)\n", 
                    ch1_meastype[i], ch1_measstart[i], ch1_measstop[i]);
         }
+        if (ch1_num_segments > 12) printf("  ... (showing first 12 segments)\n");
     }
     
     // Final validation: ensure all segment times are valid
@@ -601,73 +735,78 @@ int ACraig11_PMU_Waveform_Binary(
             free(ch1_startv); free(ch1_stopv); free(ch1_segtime);
             free(ch1_ssrctrl); free(ch1_segtrigout); free(ch1_meastype);
             free(ch1_measstart); free(ch1_measstop);
+            free(ch1_seqList); free(ch1_loopCount);
             return -122;
         }
     }
     
-    // Configure seg_arb sequence for CH1
-    if(debug) 
+    // Configure one seg_arb sequence for CH1 per amplitude step
+    for (step = 0; step < numSteps; step++)
     {
-        printf("Configuring seg_arb_sequence for CH%d (%d segments)...\n", chan, ch1_num_segments);
-        printf("  pulserId=%d, channel=%d, sequenceNumber=1, numSegments=%d\n", pulserId, chan, ch1_num_segments);
-        fflush(stdout);
-    }
-    
-    status = seg_arb_sequence(pulserId, chan, 1, ch1_num_segments,
-                              ch1_startv, ch1_stopv, ch1_segtime,
-                              ch1_segtrigout, ch1_ssrctrl,
-                              ch1_meastype, ch1_measstart, ch1_measstop);
-    
-    if(debug) 
-    {
-        printf("seg_arb_sequence CH1 returned: %d\n", status);
-        fflush(stdout);
-    }
-    
-    if ( status )
-    {
-        if(debug) 
+        int first = step * ch1_seq_segments;
+        
+        if(debug && (step == 0 || step == numSteps - 1)) 
+        {
+            printf("Configuring seg_arb_sequence for CH%d (%d segments)...\n", chan, ch1_seq_segments);
+            printf("  pulserId=%d, channel=%d, sequenceNumber=%d, numSegments=%d, amplitude=%.6g V\n",
+                   pulserId, chan, step + 1, ch1_seq_segments, ch1_stopv[first + 1]);
+            fflush(stdout);
+        }
+        
+        status = seg_arb_sequence(pulserId, chan, step + 1, ch1_seq_segments,
+                                  &ch1_startv[first], &ch1_stopv[first], &ch1_segtime[first],
+                                  &ch1_segtrigout[first], &ch1_ssrctrl[first],
+                                  &ch1_meastype[first], &ch1_measstart[first], &ch1_measstop[first]);
+        if ( status )
         {
-            printf("ERROR: seg_arb_sequence CH1 failed: %d\n", status);
-            if (status == -804)
-                printf("  Error -804: seg_arb function not valid in present pulse mode\n");
+            if(debug) 
+            {
+                printf("ERROR: seg_arb_sequence CH1 sequence %d failed: %d\n", step + 1, status);
+                if (status == -804)
+                    printf("  Error -804: seg_arb function not valid in present pulse mode\n");
+            }
+            free(ch1_startv); free(ch1_stopv); free(ch1_segtime);
+            free(ch1_ssrctrl); free(ch1_segtrigout); free(ch1_meastype);
+            free(ch1_measstart); free(ch1_measstop);
+            free(ch1_seqList); free(ch1_loopCount);
+            return status;
         }
-        free(ch1_startv); free(ch1_stopv); free(ch1_segtime);
-        free(ch1_ssrctrl); free(ch1_segtrigout); free(ch1_meastype);
-        free(ch1_measstart); free(ch1_measstop);
-        return status;
     }
     
-    // Configure seg_arb waveform for CH1 (loop count = burstCount)
-    long ch1_seqList[1] = {1};
-    double ch1_loopCount[1] = {(double)burstCount};
+    // Configure seg_arb waveform for CH1 (each step's loop count = burstCount)
+    if(debug) printf("Configuring seg_arb_waveform for CH%d (%d sequence%s, loop count=%d each)...\n",
+                     chan, numSteps, (numSteps > 1) ? "s" : "", burstCount);
     
-    if(debug) printf("Configuring seg_arb_waveform for CH%d (loop count=%d)...\n", chan, burstCount);
-    
-    status = seg_arb_waveform(pulserId, chan, 1, ch1_seqList, ch1_loopCount);
+    status = seg_arb_waveform(pulserId, chan, numSteps, ch1_seqList, ch1_loopCount);
     if ( status )
     {
         if(debug) printf("ERROR: seg_arb_waveform CH1 failed: %d\n", status);
         free(ch1_startv); free(ch1_stopv); free(ch1_segtime);
         free(ch1_ssrctrl); free(ch1_segtrigout); free(ch1_meastype);
         free(ch1_measstart); free(ch1_measstop);
+        free(ch1_seqList); free(ch1_loopCount);
         return status;
     }
     
     if(debug) 
     {
-        printf("CH1 seg_arb configured: %d segments, loop count=%d\n", ch1_num_segments, burstCount);
-        printf("  Total CH1 duration: %.6g s (%d pulses @ %.6g s period)\n", 
-               burstCount * period, burstCount, period);
+        printf("CH1 seg_arb configured: %d segments, %d step%s x loop count %d\n",
+               ch1_num_segments, numSteps, (numSteps > 1) ? "s" : "", burstCount);
+        printf("  Total CH1 duration: %.6g s (%d pulses @ %.6g s loop)\n", 
+               totalPulses * ch1_loop_time, totalPulses, ch1_loop_time);
     }
     
     // Free CH1 segment arrays (seg_arb_sequence has copied data to hardware)
     free(ch1_startv); free(ch1_stopv); free(ch1_segtime);
     free(ch1_ssrctrl); free(ch1_segtrigout); free(ch1_meastype);
     free(ch1_measstart); free(ch1_measstop);
+    free(ch1_seqList); free(ch1_loopCount);
     
-    if(debug) printf("Configured CH1 for %d pulses with waveform capture (acqType=%d)\n", burstCount, acqType);
+    if(debug) printf("Configured CH1 for %d pulses with waveform capture (acqType=%d)\n", totalPulses, acqType);
 
+    // Programmed run time of the longest channel, for the completion wait
+    double exec_duration = ch1_loop_time * totalPulses;
+    
     // ============================================================
     // CH2 Setup for seg_arb waveform (no measurement)
     // ============================================================
@@ -675,203 +814,100 @@ int ACraig11_PMU_Waveform_Binary(
     {
         int ch2 = (chan == 1) ? 2 : 1;  // Use the other channel
         
-        // Build CH2 segments from binary pattern
-        // Each bit gets: transition (if voltage changed) + flat segment
-        // Maximum segments: 2 per bit + 1 final = 2*Ch2PatternSize + 1
-        // But we'll allocate dynamically based on actual pattern
-        int max_ch2_segments = 2 * Ch2PatternSize + 2;  // Extra buffer for safety
-        int actual_ch2_segments = max_ch2_segments;  // Will be updated after building
-        
-        // Allocate arrays for segments (use max size)
-        double *ch2_startv = (double *)calloc(max_ch2_segments, sizeof(double));
-        double *ch2_stopv = (double *)calloc(max_ch2_segments, sizeof(double));
-        double *ch2_segtime = (double *)calloc(max_ch2_segments, sizeof(double));
-        long *ch2_ssrctrl = (long *)calloc(max_ch2_segments, sizeof(long));
-        long *ch2_segtrigout = (long *)calloc(max_ch2_segments, sizeof(long));
-        long *ch2_meastype = (long *)calloc(max_ch2_segments, sizeof(long));
-        double *ch2_measstart = (double *)calloc(max_ch2_segments, sizeof(double));
-        double *ch2_measstop = (double *)calloc(max_ch2_segments, sizeof(double));
-        
-        if (!ch2_startv || !ch2_stopv || !ch2_segtime || !ch2_ssrctrl || 
-            !ch2_segtrigout || !ch2_meastype || !ch2_measstart || !ch2_measstop)
+        // Validate Ch2LoopCount before using it
+        // Check for NaN, infinity, or invalid values
+        if (Ch2LoopCount != Ch2LoopCount || Ch2LoopCount < 1.0)  // NaN check: NaN != NaN is true
         {
-            if(debug) printf("ERROR: Failed to allocate memory for CH2 segments\n");
-            if (ch2_startv) free(ch2_startv);
-            if (ch2_stopv) free(ch2_stopv);
-            if (ch2_segtime) free(ch2_segtime);
-            if (ch2_ssrctrl) free(ch2_ssrctrl);
-            if (ch2_segtrigout) free(ch2_segtrigout);
-            if (ch2_meastype) free(ch2_meastype);
-            if (ch2_measstart) free(ch2_measstart);
-            if (ch2_measstop) free(ch2_measstop);
-            return -999;
+            if(debug) 
+            {
+                if (Ch2LoopCount != Ch2LoopCount)
+                    printf("ERROR: Ch2LoopCount is NaN (not a number)\n");
+                else if (Ch2LoopCount < 1.0)
+                    printf("ERROR: Ch2LoopCount (%.6g) must be >= 1.0\n", Ch2LoopCount);
+            }
+            free(patternArray);
+            return -122;
         }
         
-        // Build segments from pattern
-        // Start with delay segment (if Ch2Delay > 0)
-        // For each bit:
-        //   - If bit = 1: rise to high + width (flat high) + fall to low + spacing (flat low)
-        //   - If bit = 0: spacing (flat low) only
-        double prev_voltage = 0.0;  // Start at 0V
-        
-        int seg_idx = 0;
-        
-        // Add delay segment at the beginning (if delay > 0)
-        if (Ch2Delay > ch2_min_seg_time)
+        // Check for infinity
+        if (Ch2LoopCount > 1e10)
         {
-            ch2_startv[seg_idx] = 0.0;
-            ch2_stopv[seg_idx] = 0.0;  // Hold at 0V during delay
-            ch2_segtime[seg_idx] = Ch2Delay;
-            ch2_ssrctrl[seg_idx] = 1;
-            ch2_segtrigout[seg_idx] = 1;  // First segment triggers
-            ch2_meastype[seg_idx] = 0;
-            ch2_measstart[seg_idx] = 0.0;
-            ch2_measstop[seg_idx] = 0.0;
-            seg_idx++;
-            prev_voltage = 0.0;
+            if(debug) printf("ERROR: Ch2LoopCount (%.6g) is too large (infinity?)\n", Ch2LoopCount);
+            free(patternArray);
+            return -122;
         }
         
-        for (i = 0; i < Ch2PatternSize; i++)
-        {
-            if (patternArray[i] == 1)  // Bit = 1: pulse high
-            {
-                // Rise: transition to high voltage (if not already high)
-                if (fabs(prev_voltage - Ch2Vhigh) > 1e-6)
-                {
-                    ch2_startv[seg_idx] = prev_voltage;
-                    ch2_stopv[seg_idx] = Ch2Vhigh;
-                    ch2_segtime[seg_idx] = Ch2Rise;
-                    ch2_ssrctrl[seg_idx] = 1;
-                    ch2_segtrigout[seg_idx] = (seg_idx == 0) ? 1 : 0;
-                    ch2_meastype[seg_idx] = 0;
-                    ch2_measstart[seg_idx] = 0.0;
-                    ch2_measstop[seg_idx] = 0.0;
-                    seg_idx++;
-                }
-                
-                // Flat top at high voltage (pulse width)
-                ch2_startv[seg_idx] = Ch2Vhigh;
-                ch2_stopv[seg_idx] = Ch2Vhigh;  // Flat
-                ch2_segtime[seg_idx] = Ch2Width;
-                ch2_ssrctrl[seg_idx] = 1;
-                ch2_segtrigout[seg_idx] = (seg_idx == 0) ? 1 : 0;
-                ch2_meastype[seg_idx] = 0;
-                ch2_measstart[seg_idx] = 0.0;
-                ch2_measstop[seg_idx] = 0.0;
-                seg_idx++;
-                
-                // Fall: transition to low
-                ch2_startv[seg_idx] = Ch2Vhigh;
-                ch2_stopv[seg_idx] = Ch2Vlow;
-                ch2_segtime[seg_idx] = Ch2Fall;
-                ch2_ssrctrl[seg_idx] = 1;
-                ch2_segtrigout[seg_idx] = 0;
-                ch2_meastype[seg_idx] = 0;
-                ch2_measstart[seg_idx] = 0.0;
-                ch2_measstop[seg_idx] = 0.0;
-                seg_idx++;
-                
-                // Spacing: flat low after fall
-                ch2_startv[seg_idx] = Ch2Vlow;
-                ch2_stopv[seg_idx] = Ch2Vlow;  // Flat
-                ch2_segtime[seg_idx] = Ch2Spacing;
-                ch2_ssrctrl[seg_idx] = 1;
-                ch2_segtrigout[seg_idx] = 0;
-                ch2_meastype[seg_idx] = 0;
-                ch2_measstart[seg_idx] = 0.0;
-                ch2_measstop[seg_idx] = 0.0;
-                seg_idx++;
-                
-                prev_voltage = Ch2Vlow;
-            }
-            else  // Bit = 0: stay low (spacing only)
-            {
-                // Spacing: hold at low voltage
-                if (fabs(prev_voltage - Ch2Vlow) > 1e-6)
-                {
-                    // Transition to low first (if needed)
-                    ch2_startv[seg_idx] = prev_voltage;
-                    ch2_stopv[seg_idx] = Ch2Vlow;
-                    ch2_segtime[seg_idx] = Ch2Fall;  // Use fall time for transition to low
-                    ch2_ssrctrl[seg_idx] = 1;
-                    ch2_segtrigout[seg_idx] = (seg_idx == 0) ? 1 : 0;
-                    ch2_meastype[seg_idx] = 0;
-                    ch2_measstart[seg_idx] = 0.0;
-                    ch2_measstop[seg_idx] = 0.0;
-                    seg_idx++;
-                }
-                
-                // Hold at low for spacing duration
-                ch2_startv[seg_idx] = Ch2Vlow;
-                ch2_stopv[seg_idx] = Ch2Vlow;  // Flat
-                ch2_segtime[seg_idx] = Ch2Spacing;
-                ch2_ssrctrl[seg_idx] = 1;
-                ch2_segtrigout[seg_idx] = (seg_idx == 0) ? 1 : 0;
-                ch2_meastype[seg_idx] = 0;
-                ch2_measstart[seg_idx] = 0.0;
-                ch2_measstop[seg_idx] = 0.0;
-                seg_idx++;
-                
-                prev_voltage = Ch2Vlow;
-            }
-        }
+        double valid_loop_count = Ch2LoopCount;
         
-        // Final segment: return to 0V
-        if (fabs(prev_voltage) > 1e-6)  // Only add if not already at 0V
+        // Compile the pattern into seg_arb sequences (see binary_pattern_seq.h):
+        // runs of low time are merged into single segments and blocks that repeat
+        // back to back become their own sequence with a loop count, so long
+        // patterns fit in the 2048 hardware segments
+        bps_program *ch2_prog = (bps_program *)calloc(1, sizeof(bps_program));
+        if (ch2_prog == NULL)
         {
-            ch2_startv[seg_idx] = prev_voltage;
-            ch2_stopv[seg_idx] = 0.0;
-            ch2_segtime[seg_idx] = ch2_min_seg_time;  // Minimal time to return to 0V
-            ch2_ssrctrl[seg_idx] = 1;  // Relays closed
-            ch2_segtrigout[seg_idx] = 0;
-            ch2_meastype[seg_idx] = 0;  // No measurement
-            ch2_measstart[seg_idx] = 0.0;
-            ch2_measstop[seg_idx] = 0.0;
-            seg_idx++;
+            if(debug) printf("ERROR: Failed to allocate memory for CH2 segments\n");
+            free(patternArray);
+            return -999;
         }
         
-        // Update actual segment count
-        actual_ch2_segments = seg_idx;
+        bps_timing ch2_timing;
+        ch2_timing.vlow = Ch2Vlow;
+        ch2_timing.vhigh = Ch2Vhigh;
+        ch2_timing.width = Ch2Width;
+        ch2_timing.rise = Ch2Rise;
+        ch2_timing.fall = Ch2Fall;
+        ch2_timing.spacing = Ch2Spacing;
+        ch2_timing.delay = Ch2Delay;
+        ch2_timing.min_seg_time = ch2_min_seg_time;
         
-        // Validate that at least one segment has segtrigout=1 (required for seg_arb)
-        int has_trigger = 0;
-        for (i = 0; i < actual_ch2_segments; i++)
+        status = bps_compile(ch2_prog, patternArray, Ch2PatternSize, &ch2_timing, valid_loop_count);
+        if ( status )
         {
-            if (ch2_segtrigout[i] == 1)
+            if(debug) 
             {
-                has_trigger = 1;
-                break;
+                printf("ERROR: CH2 pattern compile failed: %d\n", status);
+                if (status == BPS_ERR_SIZE)
+                    printf("  Pattern needs more than %d segments or %d sequences after compression\n",
+                           BPS_MAX_SEGMENTS, BPS_MAX_SEQUENCES);
+                else if (status == BPS_ERR_PARAM)
+                    printf("  Pattern too short for a seg_arb sequence (3 segments minimum), or\n"
+                           "  Ch2LoopCount (%.6g) is not an integer for a multi-sequence pattern\n", Ch2LoopCount);
             }
-        }
-        if (!has_trigger && actual_ch2_segments > 0)
-        {
-            if(debug) printf("WARNING: No segment has segtrigout=1, setting first segment to trigger\n");
-            ch2_segtrigout[0] = 1;
+            free(ch2_prog);
+            free(patternArray);
+            return status;
         }
         
         if(debug) 
         {
-            printf("Built %d segments for CH2 binary pattern:\n", actual_ch2_segments);
+            printf("Built %d segments in %d sequences for CH2 binary pattern (%d bits):\n",
+                   ch2_prog->num_segments, ch2_prog->num_sequences, Ch2PatternSize);
             printf("  Delay segment: %s\n", (Ch2Delay > ch2_min_seg_time) ? "YES" : "NO");
-            printf("  Has trigger segment: %s\n", has_trigger ? "YES" : "NO");
-            for (i = 0; i < actual_ch2_segments && i < 10; i++) // Print first 10 segments
+            printf("  Sequence list (%d entries):", ch2_prog->num_list);
+            for (i = 0; i < ch2_prog->num_list && i < 10; i++)
+                printf(" %ld x %.6g", ch2_prog->seq_list[i], ch2_prog->loop_list[i]);
+            if (ch2_prog->num_list > 10) printf(" ...");
+            printf("\n");
+            for (i = 0; i < ch2_prog->num_segments && i < 10; i++) // Print first 10 segments
             {
                     printf("  Seg %d: %.6g V -> %.6g V, time=%.6g s, trig=%ld\n", 
-                           i, ch2_startv[i], ch2_stopv[i], ch2_segtime[i], ch2_segtrigout[i]);
+                           i, ch2_prog->startv[i], ch2_prog->stopv[i], ch2_prog->segtime[i], ch2_prog->segtrigout[i]);
             }
-            if (actual_ch2_segments > 10) printf("  ... (showing first 10 segments)\n");
+            if (ch2_prog->num_segments > 10) printf("  ... (showing first 10 segments)\n");
         }
         
         // Ensure RPM in pulse mode for CH2
-        status = rpm_config(pulserId, ch2, KI_RPM_PATHWAY, KI_RPM_PULSE);
+        status = rpm_pathway_set(pulserId, ch2, KI_RPM_PULSE);
         if ( status && debug )
-           printf("rpm_config CH2 returned: %d\n", status);
+           printf("rpm_pathway_set CH2 returned: %d\n", status);
         
         // Set load for CH2 (required before seg_arb)
         status = pulse_load(pulserId, ch2, 1e6);  // High impedance load
         if ( status )
         {
             if(debug) printf("pulse_load CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
@@ -880,6 +916,7 @@ int ACraig11_PMU_Waveform_Binary(
         if ( status )
         {
             if(debug) printf("pulse_ranges CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
@@ -888,6 +925,7 @@ int ACraig11_PMU_Waveform_Binary(
         if ( status )
         {
             if(debug) printf("pulse_burst_count CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
@@ -896,250 +934,78 @@ int ACraig11_PMU_Waveform_Binary(
         if ( status )
         {
             if(debug) printf("pulse_output CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
-        // Configure seg_arb sequence for CH2
+        // Configure one seg_arb sequence per compiled sequence
         // Note: seg_arb_sequence parameters:
         //   pulserId, channel, sequenceNumber, numSegments,
         //   startV[], stopV[], segTime[], trigOut[], ssrCtrl[],
         //   measType[], measStart[], measStop[]
-        if(debug) 
-        {
-            printf("Configuring seg_arb_sequence for CH%d (%d segments)...\n", ch2, actual_ch2_segments);
-            printf("  PMU should be in SARB mode (pulse_mode=%d)\n", pulse_mode);
-            printf("  First segment: %.6g V -> %.6g V, time=%.6g s\n", 
-                   ch2_startv[0], ch2_stopv[0], ch2_segtime[0]);
-        }
-        
-        // CRITICAL: Verify we're in SARB mode (required for seg_arb functions)
-        if(debug) 
-        {
-            printf("========================================\n");
-            printf("CH2 seg_arb Configuration Check:\n");
-            printf("  pulse_mode variable=%d\n", pulse_mode);
-            printf("  PULSE_MODE_SARB constant=%d\n", PULSE_MODE_SARB);
-            printf("  Ch2Enable=%d\n", Ch2Enable);
-            printf("  Mode match: %s\n", (pulse_mode == PULSE_MODE_SARB) ? "YES ✓" : "NO ✗");
-            printf("========================================\n");
-        }
-        
-        if (pulse_mode != PULSE_MODE_SARB)
-        {
-            if(debug) 
-            {
-                printf("ERROR: PMU not in SARB mode!\n");
-                printf("  Current pulse_mode=%d\n", pulse_mode);
-                printf("  Required PULSE_MODE_SARB=%d\n", PULSE_MODE_SARB);
-                printf("  Ch2Enable=%d (should trigger SARB mode)\n", Ch2Enable);
-                printf("  This will cause seg_arb_sequence to fail with -804\n");
-            }
-            return -804;  // Return the same error code that seg_arb would return
-        }
-        
-        // Validate arrays are not NULL before calling seg_arb_sequence
-        if (!ch2_startv || !ch2_stopv || !ch2_segtime || !ch2_segtrigout || 
-            !ch2_ssrctrl || !ch2_meastype || !ch2_measstart || !ch2_measstop)
-        {
-            if(debug) 
-            {
-                printf("ERROR: CH2 segment arrays are NULL!\n");
-                printf("  startv=%p, stopv=%p, segtime=%p\n", ch2_startv, ch2_stopv, ch2_segtime);
-            }
-            if (ch2_startv) free(ch2_startv);
-            if (ch2_stopv) free(ch2_stopv);
-            if (ch2_segtime) free(ch2_segtime);
-            if (ch2_ssrctrl) free(ch2_ssrctrl);
-            if (ch2_segtrigout) free(ch2_segtrigout);
-            if (ch2_meastype) free(ch2_meastype);
-            if (ch2_measstart) free(ch2_measstart);
-            if (ch2_measstop) free(ch2_measstop);
-            return -999;
-        }
-        
-        // Validate segment count
-        if (actual_ch2_segments < 3 || actual_ch2_segments > 2048)
-        {
-            if(debug) printf("ERROR: actual_ch2_segments (%d) is invalid (must be 3-2048)\n", actual_ch2_segments);
-            free(ch2_startv); free(ch2_stopv); free(ch2_segtime);
-            free(ch2_ssrctrl); free(ch2_segtrigout); free(ch2_meastype);
-            free(ch2_measstart); free(ch2_measstop);
-            return -122;
-        }
-        
-        if(debug) 
-        {
-            printf("About to call seg_arb_sequence:\n");
-            printf("  pulserId=%d\n", pulserId);
-            printf("  channel=%d\n", ch2);
-            printf("  sequenceNumber=1\n");
-            printf("  numSegments=%d\n", actual_ch2_segments);
-            printf("  Array pointers valid: %s\n", 
-                   (ch2_startv && ch2_stopv && ch2_segtime) ? "YES" : "NO");
-            printf("  First segment: startV=%.6g, stopV=%.6g, time=%.6g, trigOut=%ld\n",
-                   ch2_startv[0], ch2_stopv[0], ch2_segtime[0], ch2_segtrigout[0]);
-            if (actual_ch2_segments > 1)
-                printf("  Last segment: startV=%.6g, stopV=%.6g, time=%.6g, trigOut=%ld\n",
-                       ch2_startv[actual_ch2_segments-1], ch2_stopv[actual_ch2_segments-1], 
-                       ch2_segtime[actual_ch2_segments-1], ch2_segtrigout[actual_ch2_segments-1]);
-            fflush(stdout);  // Force output before potentially blocking call
-        }
-        
-        status = seg_arb_sequence(pulserId, ch2, 1, actual_ch2_segments,
-                                  ch2_startv, ch2_stopv, ch2_segtime,
-                                  ch2_segtrigout, ch2_ssrctrl,
-                                  ch2_meastype, ch2_measstart, ch2_measstop);
-        
-        if(debug) 
-        {
-            printf("seg_arb_sequence returned: %d\n", status);
-            fflush(stdout);
-        }
-        if ( status )
+        for (i = 0; i < ch2_prog->num_sequences; i++)
         {
+            int first = ch2_prog->seq_first[i];
+            
             if(debug) 
             {
-                printf("ERROR: seg_arb_sequence CH2 failed: %d\n", status);
-                if (status == -804)
-                    printf("  Error -804: seg_arb function not valid in present pulse mode\n");
-                printf("  Current pulse_mode=%d (should be %d for SARB)\n", pulse_mode, PULSE_MODE_SARB);
-                printf("  Check that segment voltages are continuous (startV[i] == stopV[i-1])\n");
-                printf("  Check that first SegTrigOut[0] == 1\n");
+                printf("Configuring seg_arb_sequence for CH%d: sequence %d, %d segments (from %d)\n",
+                       ch2, i + 1, ch2_prog->seq_count[i], first);
+                fflush(stdout);  // Force output before potentially blocking call
             }
-            // Free allocated arrays on error
-            free(ch2_startv);
-            free(ch2_stopv);
-            free(ch2_segtime);
-            free(ch2_ssrctrl);
-            free(ch2_segtrigout);
-            free(ch2_meastype);
-            free(ch2_measstart);
-            free(ch2_measstop);
-            return status;
-        }
-        
-        // Configure seg_arb waveform (sequence 1, with specified loop count)
-        // Loop count determines how many times the seg_arb sequence repeats
-        // Validate Ch2LoopCount before using it
-        // Check for NaN, infinity, or invalid values
-        if (Ch2LoopCount != Ch2LoopCount || Ch2LoopCount < 1.0)  // NaN check: NaN != NaN is true
-        {
-            if(debug) 
+            
+            status = seg_arb_sequence(pulserId, ch2, i + 1, ch2_prog->seq_count[i],
+                                      &ch2_prog->startv[first], &ch2_prog->stopv[first], &ch2_prog->segtime[first],
+                                      &ch2_prog->segtrigout[first], &ch2_prog->ssrctrl[first],
+                                      &ch2_prog->meastype[first], &ch2_prog->measstart[first], &ch2_prog->measstop[first]);
+            if ( status )
             {
-                if (Ch2LoopCount != Ch2LoopCount)
-                    printf("ERROR: Ch2LoopCount is NaN (not a number)\n");
-                else if (Ch2LoopCount < 1.0)
-                    printf("ERROR: Ch2LoopCount (%.6g) must be >= 1.0\n", Ch2LoopCount);
+                if(debug) 
+                {
+                    printf("ERROR: seg_arb_sequence CH2 sequence %d failed: %d\n", i + 1, status);
+                    if (status == -804)
+                        printf("  Error -804: seg_arb function not valid in present pulse mode\n");
+                    printf("  Check that segment voltages are continuous (startV[i] == stopV[i-1])\n");
+                    printf("  Check that first SegTrigOut[0] == 1\n");
+                }
+                free(ch2_prog);
+                return status;
             }
-            // Free allocated arrays on error
-            free(ch2_startv);
-            free(ch2_stopv);
-            free(ch2_segtime);
-            free(ch2_ssrctrl);
-            free(ch2_segtrigout);
-            free(ch2_meastype);
-            free(ch2_measstart);
-            free(ch2_measstop);
-            return -122;
-        }
-        
-        // Check for infinity
-        if (Ch2LoopCount > 1e10)
-        {
-            if(debug) printf("ERROR: Ch2LoopCount (%.6g) is too large (infinity?)\n", Ch2LoopCount);
-            free(ch2_startv);
-            free(ch2_stopv);
-            free(ch2_segtime);
-            free(ch2_ssrctrl);
-            free(ch2_segtrigout);
-            free(ch2_meastype);
-            free(ch2_measstart);
-            free(ch2_measstop);
-            return -122;
-        }
-        
-        // Ensure loop count is valid and at least 1.0
-        double valid_loop_count = Ch2LoopCount;
-        if (valid_loop_count < 1.0) valid_loop_count = 1.0;
-        
-        long seqList[1] = {1};
-        double loopCount[1] = {valid_loop_count};
-        
-        if(debug) 
-        {
-            printf("Configuring seg_arb_waveform for CH%d:\n", ch2);
-            printf("  Original Ch2LoopCount: %.6g\n", Ch2LoopCount);
-            printf("  Using loop count: %.6g\n", valid_loop_count);
         }
         
         // Calculate total CH2 waveform time for reference
-        double ch2_total_time = 0.0;
-        for (i = 0; i < actual_ch2_segments; i++)
-        {
-            ch2_total_time += ch2_segtime[i];
-        }
-        double ch2_total_duration = ch2_total_time * valid_loop_count;
+        double ch2_total_duration = bps_duration(ch2_prog);
+        if (ch2_total_duration > exec_duration) exec_duration = ch2_total_duration;
         
         if(debug) 
         {
             printf("CH2 binary pattern timing:\n");
-            printf("  One cycle time: %.6g s (sum of %d segment times)\n", ch2_total_time, actual_ch2_segments);
-            printf("  Loop count: %.6g (using %.6g)\n", Ch2LoopCount, valid_loop_count);
+            printf("  Loop count: %.6g\n", Ch2LoopCount);
             printf("  Total CH2 duration: %.6g s\n", ch2_total_duration);
-            printf("  CH1 measurement duration: %.6g s (%d pulses @ %.6g s period)\n", 
-                   burstCount * period, burstCount, period);
-        }
-        
-        if(debug) 
-        {
-            printf("Calling seg_arb_waveform:\n");
-            printf("  pulserId=%d, channel=%d, numSequences=1\n", pulserId, ch2);
-            printf("  seqList[0]=%ld\n", seqList[0]);
-            printf("  loopCount[0]=%.6g\n", loopCount[0]);
-            printf("  loopCount[0] is valid: %s\n", (loopCount[0] == loopCount[0] && loopCount[0] >= 1.0 && loopCount[0] <= 1e10) ? "YES" : "NO");
+            printf("  CH1 measurement duration: %.6g s (%d pulses @ %.6g s loop)\n", 
+                   totalPulses * ch1_loop_time, totalPulses, ch1_loop_time);
+            printf("Calling seg_arb_waveform: pulserId=%d, channel=%d, numSequences=%d\n",
+                   pulserId, ch2, ch2_prog->num_list);
             fflush(stdout);  // Force output before potentially blocking call
         }
         
-        status = seg_arb_waveform(pulserId, ch2, 1, seqList, loopCount);
+        // The sequence list carries the pattern loop count (see bps_compile)
+        status = seg_arb_waveform(pulserId, ch2, ch2_prog->num_list, ch2_prog->seq_list, ch2_prog->loop_list);
         if ( status )
         {
-            if(debug) 
-            {
-                printf("ERROR: seg_arb_waveform CH2 failed: %d\n", status);
-                printf("  Parameter 5 (loopCount[0]) = %.6g\n", loopCount[0]);
-                if (loopCount[0] <= 0)
-                    printf("  ERROR: loopCount must be > 0!\n");
-                if (loopCount[0] < 1.0)
-                    printf("  ERROR: loopCount must be >= 1.0!\n");
-            }
-            // Free allocated arrays on error
-            free(ch2_startv);
-            free(ch2_stopv);
-            free(ch2_segtime);
-            free(ch2_ssrctrl);
-            free(ch2_segtrigout);
-            free(ch2_meastype);
-            free(ch2_measstart);
-            free(ch2_measstop);
+            if(debug) printf("ERROR: seg_arb_waveform CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
-        // Free allocated arrays now (seg_arb_sequence has copied data to hardware)
-        free(ch2_startv);
-        free(ch2_stopv);
-        free(ch2_segtime);
-        free(ch2_ssrctrl);
-        free(ch2_segtrigout);
-        free(ch2_meastype);
-        free(ch2_measstart);
-        free(ch2_measstop);
-        if(debug) printf("Freed CH2 segment arrays\n");
-        
         if(debug) 
         {
-            printf("CH2 binary pattern configured: %d segments, loop count=%.6g\n", 
-                   actual_ch2_segments, valid_loop_count);
+            printf("CH2 binary pattern configured: %d segments, %d sequences, loop count=%.6g\n", 
+                   ch2_prog->num_segments, ch2_prog->num_sequences, valid_loop_count);
         }
+        
+        // Free the program now (seg_arb_sequence has copied data to hardware)
+        free(ch2_prog);
     }
 
     // Set test execute mode to Simple or Advanced
@@ -1150,33 +1016,69 @@ int ACraig11_PMU_Waveform_Binary(
 
     if(debug) printf("About to execute: TestMode=%d, CH1 burstCount=%d, CH2 enabled=%d\n", TestMode, burstCount, Ch2Enable);
     
-    // Execute both channels together
-    if(debug) printf("Executing pulses (CH1 simple + CH2 seg_arb)...\n");
-    status = pulse_exec(TestMode);
-    if (status)
-    {
-        if(debug) printf("pulse_exec failed: %d\n", status);
-        return status;
-    }
-
-    // Wait until test is complete
-    i = 0;
-    while ( pulse_exec_status(&t) == 1 && i < 200 )
+    // Calculate expected number of samples based on total measurement time
+    // For seg_arb with loop count, total time = loop length * pulses (all steps)
+    double total_measurement_time = ch1_loop_time * totalPulses;
+    double expectedSamples = floor(total_measurement_time * SampleRate) + 1;
+    if (expectedSamples < 100) expectedSamples = 100;  // Minimum fetch size
+    
+    // With NumAverages > 1 every run is folded into one averaged capture.
+    // From here on every exit goes through RETURN, which frees the buffers.
+    pmu_wave_avg avg;
+    double *timeV = NULL, *timeI = NULL, *timeT = NULL;
+    memset(&avg, 0, sizeof(avg));
+    if (NumAverages > 1)
     {
-        Sleep(100);
-        i++;
+        if (expectedSamples > PMU_AVG_MAX_SAMPLES)
+        {
+            if(debug) printf("ERROR: %.0f samples per run exceeds %d for NumAverages > 1\n", expectedSamples, PMU_AVG_MAX_SAMPLES);
+            status = -831;
+            goto RETURN;
+        }
+        if (pmu_wave_avg_init(&avg, (int)expectedSamples, size_I_Var > 1))
+        {
+            if(debug) printf("Failed to allocate memory for waveform averaging\n");
+            status = -999;
+            goto RETURN;
+        }
     }
     
-    if (i >= 200)
+    int run;
+    for (run = 0; run < NumAverages; run++)
     {
-        if(debug) printf("ERROR: Pulse execution timed out after 20 seconds\n");
-        return -998;
+        // Execute both channels together
+        if(debug) printf("Executing pulses (CH1 simple + CH2 seg_arb), run %d of %d...\n", run + 1, NumAverages);
+        status = pulse_exec(TestMode);
+        if (status)
+        {
+            if(debug) printf("pulse_exec failed: %d\n", status);
+            goto RETURN;
+        }
+
+        // Wait until test is complete: sleep through the programmed duration,
+        // then poll finely (see pmu_exec_wait.h)
+        status = pmu_exec_wait(exec_duration, &t);
+        if (status)
+        {
+            if(debug) printf("ERROR: Pulse execution timed out after %.3f s (programmed %.6g s)\n", t, exec_duration);
+            goto RETURN;
+        }
+        
+        if(debug) printf("Pulse execution complete after %.3f s (programmed %.6g s)\n", t, exec_duration);
+        
+        if (NumAverages > 1)
+        {
+            status = pmu_wave_avg_fetch(&avg, pulserId, chan);
+            if (status)
+            {
+                if(debug) printf("pulse_fetch failed with error: %d (run %d)\n", status, run + 1);
+                goto RETURN;
+            }
+        }
     }
     
-    if(debug) printf("Pulse execution complete after %d waits (%.1f seconds)\n", i, i * 0.1);
-
-    // Small delay to ensure measurement data is ready (working examples sometimes have commented Sleep here)
-    Sleep(50);  // 50ms delay to ensure data is ready
+    if (NumAverages > 1 && debug)
+        printf("Averaged %d runs, %d samples each\n", avg.runs, avg.n);
     
     // Turn off CH2 if it was enabled
     if (Ch2Enable)
@@ -1190,28 +1092,31 @@ int ACraig11_PMU_Waveform_Binary(
     // Fetch waveform and extract averaged values per pulse
     // ============================================================
     
-    // Calculate expected number of samples based on total measurement time
-    // For seg_arb with loop count, total time = period * burstCount
-    double total_measurement_time = period * burstCount;
-    int expectedSamples = (int)(total_measurement_time * SampleRate + 1);
+    // The waveform is streamed from the card in PMU_FETCH_CHUNK blocks and each
+    // block is reduced to per-pulse averages before the next is fetched, so
+    // memory stays constant and long captures are not truncated. An averaged
+    // capture (NumAverages > 1) is already in memory and is fed in one go.
     
-    // Allocate temporary buffers for full waveform
-    // Use expected samples, not pulse_chan_status (which can be unreliable)
-    int maxSamples = expectedSamples;
-    if (maxSamples < 100) maxSamples = 100;  // Minimum buffer size
-    if (maxSamples > 100000) maxSamples = 100000;  // Maximum buffer size
+    // Extract one averaged value per pulse (from 40-80% of pulse width)
+    // Single pass over the samples: threshold and time-based (known period)
+    // detection run side by side, see pmu_pulse_extract.h
+    int outputIdx = 0;
+    double measurementStartFrac = 0.4;
+    double measurementEndFrac = 0.8;
+    double voltageThreshold = fabs(startV) * 0.5;  // Unused for a sweep (time path only)
     
-    waveformV = (double *)calloc(maxSamples, sizeof(double));
-    waveformI = (double *)calloc(maxSamples, sizeof(double));
-    waveformT = (double *)calloc(maxSamples, sizeof(double));
+    int maxOutput = size_V_Meas;
+    if (size_I_Meas < maxOutput) maxOutput = size_I_Meas;
+    if (size_T_Stamp < maxOutput) maxOutput = size_T_Stamp;
     
-    if (waveformV == NULL || waveformI == NULL || waveformT == NULL)
+    timeV = (double *)calloc(maxOutput, sizeof(double));
+    timeI = (double *)calloc(maxOutput, sizeof(double));
+    timeT = (double *)calloc(maxOutput, sizeof(double));
+    if (timeV == NULL || timeI == NULL || timeT == NULL)
     {
-        if(debug) printf("Failed to allocate memory for waveform buffers\n");
-        if (waveformV) free(waveformV);
-        if (waveformI) free(waveformI);
-        if (waveformT) free(waveformT);
-        return -999;
+        if(debug) printf("Failed to allocate memory for pulse extraction\n");
+        status = -999;
+        goto RETURN;
     }
     
     if(debug) 
@@ -1219,137 +1124,99 @@ int ACraig11_PMU_Waveform_Binary(
         printf("Fetching waveform:\n");
         printf("  Total measurement time: %.6g s\n", total_measurement_time);
         printf("  Sample rate: %.6g Hz\n", SampleRate);
-        printf("  Expected samples: %d\n", expectedSamples);
-        printf("  Buffer size: %d\n", maxSamples);
-        printf("  Fetching (StartIndex=0, StopIndex=%d)...\n", maxSamples-1);
+        printf("  Expected samples: %.0f (fetched in blocks of %d)\n", expectedSamples, PMU_FETCH_CHUNK);
     }
     
-    // Fetch waveform data - use maxSamples-1 as StopIndex (pulse_fetch is inclusive)
-    status = pulse_fetch(pulserId, chan, 0, maxSamples-1, waveformV, waveformI, waveformT, NULL);
-    if (status)
+    pmu_pulse_extract extract;
+    pmu_pulse_extract_init(&extract, ch1_loop_time, rise, width, fall,
+                           measurementStartFrac, measurementEndFrac, voltageThreshold, totalPulses,
+                           V_Meas, I_Meas, T_Stamp, timeV, timeI, timeT, maxOutput);
+    
+    // Optional per-pulse feature table, filled during the same pass
+    if (size_Features >= PMU_FEATURE_COLS)
     {
-        if(debug) printf("pulse_fetch failed with error: %d\n", status);
-        free(waveformV);
-        free(waveformI);
-        free(waveformT);
-        return status;
+        int featureRows = size_Features / PMU_FEATURE_COLS;
+        if (featureRows > totalPulses) featureRows = totalPulses;
+        if (pmu_pulse_extract_features(&extract, Features, featureRows))
+        {
+            if(debug) printf("Failed to allocate memory for feature extraction\n");
+            status = -999;
+            goto RETURN;
+        }
+        if(debug) printf("  Feature table: %d rows x %d columns\n", featureRows, PMU_FEATURE_COLS);
     }
     
-    // Find actual number of samples
-    int numWaveformSamples = 0;
-    for (i = 0; i < maxSamples; i++)
+    double numWaveformSamples = 0.0;
+    if (NumAverages > 1)
     {
-        if (waveformT[i] == 0.0 && i > 0) break;
-        numWaveformSamples++;
+        pmu_pulse_extract_feed(&extract, avg.V, avg.I, avg.T, avg.n);
+        pmu_pulse_extract_finish(&extract);
+        numWaveformSamples = avg.n;
+        status = 0;
     }
+    else
+        status = pmu_pulse_extract_fetch(&extract, pulserId, chan, expectedSamples, &numWaveformSamples);
+    if (status)
+    {
+        if(debug) printf("pulse_fetch failed with error: %d (after %.0f samples)\n", status, numWaveformSamples);
+        goto RETURN;
+    }
+    outputIdx = extract.h_out;
     
-    if(debug) printf("Fetched %d waveform samples, extracting averaged values per pulse...\n", numWaveformSamples);
-    
-    // Extract one averaged value per pulse (from 40-80% of pulse width)
-    int outputIdx = 0;
-    double measurementStartFrac = 0.4;
-    double measurementEndFrac = 0.8;
-    double voltageThreshold = fabs(startV) * 0.5;
-    
-    int pulseStartIdx = -1;
-    int pulseEndIdx = -1;
-    int pulseNum = 0;
+    if(debug) printf("Fetched %.0f waveform samples\n", numWaveformSamples);
+    if(debug) printf("Threshold-based detection found %d pulses (expected %d)\n", outputIdx, totalPulses);
     
-    for (i = 0; i < numWaveformSamples && pulseNum < burstCount && outputIdx < size_V_Meas; i++)
+    // If we didn't find enough pulses, use the evenly-spaced (period-based) result
+    // A sweep always uses it: pulse k is step k / burstCount, and steps near
+    // 0 V never cross the threshold
+    int useTimePath = (outputIdx < totalPulses || numSteps > 1);
+    if (useTimePath && numWaveformSamples > 0)
     {
-        // Detect pulse start
-        if (pulseStartIdx < 0 && fabs(waveformV[i]) > voltageThreshold)
-        {
-            pulseStartIdx = i;
-        }
+        if(debug) printf("Only found %d pulses via threshold detection, using evenly-spaced detection (%d pulses, loop %.6g s)\n",
+                         outputIdx, extract.t_out, ch1_loop_time);
         
-        // Detect pulse end
-        if (pulseStartIdx >= 0 && fabs(waveformV[i]) < voltageThreshold)
+        for (i = 0; i < extract.t_out; i++)
         {
-            pulseEndIdx = i;
-            
-            int pulseWidthSamples = pulseEndIdx - pulseStartIdx;
-            int measStartSample = pulseStartIdx + (int)(pulseWidthSamples * measurementStartFrac);
-            int measEndSample = pulseStartIdx + (int)(pulseWidthSamples * measurementEndFrac);
-            
-            if (measEndSample > pulseEndIdx) measEndSample = pulseEndIdx;
-            if (measStartSample < pulseStartIdx) measStartSample = pulseStartIdx;
-            
-            // Average samples in measurement window
-            double sumV = 0.0, sumI = 0.0, sumT = 0.0;
-            int count = 0;
-            
-            for (j = measStartSample; j <= measEndSample && j < numWaveformSamples; j++)
-            {
-                sumV += waveformV[j];
-                sumI += waveformI[j];
-                sumT += waveformT[j];
-                count++;
-            }
-            
-            if (count > 0)
-            {
-                V_Meas[outputIdx] = sumV / count;
-                I_Meas[outputIdx] = sumI / count;
-                T_Stamp[outputIdx] = sumT / count;
-                outputIdx++;
-            }
-            
-            pulseNum++;
-            pulseStartIdx = -1;
-            pulseEndIdx = -1;
+            V_Meas[i] = timeV[i];
+            I_Meas[i] = timeI[i];
+            T_Stamp[i] = timeT[i];
         }
+        outputIdx = extract.t_out;
     }
     
-    if(debug) printf("Threshold-based detection found %d pulses (expected %d)\n", outputIdx, burstCount);
-    
-    // If we didn't find enough pulses, try alternative: assume evenly spaced pulses
-    if (outputIdx < burstCount && numWaveformSamples > 0)
+    // Per-pulse variance of I over the runs, same windows and path as I_Meas
+    if (size_I_Var > 1)
     {
-        if(debug) printf("Only found %d pulses via threshold detection, trying evenly-spaced detection...\n", outputIdx);
-        
-        // Reset output
-        for (i = 0; i < outputIdx; i++)
-        {
-            V_Meas[i] = 0.0;
-            I_Meas[i] = 0.0;
-            T_Stamp[i] = 0.0;
-        }
-        outputIdx = 0;
-        
-        // Use time-based detection assuming pulses are evenly spaced
-        double totalTime = waveformT[numWaveformSamples-1] - waveformT[0];
-        double estimatedPeriod = totalTime / burstCount;
-        
-        if(debug) printf("Estimated period: %.6g s (total time: %.6g s)\n", estimatedPeriod, totalTime);
-        
-        for (int pulseIdx = 0; pulseIdx < burstCount && outputIdx < size_V_Meas; pulseIdx++)
+        int varRows = (size_I_Var < maxOutput) ? size_I_Var : maxOutput;
+        memset(I_Var, 0, size_I_Var * sizeof(double));
+        if (avg.m2I != NULL)
         {
-            double pulseStartTime = waveformT[0] + pulseIdx * estimatedPeriod;
-            double measStartTime = pulseStartTime + delay + rise + width * measurementStartFrac;
-            double measEndTime = pulseStartTime + delay + rise + width * measurementEndFrac;
-            
-            double sumV = 0.0, sumI = 0.0, sumT = 0.0;
-            int count = 0;
-            
-            for (i = 0; i < numWaveformSamples; i++)
+            // Own outputs: threshold I goes straight to I_Var, the rest
+            // (threshold V/T, time-path V/I/T) to one scratch block
+            pmu_pulse_extract vx;
+            double *varScratch = (double *)calloc(5 * (size_t)varRows, sizeof(double));
+            if (varScratch == NULL)
             {
-                if (waveformT[i] >= measStartTime && waveformT[i] <= measEndTime)
-                {
-                    sumV += waveformV[i];
-                    sumI += waveformI[i];
-                    sumT += waveformT[i];
-                    count++;
-                }
+                if(debug) printf("Failed to allocate memory for the I_Var pass\n");
+                status = -999;
+                goto RETURN;
             }
-            
-            if (count > 0)
+            pmu_wave_avg_variance(&avg);
+            pmu_pulse_extract_init(&vx, ch1_loop_time, rise, width, fall,
+                                   measurementStartFrac, measurementEndFrac, voltageThreshold, totalPulses,
+                                   varScratch, I_Var, varScratch + varRows,
+                                   varScratch + 2 * varRows, varScratch + 3 * varRows, varScratch + 4 * varRows,
+                                   varRows);
+            pmu_pulse_extract_feed(&vx, avg.V, avg.m2I, avg.T, avg.n);
+            pmu_pulse_extract_finish(&vx);
+            if (useTimePath)
             {
-                V_Meas[outputIdx] = sumV / count;
-                I_Meas[outputIdx] = sumI / count;
-                T_Stamp[outputIdx] = sumT / count;
-                outputIdx++;
+                for (i = 0; i < vx.t_out; i++)
+                    I_Var[i] = varScratch[3 * varRows + i];
+                for (; i < varRows; i++)
+                    I_Var[i] = 0.0;
             }
+            free(varScratch);
         }
     }
     
@@ -1361,14 +1228,15 @@ int ACraig11_PMU_Waveform_Binary(
         T_Stamp[i] = 0.0;
     }
     
-    free(waveformV);
-    free(waveformI);
-    free(waveformT);
-    
-    // Free patternArray if it was allocated
-    if (patternArray != NULL)
+    // Tag each result with its amplitude step: pulse index from its window
+    // time (time path), step = pulse / burstCount
+    if (size_SweepStep > 1)
     {
-        free(patternArray);
+        for (i = 0; i < size_SweepStep; i++)
+        {
+            int pulse = (i < outputIdx) ? (int)floor((T_Stamp[i] - extract.t_first) / ch1_loop_time) : -1;
+            SweepStep[i] = (pulse >= 0) ? (double)(pulse / burstCount) : -1.0;
+        }
     }
     
     if(debug) 
@@ -1376,8 +1244,21 @@ int ACraig11_PMU_Waveform_Binary(
         printf("Extracted %d averaged measurements (one per pulse from 40-80%% window).\n", outputIdx);
         printf("ACraig11_PMU_Waveform_Binary: complete, returning to KXCI\n");
     }
+    status = 0;
+
+ RETURN:
+    pmu_wave_avg_free(&avg);
+    if (timeV) free(timeV);
+    if (timeI) free(timeI);
+    if (timeT) free(timeT);
+    
+    // Free patternArray if it was allocated
+    if (patternArray != NULL)
+    {
+        free(patternArray);
+    }
 
-    return 0;
+    return status;
 /* USRLIB MODULE END  */
 } 		/* End ACraig10_PMU_Waveform_SegArb.c */
 
@@ -11,6 +11,9 @@ KEY FEATURE:
 - CH2 generates binary pulse trains from a pattern array (e.g., "10110100")
 - Each bit in the pattern becomes one segment in the seg_arb waveform
 - Pattern can be repeated multiple times via loop count
+- The C module merges low runs and turns repeated blocks into looped
+  seg_arb sequences, so patterns of up to 100000 bits can be sent as long
+  as they compress to 2048 segments
 
 MEASUREMENT WINDOW (40-80% of Pulse Width):
 ===========================================
@@ -36,6 +39,32 @@ command-line parameters. To modify it, edit the C source file:
   measurementStartFrac = 0.4  (40% of pulse width)
   measurementEndFrac = 0.8    (80% of pulse width)
 
+PER-PULSE FEATURES (--features):
+================================
+The C module can also reduce every pulse to 5 features in the same pass
+(t_start, I_peak, t_switch, Q = integral of I dt, t_rise 10-90%), returned
+as one row per pulse in the Features array (GP 42). This replaces shipping
+full waveforms to Python for switching-dynamics analysis.
+
+COHERENT AVERAGING (--averages M, --variance):
+==============================================
+For low currents (e.g. the 100 nA range) the module can execute the armed
+test M times and average the M waveforms sample by sample on the
+instrument before extraction, instead of re-running it M times from
+Python. Noise drops by sqrt(M) and only one set of results is transferred.
+--variance also returns I_Var (GP 45): per pulse, the single-run variance
+of the current averaged over the pulse window (A^2). Captures are limited
+to 1e6 samples per run when averaging.
+
+AMPLITUDE SWEEP (--start-v / --stop-v / --step-v, --sweep-steps):
+=================================================================
+With --stop-v different from --start-v the CH1 amplitude steps from start
+towards stop in |step| increments, never past stop (0 -> 5 V by 2 V gives
+0, 2, 4 V), with burst-count pulses at every step, all in one seg_arb
+test. Results hold steps x burst-count pulses in order; --sweep-steps also
+returns SweepStep (GP 47), the step index of each result, and prints the
+mean current and resistance per step. Up to 341 steps.
+
 Usage examples:
 
     # CH1 reads at 1µs, CH2 sends pattern "10110100" (8 bits, 1µs each)
@@ -44,6 +73,9 @@ Usage examples:
     # CH1 reads at 2µs, CH2 sends pattern "1100" repeated 10 times
     python run_acraig11_waveform_binary.py --burst-count 100 --period 2e-6 --ch2-pattern "1100" --ch2-width 500e-9 --ch2-spacing 500e-9 --ch2-loop-count 10
 
+    # CH1 sweeps 0.2 V to 1.0 V in 0.2 V steps, 20 pulses per step
+    python run_acraig11_waveform_binary.py --burst-count 20 --start-v 0.2 --stop-v 1.0 --step-v 0.2 --sweep-steps
+
 Pass `--dry-run` to print the generated EX command without contacting the instrument.
 """
 
@@ -185,6 +217,10 @@ def format_param(value: float | int | str) -> str:
 # format_array_param removed - arrays are expanded directly into params list
 
 
+FEATURE_COLUMNS = 5
+FEATURE_NAMES = ["t_start_s", "I_peak_A", "t_switch_s", "charge_C", "t_rise_s"]
+
+
 def build_ex_command(
     # CH1 parameters
     width: float, rise: float, fall: float, delay: float, period: float,
@@ -197,7 +233,11 @@ def build_ex_command(
     ch2_enable: int, ch2_vrange: float,
     ch2_pattern: List[int], ch2_pattern_size: int,
     ch2_delay: float, ch2_width: float, ch2_rise: float, ch2_fall: float, ch2_spacing: float, ch2_vlow: float, ch2_vhigh: float, ch2_loop_count: float,
-    clarius_debug: int = 1
+    clarius_debug: int = 1,
+    feature_rows: int = 0,
+    num_averages: int = 1,
+    variance_rows: int = 0,
+    sweep_rows: int = 0
 ) -> str:
     """Build EX command for ACraig11_PMU_Waveform_Binary."""
     
@@ -248,14 +288,30 @@ def build_ex_command(
         format_param(ch2_vhigh),                 # 39: Ch2Vhigh
         format_param(ch2_loop_count),           # 40: Ch2LoopCount
         format_param(clarius_debug),            # 41: ClariusDebug
+        "",                                     # 42: Features output array
+        format_param(max(1, feature_rows * FEATURE_COLUMNS)),  # 43: size_Features (1 = off)
+        format_param(num_averages),             # 44: NumAverages
+        "",                                     # 45: I_Var output array
+        format_param(max(1, variance_rows)),    # 46: size_I_Var (1 = off)
+        "",                                     # 47: SweepStep output array
+        format_param(max(1, sweep_rows)),       # 48: size_SweepStep (1 = off)
     ]
     
-    # Total: 41 parameters (arrays passed as single string, no expansion)
-    # 1-21: CH1 (21), 22: PMU_ID (1), 23-28: Output arrays + sizes (6), 29-41: CH2 (13) = 41
+    # Total: 48 parameters (arrays passed as single string, no expansion)
+    # 1-21: CH1 (21), 22: PMU_ID (1), 23-28: Output arrays + sizes (6), 29-41: CH2 (13),
+    # 42-43: Features + size (2), 44-46: NumAverages, I_Var + size (3),
+    # 47-48: SweepStep + size (2) = 48
 
     return f"EX A_Ch1Read_Ch2Binary_out ACraig11_PMU_Waveform_Binary({','.join(params)})"
 
 
+def sweep_step_count(start_v: float, stop_v: float, step_v: float) -> int:
+    """Number of CH1 amplitude steps, rounded the same way as the C module."""
+    if step_v == 0 or stop_v == start_v:
+        return 1
+    return int(abs((stop_v - start_v) / step_v) + 1e-9) + 1
+
+
 def parse_pattern(pattern_str: str) -> List[int]:
     """Parse pattern string into list of integers (0s and 1s).
     
@@ -307,11 +363,14 @@ def run_measurement(args, enable_plot: bool) -> None:
         print(f"[ERROR] Invalid pattern: {e}")
         return
     
+    num_steps = sweep_step_count(args.start_v, args.stop_v, args.step_v)
+    total_pulses = args.burst_count * num_steps
+
     # Auto-calculate array_size if needed
     array_size = args.array_size
     if array_size == 0:
         if args.acq_type == 1:
-            array_size = args.burst_count
+            array_size = args.burst_count * num_steps
         else:
             array_size = min(int(args.period * args.sample_rate * args.burst_count) + 100, 10000)
         print(f"[Auto] array_size set to {array_size}")
@@ -348,7 +407,11 @@ def run_measurement(args, enable_plot: bool) -> None:
         args.ch2_enable, args.ch2_vrange,
         ch2_pattern, ch2_pattern_size,
         args.ch2_delay, args.ch2_width, args.ch2_rise, args.ch2_fall, args.ch2_spacing, args.ch2_vlow, args.ch2_vhigh, ch2_loop_count,
-        debug_enable
+        debug_enable,
+        feature_rows=total_pulses if args.features else 0,
+        num_averages=args.averages,
+        variance_rows=max(2, total_pulses) if args.variance else 0,
+        sweep_rows=max(2, array_size) if args.sweep_steps else 0
     )
     
     print("\n" + "="*80)
@@ -367,6 +430,8 @@ def run_measurement(args, enable_plot: bool) -> None:
         
         print(f"\n[KXCI] CH1: {args.burst_count} pulses @ {args.period*1e6:.2f}µs period")
         print(f"[KXCI] CH1 pulse: width={args.width*1e6:.2f}µs, rise={args.rise*1e6:.2f}µs, fall={args.fall*1e6:.2f}µs")
+        if num_steps > 1:
+            print(f"[KXCI] CH1 sweep: {num_steps} steps from {args.start_v:.3f}V by {abs(args.step_v):.3f}V, {total_pulses} pulses total")
         
         if args.ch2_enable:
             pattern_str = "".join(str(b) for b in ch2_pattern)
@@ -376,6 +441,8 @@ def run_measurement(args, enable_plot: bool) -> None:
             print(f"[KXCI]        Pulse width: {args.ch2_width*1e6:.2f}µs, Rise: {args.ch2_rise*1e6:.2f}µs, Fall: {args.ch2_fall*1e6:.2f}µs, Spacing: {args.ch2_spacing*1e6:.2f}µs")
             print(f"[KXCI]        {args.ch2_vlow:.1f}V (0) / {args.ch2_vhigh:.1f}V (1)")
             print(f"[KXCI]        Loop count: {ch2_loop_count:.1f}")
+        if args.averages > 1:
+            print(f"[KXCI] Averaging {args.averages} runs on the instrument")
         
         return_value, error_msg = controller.execute_ex(command)
         
@@ -401,6 +468,17 @@ def run_measurement(args, enable_plot: bool) -> None:
         
         print(f"[KXCI] Received: {len(voltage)} voltage, {len(current)} current, {len(time_axis)} time samples")
 
+        if args.features:
+            print_features(controller.safe_query(42, total_pulses * FEATURE_COLUMNS, "features"))
+
+        if args.variance:
+            i_var = controller.safe_query(45, total_pulses, "current variance")
+            print_variance(current, i_var, args.averages)
+
+        if args.sweep_steps:
+            steps = controller.safe_query(47, num_points, "sweep steps")
+            print_sweep_steps(voltage, current, steps)
+
         usable = min(len(voltage), len(current), len(time_axis))
         voltage = voltage[:usable]
         current = current[:usable]
@@ -516,6 +594,47 @@ def run_measurement(args, enable_plot: bool) -> None:
         controller.disconnect()
 
 
+def print_features(values: List[float]) -> None:
+    """Print the per-pulse feature table (one row of FEATURE_COLUMNS per pulse)."""
+    rows = [values[k:k + FEATURE_COLUMNS] for k in range(0, len(values) - FEATURE_COLUMNS + 1, FEATURE_COLUMNS)]
+    print(f"\n[KXCI] Per-pulse features: {len(rows)} rows")
+    print("  pulse  " + "  ".join(f"{name:>12}" for name in FEATURE_NAMES))
+    for k, row in enumerate(rows[:20]):
+        print(f"  {k:5d}  " + "  ".join(f"{value:12.4e}" for value in row))
+    if len(rows) > 20:
+        print(f"  ... ({len(rows) - 20} more rows)")
+
+
+def print_variance(current: List[float], i_var: List[float], averages: int) -> None:
+    """Print per-pulse mean current with its standard error over the averaged runs."""
+    print(f"\n[KXCI] Per-pulse current over {averages} runs: {len(i_var)} pulses")
+    print(f"  {'pulse':>5} {'I (A)':>13} {'sigma_run (A)':>14} {'sigma_mean (A)':>15}")
+    for k, var in enumerate(i_var[:min(len(i_var), len(current), 20)]):
+        sigma = max(var, 0.0) ** 0.5
+        print(f"  {k:5d} {current[k]:13.5e} {sigma:14.5e} {sigma / max(averages, 1) ** 0.5:15.5e}")
+    if len(i_var) > 20:
+        print(f"  ... ({len(i_var) - 20} more)")
+
+
+def print_sweep_steps(voltage: List[float], current: List[float], steps: List[float]) -> None:
+    """Print mean voltage, current and resistance for each amplitude step."""
+    sums: dict[int, List[float]] = {}
+    for v, i, step in zip(voltage, current, steps):
+        if step < 0:
+            continue
+        acc = sums.setdefault(int(step), [0.0, 0.0, 0])
+        acc[0] += v
+        acc[1] += i
+        acc[2] += 1
+    print(f"\n[KXCI] Per-step means: {len(sums)} steps")
+    print(f"  {'step':>5} {'n':>6} {'V (V)':>11} {'I (A)':>13} {'R (Ohm)':>13}")
+    for step in sorted(sums):
+        v_sum, i_sum, n = sums[step]
+        v_mean, i_mean = v_sum / n, i_sum / n
+        r = v_mean / i_mean if abs(i_mean) > 1e-15 else float("inf")
+        print(f"  {step:5d} {n:6d} {v_mean:11.4f} {i_mean:13.5e} {r:13.5e}")
+
+
 def parse_arguments() -> argparse.Namespace:
     """Parse command-line arguments."""
     parser = argparse.ArgumentParser(
@@ -528,6 +647,9 @@ Examples:
 
   # CH1 reads at 2µs, CH2 sends pattern "1100" repeated 10 times
   python run_acraig11_waveform_binary.py --burst-count 100 --period 2e-6 --ch2-pattern "1100" --ch2-width 500e-9 --ch2-spacing 500e-9 --ch2-loop-count 10
+
+  # CH1 sweeps 0.2 V to 1.0 V in 0.2 V steps, 20 pulses per step
+  python run_acraig11_waveform_binary.py --burst-count 20 --start-v 0.2 --stop-v 1.0 --step-v 0.2 --sweep-steps
         """
     )
 
@@ -567,6 +689,14 @@ Examples:
     parser.add_argument("--chan", type=int, default=1, choices=[1, 2], help="PMU channel for DUT measurement")
     parser.add_argument("--pmu-id", type=str, default="PMU1", help="PMU instrument ID")
     parser.add_argument("--array-size", type=int, default=0, help="Output array size (0=auto)")
+    parser.add_argument("--features", action="store_true",
+                       help="Also return per-pulse features (t_start, I_peak, t_switch, Q, t_rise)")
+    parser.add_argument("--averages", type=int, default=1,
+                       help="Runs averaged sample by sample on the instrument (1-10000, default 1)")
+    parser.add_argument("--variance", action="store_true",
+                       help="Also return the per-pulse current variance over the averaged runs")
+    parser.add_argument("--sweep-steps", action="store_true",
+                       help="Also return the amplitude step of each result and print per-step means")
 
     # CH2 binary pattern parameters
     parser.add_argument("--ch2-enable", type=int, default=1, choices=[0, 1], 
@@ -609,9 +739,11 @@ def main() -> None:
             print(f"[ERROR] Invalid pattern: {e}")
             return
         
+        num_steps = sweep_step_count(args.start_v, args.stop_v, args.step_v)
+        total_pulses = args.burst_count * num_steps
         array_size = args.array_size
         if array_size == 0:
-            array_size = args.burst_count if args.acq_type == 1 else 10000
+            array_size = total_pulses if args.acq_type == 1 else 10000
         
         ch2_loop_count = max(1.0, float(args.ch2_loop_count))
         debug_enable = 1
@@ -625,8 +757,12 @@ def main() -> None:
             args.chan, args.pmu_id, array_size,
             args.ch2_enable, args.ch2_vrange,
             ch2_pattern, ch2_pattern_size,
-            args.ch2_width, args.ch2_spacing, args.ch2_vlow, args.ch2_vhigh, ch2_loop_count,
-            debug_enable
+            args.ch2_delay, args.ch2_width, args.ch2_rise, args.ch2_fall, args.ch2_spacing, args.ch2_vlow, args.ch2_vhigh, ch2_loop_count,
+            debug_enable,
+            feature_rows=total_pulses if args.features else 0,
+            num_averages=args.averages,
+            variance_rows=max(2, total_pulses) if args.variance else 0,
+            sweep_rows=max(2, array_size) if args.sweep_steps else 0
         )
         
         print("\n" + "="*80)
@@ -0,0 +1,459 @@
+/* Binary pattern compiler for the ACraig11 CH2 seg_arb waveform.
+ * Include from USRLIB modules only (ACraig11_PMU_Waveform_Binary.c).
+ *
+ * Every bit of the pattern starts and ends at Vlow:
+ *
+ *   '1' -> rise to Vhigh, flat Vhigh (width), fall to Vlow, flat Vlow (spacing)
+ *   '0' -> flat Vlow (spacing)
+ *
+ * so the pattern is compiled without unrolling it segment by segment:
+ *
+ *   run-length  a '1' and the zeros after it share one flat low segment
+ *               ("1000" is 4 segments, not 7); leading zeros are one segment
+ *   repeats     a block of tokens that repeats back to back ("1100" x 500)
+ *               becomes its own seg_arb sequence played with a loop count,
+ *               and identical blocks share one sequence
+ *
+ * The waveform played is exactly the unrolled one: the same levels and
+ * segment boundaries, with runs of flat segments merged. Stretches between
+ * repeats go to literal sequences. Each cycle starts at 0 V (optional delay
+ * segment) and ends back at 0 V, and the whole program repeats loop_count
+ * times as before. */
+
+#ifndef BINARY_PATTERN_SEQ_H
+#define BINARY_PATTERN_SEQ_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BPS_MAX_SEGMENTS 2048     /* seg_arb segments per channel, all sequences */
+#define BPS_MAX_SEQUENCES 512     /* sequences and sequence-list entries */
+#define BPS_MIN_SEQ_SEGMENTS 3    /* seg_arb_sequence minimum */
+#define BPS_MAX_SEG_TIME 40.0     /* longest seg_arb segment (s) */
+#define BPS_MAX_UNIT 256          /* longest repeated block searched (tokens) */
+#define BPS_MIN_SAVING 8          /* segments a repeat must save to get a sequence */
+#define BPS_LEVEL_EPS 1e-6
+
+/* Return codes */
+#define BPS_OK 0
+#define BPS_ERR_PARAM -122        /* pattern too short, or fractional loop count */
+#define BPS_ERR_MEMORY -999
+#define BPS_ERR_SIZE -831         /* too many segments or sequences */
+
+typedef struct
+{
+  double vlow, vhigh;
+  double width, rise, fall, spacing;
+  double delay;
+  double min_seg_time;
+} bps_timing;
+
+typedef struct
+{
+  /* segment table; sequence s is segments seq_first[s] .. + seq_count[s] - 1 */
+  double startv[BPS_MAX_SEGMENTS];
+  double stopv[BPS_MAX_SEGMENTS];
+  double segtime[BPS_MAX_SEGMENTS];
+  long ssrctrl[BPS_MAX_SEGMENTS];
+  long segtrigout[BPS_MAX_SEGMENTS];
+  long meastype[BPS_MAX_SEGMENTS];
+  double measstart[BPS_MAX_SEGMENTS];
+  double measstop[BPS_MAX_SEGMENTS];
+  int num_segments;
+
+  int seq_first[BPS_MAX_SEQUENCES];
+  int seq_count[BPS_MAX_SEQUENCES];
+  int seq_unit_start[BPS_MAX_SEQUENCES];  /* token block of a repeat sequence, */
+  int seq_unit_len[BPS_MAX_SEQUENCES];    /* unit_len 0 for literal sequences */
+  int num_sequences;
+
+  /* seg_arb_waveform list: 1-based sequence numbers and loop counts */
+  long seq_list[BPS_MAX_SEQUENCES];
+  double loop_list[BPS_MAX_SEQUENCES];
+  int num_list;
+
+  int error;
+} bps_program;
+
+/* Tokens: k >= 0 is a '1' followed by k zeros, -n is a run of n leading zeros.
+ * Returns the number of tokens written to tokens[] (at most nbits). */
+static inline int bps_tokenize(const long *bits, int nbits, int *tokens)
+{
+  int i = 0, n = 0, run;
+
+  if (nbits > 0 && bits[0] == 0)
+  {
+    for (run = 0; i < nbits && bits[i] == 0; i++)
+      run++;
+    tokens[n++] = -run;
+  }
+  while (i < nbits)
+  {
+    i++;  /* the '1' */
+    for (run = 0; i < nbits && bits[i] == 0; i++)
+      run++;
+    tokens[n++] = run;
+  }
+  return n;
+}
+
+/* Append one segment; flats longer than BPS_MAX_SEG_TIME are split */
+static inline void bps_segment(bps_program *p, double v0, double v1, double time)
+{
+  int s;
+  double t;
+
+  while (time > 0.0 && p->error == BPS_OK)
+  {
+    if (p->num_segments >= BPS_MAX_SEGMENTS)
+    {
+      p->error = BPS_ERR_SIZE;
+      return;
+    }
+    t = time;
+    if (t > BPS_MAX_SEG_TIME && fabs(v1 - v0) < BPS_LEVEL_EPS)
+      t = (time - BPS_MAX_SEG_TIME < 1e-6) ? time / 2.0 : BPS_MAX_SEG_TIME;
+    s = p->num_segments++;
+    p->startv[s] = v0;
+    p->stopv[s] = v1;
+    p->segtime[s] = t;
+    p->ssrctrl[s] = 1;
+    p->segtrigout[s] = (s == 0) ? 1 : 0;  /* first segment triggers */
+    p->meastype[s] = 0;
+    p->measstart[s] = 0.0;
+    p->measstop[s] = 0.0;
+    time -= t;
+  }
+}
+
+/* Segments of one token starting from level v0 (0 V for the first token) */
+static inline void bps_token(bps_program *p, int token, double v0, const bps_timing *tm)
+{
+  if (token < 0)
+  {
+    if (fabs(v0 - tm->vlow) > BPS_LEVEL_EPS)
+      bps_segment(p, v0, tm->vlow, tm->fall);
+    bps_segment(p, tm->vlow, tm->vlow, tm->spacing * (double)(-token));
+    return;
+  }
+  if (fabs(v0 - tm->vhigh) > BPS_LEVEL_EPS)
+    bps_segment(p, v0, tm->vhigh, tm->rise);
+  bps_segment(p, tm->vhigh, tm->vhigh, tm->width);
+  bps_segment(p, tm->vhigh, tm->vlow, tm->fall);
+  bps_segment(p, tm->vlow, tm->vlow, tm->spacing * (double)(token + 1));
+}
+
+/* Segments a token adds when it starts at Vlow */
+static inline int bps_token_segments(int token, const bps_timing *tm)
+{
+  if (token < 0)
+    return 1;
+  return (fabs(tm->vlow - tm->vhigh) > BPS_LEVEL_EPS) ? 4 : 3;
+}
+
+/* Open a new sequence at the end of the segment table */
+static inline int bps_open(bps_program *p, int unit_start, int unit_len)
+{
+  int s;
+
+  if (p->num_sequences >= BPS_MAX_SEQUENCES)
+  {
+    p->error = BPS_ERR_SIZE;
+    return -1;
+  }
+  s = p->num_sequences++;
+  p->seq_first[s] = p->num_segments;
+  p->seq_count[s] = 0;
+  p->seq_unit_start[s] = unit_start;
+  p->seq_unit_len[s] = unit_len;
+  return s;
+}
+
+static inline void bps_close(bps_program *p, int s)
+{
+  p->seq_count[s] = p->num_segments - p->seq_first[s];
+}
+
+static inline void bps_list(bps_program *p, int s, double loops)
+{
+  if (p->num_list >= BPS_MAX_SEQUENCES)
+  {
+    p->error = BPS_ERR_SIZE;
+    return;
+  }
+  p->seq_list[p->num_list] = s + 1;
+  p->loop_list[p->num_list] = loops;
+  p->num_list++;
+}
+
+/* Split the longest flat segment of the last sequence (starting at first) in
+ * two, so a short sequence reaches the seg_arb minimum without changing the
+ * waveform. Returns 0 when no flat is long enough. */
+static inline int bps_split_flat(bps_program *p, int first, double min_seg_time)
+{
+  int k, best = -1;
+
+  for (k = first; k < p->num_segments; k++)
+  {
+    if (fabs(p->stopv[k] - p->startv[k]) < BPS_LEVEL_EPS && p->segtime[k] >= 2.0 * min_seg_time &&
+        (best < 0 || p->segtime[k] > p->segtime[best]))
+      best = k;
+  }
+  if (best < 0 || p->num_segments >= BPS_MAX_SEGMENTS)
+    return 0;
+
+  for (k = p->num_segments; k > best; k--)
+  {
+    p->startv[k] = p->startv[k - 1];
+    p->stopv[k] = p->stopv[k - 1];
+    p->segtime[k] = p->segtime[k - 1];
+    p->ssrctrl[k] = p->ssrctrl[k - 1];
+    p->segtrigout[k] = p->segtrigout[k - 1];
+    p->meastype[k] = p->meastype[k - 1];
+    p->measstart[k] = p->measstart[k - 1];
+    p->measstop[k] = p->measstop[k - 1];
+  }
+  p->segtime[best] /= 2.0;
+  p->segtime[best + 1] = p->segtime[best];
+  p->segtrigout[best + 1] = 0;
+  p->num_segments++;
+  return 1;
+}
+
+/* Longest back-to-back repeat of a block starting at token i; returns the
+ * best repeat count (1 = none) and its block length in *unit */
+static inline int bps_find_repeat(const int *tokens, int ntok, int i, const bps_timing *tm, int *unit)
+{
+  int L, c, r, segs, saving, best_saving = 0, best_r = 1, k;
+
+  *unit = 0;
+  for (L = 1; L <= BPS_MAX_UNIT && i + 2 * L <= ntok; L++)
+  {
+    for (c = 0; i + L + c < ntok && tokens[i + c] == tokens[i + L + c]; c++)
+      ;
+    r = 1 + c / L;
+    if (r < 2)
+      continue;
+    for (segs = 0, k = 0; k < L; k++)
+      segs += bps_token_segments(tokens[i + k], tm);
+    saving = (r - 1) * segs;
+    if (saving > best_saving)
+    {
+      best_saving = saving;
+      best_r = r;
+      *unit = L;
+    }
+  }
+  if (best_saving < BPS_MIN_SAVING)
+    return 1;
+  return best_r;
+}
+
+/* Sequence already holding this token block, or -1 */
+static inline int bps_find_sequence(const bps_program *p, const int *tokens, int start, int len)
+{
+  int s;
+
+  for (s = 0; s < p->num_sequences; s++)
+  {
+    if (p->seq_unit_len[s] == len &&
+        memcmp(tokens + p->seq_unit_start[s], tokens + start, len * sizeof(int)) == 0)
+      return s;
+  }
+  return -1;
+}
+
+/* Compile nbits pattern bits into p (which the caller allocates, it is large).
+ * loop_count repeats the whole program; when the program needs more than one
+ * sequence-list entry it is repeated by copying the list, so loop_count must
+ * then be an integer. Returns BPS_OK or an error code. */
+static inline int bps_compile(bps_program *p, const long *bits, int nbits, const bps_timing *tm,
+                              double loop_count)
+{
+  int *tokens;
+  int ntok, i, k, r, unit, open, rep, tail, n, copy, lit;
+  double level = 0.0, reps;
+
+  memset(p, 0, sizeof(*p));
+  if (nbits < 1)
+    return BPS_ERR_PARAM;
+  tokens = (int *)calloc(nbits, sizeof(int));
+  if (tokens == NULL)
+    return BPS_ERR_MEMORY;
+  ntok = bps_tokenize(bits, nbits, tokens);
+
+  /* literal sequence holding the delay and the first token(s) */
+  open = bps_open(p, 0, 0);
+  if (tm->delay > tm->min_seg_time)
+    bps_segment(p, 0.0, 0.0, tm->delay);
+
+  /* The first token starts at 0 V; if Vlow is not 0 V it differs from the
+   * same token later in the pattern, so it never joins a repeat */
+  i = 0;
+  if (fabs(tm->vlow) > BPS_LEVEL_EPS)
+  {
+    bps_token(p, tokens[0], level, tm);
+    level = tm->vlow;
+    i = 1;
+  }
+
+  while (i < ntok && p->error == BPS_OK)
+  {
+    r = bps_find_repeat(tokens, ntok, i, tm, &unit);
+    if (r < 2)
+    {
+      bps_token(p, tokens[i], level, tm);
+      level = tm->vlow;
+      i++;
+      continue;
+    }
+
+    /* a literal sequence too short for seg_arb takes one pass of the repeat */
+    lit = p->num_segments - p->seq_first[open];
+    if (lit > 0 && lit < BPS_MIN_SEQ_SEGMENTS)
+    {
+      for (k = 0; k < unit; k++)
+        bps_token(p, tokens[i + k], level, tm);
+      level = tm->vlow;
+      i += unit;
+      r--;
+      if (r < 2)
+        continue;
+    }
+
+    if (p->num_segments > p->seq_first[open])
+    {
+      bps_close(p, open);
+      bps_list(p, open, 1.0);
+    }
+    else
+    {
+      p->num_sequences--;  /* empty, reuse the slot */
+    }
+
+    rep = bps_find_sequence(p, tokens, i, unit);
+    if (rep < 0)
+    {
+      rep = bps_open(p, i, unit);
+      if (rep < 0)
+        break;
+      for (k = 0; k < unit; k++)
+        bps_token(p, tokens[i + k], tm->vlow, tm);
+      bps_close(p, rep);
+    }
+    bps_list(p, rep, (double)r);
+    i += unit * r;
+    level = tm->vlow;
+
+    open = bps_open(p, 0, 0);
+    if (open < 0)
+      break;
+  }
+
+  /* return to 0 V */
+  if (p->error == BPS_OK && fabs(level) > BPS_LEVEL_EPS)
+    bps_segment(p, level, 0.0, tm->min_seg_time);
+
+  /* A short tail is played with one pass of the repeat before it */
+  tail = p->num_segments - p->seq_first[open];
+  if (p->error == BPS_OK && tail > 0 && tail < BPS_MIN_SEQ_SEGMENTS && p->num_list > 0)
+  {
+    rep = p->seq_list[p->num_list - 1] - 1;
+    n = p->seq_count[rep];
+    if (p->num_segments + n > BPS_MAX_SEGMENTS)
+    {
+      p->error = BPS_ERR_SIZE;
+    }
+    else
+    {
+      /* shift the tail up and copy the repeat block in front of it */
+      for (k = tail - 1; k >= 0; k--)
+      {
+        copy = p->seq_first[open] + k;
+        p->startv[copy + n] = p->startv[copy];
+        p->stopv[copy + n] = p->stopv[copy];
+        p->segtime[copy + n] = p->segtime[copy];
+      }
+      for (k = 0; k < n; k++)
+      {
+        copy = p->seq_first[open] + k;
+        p->startv[copy] = p->startv[p->seq_first[rep] + k];
+        p->stopv[copy] = p->stopv[p->seq_first[rep] + k];
+        p->segtime[copy] = p->segtime[p->seq_first[rep] + k];
+      }
+      for (k = 0; k < n + tail; k++)
+      {
+        copy = p->seq_first[open] + k;
+        p->ssrctrl[copy] = 1;
+        p->segtrigout[copy] = 0;
+        p->meastype[copy] = 0;
+        p->measstart[copy] = 0.0;
+        p->measstop[copy] = 0.0;
+      }
+      p->num_segments += n;
+      p->loop_list[p->num_list - 1] -= 1.0;
+      tail += n;
+    }
+  }
+  while (p->error == BPS_OK && tail > 0 && tail < BPS_MIN_SEQ_SEGMENTS &&
+         bps_split_flat(p, p->seq_first[open], tm->min_seg_time))
+    tail++;
+  if (p->error == BPS_OK && tail > 0)
+  {
+    if (tail < BPS_MIN_SEQ_SEGMENTS)
+      p->error = BPS_ERR_PARAM;
+    bps_close(p, open);
+    bps_list(p, open, 1.0);
+  }
+  else if (tail == 0)
+  {
+    p->num_sequences--;
+  }
+  free(tokens);
+  if (p->error != BPS_OK)
+    return p->error;
+
+  /* whole-program loop count */
+  if (loop_count > 1.0)
+  {
+    if (p->num_list == 1)
+    {
+      p->loop_list[0] *= loop_count;
+    }
+    else
+    {
+      reps = floor(loop_count + 0.5);
+      if (fabs(loop_count - reps) > 1e-9)
+        return BPS_ERR_PARAM;
+      n = p->num_list;
+      if ((double)n * reps > BPS_MAX_SEQUENCES)
+        return BPS_ERR_SIZE;
+      for (k = 1; k < (int)reps; k++)
+      {
+        memcpy(p->seq_list + k * n, p->seq_list, n * sizeof(long));
+        memcpy(p->loop_list + k * n, p->loop_list, n * sizeof(double));
+      }
+      p->num_list = n * (int)reps;
+    }
+  }
+  return BPS_OK;
+}
+
+/* Duration of one full playback of the program (s) */
+static inline double bps_duration(const bps_program *p)
+{
+  int e, k;
+  double seq_time, total = 0.0;
+
+  for (e = 0; e < p->num_list; e++)
+  {
+    seq_time = 0.0;
+    for (k = 0; k < p->seq_count[p->seq_list[e] - 1]; k++)
+      seq_time += p->segtime[p->seq_first[p->seq_list[e] - 1] + k];
+    total += seq_time * p->loop_list[e];
+  }
+  return total;
+}
+
+#endif /* BINARY_PATTERN_SEQ_H */
@@ -2,7 +2,7 @@
 
 	MODULE NAME: ACraig10_PMU_Waveform_SegArb
 	MODULE RETURN TYPE: int 
-	NUMBER OF PARMS: 55
+	NUMBER OF PARMS: 60
 	ARGUMENTS:
 		width,	double,	Input,	500e-9,	40e-9,	.999999
 		rise,	double,	Input,	100e-9,	20e-9,	.033
@@ -59,8 +59,16 @@
 		Ch2MeasStop_size,	int,	Input,	10,	3,	2048
 		Ch2LoopCount,	double,	Input,	1.0,	1.0,	100000.0
 		ClariusDebug,	int,	Input,	0,	0,	1
+		Features,	D_ARRAY_T,	Output,	,	,	
+		size_Features,	int,	Input,	1,	1,	500000
+		NumAverages,	int,	Input,	1,	1,	10000
+		I_Var,	D_ARRAY_T,	Output,	,	,	
+		size_I_Var,	int,	Input,	1,	1,	32767
 	INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
+#include "pmu_pulse_extract.h"
+#include "pmu_exec_wait.h"
 	END USRLIB MODULE INFORMATION
 */
 /* USRLIB MODULE HELP DESCRIPTION
@@ -102,14 +110,39 @@ MODE 2: Manual Segments (Advanced)
 - Ch2MeasStart[]: Array of measurement start times within each segment
 - Ch2MeasStop[]: Array of measurement stop times within each segment
 
+PER-PULSE FEATURES (Features / size_Features):
+- With size_Features >= 5 the extraction pass also fills one row of 5 values
+  per pulse: t_start, I_peak, t_switch (from flat-top start), Q = integral
+  of I dt, t_rise (10-90% of |I|); row k = Features[5*k .. 5*k+4]
+- Currents are baseline-compensated like I_Meas
+- Rows = min(burstCount, size_Features / 5); size_Features = 1 disables it
+
+COHERENT AVERAGING (NumAverages / I_Var):
+- NumAverages = M > 1 executes the armed test M times and averages the M
+  waveforms sample by sample (same trigger, so sample i lines up in every
+  run) before baseline compensation and extraction: sqrt(M) less noise on
+  the 100 nA range with no extra data sent back
+- With size_I_Var > 1, I_Var[k] is the variance of a single run's current
+  (A^2) averaged over pulse k's window; divide by M for the variance of the
+  averaged samples. Needs NumAverages > 1, else zeros
+
+COMPLETION WAIT (pmu_exec_wait.h):
+- The module sleeps through ~90% of the programmed run time (the longer of
+  CH1 loop length * burstCount and the CH2 sequence duration), then polls
+  pulse_exec_status() at 1-20 ms; short captures return in milliseconds
+- Timeout (-998) is 2 x the programmed run time + 2 s, not a fixed 20 s
+
 NOTE: CH2 should be enabled (Ch2Enable=1) even if not using it - disabling CH2 may cause pulse_exec to fail.
 
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
+#include "pmu_pulse_extract.h"
+#include "pmu_exec_wait.h"
 
 /* USRLIB MODULE MAIN FUNCTION */
-int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double delay, double period, double voltsSourceRng, double currentMeasureRng, double DUTRes, double startV, double stopV, double stepV, double baseV, int acqType, int LLEComp, double preDataPct, double postDataPct, int pulseAvgCnt, int burstCount, double SampleRate, int PMUMode, int chan, char *PMU_ID, double *V_Meas, int size_V_Meas, double *I_Meas, int size_I_Meas, double *T_Stamp, int size_T_Stamp, int Ch2Enable, double Ch2VRange, double Ch2Vlow, double Ch2Vhigh, double Ch2Width, double Ch2Rise, double Ch2Fall, double Ch2Period, int Ch2NumSegments, double *Ch2StartV, int Ch2StartV_size, double *Ch2StopV, int Ch2StopV_size, double *Ch2SegTime, int Ch2SegTime_size, int *Ch2SSRCtrl, int Ch2SSRCtrl_size, int *Ch2SegTrigOut, int Ch2SegTrigOut_size, int *Ch2MeasType, int Ch2MeasType_size, double *Ch2MeasStart, int Ch2MeasStart_size, double *Ch2MeasStop, int Ch2MeasStop_size, double Ch2LoopCount, int ClariusDebug )
+int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double delay, double period, double voltsSourceRng, double currentMeasureRng, double DUTRes, double startV, double stopV, double stepV, double baseV, int acqType, int LLEComp, double preDataPct, double postDataPct, int pulseAvgCnt, int burstCount, double SampleRate, int PMUMode, int chan, char *PMU_ID, double *V_Meas, int size_V_Meas, double *I_Meas, int size_I_Meas, double *T_Stamp, int size_T_Stamp, int Ch2Enable, double Ch2VRange, double Ch2Vlow, double Ch2Vhigh, double Ch2Width, double Ch2Rise, double Ch2Fall, double Ch2Period, int Ch2NumSegments, double *Ch2StartV, int Ch2StartV_size, double *Ch2StopV, int Ch2StopV_size, double *Ch2SegTime, int Ch2SegTime_size, int *Ch2SSRCtrl, int Ch2SSRCtrl_size, int *Ch2SegTrigOut, int Ch2SegTrigOut_size, int *Ch2MeasType, int Ch2MeasType_size, double *Ch2MeasStart, int Ch2MeasStart_size, double *Ch2MeasStop, int Ch2MeasStop_size, double Ch2LoopCount, int ClariusDebug, double *Features, int size_Features, int NumAverages, double *I_Var, int size_I_Var )
 {
 /* USRLIB MODULE CODE */
     int debug = 0;
@@ -121,7 +154,7 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
     double dSweeps;
     double pointsPerWfm;
     double DIFF = 1.0e-9;
-    int i, j;
+    int i;
     
     double *waveformV = NULL;
     double *waveformI = NULL;
@@ -135,6 +168,12 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
         if(debug) printf("Instrument %s is not in system configuration\n", PMU_ID);
         return -17001;
     }
+    
+    if (NumAverages < 1 || NumAverages > 10000)
+    {
+        if(debug) printf("ERROR: NumAverages (%d) must be between 1 and 10000\n", NumAverages);
+        return -122;
+    }
 
     getinstid(PMU_ID, &pulserId);
     if ( -1 == pulserId )
@@ -180,9 +219,9 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
     if(debug) printf("Number of sweep points: %g\n", dSweeps);
 
     // Ensure that 4225-RPMs (if attached) are in pulse mode for CH1
-    status = rpm_config(pulserId, chan, KI_RPM_PATHWAY, KI_RPM_PULSE);
+    status = rpm_pathway_set(pulserId, chan, KI_RPM_PULSE);
     if ( status && debug )
-       printf("rpm_config CH1 returned: %d\n", status);
+       printf("rpm_pathway_set CH1 returned: %d\n", status);
 
     // Put card into pulse mode
     // NOTE: Both CH1 and CH2 now use seg_arb, so we MUST use PULSE_MODE_SARB
@@ -442,7 +481,13 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
     
     // Segment 4: Post-delay (at baseV)
     // Ensure post_delay is at least minimum segment time (or 0 if period exactly matches pulse time)
+    // Segment 5 (and segment 0 when delay is 0) adds min_seg_time the period
+    // does not include; take it out of the post-delay where it fits, so one
+    // loop of the sequence is exactly one period
     double seg4_time = (ch1_post_delay > 0) ? ch1_post_delay : min_seg_time;
+    double seq_extra = (seg0_time - delay) + min_seg_time;
+    if (seg4_time - seq_extra >= min_seg_time)
+        seg4_time -= seq_extra;
     ch1_startv[idx] = baseV; ch1_stopv[idx] = baseV; ch1_segtime[idx] = seg4_time;
     ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;  // Relays closed
     ch1_meastype[idx] = PULSE_MEAS_NONE; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;
@@ -453,6 +498,13 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
     ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;  // Relays closed
     ch1_meastype[idx] = PULSE_MEAS_NONE; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;
     
+    // Actual length of one loop: pulse k starts k * ch1_loop_time after the
+    // first one. Near the minimum period the padding does not fit and the
+    // loop is longer than period, so timing below uses this, never period.
+    double ch1_loop_time = seg0_time + rise + width + fall + seg4_time + min_seg_time;
+    if(debug && fabs(ch1_loop_time - period) > 1e-12)
+        printf("NOTE: CH1 loop is %.6g s, %.6g s longer than period\n", ch1_loop_time, ch1_loop_time - period);
+    
     if(debug) 
     {
         printf("Built %d segments for CH1:\n", ch1_num_segments);
@@ -525,8 +577,8 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
     if(debug) 
     {
         printf("CH1 seg_arb configured: %d segments, loop count=%d\n", ch1_num_segments, burstCount);
-        printf("  Total CH1 duration: %.6g s (%d pulses @ %.6g s period)\n", 
-               burstCount * period, burstCount, period);
+        printf("  Total CH1 duration: %.6g s (%d pulses @ %.6g s loop)\n", 
+               burstCount * ch1_loop_time, burstCount, ch1_loop_time);
     }
     
     // Also set load resistance to help PMU optimize current measurement
@@ -551,6 +603,9 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
     
     if(debug) printf("Configured CH1 for %d pulses with waveform capture (acqType=%d)\n", burstCount, acqType);
 
+    // Programmed run time of the longest channel, for the completion wait
+    double exec_duration = ch1_loop_time * burstCount;
+    
     // ============================================================
     // CH2 Setup for seg_arb waveform (no measurement)
     // ============================================================
@@ -694,9 +749,9 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
         }
         
         // Ensure RPM in pulse mode for CH2
-        status = rpm_config(pulserId, ch2, KI_RPM_PATHWAY, KI_RPM_PULSE);
+        status = rpm_pathway_set(pulserId, ch2, KI_RPM_PULSE);
         if ( status && debug )
-           printf("rpm_config CH2 returned: %d\n", status);
+           printf("rpm_pathway_set CH2 returned: %d\n", status);
         
         // Set load for CH2 (required before seg_arb)
         status = pulse_load(pulserId, ch2, 1e6);  // High impedance load
@@ -829,6 +884,7 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
         }
         double ch2_effective_period = ch2_total_time;  // Period = one cycle time
         double ch2_total_duration = ch2_total_time * valid_loop_count;
+        if (ch2_total_duration > exec_duration) exec_duration = ch2_total_duration;
         
         if(debug) 
         {
@@ -836,8 +892,8 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
             printf("  One cycle time: %.6g s (sum of %d segment times)\n", ch2_total_time, actual_ch2_segments);
             printf("  Loop count: %.6g (using %.6g)\n", Ch2LoopCount, valid_loop_count);
             printf("  Total CH2 duration: %.6g s\n", ch2_total_duration);
-            printf("  CH1 measurement duration: %.6g s (%d pulses @ %.6g s period)\n", 
-                   burstCount * period, burstCount, period);
+            printf("  CH1 measurement duration: %.6g s (%d pulses @ %.6g s loop)\n", 
+                   burstCount * ch1_loop_time, burstCount, ch1_loop_time);
             if (auto_build)
                 printf("  CH2 pulse period: %.6g s (independent of CH1!)\n", Ch2Period);
         }
@@ -926,67 +982,22 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
 
     if(debug) printf("About to execute: TestMode=%d, CH1 burstCount=%d, CH2 enabled=%d\n", TestMode, burstCount, Ch2Enable);
     
-    // Execute both channels together
-    if(debug) printf("Executing pulses (CH1 seg_arb + CH2 seg_arb)...\n");
-    status = pulse_exec(TestMode);
-    if (status)
-    {
-        if(debug) printf("pulse_exec failed: %d\n", status);
-        return status;
-    }
-
-    // Wait until test is complete
-    i = 0;
-    while ( pulse_exec_status(&t) == 1 && i < 200 )
-    {
-        Sleep(100);
-        i++;
-    }
-    
-    if (i >= 200)
-    {
-        if(debug) printf("ERROR: Pulse execution timed out after 20 seconds\n");
-        return -998;
-    }
-    
-    if(debug) printf("Pulse execution complete after %d waits (%.1f seconds)\n", i, i * 0.1);
-
-    // Small delay to ensure measurement data is ready (working examples sometimes have commented Sleep here)
-    Sleep(50);  // 50ms delay to ensure data is ready
-    
-    // Turn off CH2 if it was enabled
-    if (Ch2Enable)
-    {
-        int ch2 = (chan == 1) ? 2 : 1;
-        status = pulse_output(pulserId, ch2, 0);
-        if(debug) printf("CH2 output disabled\n");
-    }
-    
-    // ============================================================
-    // Fetch waveform and extract averaged values per pulse
-    // ============================================================
-    
     // Calculate expected number of samples based on total measurement time
-    // For seg_arb with loop count, total time = period * burstCount
-    double total_measurement_time = period * burstCount;
+    // For seg_arb with loop count, total time = loop length * burstCount
+    double total_measurement_time = ch1_loop_time * burstCount;
     int expectedSamples = (int)(total_measurement_time * SampleRate + 1);
     
-    // Allocate temporary buffers for full waveform
+    // Allocate buffers for the full (averaged) waveform
     // Use expected samples, not pulse_chan_status (which can be unreliable)
     int maxSamples = expectedSamples;
     if (maxSamples < 100) maxSamples = 100;  // Minimum buffer size
-    if (maxSamples > 100000) maxSamples = 1000000;  // Maximum buffer size:  changed 0 added to make it million
-    
-    waveformV = (double *)calloc(maxSamples, sizeof(double));
-    waveformI = (double *)calloc(maxSamples, sizeof(double));
-    waveformT = (double *)calloc(maxSamples, sizeof(double));
+    if (maxSamples > 100000) maxSamples = PMU_AVG_MAX_SAMPLES;  // Maximum buffer size (see pmu_pulse_extract.h)
     
-    if (waveformV == NULL || waveformI == NULL || waveformT == NULL)
+    // Every run is folded into the running mean; one run is the plain capture
+    pmu_wave_avg avg;
+    if (pmu_wave_avg_init(&avg, maxSamples, NumAverages > 1 && size_I_Var > 1))
     {
         if(debug) printf("Failed to allocate memory for waveform buffers\n");
-        if (waveformV) free(waveformV);
-        if (waveformI) free(waveformI);
-        if (waveformT) free(waveformT);
         return -999;
     }
     
@@ -997,32 +1008,65 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
         printf("  Sample rate: %.6g Hz\n", SampleRate);
         printf("  Expected samples: %d\n", expectedSamples);
         printf("  Buffer size: %d\n", maxSamples);
-        printf("  Fetching (StartIndex=0, StopIndex=%d)...\n", maxSamples-1);
+        printf("  Runs averaged: %d\n", NumAverages);
     }
     
-    // Fetch waveform data - use maxSamples-1 as StopIndex (pulse_fetch is inclusive)
-    // IMPORTANT: pulse_fetch returns MEASURED voltage and current from the specified channel
-    // For single-channel mode (CH1), this is the measured voltage at the DUT and current through the DUT
-    // For dual-channel mode, you would fetch separately from ForceCh and MeasureCh
-    if(debug) printf("Fetching data from CH%d (single-channel mode: force + measure)\n", chan);
-    status = pulse_fetch(pulserId, chan, 0, maxSamples-1, waveformV, waveformI, waveformT, NULL);
-    if (status)
+    int run;
+    for (run = 0; run < NumAverages; run++)
     {
-        if(debug) printf("pulse_fetch failed with error: %d\n", status);
-        free(waveformV);
-        free(waveformI);
-        free(waveformT);
-        return status;
+        // Execute both channels together
+        if(debug) printf("Executing pulses (CH1 seg_arb + CH2 seg_arb), run %d of %d...\n", run + 1, NumAverages);
+        status = pulse_exec(TestMode);
+        if (status)
+        {
+            if(debug) printf("pulse_exec failed: %d\n", status);
+            pmu_wave_avg_free(&avg);
+            return status;
+        }
+
+        // Wait until test is complete: sleep through the programmed duration,
+        // then poll finely (see pmu_exec_wait.h)
+        status = pmu_exec_wait(exec_duration, &t);
+        if (status)
+        {
+            if(debug) printf("ERROR: Pulse execution timed out after %.3f s (programmed %.6g s)\n", t, exec_duration);
+            pmu_wave_avg_free(&avg);
+            return status;
+        }
+        
+        if(debug) printf("Pulse execution complete after %.3f s (programmed %.6g s)\n", t, exec_duration);
+        
+        // Fetch waveform data in blocks and add it to the running mean
+        // IMPORTANT: pulse_fetch returns MEASURED voltage and current from the specified channel
+        // For single-channel mode (CH1), this is the measured voltage at the DUT and current through the DUT
+        // For dual-channel mode, you would fetch separately from ForceCh and MeasureCh
+        if(debug && run == 0) printf("Fetching data from CH%d (single-channel mode: force + measure)\n", chan);
+        status = pmu_wave_avg_fetch(&avg, pulserId, chan);
+        if (status)
+        {
+            if(debug) printf("pulse_fetch failed with error: %d (run %d)\n", status, run + 1);
+            pmu_wave_avg_free(&avg);
+            return status;
+        }
     }
     
-    // Find actual number of samples
-    int numWaveformSamples = 0;
-    for (i = 0; i < maxSamples; i++)
+    // Turn off CH2 if it was enabled
+    if (Ch2Enable)
     {
-        if (waveformT[i] == 0.0 && i > 0) break;
-        numWaveformSamples++;
+        int ch2 = (chan == 1) ? 2 : 1;
+        status = pulse_output(pulserId, ch2, 0);
+        if(debug) printf("CH2 output disabled\n");
     }
     
+    // ============================================================
+    // Extract averaged values per pulse from the (averaged) waveform
+    // ============================================================
+    
+    waveformV = avg.V;
+    waveformI = avg.I;
+    waveformT = avg.T;
+    int numWaveformSamples = avg.n;
+    
     if(debug) 
     {
         printf("Fetched %d waveform samples, extracting averaged values per pulse...\n", numWaveformSamples);
@@ -1168,129 +1212,125 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
         }
     }
     
-    // Extract one averaged value per pulse (from 40-80% of pulse width)
+    // Extract one averaged value per pulse (from 50-80% of pulse width)
+    // Single pass over the samples: threshold and time-based (known period)
+    // detection run side by side, see pmu_pulse_extract.h
     int outputIdx = 0;
     double measurementStartFrac = 0.5;
     double measurementEndFrac = 0.8;
     double voltageThreshold = fabs(startV) * 0.5;
     
-    int pulseStartIdx = -1;
-    int pulseEndIdx = -1;
-    int pulseNum = 0;
+    int maxOutput = size_V_Meas;
+    if (size_I_Meas < maxOutput) maxOutput = size_I_Meas;
+    if (size_T_Stamp < maxOutput) maxOutput = size_T_Stamp;
+    
+    double *timeV = (double *)calloc(maxOutput, sizeof(double));
+    double *timeI = (double *)calloc(maxOutput, sizeof(double));
+    double *timeT = (double *)calloc(maxOutput, sizeof(double));
+    if (timeV == NULL || timeI == NULL || timeT == NULL)
+    {
+        if(debug) printf("Failed to allocate memory for pulse extraction\n");
+        if (timeV) free(timeV);
+        if (timeI) free(timeI);
+        if (timeT) free(timeT);
+        pmu_wave_avg_free(&avg);
+        return -999;
+    }
+    
+    pmu_pulse_extract extract;
+    pmu_pulse_extract_init(&extract, ch1_loop_time, rise, width, fall,
+                           measurementStartFrac, measurementEndFrac, voltageThreshold, burstCount,
+                           V_Meas, I_Meas, T_Stamp, timeV, timeI, timeT, maxOutput);
+    extract.i_offset = baseline_current_offset;  // Subtract baseline/offset current
     
-    for (i = 0; i < numWaveformSamples && pulseNum < burstCount && outputIdx < size_V_Meas; i++)
+    // Optional per-pulse feature table, filled during the same pass
+    if (size_Features >= PMU_FEATURE_COLS)
     {
-        // Detect pulse start
-        if (pulseStartIdx < 0 && fabs(waveformV[i]) > voltageThreshold)
+        int featureRows = size_Features / PMU_FEATURE_COLS;
+        if (featureRows > burstCount) featureRows = burstCount;
+        if (pmu_pulse_extract_features(&extract, Features, featureRows))
         {
-            pulseStartIdx = i;
-        }
-        
-        // Detect pulse end
-        if (pulseStartIdx >= 0 && fabs(waveformV[i]) < voltageThreshold)
-        {
-            pulseEndIdx = i;
-            
-            int pulseWidthSamples = pulseEndIdx - pulseStartIdx;
-            int measStartSample = pulseStartIdx + (int)(pulseWidthSamples * measurementStartFrac);
-            int measEndSample = pulseStartIdx + (int)(pulseWidthSamples * measurementEndFrac);
-            
-            if (measEndSample > pulseEndIdx) measEndSample = pulseEndIdx;
-            if (measStartSample < pulseStartIdx) measStartSample = pulseStartIdx;
-            
-            // Average samples in measurement window (with offset compensation)
-            double sumV = 0.0, sumI = 0.0, sumT = 0.0;
-            int count = 0;
-            
-            for (j = measStartSample; j <= measEndSample && j < numWaveformSamples; j++)
-            {
-                sumV += waveformV[j];
-                // Subtract baseline/offset current for accurate measurement
-                sumI += (waveformI[j] - baseline_current_offset);
-                sumT += waveformT[j];
-                count++;
-            }
-            
-            if (count > 0)
-            {
-                V_Meas[outputIdx] = sumV / count;
-                I_Meas[outputIdx] = sumI / count;  // Already compensated
-                T_Stamp[outputIdx] = sumT / count;
-                
-                if(debug && outputIdx < 5)
-                {
-                    double raw_avg_current = 0.0;
-                    for (j = measStartSample; j <= measEndSample && j < numWaveformSamples; j++)
-                    {
-                        raw_avg_current += waveformI[j];
-                    }
-                    raw_avg_current /= count;
-                    printf("[DEBUG] Pulse %d: V=%.6f V, I_raw=%.6e A, I_offset=%.6e A, I_net=%.6e A\n",
-                           outputIdx, V_Meas[outputIdx], raw_avg_current, baseline_current_offset, I_Meas[outputIdx]);
-                }
-                
-                outputIdx++;
-            }
-            
-            pulseNum++;
-            pulseStartIdx = -1;
-            pulseEndIdx = -1;
+            if(debug) printf("Failed to allocate memory for feature extraction\n");
+            free(timeV);
+            free(timeI);
+            free(timeT);
+            pmu_wave_avg_free(&avg);
+            return -999;
         }
+        if(debug) printf("Feature table: %d rows x %d columns\n", featureRows, PMU_FEATURE_COLS);
     }
     
+    pmu_pulse_extract_feed(&extract, waveformV, waveformI, waveformT, numWaveformSamples);
+    pmu_pulse_extract_finish(&extract);
+    outputIdx = extract.h_out;
+    
     if(debug) printf("Threshold-based detection found %d pulses (expected %d)\n", outputIdx, burstCount);
     
-    // If we didn't find enough pulses, try alternative: assume evenly spaced pulses
+    // If we didn't find enough pulses, use the evenly-spaced (period-based) result
     if (outputIdx < burstCount && numWaveformSamples > 0)
     {
-        if(debug) printf("Only found %d pulses via threshold detection, trying evenly-spaced detection...\n", outputIdx);
+        if(debug) printf("Only found %d pulses via threshold detection, using evenly-spaced detection (%d pulses, loop %.6g s)\n",
+                         outputIdx, extract.t_out, ch1_loop_time);
         
-        // Reset output
-        for (i = 0; i < outputIdx; i++)
+        for (i = 0; i < extract.t_out; i++)
         {
-            V_Meas[i] = 0.0;
-            I_Meas[i] = 0.0;
-            T_Stamp[i] = 0.0;
+            V_Meas[i] = timeV[i];
+            I_Meas[i] = timeI[i];
+            T_Stamp[i] = timeT[i];
         }
-        outputIdx = 0;
-        
-        // Use time-based detection assuming pulses are evenly spaced
-        double totalTime = waveformT[numWaveformSamples-1] - waveformT[0];
-        double estimatedPeriod = totalTime / burstCount;
-        
-        if(debug) printf("Estimated period: %.6g s (total time: %.6g s)\n", estimatedPeriod, totalTime);
-        
-        for (int pulseIdx = 0; pulseIdx < burstCount && outputIdx < size_V_Meas; pulseIdx++)
+        outputIdx = extract.t_out;
+    }
+    
+    // Per-pulse variance of I over the runs, same windows and path as I_Meas
+    if (size_I_Var > 1)
+    {
+        int varRows = (size_I_Var < maxOutput) ? size_I_Var : maxOutput;
+        memset(I_Var, 0, size_I_Var * sizeof(double));
+        if (avg.m2I != NULL)
         {
-            double pulseStartTime = waveformT[0] + pulseIdx * estimatedPeriod;
-            double measStartTime = pulseStartTime + delay + rise + width * measurementStartFrac;
-            double measEndTime = pulseStartTime + delay + rise + width * measurementEndFrac;
-            
-            double sumV = 0.0, sumI = 0.0, sumT = 0.0;
-            int count = 0;
-            
-            for (i = 0; i < numWaveformSamples; i++)
+            // Own outputs: threshold I goes straight to I_Var, the rest
+            // (threshold V/T, time-path V/I/T) to one scratch block
+            pmu_pulse_extract vx;
+            double *varScratch = (double *)calloc(5 * (size_t)varRows, sizeof(double));
+            if (varScratch == NULL)
             {
-                if (waveformT[i] >= measStartTime && waveformT[i] <= measEndTime)
-                {
-                    sumV += waveformV[i];
-                    // Subtract baseline/offset current for accurate measurement
-                    sumI += (waveformI[i] - baseline_current_offset);
-                    sumT += waveformT[i];
-                    count++;
-                }
+                if(debug) printf("Failed to allocate memory for the I_Var pass\n");
+                free(timeV);
+                free(timeI);
+                free(timeT);
+                pmu_wave_avg_free(&avg);
+                return -999;
             }
-            
-            if (count > 0)
+            pmu_wave_avg_variance(&avg);
+            pmu_pulse_extract_init(&vx, ch1_loop_time, rise, width, fall,
+                                   measurementStartFrac, measurementEndFrac, voltageThreshold, burstCount,
+                                   varScratch, I_Var, varScratch + varRows,
+                                   varScratch + 2 * varRows, varScratch + 3 * varRows, varScratch + 4 * varRows,
+                                   varRows);
+            pmu_pulse_extract_feed(&vx, waveformV, avg.m2I, waveformT, numWaveformSamples);
+            pmu_pulse_extract_finish(&vx);
+            if (extract.h_out < burstCount)
             {
-                V_Meas[outputIdx] = sumV / count;
-                I_Meas[outputIdx] = sumI / count;  // Already compensated
-                T_Stamp[outputIdx] = sumT / count;
-                outputIdx++;
+                for (i = 0; i < vx.t_out; i++)
+                    I_Var[i] = varScratch[3 * varRows + i];
+                for (; i < varRows; i++)
+                    I_Var[i] = 0.0;
             }
+            free(varScratch);
         }
     }
     
+    free(timeV);
+    free(timeI);
+    free(timeT);
+    
+    if(debug)
+    {
+        for (i = 0; i < outputIdx && i < 5; i++)
+            printf("[DEBUG] Pulse %d: V=%.6f V, I_offset=%.6e A, I_net=%.6e A\n",
+                   i, V_Meas[i], baseline_current_offset, I_Meas[i]);
+    }
+    
     // Zero out remaining array elements
     for (i = outputIdx; i < size_V_Meas && i < size_I_Meas && i < size_T_Stamp; i++)
     {
@@ -1299,9 +1339,7 @@ int ACraig10_PMU_Waveform_SegArb( double width, double rise, double fall, double
         T_Stamp[i] = 0.0;
     }
     
-    free(waveformV);
-    free(waveformI);
-    free(waveformT);
+    pmu_wave_avg_free(&avg);
     
     if(debug) 
     {
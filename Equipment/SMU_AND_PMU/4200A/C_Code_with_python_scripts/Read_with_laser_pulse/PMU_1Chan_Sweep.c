@@ -38,6 +38,7 @@
 		Status_Ch1_Size,	int,	Input,	100,	1,	10000
 	INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "PMU_examples_ulib_internal.h"
 
 BOOL LPTIsInCurrentConfiguration(char* hrid);
@@ -260,6 +261,7 @@ Value  | Description
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "PMU_examples_ulib_internal.h"
 
 BOOL LPTIsInCurrentConfiguration(char* hrid);
@@ -336,7 +338,7 @@ if (verbose)
     AllocateArrays_1ChanSw(NumSweepPts);
 
     //Ensure that 4225-RPM (if attached) is in the pulse mode
-    status = rpm_config(InstId, Chan, KI_RPM_PATHWAY, KI_RPM_PULSE);
+    status = rpm_pathway_set(InstId, Chan, KI_RPM_PULSE);
     if ( status )
     {
         FreeArrays_1ChanSw();
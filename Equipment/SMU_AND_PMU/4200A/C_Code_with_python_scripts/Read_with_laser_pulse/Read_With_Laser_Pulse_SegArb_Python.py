@@ -60,6 +60,22 @@ command-line parameters. To modify it, edit the C source file:
   measurementStartFrac = 0.4  (40% of pulse width)
   measurementEndFrac = 0.8    (80% of pulse width)
 
+PER-PULSE FEATURES (--features):
+================================
+The C module can also reduce every pulse to 5 features in the same pass
+(t_start, I_peak, t_switch, Q = integral of I dt, t_rise 10-90%), with the
+same baseline current compensation as I_Meas, returned as one row per pulse
+in the Features array (GP 56) instead of the full waveform.
+
+COHERENT AVERAGING (--averages M, --variance):
+==============================================
+On high-resistance devices (100 nA range) the module can execute the armed
+test M times and average the M waveforms sample by sample on the
+instrument, before baseline compensation and extraction, instead of
+re-running it from Python and transferring every waveform. Noise drops by
+sqrt(M). --variance also returns I_Var (GP 59): per pulse, the single-run
+current variance averaged over the pulse window (A^2).
+
 Usage examples:
 
     # CH1 reads at 2µs, CH2 pulses laser every 10µs
@@ -229,6 +245,10 @@ def format_param(value: float | int | str) -> str:
     return str(value)
 
 
+FEATURE_COLUMNS = 5
+FEATURE_NAMES = ["t_start_s", "I_peak_A", "t_switch_s", "charge_C", "t_rise_s"]
+
+
 def build_ex_command(
     # CH1 parameters
     width: float, rise: float, fall: float, delay: float, period: float,
@@ -241,7 +261,10 @@ def build_ex_command(
     ch2_enable: int, ch2_vrange: float,
     ch2_vlow: float, ch2_vhigh: float, ch2_width: float,
     ch2_rise: float, ch2_fall: float, ch2_period: float, ch2_loop_count: float,
-    clarius_debug: int = 1
+    clarius_debug: int = 1,
+    feature_rows: int = 0,
+    num_averages: int = 1,
+    variance_rows: int = 0
 ) -> str:
     """Build EX command for ACraig10_PMU_Waveform_SegArb."""
     
@@ -308,6 +331,11 @@ def build_ex_command(
         format_param(10),                  # 53: Ch2MeasStop_size
         format_param(ch2_loop_count),      # 54: Ch2LoopCount (MUST be >= 1.0!)
         format_param(clarius_debug),       # 55: ClariusDebug
+        "",                                 # 56: Features output array
+        format_param(max(1, feature_rows * FEATURE_COLUMNS)),  # 57: size_Features (1 = off)
+        format_param(num_averages),        # 58: NumAverages
+        "",                                 # 59: I_Var output array
+        format_param(max(1, variance_rows)),  # 60: size_I_Var (1 = off)
     ]
 
     return f"EX A_Ch1Read_Ch2Laser_Pulse ACraig10_PMU_Waveform_SegArb({','.join(params)})"
@@ -365,7 +393,10 @@ def run_measurement(args, enable_plot: bool) -> None:
         args.ch2_enable, args.ch2_vrange,
         args.ch2_vlow, args.ch2_vhigh, args.ch2_width,
         args.ch2_rise, args.ch2_fall, args.ch2_period, ch2_loop_count,
-        debug_enable
+        debug_enable,
+        feature_rows=args.burst_count if args.features else 0,
+        num_averages=args.averages,
+        variance_rows=max(2, args.burst_count) if args.variance else 0
     )
     
     print("\n" + "="*80)
@@ -382,8 +413,8 @@ def run_measurement(args, enable_plot: bool) -> None:
         # Count non-empty parameters to find Ch2LoopCount
         # Ch2LoopCount should be near the end (parameter 54 in metadata, but empty strings shift indices)
         if len(params_list) >= 50:  # Should have at least 50 non-empty params
-            # Ch2LoopCount is the second-to-last parameter (before ClariusDebug)
-            ch2_loop_param = params_list[-2] if len(params_list) >= 2 else "N/A"
+            # Ch2LoopCount is fifth from last (before ClariusDebug, size_Features, NumAverages, size_I_Var)
+            ch2_loop_param = params_list[-5] if len(params_list) >= 5 else "N/A"
             print(f"\n[DEBUG] Ch2LoopCount (from command): '{ch2_loop_param}'")
             print(f"[DEBUG] Total non-empty parameters: {len(params_list)}")
     except Exception as e:
@@ -449,6 +480,12 @@ def run_measurement(args, enable_plot: bool) -> None:
         
         print(f"[KXCI] Received: {len(voltage)} voltage, {len(current)} current, {len(time_axis)} time samples")
 
+        if args.features:
+            print_features(safe_query(56, args.burst_count * FEATURE_COLUMNS, "features"))
+
+        if args.variance:
+            print_variance(current, safe_query(59, args.burst_count, "current variance"), args.averages)
+
         usable = min(len(voltage), len(current), len(time_axis))
         voltage = voltage[:usable]
         current = current[:usable]
@@ -571,6 +608,28 @@ def run_measurement(args, enable_plot: bool) -> None:
         controller.disconnect()
 
 
+def print_variance(current: List[float], i_var: List[float], averages: int) -> None:
+    """Print per-pulse mean current with its standard error over the averaged runs."""
+    print(f"\n[KXCI] Per-pulse current over {averages} runs: {len(i_var)} pulses")
+    print(f"  {'pulse':>5} {'I (A)':>13} {'sigma_run (A)':>14} {'sigma_mean (A)':>15}")
+    for k, var in enumerate(i_var[:min(len(i_var), len(current), 20)]):
+        sigma = max(var, 0.0) ** 0.5
+        print(f"  {k:5d} {current[k]:13.5e} {sigma:14.5e} {sigma / max(averages, 1) ** 0.5:15.5e}")
+    if len(i_var) > 20:
+        print(f"  ... ({len(i_var) - 20} more)")
+
+
+def print_features(values: List[float]) -> None:
+    """Print the per-pulse feature table (one row of FEATURE_COLUMNS per pulse)."""
+    rows = [values[k:k + FEATURE_COLUMNS] for k in range(0, len(values) - FEATURE_COLUMNS + 1, FEATURE_COLUMNS)]
+    print(f"\n[KXCI] Per-pulse features: {len(rows)} rows")
+    print("  pulse  " + "  ".join(f"{name:>12}" for name in FEATURE_NAMES))
+    for k, row in enumerate(rows[:20]):
+        print(f"  {k:5d}  " + "  ".join(f"{value:12.4e}" for value in row))
+    if len(rows) > 20:
+        print(f"  ... ({len(rows) - 20} more rows)")
+
+
 def parse_arguments() -> argparse.Namespace:
     """Parse command-line arguments."""
     parser = argparse.ArgumentParser(
@@ -622,6 +681,12 @@ Examples:
     parser.add_argument("--chan", type=int, default=1, choices=[1, 2], help="PMU channel for DUT measurement")
     parser.add_argument("--pmu-id", type=str, default="PMU1", help="PMU instrument ID")
     parser.add_argument("--array-size", type=int, default=0, help="Output array size (0=auto)")
+    parser.add_argument("--features", action="store_true",
+                       help="Also return per-pulse features (t_start, I_peak, t_switch, Q, t_rise)")
+    parser.add_argument("--averages", type=int, default=1,
+                       help="Runs averaged sample by sample on the instrument (1-10000, default 1)")
+    parser.add_argument("--variance", action="store_true",
+                       help="Also return the per-pulse current variance over the averaged runs")
 
     # CH2 seg_arb parameters (simple pulse mode - auto-build)
     parser.add_argument("--ch2-enable", type=int, default=1, choices=[0, 1], 
@@ -711,7 +776,10 @@ def main() -> None:
         args.ch2_enable, args.ch2_vrange,
         args.ch2_vlow, args.ch2_vhigh, args.ch2_width,
         args.ch2_rise, args.ch2_fall, args.ch2_period, ch2_loop_count,
-        debug_enable
+        debug_enable,
+        feature_rows=args.burst_count if args.features else 0,
+        num_averages=args.averages,
+        variance_rows=max(2, args.burst_count) if args.variance else 0
     )
 
     print("Generated EX command:\n" + command)
@@ -32,6 +32,7 @@
 		npts,	int *,	Output,	,	,	
 	INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
 
 double *fstartv = NULL;
 double *fstopv = NULL;
@@ -213,6 +214,7 @@ Value  | Description
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
 
 double *fstartv = NULL;
 double *fstopv = NULL;
@@ -318,10 +320,10 @@ int read_train_ilimit( char *InstrName, long ForceCh, double ForceVRange, double
   {
       // NK added 24/10/2024
       // **************************************************************
-      status = rpm_config(InstId, ForceCh, KI_RPM_PATHWAY, KI_RPM_PULSE);
+      status = rpm_pathway_set(InstId, ForceCh, KI_RPM_PULSE);
       if(debug)printf("RPM is initialized for ForceCh! %s (0 or null is good)\n", status);
 
-      status = rpm_config(InstId, MeasureCh, KI_RPM_PATHWAY, KI_RPM_PULSE);
+      status = rpm_pathway_set(InstId, MeasureCh, KI_RPM_PULSE);
       if(debug)printf("RPM is initialized for MeasCh! %s (0 or null is good)\n", status);
 
      // **************************************************************
@@ -0,0 +1,140 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: SMU_pulse_engine_craig
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 18
+	ARGUMENTS:
+		initialize,	int,	Input,	0,	0,	1
+		logMessages,	int,	Input,	0,	0,	1
+		Amplitudes,	char *,	Input,	"1.0",	,
+		Widths,	char *,	Input,	"1e-4",	,
+		Measure,	char *,	Input,	"1",	,
+		BiasHolds,	char *,	Input,	"1e-3",	,
+		NumRecords,	int,	Input,	1,	1,	100000
+		biasV,	double,	Input,	0.2,	-20,	20
+		Irange,	double,	Input,	1e-2,	0.0,	1
+		Icomp,	double,	Input,	0.0,	-10e-3,	10e-3
+		measResistance,	D_ARRAY_T,	Output,	,	,
+		NumResistance,	int,	Input,	1,	1,	100000
+		measCurrent,	D_ARRAY_T,	Output,	,	,
+		NumCurrent,	int,	Input,	1,	1,	100000
+		measRecord,	D_ARRAY_T,	Output,	,	,
+		NumRecord,	int,	Input,	1,	1,	100000
+		NumMeasOut,	int *,	Output,	,	,
+		NumRecordsOut,	int *,	Output,	,	,
+	INCLUDES:
+#include "keithley.h"
+#include "nvm.h"
+#include "smu_pulse_engine.h"
+
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+<!--MarkdownExtra-->
+<link rel="stylesheet" type="text/css" href="file:///C:/s4200/sys/help/InfoPane/stylesheet.css">
+
+Module: SMU_pulse_engine_craig
+===================
+
+Description
+-----------
+Schedule-driven pulse engine covering SMU_pulse_only_craig (Measure = 0) and
+SMU_pulse_measure_craig (Measure = 1) for any number of records in one call.
+
+Record k = (Amplitude, Width, Measure, BiasHold), each taken from its list as
+value[k % length]. Lists are separated by ';' (or ',' / space).
+
+- BiasHold > 0: pulsev(biasV, BiasHold) before the pulse
+- BiasHold = 0: no bias step, so the pulse follows the previous one directly
+- Measure != 0: mpulse() and one reading stored
+- Measure = 0:  pulsev() only, no readback
+
+A final bias hold follows the last record if its hold is non-zero.
+
+Example - program 4 times, read once, 250 times:
+  Amplitudes "1.5;1.5;1.5;1.5;0.2", Widths "1e-4", Measure "0;0;0;0;1",
+  BiasHolds "0", NumRecords 1250
+
+Outputs are packed, one entry per measured record, and are read back once
+at the end of the run:
+measResistance = Vsat / Isat, measCurrent = Isat, measRecord = record index.
+NumResistance, NumCurrent and NumRecord must hold the number of measured
+records. NumMeasOut = readings stored, NumRecordsOut = records completed.
+
+Note: In the test it is assumed that RPM1 is linked with SMU1 and RPM2 is linked with SMU2.
+
+Return codes: 0 = OK, -1 = SMU1 not in configuration, -2 = empty or bad list,
+-3 = output arrays too small, -4 = out of memory, -6 = pulse failed (see NumRecordsOut),
+SLEW_RATE_ERROR = unattainable slew rate
+
+	END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include "nvm.h"
+#include "smu_pulse_engine.h"  /* Schedule parsing, SMU setup and record loop */
+
+
+/* USRLIB MODULE MAIN FUNCTION */
+int SMU_pulse_engine_craig( int initialize, int logMessages, char *Amplitudes, char *Widths, char *Measure, char *BiasHolds, int NumRecords, double biasV, double Irange, double Icomp, double *measResistance, int NumResistance, double *measCurrent, int NumCurrent, double *measRecord, int NumRecord, int *NumMeasOut, int *NumRecordsOut )
+{
+/* USRLIB MODULE CODE */
+
+// ************** NOTE: DO NOT TRY TO COMPILE WITH KXCI OPEN, it always give linker errors    **********************
+
+        char mod[] = "SMU_pulse_engine_craig";
+        int smuId;
+        int stat;
+        int maxMeas;
+        smu_pulse_schedule *sched;
+
+        *NumMeasOut = 0;
+        *NumRecordsOut = 0;
+
+        if (!LPTIsInCurrentConfiguration("SMU1"))
+                return(-1);
+        getinstid("SMU1", &smuId);
+
+    //CHECK INPUTS FOR ERRORS!
+        sched = (smu_pulse_schedule *)calloc(1, sizeof(smu_pulse_schedule));
+        if (sched == NULL)
+                return(SMU_PULSE_ERR_MEMORY);
+
+        stat = smu_pulse_schedule_parse(sched, Amplitudes, Widths, Measure, BiasHolds);
+        if (stat != SMU_PULSE_OK || NumRecords < 1) {
+                if (logMessages) nlogErr("%s: bad schedule (%d)\n", mod, stat);
+                if (stat == SMU_PULSE_OK) stat = SMU_PULSE_ERR_LIST;
+                goto RETURN;
+        }
+
+        maxMeas = NumResistance;
+        if (NumCurrent < maxMeas) maxMeas = NumCurrent;
+        if (NumRecord < maxMeas) maxMeas = NumRecord;
+
+ //STOP CHECKING INPUTS
+
+        if (logMessages) {
+                printf("\n%s: %d records (%d measured), bias %f V\n", mod, NumRecords,
+                       smu_pulse_schedule_count_measured(sched, NumRecords), biasV);
+        }
+
+if (initialize==1)  {
+//only needed if SMU is connected through the RPMS
+// rpm_config(PMU1, 1, KI_RPM_PATHWAY, KI_RPM_SMU);
+// rpm_config(PMU1, 2, KI_RPM_PATHWAY, KI_RPM_SMU);
+ }
+
+        smu_pulse_setup(smuId, Irange, Icomp);
+
+        stat = smu_pulse_run(smuId, sched, NumRecords, biasV, measResistance, measCurrent,
+                             measRecord, maxMeas, NumRecordsOut, NumMeasOut);
+
+        if (logMessages)
+                printf("%s: %d records done, %d readings\n", mod, *NumRecordsOut, *NumMeasOut);
+
+RETURN:
+        if (logMessages) nlog("%s: exiting with status: %d\n", mod, stat);
+        free(sched);
+        return stat;
+/* USRLIB MODULE END  */
+} 		/* End SMU_pulse_engine_craig.c */
+
@@ -16,6 +16,7 @@
 	INCLUDES:
 #include "keithley.h"
 #include "nvm.h"
+#include "smu_pulse_engine.h"
 
 	END USRLIB MODULE INFORMATION
 */
@@ -45,6 +46,7 @@ Polarities of the forced bias and measured current are inverted in the code.
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
 #include "nvm.h"
+#include "smu_pulse_engine.h"  /* smu_pulse_setup() shared with the pulse engine */
 
 
 /* USRLIB MODULE MAIN FUNCTION */
@@ -59,7 +61,6 @@ int SMU_pulse_only_craig( int initialize, int logMessages, double widthTime, dou
         int SMU1;
         int error=0;
         double riseTime=1e-7; //default = 1e-4, Min=40e-9,Max=1
-        double compCH=1; // sets the compliance channel, default = 1, Min=1,Max=1
 
 
 pulse_success=&stat; //so clarius console message can be turned off and a value is still returned
@@ -121,8 +122,6 @@ pulse_success=&stat; //so clarius console message can be turned off and a value
         //if (!LPTIsInCurrentConfiguration("SMU1"))
           //      return(-2);
 
-        setmode(SMU1, KI_LIM_MODE, KI_VALUE); // tells SMU to return an indicator or actual value when in limit or over range
-      //setmode(SMU2, KI_LIM_MODE, KI_VALUE);
 
 
         //switch matrix:
@@ -136,19 +135,8 @@ if (initialize==1)  {
 
 
         
-//set compliance current
-        if (Icomp != 0.0) {
-                if (1 == compCH)
-                    limiti(SMU1, Icomp);
-               // else
-                //    limiti(SMU2, Icomp);
-                }
-                
-//set current range 
-        if (Irange != 0.0) {
-                        rangei(SMU1, Irange);
-                 //       rangei(SMU2, Irange);
-                }
+//set limit mode, compliance current and current range
+        smu_pulse_setup(SMU1, Irange, Icomp);
 
 // use mpulse to do a pulse and measrure at the same time
 //double vsat,isat;
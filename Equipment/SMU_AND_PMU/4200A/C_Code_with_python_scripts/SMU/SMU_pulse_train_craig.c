@@ -0,0 +1,134 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: SMU_pulse_train_craig
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 14
+	ARGUMENTS:
+		initialize,	int,	Input,	0,	0,	1
+		logMessages,	int,	Input,	0,	0,	1
+		Amplitudes,	char *,	Input,	"1.0",	,
+		Widths,	char *,	Input,	"1e-4",	,
+		BiasHolds,	char *,	Input,	"1e-3",	,
+		NumPulses,	int,	Input,	1,	1,	100000
+		biasV,	double,	Input,	0.2,	-20,	20
+		Irange,	double,	Input,	1e-2,	0.0,	1
+		Icomp,	double,	Input,	0.0,	-10e-3,	10e-3
+		measResistance,	D_ARRAY_T,	Output,	,	,
+		NumResistance,	int,	Input,	1,	1,	100000
+		measCurrent,	D_ARRAY_T,	Output,	,	,
+		NumCurrent,	int,	Input,	1,	1,	100000
+		NumPulsesOut,	int *,	Output,	,	,
+	INCLUDES:
+#include "keithley.h"
+#include "nvm.h"
+#include "smu_pulse_engine.h"
+
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+<!--MarkdownExtra-->
+<link rel="stylesheet" type="text/css" href="file:///C:/s4200/sys/help/InfoPane/stylesheet.css">
+
+Module: SMU_pulse_train_craig
+===================
+
+Description
+-----------
+Train version of SMU_pulse_measure_craig: runs NumPulses bias-hold + measured
+pulse records back to back in one call and returns one resistance per pulse,
+instead of one EX round trip per pulse.
+
+Each record k is: pulsev(biasV, BiasHold[k]) then mpulse(Amplitude[k], Width[k]).
+One final pulsev(biasV, last BiasHold) follows the last pulse, so between two
+pulses there is a single bias hold (not post + pre as with repeated single calls).
+A BiasHold of 0 skips the bias step. This is SMU_pulse_engine_craig with every
+record measured.
+
+Amplitudes, Widths and BiasHolds are lists separated by ';' (or ',' / space).
+A list shorter than NumPulses repeats: record k uses value[k % length], so
+"1.5;-1.5" with NumPulses = 1000 is 500 SET/RESET pairs.
+
+Setup (SMU lookup, limit mode, compliance, range) is done once for the train.
+
+Outputs: measResistance[k] = Vsat / Isat and measCurrent[k] = Isat for pulse k,
+NumPulsesOut = pulses completed.
+
+Note: In the test it is assumed that RPM1 is linked with SMU1 and RPM2 is linked with SMU2.
+
+Return codes: 0 = OK, -1 = SMU1 not in configuration, -2 = empty or bad list,
+-3 = output arrays smaller than NumPulses, -4 = out of memory, -6 = mpulse
+failed (NumPulsesOut pulses done), SLEW_RATE_ERROR = unattainable slew rate
+
+	END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include "nvm.h"
+#include "smu_pulse_engine.h"  /* Schedule parsing, SMU setup and record loop */
+
+
+/* USRLIB MODULE MAIN FUNCTION */
+int SMU_pulse_train_craig( int initialize, int logMessages, char *Amplitudes, char *Widths, char *BiasHolds, int NumPulses, double biasV, double Irange, double Icomp, double *measResistance, int NumResistance, double *measCurrent, int NumCurrent, int *NumPulsesOut )
+{
+/* USRLIB MODULE CODE */
+
+// ************** NOTE: DO NOT TRY TO COMPILE WITH KXCI OPEN, it always give linker errors    **********************
+
+        char mod[] = "SMU_pulse_train_craig";
+        int smuId;
+        int stat;
+        int numMeas;
+        smu_pulse_schedule *sched;
+
+        *NumPulsesOut = 0;
+
+        if (!LPTIsInCurrentConfiguration("SMU1"))
+                return(-1);
+        getinstid("SMU1", &smuId);
+
+    //CHECK INPUTS FOR ERRORS!
+        if (NumResistance < NumPulses || NumCurrent < NumPulses) {
+                if (logMessages) printf("%s: output arrays (%d, %d) smaller than NumPulses (%d)\n", mod, NumResistance, NumCurrent, NumPulses);
+                return(SMU_PULSE_ERR_SIZE);
+        }
+
+        sched = (smu_pulse_schedule *)calloc(1, sizeof(smu_pulse_schedule));
+        if (sched == NULL)
+                return(SMU_PULSE_ERR_MEMORY);
+
+        stat = smu_pulse_schedule_parse(sched, Amplitudes, Widths, NULL, BiasHolds);
+        if (stat != SMU_PULSE_OK || NumPulses < 1) {
+                if (logMessages) nlogErr("%s: bad pulse lists (%d)\n", mod, stat);
+                if (stat == SMU_PULSE_OK) stat = SMU_PULSE_ERR_LIST;
+                goto RETURN;
+        }
+
+ //STOP CHECKING INPUTS
+
+        if (logMessages) {
+                printf("\n%s: %d pulses (%d amplitudes, %d widths, %d holds), bias %f V\n",
+                       mod, NumPulses, sched->n_amplitude, sched->n_width, sched->n_hold, biasV);
+        }
+
+if (initialize==1)  {
+//only needed if SMU is connected through the RPMS
+// rpm_config(PMU1, 1, KI_RPM_PATHWAY, KI_RPM_SMU);
+// rpm_config(PMU1, 2, KI_RPM_PATHWAY, KI_RPM_SMU);
+ }
+
+        // one-time setup for the whole train
+        smu_pulse_setup(smuId, Irange, Icomp);
+
+        // bias hold + measured pulse, back to back
+        stat = smu_pulse_run(smuId, sched, NumPulses, biasV, measResistance, measCurrent,
+                             NULL, NumPulses, NumPulsesOut, &numMeas);
+
+        if (logMessages && *NumPulsesOut > 0)
+                printf("%s: first R = %E, last R = %E\n", mod, measResistance[0], measResistance[*NumPulsesOut - 1]);
+
+RETURN:
+        if (logMessages) nlog("%s: exiting with status: %d\n", mod, stat);
+        free(sched);
+        return stat;
+/* USRLIB MODULE END  */
+} 		/* End SMU_pulse_train_craig.c */
+
@@ -4,6 +4,8 @@ Simple runner for SMU single-pulse modules with pre/post bias, sent over GPIB (e
 Calls:
   - SMU_pulse_measure_craig (measured pulse)
   - SMU_pulse_only_craig    (pulse only)
+  - SMU_pulse_train_craig   (N measured pulses in one call, resistance array back)
+  - SMU_pulse_engine_craig  (schedule of pulse records, each measured or not)
 
 Defaults:
   biasV = 0.2 V, biasHold = 1.0 s (each side), pulse = 2.0 V for 2.0 s.
@@ -12,20 +14,145 @@ Defaults:
 
 import argparse
 import time
-import pyvisa
+from typing import Sequence
 
 
 LIB_NAME = "a_SMU_Pulse"
 
+# GP positions (1-based) in SMU_pulse_train_craig(...)
+GP_TRAIN_RESISTANCE = 10
+GP_TRAIN_CURRENT = 12
+GP_TRAIN_COUNT = 14
 
-def run_ul_over_gpib(resource: str, module_name: str, args: list[str]) -> str:
+# GP positions (1-based) in SMU_pulse_engine_craig(...)
+GP_ENGINE_RESISTANCE = 11
+GP_ENGINE_CURRENT = 13
+GP_ENGINE_RECORD = 15
+GP_ENGINE_MEAS_COUNT = 17
+GP_ENGINE_RECORD_COUNT = 18
+
+
+def format_train_list(values: Sequence[float]) -> str:
+    """Join values as a ';' list for the train module (repeats cyclically on the C side)."""
+    if not values:
+        raise ValueError("train list must contain at least one value")
+    return ";".join(f"{float(v):.6e}" for v in values)
+
+
+def build_train_args(
+    amplitudes: Sequence[float],
+    widths: Sequence[float],
+    bias_holds: Sequence[float],
+    num_pulses: int,
+    bias_v: float = 0.2,
+    i_range: float = 1e-2,
+    i_comp: float = 0.0,
+    log_messages: int = 0,
+    initialize: int = 1,
+) -> list[str]:
+    """Arguments for SMU_pulse_train_craig; outputs are left as placeholders."""
+    if num_pulses < 1 or num_pulses > 100000:
+        raise ValueError("num_pulses must be in 1..100000")
+    # initialize, logMessages, Amplitudes, Widths, BiasHolds, NumPulses, biasV, Irange, Icomp,
+    # measResistance(out), NumResistance, measCurrent(out), NumCurrent, NumPulsesOut(out)
+    return [
+        str(int(initialize)),
+        str(int(log_messages)),
+        format_train_list(amplitudes),
+        format_train_list(widths),
+        format_train_list(bias_holds),
+        str(int(num_pulses)),
+        f"{bias_v:.6e}",
+        f"{i_range:.6e}",
+        f"{i_comp:.6e}",
+        "",
+        str(int(num_pulses)),
+        "",
+        str(int(num_pulses)),
+        "",
+    ]
+
+
+def count_measured(measure: Sequence[float], num_records: int) -> int:
+    """Readings the engine returns: measured records among num_records, lists repeat."""
+    period = sum(1 for m in measure if m)
+    full, rest = divmod(num_records, len(measure))
+    return full * period + sum(1 for m in measure[:rest] if m)
+
+
+def build_engine_args(
+    amplitudes: Sequence[float],
+    widths: Sequence[float],
+    measure: Sequence[float],
+    bias_holds: Sequence[float],
+    num_records: int,
+    bias_v: float = 0.2,
+    i_range: float = 1e-2,
+    i_comp: float = 0.0,
+    log_messages: int = 0,
+    initialize: int = 1,
+) -> list[str]:
     """
-    Send UL command over GPIB to the 4200A.
-    Sequence: UL -> EX <lib> <module>(args) -> DE
+    Arguments for SMU_pulse_engine_craig. Output arrays are sized to the number
+    of measured records, so e.g. measure=[0, 0, 0, 1] reads back a quarter of the records.
     """
+    if num_records < 1 or num_records > 100000:
+        raise ValueError("num_records must be in 1..100000")
+    if not measure:
+        raise ValueError("measure list must contain at least one value")
+    size = str(max(1, count_measured(measure, num_records)))
+    # initialize, logMessages, Amplitudes, Widths, Measure, BiasHolds, NumRecords, biasV, Irange, Icomp,
+    # measResistance(out), NumResistance, measCurrent(out), NumCurrent, measRecord(out), NumRecord,
+    # NumMeasOut(out), NumRecordsOut(out)
+    return [
+        str(int(initialize)),
+        str(int(log_messages)),
+        format_train_list(amplitudes),
+        format_train_list(widths),
+        ";".join("1" if m else "0" for m in measure),
+        format_train_list(bias_holds),
+        str(int(num_records)),
+        f"{bias_v:.6e}",
+        f"{i_range:.6e}",
+        f"{i_comp:.6e}",
+        "",
+        size,
+        "",
+        size,
+        "",
+        size,
+        "",
+        "",
+    ]
+
+
+def _parse_gp_values(resp: str) -> list[float]:
+    values = []
+    for part in resp.replace(";", ",").split(","):
+        part = part.strip()
+        if part:
+            try:
+                values.append(float(part))
+            except ValueError:
+                pass
+    return values
+
+
+def _open_instrument(resource: str):
+    import pyvisa
+
     rm = pyvisa.ResourceManager()
     inst = rm.open_resource(resource)
     inst.timeout = 30000  # ms
+    return inst
+
+
+def run_ul_over_gpib(resource: str, module_name: str, args: list[str]) -> str:
+    """
+    Send UL command over GPIB to the 4200A.
+    Sequence: UL -> EX <lib> <module>(args) -> DE
+    """
+    inst = _open_instrument(resource)
     # Enter UL mode
     inst.write("UL")
     time.sleep(0.05)
@@ -39,6 +166,67 @@ def run_ul_over_gpib(resource: str, module_name: str, args: list[str]) -> str:
     return resp
 
 
+def run_arrays_over_gpib(
+    resource: str,
+    module_name: str,
+    ul_args: list[str],
+    count_position: int,
+    arrays: dict[str, int],
+    size: int,
+    timeout_s: float = 600.0,
+) -> dict:
+    """
+    Run one array-returning module (train / engine) and read its outputs back with GP.
+    arrays maps result names to GP positions; each is trimmed to the count at count_position.
+    """
+    inst = _open_instrument(resource)
+    inst.timeout = int(timeout_s * 1000)  # whole run happens inside one EX
+    try:
+        inst.write("UL")
+        time.sleep(0.05)
+        inst.write(f"EX {LIB_NAME} {module_name}({','.join(ul_args)})")
+        resp = inst.read().strip()
+        try:
+            status = int(float(resp.split("=")[-1]))
+        except ValueError:
+            status = None
+        count = _parse_gp_values(inst.query(f"GP {count_position} 1"))
+        done = int(count[0]) if count else 0
+        result: dict = {"status": status}
+        for name, position in arrays.items():
+            result[name] = _parse_gp_values(inst.query(f"GP {position} {size}"))[:done] if done > 0 else []
+        return result
+    finally:
+        # Leave UL mode even if the EX read or a GP query times out
+        try:
+            inst.write("DE")
+            time.sleep(0.05)
+        finally:
+            inst.close()
+
+
+def run_train_over_gpib(resource: str, ul_args: list[str], num_pulses: int, timeout_s: float = 600.0) -> dict:
+    """Run SMU_pulse_train_craig; returns {"status", "resistance", "current"}."""
+    return run_arrays_over_gpib(
+        resource, "SMU_pulse_train_craig", ul_args, GP_TRAIN_COUNT,
+        {"resistance": GP_TRAIN_RESISTANCE, "current": GP_TRAIN_CURRENT},
+        num_pulses, timeout_s,
+    )
+
+
+def run_engine_over_gpib(resource: str, ul_args: list[str], timeout_s: float = 600.0) -> dict:
+    """Run SMU_pulse_engine_craig; returns {"status", "resistance", "current", "record"}."""
+    return run_arrays_over_gpib(
+        resource, "SMU_pulse_engine_craig", ul_args, GP_ENGINE_MEAS_COUNT,
+        {"resistance": GP_ENGINE_RESISTANCE, "current": GP_ENGINE_CURRENT, "record": GP_ENGINE_RECORD},
+        int(ul_args[GP_ENGINE_RESISTANCE]), timeout_s,
+    )
+
+
+def _float_list(text: str) -> list[float]:
+    return [float(v) for v in text.replace(";", ",").split(",") if v.strip()]
+
+
 def main():
     parser = argparse.ArgumentParser(description="Run SMU pulse modules with pre/post bias over GPIB")
     parser.add_argument("--biasV", type=float, default=0.2, help="Bias voltage (V) pre/post")
@@ -50,10 +238,57 @@ def main():
     parser.add_argument("--log", type=int, default=1, help="logMessages (0/1)")
     parser.add_argument("--init", type=int, default=1, help="initialize (0/1)")
     parser.add_argument("--gpib-address", default="GPIB0::17::INSTR", help="VISA resource string (e.g., GPIB0::17::INSTR)")
-    parser.add_argument("--mode", choices=["measure", "pulse"], default="measure",
-                        help="measure: SMU_pulse_measure_craig; pulse: SMU_pulse_only_craig")
+    parser.add_argument("--mode", choices=["measure", "pulse", "train", "engine"], default="measure",
+                        help="measure: SMU_pulse_measure_craig; pulse: SMU_pulse_only_craig; "
+                             "train: SMU_pulse_train_craig; engine: SMU_pulse_engine_craig")
+    parser.add_argument("--amplitudes", default=None,
+                        help="train/engine: comma list of amplitudes (V), repeated over --pulses (default --pulseV)")
+    parser.add_argument("--widths", default=None,
+                        help="train/engine: comma list of widths (s), repeated (default --pulseWidth)")
+    parser.add_argument("--holds", default=None,
+                        help="train/engine: comma list of bias holds (s), repeated, 0 = no bias step (default --biasHold)")
+    parser.add_argument("--pulses", type=int, default=1, help="train/engine: number of pulses (records)")
+    parser.add_argument("--measure", default="1",
+                        help="engine: comma list of measure flags (1/0), repeated, e.g. 0,0,0,1")
     args = parser.parse_args()
 
+    if args.mode == "engine":
+        ul_args = build_engine_args(
+            _float_list(args.amplitudes) if args.amplitudes else [args.pulseV],
+            _float_list(args.widths) if args.widths else [args.pulseWidth],
+            _float_list(args.measure),
+            _float_list(args.holds) if args.holds else [args.biasHold],
+            args.pulses,
+            bias_v=args.biasV,
+            i_range=args.iRange,
+            i_comp=args.iComp,
+            log_messages=args.log,
+            initialize=args.init,
+        )
+        result = run_engine_over_gpib(args.gpib_address, ul_args)
+        print(f"SMU_pulse_engine_craig status: {result['status']}, readings: {len(result['resistance'])}")
+        for k, r in zip(result["record"], result["resistance"]):
+            print(f"{int(k)}\t{r:.6e}")
+        return
+
+    if args.mode == "train":
+        ul_args = build_train_args(
+            _float_list(args.amplitudes) if args.amplitudes else [args.pulseV],
+            _float_list(args.widths) if args.widths else [args.pulseWidth],
+            _float_list(args.holds) if args.holds else [args.biasHold],
+            args.pulses,
+            bias_v=args.biasV,
+            i_range=args.iRange,
+            i_comp=args.iComp,
+            log_messages=args.log,
+            initialize=args.init,
+        )
+        result = run_train_over_gpib(args.gpib_address, ul_args, args.pulses)
+        print(f"SMU_pulse_train_craig status: {result['status']}, pulses: {len(result['resistance'])}")
+        for k, r in enumerate(result["resistance"]):
+            print(f"{k}\t{r:.6e}")
+        return
+
     if args.mode == "measure":
         module = "SMU_pulse_measure_craig"
         # initialize, logMessages, widthTime, Amplitude, Irange, Icomp, biasV, biasHold, measResistance(out)
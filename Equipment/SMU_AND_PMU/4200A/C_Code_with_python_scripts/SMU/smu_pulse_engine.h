@@ -0,0 +1,205 @@
+/* Shared SMU pulse engine for the a_SMU_Pulse modules.
+ * Include from USRLIB modules only (SMU_pulse_engine_craig.c, etc.).
+ *
+ * A schedule is NumRecords pulse records. Record k takes its amplitude,
+ * width, measure flag and bias hold from four short lists, each indexed
+ * cyclically (value[k % length]), so
+ *
+ *   Amplitudes 1.5;-1.5   Measure 1          -> SET/RESET pairs, R after each
+ *   Amplitudes 1.5;0.2    Measure 0;1        -> program, then read pulse
+ *   Measure 0;0;0;0;1     BiasHolds 0        -> program 4 times, read once,
+ *                                               pulses back to back
+ *
+ * Each record is: pulsev(biasV, hold) if hold > 0, then mpulse() when the
+ * record measures or pulsev() when it does not. Readings are packed into the
+ * output arrays in order (one per measured record) and read back by the host
+ * once at the end, so unmeasured pulses cost no LPTLib readback at all. */
+
+#ifndef SMU_PULSE_ENGINE_H
+#define SMU_PULSE_ENGINE_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SMU_PULSE_MAX_LIST 4096
+
+/* SMU rise time used by the slew-rate check (500 us/V limit) */
+#define SMU_PULSE_RISE_TIME 1e-7
+/* Minimum pulse / hold width */
+#define SMU_PULSE_MIN_WIDTH 2e-8
+
+/* Return codes (SLEW_RATE_ERROR comes from nvm.h) */
+#define SMU_PULSE_OK 0
+#define SMU_PULSE_ERR_LIST -2      /* empty or unreadable list */
+#define SMU_PULSE_ERR_SIZE -3      /* output arrays too small */
+#define SMU_PULSE_ERR_MEMORY -4    /* schedule allocation failed */
+#define SMU_PULSE_ERR_PULSE -6     /* pulsev/mpulse failed part way */
+
+typedef struct
+{
+  double amplitude[SMU_PULSE_MAX_LIST];
+  double width[SMU_PULSE_MAX_LIST];
+  double measure[SMU_PULSE_MAX_LIST];
+  double hold[SMU_PULSE_MAX_LIST];
+  int n_amplitude;
+  int n_width;
+  int n_measure;
+  int n_hold;
+} smu_pulse_schedule;
+
+/* Parse a ';', ',' or space separated list; returns the number of values */
+static inline int smu_pulse_list_parse(const char *str, double *array, int max_size)
+{
+  char *copy;
+  char *token;
+  int count = 0;
+
+  if (str == NULL || array == NULL || max_size <= 0)
+    return 0;
+
+  copy = (char *)calloc(strlen(str) + 1, sizeof(char));
+  if (copy == NULL)
+    return 0;
+  strcpy(copy, str);
+
+  token = strtok(copy, ",; ");
+  while (token != NULL && count < max_size)
+  {
+    array[count++] = strtod(token, NULL);
+    token = strtok(NULL, ",; ");
+  }
+
+  free(copy);
+  return count;
+}
+
+/* Fill a schedule from the four lists. Measure may be NULL (every record
+ * measures). Returns SMU_PULSE_OK, SMU_PULSE_ERR_LIST or SLEW_RATE_ERROR. */
+static inline int smu_pulse_schedule_parse(smu_pulse_schedule *s, const char *amplitudes,
+                                           const char *widths, const char *measure,
+                                           const char *holds)
+{
+  int i;
+
+  s->n_amplitude = smu_pulse_list_parse(amplitudes, s->amplitude, SMU_PULSE_MAX_LIST);
+  s->n_width = smu_pulse_list_parse(widths, s->width, SMU_PULSE_MAX_LIST);
+  s->n_hold = smu_pulse_list_parse(holds, s->hold, SMU_PULSE_MAX_LIST);
+  if (measure != NULL)
+  {
+    s->n_measure = smu_pulse_list_parse(measure, s->measure, SMU_PULSE_MAX_LIST);
+  }
+  else
+  {
+    s->measure[0] = 1.0;
+    s->n_measure = 1;
+  }
+  if (s->n_amplitude < 1 || s->n_width < 1 || s->n_measure < 1 || s->n_hold < 1)
+    return SMU_PULSE_ERR_LIST;
+
+  /* Check if risetime violates slew rate of 500us/V */
+  for (i = 0; i < s->n_amplitude; i++)
+  {
+    if (SMU_PULSE_RISE_TIME > fabs(s->amplitude[i] * .0005))
+      return SLEW_RATE_ERROR;
+  }
+
+  /* make sure minimum widths are 20 ns; a hold of 0 means no bias step */
+  for (i = 0; i < s->n_width; i++)
+  {
+    if (s->width[i] < SMU_PULSE_MIN_WIDTH)
+      s->width[i] = SMU_PULSE_MIN_WIDTH;
+  }
+  for (i = 0; i < s->n_hold; i++)
+  {
+    if (s->hold[i] < 0.0)
+      s->hold[i] = 0.0;
+    else if (s->hold[i] > 0.0 && s->hold[i] < SMU_PULSE_MIN_WIDTH)
+      s->hold[i] = SMU_PULSE_MIN_WIDTH;
+  }
+  return SMU_PULSE_OK;
+}
+
+/* Number of measured records in the first num_records of the schedule */
+static inline int smu_pulse_schedule_count_measured(const smu_pulse_schedule *s, int num_records)
+{
+  int k, n = 0;
+
+  for (k = 0; k < num_records; k++)
+  {
+    if (s->measure[k % s->n_measure] != 0.0)
+      n++;
+  }
+  return n;
+}
+
+/* One-time SMU setup for a pulse run: limit indicator mode, compliance, range.
+ * Irange above 10 mA is raised to 0.2 A as in the single-pulse modules. */
+static inline void smu_pulse_setup(int smu, double Irange, double Icomp)
+{
+  setmode(smu, KI_LIM_MODE, KI_VALUE); /* return the actual value when in limit or over range */
+
+  if (fabs(Irange) > 0.01)
+    Irange = 0.2;
+  if (Icomp != 0.0)
+    limiti(smu, Icomp);
+  if (Irange != 0.0)
+    rangei(smu, Irange);
+}
+
+/* Run num_records records back to back. Measured records append Vsat/Isat
+ * and Isat to resistance[]/current[] and the record index to record[]
+ * (record may be NULL); max_meas is the output capacity. num_done and
+ * num_meas report progress, also on failure (the SMU is returned to biasV).
+ * A final bias hold follows the last record if its hold is non-zero. */
+static inline int smu_pulse_run(int smu, const smu_pulse_schedule *s, int num_records, double biasV,
+                                double *resistance, double *current, double *record, int max_meas,
+                                int *num_done, int *num_meas)
+{
+  int k;
+  double a, w, h = 0.0;
+  double vsat, isat;
+
+  *num_done = 0;
+  *num_meas = 0;
+  if (smu_pulse_schedule_count_measured(s, num_records) > max_meas)
+    return SMU_PULSE_ERR_SIZE;
+
+  for (k = 0; k < num_records; k++)
+  {
+    a = s->amplitude[k % s->n_amplitude];
+    w = s->width[k % s->n_width];
+    h = s->hold[k % s->n_hold];
+
+    if (h > 0.0)
+      pulsev(smu, biasV, h);
+
+    if (s->measure[k % s->n_measure] != 0.0)
+    {
+      if (mpulse(smu, a, w, &vsat, &isat) != 0)
+      {
+        pulsev(smu, biasV, h > 0.0 ? h : SMU_PULSE_MIN_WIDTH);
+        return SMU_PULSE_ERR_PULSE;
+      }
+      resistance[*num_meas] = vsat / isat;
+      current[*num_meas] = isat;
+      if (record != NULL)
+        record[*num_meas] = (double)k;
+      (*num_meas)++;
+    }
+    else if (pulsev(smu, a, w) != 0)
+    {
+      pulsev(smu, biasV, h > 0.0 ? h : SMU_PULSE_MIN_WIDTH);
+      return SMU_PULSE_ERR_PULSE;
+    }
+    *num_done = k + 1;
+  }
+
+  /* post-bias hold after the last record */
+  if (h > 0.0)
+    pulsev(smu, biasV, h);
+
+  return SMU_PULSE_OK;
+}
+
+#endif /* SMU_PULSE_ENGINE_H */
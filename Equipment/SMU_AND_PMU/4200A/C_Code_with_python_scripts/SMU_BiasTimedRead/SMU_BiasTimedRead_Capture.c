@@ -0,0 +1,346 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: SMU_BiasTimedRead_Capture
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 20
+	ARGUMENTS:
+		Vforce,	double,	Input,	0.2,	-200,	200
+		Duration_s,	double,	Input,	60.0,	0.001,	86400
+		SampleInterval_s,	double,	Input,	0.01,	0.001,	10.0
+		Ilimit,	double,	Input,	0.0001,	1e-9,	1.0
+		Irange_A,	double,	Input,	0.0,	0.0,	1.0
+		TriggerMode,	int,	Input,	0,	0,	1
+		TriggerLevel,	double,	Input,	1e-5,	0.0,	1e6
+		PreTrigger,	int,	Input,	200,	0,	99999
+		PostTrigger,	int,	Input,	200,	0,	99999
+		Imeas,	D_ARRAY_T,	Output,	,	,
+		NumPoints,	int,	Input,	401,	1,	100000
+		Timestamps,	D_ARRAY_T,	Output,	,	,
+		NumPointsTimestamps,	int,	Input,	401,	1,	100000
+		SummaryI,	D_ARRAY_T,	Output,	,	,
+		NumSummary,	int,	Input,	500,	2,	100000
+		SummaryT,	D_ARRAY_T,	Output,	,	,
+		NumSummaryT,	int,	Input,	500,	2,	100000
+		TriggerIndex,	int *,	Output,	,	,
+		NumPointsOut,	int *,	Output,	,	,
+		NumSummaryOut,	int *,	Output,	,	,
+	INCLUDES:
+#include "keithley.h"
+#include <math.h>
+#include <Windows.h>
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+
+SMU Bias Timed Read - Triggered Capture
+=======================================
+
+Constant-voltage stress with event capture. Applies Vforce and samples current
+every SampleInterval_s for up to Duration_s, but only keeps the samples around
+the first trigger event plus a low-rate summary of the whole run, instead of
+returning every sample.
+
+Pattern: forcev(Vforce) -> sample into a PreTrigger+1 ring until the trigger
+        fires -> record PostTrigger more samples -> forcev(0)
+
+- Vforce, Ilimit, Irange_A: as SMU_BiasTimedRead
+- Duration_s: Maximum time to wait for the trigger (s). The post-trigger
+              window is always completed once the trigger has fired.
+- SampleInterval_s: Target time between samples (s), minimum 0.001
+- TriggerMode: 0 = |I| >= TriggerLevel (A)
+               1 = |dI/dt| >= TriggerLevel (A/s) between consecutive samples
+- PreTrigger: Samples kept before the trigger sample
+- PostTrigger: Samples recorded after the trigger sample
+- Imeas/Timestamps: Event window, oldest first: up to PreTrigger samples, the
+              trigger sample at Imeas[TriggerIndex], then PostTrigger samples.
+              NumPoints must be >= PreTrigger + 1 + PostTrigger.
+- SummaryI/SummaryT: Block mean of I (and time of the block's last sample)
+              over the whole run. Starts with one point per sample; each time
+              the array fills, neighbouring points are merged and the block
+              length doubles, so any run length fits NumSummary points.
+- TriggerIndex: Index of the trigger sample in Imeas, -1 if no trigger within
+              Duration_s (Imeas then holds the last PreTrigger + 1 samples)
+- NumPointsOut: Valid samples in Imeas/Timestamps
+- NumSummaryOut: Valid points in SummaryI/SummaryT
+
+Return codes: 0 = OK, -1 = invalid params, -5 = forcev failed, -6 = measi failed, -7 = limiti failed
+
+END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include <math.h>
+#include <Windows.h>
+
+/* Rotate a[0..n-1] left by k in place (three reversals) */
+static void rotate_left( double *a, int n, int k )
+{
+int lo, hi;
+double tmp;
+int bounds[3][2];
+int r;
+
+if ( n <= 1 || k <= 0 || k >= n )
+    return;
+bounds[0][0] = 0;  bounds[0][1] = k - 1;
+bounds[1][0] = k;  bounds[1][1] = n - 1;
+bounds[2][0] = 0;  bounds[2][1] = n - 1;
+for ( r = 0; r < 3; r++ )
+{
+    for ( lo = bounds[r][0], hi = bounds[r][1]; lo < hi; lo++, hi-- )
+    {
+        tmp = a[lo];
+        a[lo] = a[hi];
+        a[hi] = tmp;
+    }
+}
+}
+
+/* USRLIB MODULE MAIN FUNCTION */
+int SMU_BiasTimedRead_Capture( double Vforce, double Duration_s, double SampleInterval_s, double Ilimit, double Irange_A, int TriggerMode, double TriggerLevel, int PreTrigger, int PostTrigger, double *Imeas, int NumPoints, double *Timestamps, int NumPointsTimestamps, double *SummaryI, int NumSummary, double *SummaryT, int NumSummaryT, int *TriggerIndex, int *NumPointsOut, int *NumSummaryOut )
+{
+/* USRLIB MODULE CODE */
+/* Triggered capture
+
+--------------
+
+Before the trigger, Imeas[0..PreTrigger] is a ring: sample n goes to slot
+n % (PreTrigger + 1). When the trigger fires the ring is rotated in place so
+the oldest sample is first, and post-trigger samples are appended after it.
+The summary is filled alongside from every sample.
+
+*/
+
+int i, status;
+int ring_size, slot, count;
+int summary_cap, summary_n, block_len, block_n;
+int check_interval_ms;
+int triggered;
+long n;
+LARGE_INTEGER freq, start_time, current_time;
+double time_elapsed_s;
+double next_sample_target_s;
+double current, prev_current, prev_time;
+double last_sample_s;
+double block_sum;
+
+*TriggerIndex = -1;
+*NumPointsOut = 0;
+*NumSummaryOut = 0;
+
+/* Validate input parameters */
+if ( Duration_s <= 0.0 || Duration_s > 86400.0 )
+{
+    return( -1 );  /* Invalid duration */
+}
+if ( SampleInterval_s < 0.001 )
+{
+    SampleInterval_s = 0.001;  /* Minimum 1 ms for Sleep() */
+}
+if ( SampleInterval_s > 10.0 )
+{
+    return( -1 );  /* Invalid sample interval */
+}
+if ( TriggerMode < 0 || TriggerMode > 1 || TriggerLevel < 0.0 )
+{
+    return( -1 );  /* Invalid trigger */
+}
+if ( PreTrigger < 0 || PostTrigger < 0 )
+{
+    return( -1 );  /* Invalid window */
+}
+if ( NumPoints < 1 || NumPoints > 100000 || NumPointsTimestamps != NumPoints )
+{
+    return( -1 );  /* Invalid NumPoints / Timestamps size */
+}
+if ( NumPoints < PreTrigger + 1 + PostTrigger )
+{
+    return( -1 );  /* Event window does not fit */
+}
+if ( NumSummary < 2 || NumSummaryT != NumSummary )
+{
+    return( -1 );  /* Invalid summary size */
+}
+
+check_interval_ms = (int)(SampleInterval_s * 1000.0 + 0.5);
+if ( check_interval_ms < 1 ) check_interval_ms = 1;
+if ( check_interval_ms > 10 ) check_interval_ms = 10;
+
+for ( i = 0; i < NumPoints; i++ )
+{
+    Imeas[i] = 0.0;
+    Timestamps[i] = 0.0;
+}
+for ( i = 0; i < NumSummary; i++ )
+{
+    SummaryI[i] = 0.0;
+    SummaryT[i] = 0.0;
+}
+
+QueryPerformanceFrequency(&freq);
+if ( freq.QuadPart == 0 )
+{
+    freq.QuadPart = 1000;  /* Assume 1 ms resolution */
+}
+
+status = limiti(SMU1, Ilimit);
+if ( status != 0 )
+{
+    forcev(SMU1, 0.0);
+    return( -7 );  /* limiti failed */
+}
+
+if ( Irange_A > 0.0 )
+{
+    double irange = Irange_A;
+    if ( irange > Ilimit )
+        irange = Ilimit;   /* Do not set range above compliance */
+    status = rangei(SMU1, irange);
+    /* Ignore rangei failure; instrument may not support or may use auto-range */
+}
+
+status = setmode(SMU1, KI_INTGPLC, 0.01);
+
+status = forcev(SMU1, Vforce);
+if ( status != 0 )
+{
+    forcev(SMU1, 0.0);
+    return( -5 );  /* forcev failed */
+}
+
+QueryPerformanceCounter(&start_time);
+
+ring_size = PreTrigger + 1;
+summary_cap = NumSummary & ~1;  /* Even, so merging pairs never leaves a half block */
+summary_n = 0;
+block_len = 1;
+block_n = 0;
+block_sum = 0.0;
+triggered = 0;
+count = 0;
+prev_current = 0.0;
+prev_time = 0.0;
+last_sample_s = 0.0;
+
+for ( n = 0; ; n++ )
+{
+    /* Wait for the next sample slot (first sample immediately) */
+    next_sample_target_s = (double)n * SampleInterval_s;
+    while ( 1 )
+    {
+        QueryPerformanceCounter(&current_time);
+        time_elapsed_s = (double)(current_time.QuadPart - start_time.QuadPart) / (double)freq.QuadPart;
+        if ( time_elapsed_s >= next_sample_target_s )
+            break;
+        Sleep(check_interval_ms);
+    }
+
+    /* No trigger within Duration_s: stop with the pre-trigger ring only */
+    if ( !triggered && time_elapsed_s >= Duration_s )
+        break;
+
+    status = measi(SMU1, &current);
+    if ( status != 0 )
+    {
+        forcev(SMU1, 0.0);
+        return( -6 );  /* measi failed */
+    }
+    last_sample_s = time_elapsed_s;
+
+    /* Summary: block means, merge pairs and double the block when full */
+    block_sum += current;
+    block_n++;
+    if ( block_n == block_len )
+    {
+        if ( summary_n == summary_cap )
+        {
+            for ( i = 0; i < summary_cap / 2; i++ )
+            {
+                SummaryI[i] = 0.5 * (SummaryI[2 * i] + SummaryI[2 * i + 1]);
+                SummaryT[i] = SummaryT[2 * i + 1];
+            }
+            summary_n = summary_cap / 2;
+            block_len *= 2;
+            /* Current block is half the new length: keep accumulating */
+        }
+        if ( block_n == block_len )
+        {
+            SummaryI[summary_n] = block_sum / block_len;
+            SummaryT[summary_n] = time_elapsed_s;
+            summary_n++;
+            block_sum = 0.0;
+            block_n = 0;
+        }
+    }
+
+    if ( triggered )
+    {
+        Imeas[count] = current;
+        Timestamps[count] = time_elapsed_s;
+        count++;
+        if ( count >= ring_size + PostTrigger )
+            break;
+        continue;
+    }
+
+    slot = (int)(n % ring_size);
+    Imeas[slot] = current;
+    Timestamps[slot] = time_elapsed_s;
+
+    if ( TriggerMode == 0 )
+    {
+        triggered = ( fabs(current) >= TriggerLevel );
+    }
+    else if ( n > 0 && time_elapsed_s > prev_time )
+    {
+        triggered = ( fabs(current - prev_current) / (time_elapsed_s - prev_time) >= TriggerLevel );
+    }
+    prev_current = current;
+    prev_time = time_elapsed_s;
+
+    if ( triggered )
+    {
+        /* Unroll the ring so the oldest sample is first and the trigger sample last */
+        count = ( n + 1 < ring_size ) ? (int)(n + 1) : ring_size;
+        if ( n + 1 > ring_size )
+        {
+            rotate_left(Imeas, ring_size, (int)((n + 1) % ring_size));
+            rotate_left(Timestamps, ring_size, (int)((n + 1) % ring_size));
+        }
+        *TriggerIndex = count - 1;
+        if ( PostTrigger == 0 )
+            break;
+    }
+}
+
+if ( !triggered )
+{
+    count = ( n < ring_size ) ? (int)n : ring_size;
+    if ( n > ring_size )
+    {
+        rotate_left(Imeas, ring_size, (int)(n % ring_size));
+        rotate_left(Timestamps, ring_size, (int)(n % ring_size));
+    }
+}
+
+/* Partial last block (shorter than block_len) */
+if ( block_n > 0 && summary_n < NumSummary )
+{
+    SummaryI[summary_n] = block_sum / block_n;
+    SummaryT[summary_n] = last_sample_s;
+    summary_n++;
+}
+
+*NumPointsOut = count;
+*NumSummaryOut = summary_n;
+
+/* Ramp to 0 V and leave output safe */
+status = forcev(SMU1, 0.0);
+if ( status != 0 )
+{
+    return( -5 );
+}
+
+return( 0 ); /* Returns zero if execution Ok.*/
+
+/* USRLIB MODULE END  */
+} 		/* End SMU_BiasTimedRead_Capture.c */
@@ -0,0 +1,214 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: SMU_BiasTimedRead_Log
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 14
+	ARGUMENTS:
+		Vread,	double,	Input,	0.2,	-200,	200
+		StartTime_s,	double,	Input,	0.01,	0.001,	100000
+		EndTime_s,	double,	Input,	10000,	0.001,	1000000
+		PointsPerDecade,	int,	Input,	10,	1,	1000
+		Ilimit,	double,	Input,	0.0001,	1e-9,	1.0
+		Irange_A,	double,	Input,	0.0,	0.0,	1.0
+		ReadMode,	int,	Input,	0,	0,	1
+		ReadWidth_s,	double,	Input,	0.005,	0.001,	10.0
+		IdleV,	double,	Input,	0.0,	-200,	200
+		Imeas,	D_ARRAY_T,	Output,	,	,
+		NumPoints,	int,	Input,	61,	1,	100000
+		Timestamps,	D_ARRAY_T,	Output,	,	,
+		NumPointsTimestamps,	int,	Input,	61,	1,	100000
+		NumPointsOut,	int *,	Output,	,	,
+	INCLUDES:
+#include "keithley.h"
+#include <math.h>
+#include <Windows.h>
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+
+SMU Bias Timed Read - Log-spaced retention read
+===============================================
+
+Reads current on a logarithmic time schedule for retention tests, so early
+times are well resolved and a multi-hour run stays at a few hundred points.
+
+Schedule: t_k = StartTime_s * 10^(k / PointsPerDecade), k = 0, 1, ... while
+t_k <= EndTime_s, measured from the start of the module (call it straight
+after programming the device). Count = floor(PointsPerDecade *
+log10(EndTime_s / StartTime_s)) + 1; NumPoints must be at least that.
+If a target is already past (dense early points shorter than a
+measurement), the sample is taken immediately; Timestamps always holds the
+actual time.
+
+- Vread: Read voltage (V)
+- StartTime_s, EndTime_s, PointsPerDecade: Schedule (s, s, points/decade)
+- Ilimit, Irange_A: as SMU_BiasTimedRead
+- ReadMode: 0 = Vread held for the whole run (continuous bias)
+            1 = pulsed read: IdleV between samples, Vread applied ReadWidth_s
+                before each sample time and removed after the measurement,
+                so the read duty cycle falls as the spacing grows
+- ReadWidth_s: Settle time at Vread before measi in pulsed mode (s)
+- IdleV: Voltage between reads in pulsed mode (normally 0 V)
+- Imeas, Timestamps: Currents (A) and actual sample times (s)
+- NumPointsOut: Number of samples taken
+
+Return codes: 0 = OK, -1 = invalid params, -5 = forcev failed, -6 = measi failed, -7 = limiti failed
+
+END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include <math.h>
+#include <Windows.h>
+
+static double elapsed_s( LARGE_INTEGER *start, LARGE_INTEGER *freq )
+{
+LARGE_INTEGER now;
+
+QueryPerformanceCounter(&now);
+return (double)(now.QuadPart - start->QuadPart) / (double)freq->QuadPart;
+}
+
+/* Sleep until target_s: coarse Sleep while far away, 1 ms steps near the end */
+static void wait_until( double target_s, LARGE_INTEGER *start, LARGE_INTEGER *freq )
+{
+double remaining;
+
+while ( (remaining = target_s - elapsed_s(start, freq)) > 0.0 )
+{
+    if ( remaining > 0.02 )
+        Sleep((DWORD)((remaining - 0.01) * 1000.0));
+    else
+        Sleep(1);
+}
+}
+
+/* USRLIB MODULE MAIN FUNCTION */
+int SMU_BiasTimedRead_Log( double Vread, double StartTime_s, double EndTime_s, int PointsPerDecade, double Ilimit, double Irange_A, int ReadMode, double ReadWidth_s, double IdleV, double *Imeas, int NumPoints, double *Timestamps, int NumPointsTimestamps, int *NumPointsOut )
+{
+/* USRLIB MODULE CODE */
+int i, status;
+int num_samples;
+LARGE_INTEGER freq, start_time;
+double target_s;
+
+*NumPointsOut = 0;
+
+/* Validate input parameters */
+if ( StartTime_s < 0.001 || EndTime_s < StartTime_s || EndTime_s > 1000000.0 )
+{
+    return( -1 );  /* Invalid schedule */
+}
+if ( PointsPerDecade < 1 || PointsPerDecade > 1000 )
+{
+    return( -1 );  /* Invalid points per decade */
+}
+if ( ReadMode < 0 || ReadMode > 1 )
+{
+    return( -1 );  /* Invalid read mode */
+}
+if ( ReadWidth_s < 0.001 )
+{
+    ReadWidth_s = 0.001;  /* Minimum 1 ms for Sleep() */
+}
+if ( NumPointsTimestamps != NumPoints )
+{
+    return( -1 );  /* Timestamps array size must match NumPoints */
+}
+
+/* Small epsilon so an exact decade end point is included */
+num_samples = (int)floor(PointsPerDecade * log10(EndTime_s / StartTime_s) + 1e-9) + 1;
+if ( NumPoints < num_samples )
+{
+    return( -1 );  /* Arrays too small for the schedule */
+}
+
+for ( i = 0; i < NumPoints; i++ )
+{
+    Imeas[i] = 0.0;
+    Timestamps[i] = 0.0;
+}
+
+QueryPerformanceFrequency(&freq);
+if ( freq.QuadPart == 0 )
+{
+    freq.QuadPart = 1000;  /* Assume 1 ms resolution */
+}
+
+status = limiti(SMU1, Ilimit);
+if ( status != 0 )
+{
+    forcev(SMU1, 0.0);
+    return( -7 );  /* limiti failed */
+}
+
+if ( Irange_A > 0.0 )
+{
+    double irange = Irange_A;
+    if ( irange > Ilimit )
+        irange = Ilimit;   /* Do not set range above compliance */
+    status = rangei(SMU1, irange);
+    /* Ignore rangei failure; instrument may not support or may use auto-range */
+}
+
+status = setmode(SMU1, KI_INTGPLC, 0.01);
+
+status = forcev(SMU1, (ReadMode == 0) ? Vread : IdleV);
+if ( status != 0 )
+{
+    forcev(SMU1, 0.0);
+    return( -5 );  /* forcev failed */
+}
+
+QueryPerformanceCounter(&start_time);
+
+for ( i = 0; i < num_samples; i++ )
+{
+    target_s = StartTime_s * pow(10.0, (double)i / PointsPerDecade);
+
+    if ( ReadMode == 1 )
+    {
+        /* Bias on only for the read window */
+        wait_until(target_s - ReadWidth_s, &start_time, &freq);
+        status = forcev(SMU1, Vread);
+        if ( status != 0 )
+        {
+            forcev(SMU1, 0.0);
+            *NumPointsOut = i;
+            return( -5 );
+        }
+    }
+
+    wait_until(target_s, &start_time, &freq);
+    Timestamps[i] = elapsed_s(&start_time, &freq);
+    status = measi(SMU1, &Imeas[i]);
+    if ( status != 0 )
+    {
+        forcev(SMU1, 0.0);
+        *NumPointsOut = i;
+        return( -6 );  /* measi failed */
+    }
+
+    if ( ReadMode == 1 )
+    {
+        status = forcev(SMU1, IdleV);
+        if ( status != 0 )
+        {
+            forcev(SMU1, 0.0);
+            *NumPointsOut = i + 1;
+            return( -5 );
+        }
+    }
+}
+*NumPointsOut = num_samples;
+
+/* Ramp to 0 V and leave output safe */
+status = forcev(SMU1, 0.0);
+if ( status != 0 )
+{
+    return( -5 );
+}
+
+return( 0 ); /* Returns zero if execution Ok.*/
+
+/* USRLIB MODULE END  */
+} 		/* End SMU_BiasTimedRead_Log.c */
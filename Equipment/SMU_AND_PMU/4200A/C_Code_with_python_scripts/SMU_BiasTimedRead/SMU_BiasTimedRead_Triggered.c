@@ -0,0 +1,305 @@
+/* USRLIB MODULE INFORMATION
+
+	MODULE NAME: SMU_BiasTimedRead_Triggered
+	MODULE RETURN TYPE: int
+	NUMBER OF PARMS: 18
+	ARGUMENTS:
+		Vforce,	double,	Input,	0.2,	-200,	200
+		Duration_s,	double,	Input,	10.0,	0.001,	3600
+		SampleInterval_s,	double,	Input,	0.02,	0.001,	10.0
+		Ilimit,	double,	Input,	0.0001,	1e-9,	1.0
+		Irange_A,	double,	Input,	0.0,	0.0,	1.0
+		TriggerSource,	int,	Input,	1,	0,	1
+		PMU_ID,	char *,	Input,	"PMU1",	,
+		TrigChannel,	int,	Input,	2,	1,	2
+		TrigOffset_s,	double,	Input,	0.1,	0.0,	40.0
+		TrigVhigh,	double,	Input,	5.0,	-40,	40
+		TrigWidth_s,	double,	Input,	1e-3,	20e-9,	1.0
+		TrigVRange,	double,	Input,	10,	5,	40
+		Imeas,	D_ARRAY_T,	Output,	,	,
+		NumPoints,	int,	Input,	500,	1,	100000
+		Timestamps,	D_ARRAY_T,	Output,	,	,
+		NumPointsTimestamps,	int,	Input,	500,	1,	100000
+		ExecLatency_s,	double *,	Output,	,	,
+		NumPointsOut,	int *,	Output,	,	,
+	INCLUDES:
+#include "keithley.h"
+#include "rpm_pathway.h"
+#include <Windows.h>
+	END USRLIB MODULE INFORMATION
+*/
+/* USRLIB MODULE HELP DESCRIPTION
+
+SMU Bias Timed Read - Triggered (bias, laser trigger and sampling in one call)
+=============================================================================
+
+Replaces the Start -> host -> Collect round trip for optical+read tests. The
+laser is fired by the PMU instead of by the host, so its time relative to the
+current samples no longer depends on GPIB latency.
+
+Pattern: forcev(Vforce) -> pulse_exec (PMU pulse at TrigOffset_s) -> sample
+        current for Duration_s (max NumPoints samples) -> forcev(0)
+
+The PMU channel TrigChannel plays one seg_arb pulse: 0 V for TrigOffset_s,
+then TrigVhigh for TrigWidth_s. The PMU TRIGGER OUT is set on the rising
+edge segment only (high for its 100 ns), so the laser can be triggered from
+either the channel output or the trigger output at TrigOffset_s.
+
+- Vforce, Duration_s, SampleInterval_s, Ilimit, Irange_A: as SMU_BiasTimedRead
+- TriggerSource: 0 = no trigger (t = 0 at bias on, same as SMU_BiasTimedRead)
+                 1 = PMU pulse (t = 0 when pulse_exec returns)
+- PMU_ID, TrigChannel: PMU card and channel driving the laser
+- TrigOffset_s: Time from PMU start to the trigger edge (s), 0 to 40
+- TrigVhigh, TrigWidth_s, TrigVRange: Trigger pulse level, width and PMU range
+- Imeas, Timestamps: Current samples and their times (s)
+- ExecLatency_s: Time pulse_exec took to return. The PMU starts within this
+                 window, so the trigger edge is at TrigOffset_s on the
+                 Timestamps axis to within ExecLatency_s (0 for TriggerSource 0).
+- NumPointsOut: Number of samples taken
+
+Return codes: 0 = OK, -1 = invalid params, -5 = forcev failed, -6 = measi failed,
+              -7 = limiti failed, -8 = PMU not found, -9 = PMU setup failed,
+              -10 = pulse_exec failed
+
+END USRLIB MODULE HELP DESCRIPTION */
+/* USRLIB MODULE PARAMETER LIST */
+#include "keithley.h"
+#include "rpm_pathway.h"
+#include <Windows.h>
+
+#define TRIG_SEGMENTS 5
+#define TRIG_MIN_SEG_S 20e-9     /* seg_arb minimum segment time */
+#define TRIG_EDGE_S 100e-9
+#define TRIG_TAIL_S 1e-6
+#define TRIG_WAIT_MARGIN_S 0.1   /* end-of-test wait beyond the programmed pulse */
+
+/* One-shot trigger pulse on a PMU channel: wait, rise, high, fall, tail */
+static int trigger_pulse_setup( int pulserId, int ch, double offset_s, double vhigh, double width_s, double vrange )
+{
+double startv[TRIG_SEGMENTS], stopv[TRIG_SEGMENTS], segtime[TRIG_SEGMENTS];
+double measstart[TRIG_SEGMENTS], measstop[TRIG_SEGMENTS];
+long trig[TRIG_SEGMENTS], ssr[TRIG_SEGMENTS], meastype[TRIG_SEGMENTS];
+long seqList[1] = {1};
+double loopCount[1] = {1.0};
+int k, status;
+
+startv[0] = 0.0;    stopv[0] = 0.0;    segtime[0] = ( offset_s > TRIG_MIN_SEG_S ) ? offset_s : TRIG_MIN_SEG_S;
+startv[1] = 0.0;    stopv[1] = vhigh;  segtime[1] = TRIG_EDGE_S;
+startv[2] = vhigh;  stopv[2] = vhigh;  segtime[2] = width_s;
+startv[3] = vhigh;  stopv[3] = 0.0;    segtime[3] = TRIG_EDGE_S;
+startv[4] = 0.0;    stopv[4] = 0.0;    segtime[4] = TRIG_TAIL_S;
+for ( k = 0; k < TRIG_SEGMENTS; k++ )
+{
+    trig[k] = ( k == 1 ) ? 1 : 0;  /* TRIGGER OUT on the rising edge only */
+    ssr[k] = 1;
+    meastype[k] = 0;
+    measstart[k] = 0.0;
+    measstop[k] = 0.0;
+}
+
+rpm_pathway_set(pulserId, ch, KI_RPM_PULSE);  /* No RPM on a direct connection: ignore */
+
+status = pg2_init(pulserId, PULSE_MODE_SARB);
+if ( status ) return status;
+status = pulse_load(pulserId, ch, 1e6);
+if ( status ) return status;
+status = pulse_ranges(pulserId, ch, vrange, PULSE_MEAS_FIXED, vrange, PULSE_MEAS_FIXED, 0.01);
+if ( status ) return status;
+status = pulse_burst_count(pulserId, ch, 1);
+if ( status ) return status;
+status = pulse_output(pulserId, ch, 1);
+if ( status ) return status;
+status = seg_arb_sequence(pulserId, ch, 1, TRIG_SEGMENTS, startv, stopv, segtime, trig, ssr, meastype, measstart, measstop);
+if ( status ) return status;
+return seg_arb_waveform(pulserId, ch, 1, seqList, loopCount);
+}
+
+/* USRLIB MODULE MAIN FUNCTION */
+int SMU_BiasTimedRead_Triggered( double Vforce, double Duration_s, double SampleInterval_s, double Ilimit, double Irange_A, int TriggerSource, char *PMU_ID, int TrigChannel, double TrigOffset_s, double TrigVhigh, double TrigWidth_s, double TrigVRange, double *Imeas, int NumPoints, double *Timestamps, int NumPointsTimestamps, double *ExecLatency_s, int *NumPointsOut )
+{
+/* USRLIB MODULE CODE */
+/* Bias + trigger + read
+
+--------------
+
+The PMU is fully configured before the bias is applied, so the only work
+between bias on and the first sample is pulse_exec(). Time zero is taken when
+pulse_exec returns; the trigger edge then sits at TrigOffset_s on the same
+clock as the samples.
+
+*/
+
+int i, status;
+int check_interval_ms;
+int pulserId = -1;
+LARGE_INTEGER freq, start_time, current_time, exec_start;
+double time_elapsed_s;
+double next_sample_target_s;
+double trig_end_s;
+double t;
+
+*ExecLatency_s = 0.0;
+*NumPointsOut = 0;
+
+/* Validate input parameters */
+if ( Duration_s <= 0.0 || Duration_s > 3600.0 )
+{
+    return( -1 );  /* Invalid duration */
+}
+if ( SampleInterval_s < 0.001 )
+{
+    SampleInterval_s = 0.001;  /* Minimum 1 ms for Sleep() */
+}
+if ( SampleInterval_s > 10.0 )
+{
+    return( -1 );  /* Invalid sample interval */
+}
+if ( NumPoints < 1 || NumPoints > 100000 || NumPointsTimestamps != NumPoints )
+{
+    return( -1 );  /* Invalid NumPoints / Timestamps size */
+}
+if ( TriggerSource < 0 || TriggerSource > 1 )
+{
+    return( -1 );  /* Invalid trigger source */
+}
+if ( TriggerSource == 1 && ( TrigChannel < 1 || TrigChannel > 2 || TrigOffset_s < 0.0 || TrigOffset_s > 40.0 || TrigWidth_s < TRIG_MIN_SEG_S ) )
+{
+    return( -1 );  /* Invalid trigger pulse */
+}
+
+check_interval_ms = (int)(SampleInterval_s * 1000.0 + 0.5);
+if ( check_interval_ms < 1 ) check_interval_ms = 1;
+if ( check_interval_ms > 10 ) check_interval_ms = 10;
+
+for ( i = 0; i < NumPoints; i++ )
+{
+    Imeas[i] = 0.0;
+    Timestamps[i] = 0.0;
+}
+
+QueryPerformanceFrequency(&freq);
+if ( freq.QuadPart == 0 )
+{
+    freq.QuadPart = 1000;  /* Assume 1 ms resolution */
+}
+
+/* PMU first: slow setup must not sit between bias on and t = 0 */
+if ( TriggerSource == 1 )
+{
+    if ( !LPTIsInCurrentConfiguration(PMU_ID) )
+    {
+        return( -8 );  /* PMU not in configuration */
+    }
+    getinstid(PMU_ID, &pulserId);
+    if ( pulserId == -1 )
+    {
+        return( -8 );
+    }
+    status = trigger_pulse_setup(pulserId, TrigChannel, TrigOffset_s, TrigVhigh, TrigWidth_s, TrigVRange);
+    if ( status )
+    {
+        pulse_output(pulserId, TrigChannel, 0);
+        return( -9 );  /* PMU setup failed */
+    }
+}
+
+status = limiti(SMU1, Ilimit);
+if ( status != 0 )
+{
+    forcev(SMU1, 0.0);
+    return( -7 );  /* limiti failed */
+}
+
+if ( Irange_A > 0.0 )
+{
+    double irange = Irange_A;
+    if ( irange > Ilimit )
+        irange = Ilimit;   /* Do not set range above compliance */
+    status = rangei(SMU1, irange);
+    /* Ignore rangei failure; instrument may not support or may use auto-range */
+}
+
+status = setmode(SMU1, KI_INTGPLC, 0.01);
+
+status = forcev(SMU1, Vforce);
+if ( status != 0 )
+{
+    forcev(SMU1, 0.0);
+    if ( pulserId != -1 ) pulse_output(pulserId, TrigChannel, 0);
+    return( -5 );  /* forcev failed */
+}
+
+/* Start the trigger pulse; t = 0 is when pulse_exec returns */
+if ( TriggerSource == 1 )
+{
+    QueryPerformanceCounter(&exec_start);
+    status = pulse_exec(PULSE_MODE_SIMPLE);
+    QueryPerformanceCounter(&start_time);
+    if ( status )
+    {
+        forcev(SMU1, 0.0);
+        pulse_output(pulserId, TrigChannel, 0);
+        return( -10 );  /* pulse_exec failed */
+    }
+    *ExecLatency_s = (double)(start_time.QuadPart - exec_start.QuadPart) / (double)freq.QuadPart;
+}
+else
+{
+    QueryPerformanceCounter(&start_time);
+}
+
+/* Sample until Duration_s is reached or NumPoints filled (as SMU_BiasTimedRead) */
+i = 0;
+while ( i < NumPoints )
+{
+    next_sample_target_s = (double)i * SampleInterval_s;
+    while ( 1 )
+    {
+        QueryPerformanceCounter(&current_time);
+        time_elapsed_s = (double)(current_time.QuadPart - start_time.QuadPart) / (double)freq.QuadPart;
+        if ( time_elapsed_s >= Duration_s || time_elapsed_s >= next_sample_target_s )
+            break;
+        Sleep(check_interval_ms);
+    }
+    if ( time_elapsed_s >= Duration_s )
+        break;
+
+    Timestamps[i] = time_elapsed_s;
+    status = measi(SMU1, &Imeas[i]);
+    if ( status != 0 )
+    {
+        forcev(SMU1, 0.0);
+        if ( pulserId != -1 ) pulse_output(pulserId, TrigChannel, 0);
+        *NumPointsOut = i;
+        return( -6 );  /* measi failed */
+    }
+    i++;
+}
+*NumPointsOut = i;
+
+/* Ramp to 0 V and leave output safe */
+status = forcev(SMU1, 0.0);
+
+if ( pulserId != -1 )
+{
+    /* The pulse normally finished long ago; if Duration_s < TrigOffset_s wait
+       for the rest of the programmed pulse (segments as in trigger_pulse_setup)
+       plus a small margin, never longer */
+    trig_end_s = ( ( TrigOffset_s > TRIG_MIN_SEG_S ) ? TrigOffset_s : TRIG_MIN_SEG_S )
+                 + 2.0 * TRIG_EDGE_S + TrigWidth_s + TRIG_TAIL_S + TRIG_WAIT_MARGIN_S;
+    QueryPerformanceCounter(&current_time);
+    time_elapsed_s = (double)(current_time.QuadPart - start_time.QuadPart) / (double)freq.QuadPart;
+    for ( i = 0; pulse_exec_status(&t) == 1 && time_elapsed_s + i * 0.01 < trig_end_s; i++ )
+        Sleep(10);
+    pulse_output(pulserId, TrigChannel, 0);
+}
+
+if ( status != 0 )
+{
+    return( -5 );
+}
+
+return( 0 ); /* Returns zero if execution Ok.*/
+
+/* USRLIB MODULE END  */
+} 		/* End SMU_BiasTimedRead_Triggered.c */
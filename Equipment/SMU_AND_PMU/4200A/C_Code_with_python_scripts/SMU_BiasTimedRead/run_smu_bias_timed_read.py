@@ -9,6 +9,15 @@ signals "ready". The host waits for the event, sets t0, starts the laser,
 while the instrument runs Collect (sample loop). Clocks are aligned to
 "ready".
 
+Triggered mode (--pmu-trigger): one EX of SMU_BiasTimedRead_Triggered
+applies bias, starts a PMU pulse that fires the laser TrigOffset_s later and
+samples current, so the laser edge is on the same clock as the samples
+(run_bias_timed_read_triggered()). No host round trip between bias and laser.
+
+Retention mode (--log): SMU_BiasTimedRead_Log reads on a log time schedule
+(points per decade between start and end time), optionally with pulsed reads
+so the device sits at 0 V between samples.
+
 Used by the Pulse Testing GUI optical+read tests (4200A). Run standalone for
 testing:
 
@@ -20,11 +29,21 @@ testing:
 
   # Longer run: e.g. 10 s, 0.02 s interval
   python run_smu_bias_timed_read.py --duration 10 --sample-interval 0.02
+
+  # Bias + PMU laser trigger in one call: laser fires 0.5 s into a 5 s read
+  python run_smu_bias_timed_read.py --pmu-trigger --duration 5 --trig-offset 0.5 --trig-vhigh 5 --trig-width 0.01
+
+  # Retention: 10 points/decade from 10 ms to 10^4 s, 5 ms pulsed reads
+  python run_smu_bias_timed_read.py --log --start-time 0.01 --end-time 1e4 --points-per-decade 10 --pulsed-read
+
+  # Breakdown capture: stress up to 600 s, keep 200 samples either side of |I| >= 10 uA
+  python run_smu_bias_timed_read.py --capture --duration 600 --trigger-level 1e-5 --pre-trigger 200 --post-trigger 200
 """
 
 from __future__ import annotations
 
 import argparse
+import math
 import re
 import sys
 import threading
@@ -100,6 +119,157 @@ def build_ex_command_collect(
     return f"EX A_SMU_BiasTimedRead_Start SMU_BiasTimedRead_Collect({','.join(params)})"
 
 
+def build_ex_command_capture(
+    vforce: float,
+    duration_s: float,
+    sample_interval_s: float,
+    ilimit: float,
+    trigger_level: float,
+    pre_trigger: int,
+    post_trigger: int,
+    trigger_mode: int = 0,
+    summary_points: int = 500,
+    current_range_a: float = 0.0,
+) -> str:
+    """Build EX command for SMU_BiasTimedRead_Capture (triggered event capture).
+
+    trigger_mode: 0 = |I| >= trigger_level (A), 1 = |dI/dt| >= trigger_level (A/s).
+    The event window (Imeas/Timestamps) is sized pre_trigger + 1 + post_trigger.
+    """
+    window = pre_trigger + 1 + post_trigger
+    params = [
+        format_param(vforce),  # 1: Vforce
+        format_param(duration_s),  # 2: Duration_s
+        format_param(sample_interval_s),  # 3: SampleInterval_s
+        format_param(ilimit),  # 4: Ilimit
+        format_param(current_range_a),  # 5: Irange_A
+        format_param(int(trigger_mode)),  # 6: TriggerMode
+        format_param(trigger_level),  # 7: TriggerLevel
+        format_param(int(pre_trigger)),  # 8: PreTrigger
+        format_param(int(post_trigger)),  # 9: PostTrigger
+        "",  # 10: Imeas output
+        format_param(window),  # 11: NumPoints
+        "",  # 12: Timestamps output
+        format_param(window),  # 13: NumPointsTimestamps
+        "",  # 14: SummaryI output
+        format_param(int(summary_points)),  # 15: NumSummary
+        "",  # 16: SummaryT output
+        format_param(int(summary_points)),  # 17: NumSummaryT
+        "",  # 18: TriggerIndex output
+        "",  # 19: NumPointsOut output
+        "",  # 20: NumSummaryOut output
+    ]
+    return f"EX A_SMU_BiasTimedRead_Capture SMU_BiasTimedRead_Capture({','.join(params)})"
+
+
+def build_ex_command_triggered(
+    vforce: float,
+    duration_s: float,
+    sample_interval_s: float,
+    ilimit: float,
+    num_points: int,
+    trig_offset_s: float,
+    trig_vhigh: float = 5.0,
+    trig_width_s: float = 1e-3,
+    trig_channel: int = 2,
+    pmu_id: str = "PMU1",
+    trig_vrange: float = 10.0,
+    trigger_source: int = 1,
+    current_range_a: float = 0.0,
+) -> str:
+    """Build EX command for SMU_BiasTimedRead_Triggered (bias + PMU trigger + read).
+
+    trigger_source: 0 = no trigger (t = 0 at bias on), 1 = PMU pulse at trig_offset_s.
+    """
+    params = [
+        format_param(vforce),  # 1: Vforce
+        format_param(duration_s),  # 2: Duration_s
+        format_param(sample_interval_s),  # 3: SampleInterval_s
+        format_param(ilimit),  # 4: Ilimit
+        format_param(current_range_a),  # 5: Irange_A
+        format_param(int(trigger_source)),  # 6: TriggerSource
+        pmu_id,  # 7: PMU_ID
+        format_param(int(trig_channel)),  # 8: TrigChannel
+        format_param(trig_offset_s),  # 9: TrigOffset_s
+        format_param(trig_vhigh),  # 10: TrigVhigh
+        format_param(trig_width_s),  # 11: TrigWidth_s
+        format_param(trig_vrange),  # 12: TrigVRange
+        "",  # 13: Imeas output
+        format_param(num_points),  # 14: NumPoints
+        "",  # 15: Timestamps output
+        format_param(num_points),  # 16: NumPointsTimestamps
+        "",  # 17: ExecLatency_s output
+        "",  # 18: NumPointsOut output
+    ]
+    return f"EX A_SMU_BiasTimedRead_Triggered SMU_BiasTimedRead_Triggered({','.join(params)})"
+
+
+def log_schedule(start_time_s: float, end_time_s: float, points_per_decade: int) -> List[float]:
+    """Sample times of SMU_BiasTimedRead_Log: start * 10^(k / ppd) up to end (same count rule as the C code)."""
+    if start_time_s <= 0 or end_time_s < start_time_s or points_per_decade < 1:
+        raise ValueError("need 0 < start_time_s <= end_time_s and points_per_decade >= 1")
+    count = int(math.floor(points_per_decade * math.log10(end_time_s / start_time_s) + 1e-9)) + 1
+    return [start_time_s * 10 ** (k / points_per_decade) for k in range(count)]
+
+
+def build_ex_command_log(
+    vread: float,
+    start_time_s: float,
+    end_time_s: float,
+    points_per_decade: int,
+    ilimit: float,
+    read_mode: int = 0,
+    read_width_s: float = 0.005,
+    idle_v: float = 0.0,
+    current_range_a: float = 0.0,
+) -> str:
+    """Build EX command for SMU_BiasTimedRead_Log (log-spaced retention read).
+
+    read_mode: 0 = continuous bias, 1 = pulsed read (idle_v between samples).
+    """
+    num_points = len(log_schedule(start_time_s, end_time_s, points_per_decade))
+    params = [
+        format_param(vread),  # 1: Vread
+        format_param(start_time_s),  # 2: StartTime_s
+        format_param(end_time_s),  # 3: EndTime_s
+        format_param(int(points_per_decade)),  # 4: PointsPerDecade
+        format_param(ilimit),  # 5: Ilimit
+        format_param(current_range_a),  # 6: Irange_A
+        format_param(int(read_mode)),  # 7: ReadMode
+        format_param(read_width_s),  # 8: ReadWidth_s
+        format_param(idle_v),  # 9: IdleV
+        "",  # 10: Imeas output
+        format_param(num_points),  # 11: NumPoints
+        "",  # 12: Timestamps output
+        format_param(num_points),  # 13: NumPointsTimestamps
+        "",  # 14: NumPointsOut output
+    ]
+    return f"EX A_SMU_BiasTimedRead_Log SMU_BiasTimedRead_Log({','.join(params)})"
+
+
+# GP positions (1-based) in SMU_BiasTimedRead_Log(...)
+GP_LOG_IMEAS = 10
+GP_LOG_TIMESTAMPS = 12
+GP_LOG_NUM_POINTS = 14
+
+
+# GP positions (1-based) in SMU_BiasTimedRead_Triggered(...)
+GP_TRIGGERED_IMEAS = 13
+GP_TRIGGERED_TIMESTAMPS = 15
+GP_TRIGGERED_EXEC_LATENCY = 17
+GP_TRIGGERED_NUM_POINTS = 18
+
+
+# GP positions (1-based) in SMU_BiasTimedRead_Capture(...)
+GP_CAPTURE_IMEAS = 10
+GP_CAPTURE_TIMESTAMPS = 12
+GP_CAPTURE_SUMMARY_I = 14
+GP_CAPTURE_SUMMARY_T = 16
+GP_CAPTURE_TRIGGER_INDEX = 18
+GP_CAPTURE_NUM_POINTS = 19
+GP_CAPTURE_NUM_SUMMARY = 20
+
+
 # Imeas in Collect: 3rd param of Collect. If Start+Collect share one module, 4200 may use
 # combined numbering (Start 1,2 + Collect 3,4,5,6) so Imeas is param 5.
 GP_PARAM_IMEAS_COLLECT = 3
@@ -463,6 +633,204 @@ def run_bias_timed_read(
     }
 
 
+def run_bias_timed_read_triggered(
+    gpib_address: str,
+    timeout: float,
+    vforce: float,
+    duration_s: float,
+    sample_interval_s: float,
+    ilimit: float,
+    trig_offset_s: float,
+    trig_vhigh: float = 5.0,
+    trig_width_s: float = 1e-3,
+    trig_channel: int = 2,
+    pmu_id: str = "PMU1",
+    num_points: Optional[int] = None,
+    current_range_a: float = 0.0,
+) -> Dict[str, Any]:
+    """Execute SMU_BiasTimedRead_Triggered and return samples on the trigger clock.
+
+    The laser edge is at ``trigger_time`` (= trig_offset_s) on the ``timestamps``
+    axis, to within ``exec_latency`` (time pulse_exec took on the instrument).
+    """
+    if num_points is None:
+        num_points = max(1, int(duration_s / sample_interval_s))
+    command = build_ex_command_triggered(
+        vforce, duration_s, sample_interval_s, ilimit, num_points, trig_offset_s,
+        trig_vhigh, trig_width_s, trig_channel, pmu_id, current_range_a=current_range_a,
+    )
+    wait_seconds = duration_s + 2.0
+
+    client = KXCIClient(gpib_address=gpib_address, timeout=timeout)
+    if not client.connect():
+        raise RuntimeError("Failed to connect to instrument")
+
+    try:
+        if not client._enter_ul_mode():
+            raise RuntimeError("Failed to enter UL mode")
+        return_value, error = client._execute_ex_command(command, wait_seconds=wait_seconds)
+        if error:
+            raise RuntimeError(f"EX command failed: {error}")
+        if return_value is not None and return_value < 0:
+            err_msgs = {
+                -1: "Invalid parameters",
+                -5: "forcev failed",
+                -6: "measi failed",
+                -7: "limiti failed",
+                -8: f"{pmu_id} not found",
+                -9: "PMU trigger setup failed",
+                -10: "pulse_exec failed",
+            }
+            msg = err_msgs.get(return_value, f"Error code {return_value}")
+            raise RuntimeError(f"SMU_BiasTimedRead_Triggered returned {return_value}: {msg}")
+        time.sleep(0.05)
+        n_actual = int(client._query_gp(GP_TRIGGERED_NUM_POINTS, 1)[0])
+        exec_latency = client._query_gp(GP_TRIGGERED_EXEC_LATENCY, 1)[0]
+        currents = client._query_gp(GP_TRIGGERED_IMEAS, n_actual) if n_actual > 0 else []
+        timestamps = client._query_gp(GP_TRIGGERED_TIMESTAMPS, n_actual) if n_actual > 0 else []
+    finally:
+        try:
+            client._exit_ul_mode()
+        except Exception:
+            pass
+        client.disconnect()
+
+    return {
+        "timestamps": timestamps,
+        "voltages": [vforce] * len(currents),
+        "currents": currents,
+        "resistances": [
+            (vforce / i if i and abs(i) > 1e-18 else float('nan'))
+            for i in currents
+        ],
+        "trigger_time": trig_offset_s,
+        "exec_latency": exec_latency,
+    }
+
+
+def run_bias_timed_read_log(
+    gpib_address: str,
+    timeout: float,
+    vread: float,
+    start_time_s: float,
+    end_time_s: float,
+    points_per_decade: int,
+    ilimit: float,
+    read_mode: int = 0,
+    read_width_s: float = 0.005,
+    idle_v: float = 0.0,
+    current_range_a: float = 0.0,
+) -> Dict[str, Any]:
+    """Execute SMU_BiasTimedRead_Log and return timestamps, voltages, currents, resistances.
+
+    The instrument timeout must exceed end_time_s: the EX reply only arrives at the end.
+    """
+    command = build_ex_command_log(
+        vread, start_time_s, end_time_s, points_per_decade, ilimit,
+        read_mode, read_width_s, idle_v, current_range_a,
+    )
+    num_points = len(log_schedule(start_time_s, end_time_s, points_per_decade))
+
+    client = KXCIClient(gpib_address=gpib_address, timeout=max(timeout, end_time_s + 30.0))
+    if not client.connect():
+        raise RuntimeError("Failed to connect to instrument")
+
+    try:
+        if not client._enter_ul_mode():
+            raise RuntimeError("Failed to enter UL mode")
+        # read() blocks until the module returns, no fixed wait needed
+        return_value, error = client._execute_ex_command(command, wait_seconds=0)
+        if error:
+            raise RuntimeError(f"EX command failed: {error}")
+        if return_value is not None and return_value < 0:
+            raise RuntimeError(f"SMU_BiasTimedRead_Log returned {return_value}")
+        time.sleep(0.05)
+        n_actual = int(client._query_gp(GP_LOG_NUM_POINTS, 1)[0])
+        currents = client._query_gp(GP_LOG_IMEAS, n_actual) if n_actual > 0 else []
+        timestamps = client._query_gp(GP_LOG_TIMESTAMPS, n_actual) if n_actual > 0 else []
+    finally:
+        try:
+            client._exit_ul_mode()
+        except Exception:
+            pass
+        client.disconnect()
+
+    if len(currents) < num_points:
+        print(f"[WARN] Got {len(currents)} of {num_points} scheduled points", file=sys.stderr)
+    return {
+        "timestamps": timestamps,
+        "voltages": [vread] * len(currents),
+        "currents": currents,
+        "resistances": [
+            (vread / i if i and abs(i) > 1e-18 else float('nan'))
+            for i in currents
+        ],
+    }
+
+
+def run_bias_capture(
+    gpib_address: str,
+    timeout: float,
+    vforce: float,
+    duration_s: float,
+    sample_interval_s: float,
+    ilimit: float,
+    trigger_level: float,
+    pre_trigger: int = 200,
+    post_trigger: int = 200,
+    trigger_mode: int = 0,
+    summary_points: int = 500,
+    current_range_a: float = 0.0,
+) -> Dict[str, Any]:
+    """Execute SMU_BiasTimedRead_Capture and return the event window and summary trace.
+
+    Returns timestamps/currents of the event window, trigger_index (-1 if no
+    event within duration_s) and summary_timestamps/summary_currents covering
+    the whole run.
+    """
+    command = build_ex_command_capture(
+        vforce, duration_s, sample_interval_s, ilimit, trigger_level,
+        pre_trigger, post_trigger, trigger_mode, summary_points, current_range_a,
+    )
+    wait_seconds = duration_s + (post_trigger + 1) * sample_interval_s + 2.0
+
+    client = KXCIClient(gpib_address=gpib_address, timeout=timeout)
+    if not client.connect():
+        raise RuntimeError("Failed to connect to instrument")
+
+    try:
+        if not client._enter_ul_mode():
+            raise RuntimeError("Failed to enter UL mode")
+        return_value, error = client._execute_ex_command(command, wait_seconds=wait_seconds)
+        if error:
+            raise RuntimeError(f"EX command failed: {error}")
+        if return_value is not None and return_value < 0:
+            raise RuntimeError(f"SMU_BiasTimedRead_Capture returned {return_value}")
+        time.sleep(0.05)
+        trigger_index = int(client._query_gp(GP_CAPTURE_TRIGGER_INDEX, 1)[0])
+        num_points = int(client._query_gp(GP_CAPTURE_NUM_POINTS, 1)[0])
+        num_summary = int(client._query_gp(GP_CAPTURE_NUM_SUMMARY, 1)[0])
+        currents = client._query_gp(GP_CAPTURE_IMEAS, num_points) if num_points > 0 else []
+        timestamps = client._query_gp(GP_CAPTURE_TIMESTAMPS, num_points) if num_points > 0 else []
+        summary_currents = client._query_gp(GP_CAPTURE_SUMMARY_I, num_summary) if num_summary > 0 else []
+        summary_timestamps = client._query_gp(GP_CAPTURE_SUMMARY_T, num_summary) if num_summary > 0 else []
+    finally:
+        try:
+            client._exit_ul_mode()
+        except Exception:
+            pass
+        client.disconnect()
+
+    return {
+        "trigger_index": trigger_index,
+        "trigger_time": timestamps[trigger_index] if 0 <= trigger_index < len(timestamps) else None,
+        "timestamps": timestamps,
+        "currents": currents,
+        "summary_timestamps": summary_timestamps,
+        "summary_currents": summary_currents,
+    }
+
+
 def main() -> None:
     parser = argparse.ArgumentParser(
         description="SMU Bias Timed Read: apply voltage for duration, sample current, return data.",
@@ -478,8 +846,109 @@ def main() -> None:
     parser.add_argument("--num-points", type=int, default=None, help="Number of samples (default: duration/sample_interval)")
     parser.add_argument("--current-range", type=float, default=0.0, help="Current measurement range (A). 0=auto, e.g. 1e-6=1uA for fixed range")
     parser.add_argument("--dry-run", action="store_true", help="Print EX command only (no instrument)")
+    parser.add_argument("--pmu-trigger", action="store_true", help="Bias + PMU laser trigger + read in one call (SMU_BiasTimedRead_Triggered)")
+    parser.add_argument("--pmu-id", type=str, default="PMU1", help="PMU card driving the laser trigger")
+    parser.add_argument("--trig-channel", type=int, choices=(1, 2), default=2, help="PMU channel for the trigger pulse")
+    parser.add_argument("--trig-offset", type=float, default=0.1, help="Trigger edge time after t = 0 (s)")
+    parser.add_argument("--trig-vhigh", type=float, default=5.0, help="Trigger pulse level (V)")
+    parser.add_argument("--trig-width", type=float, default=1e-3, help="Trigger pulse width (s)")
+    parser.add_argument("--log", action="store_true", help="Log-spaced retention read (SMU_BiasTimedRead_Log)")
+    parser.add_argument("--start-time", type=float, default=0.01, help="First retention sample time (s)")
+    parser.add_argument("--end-time", type=float, default=1e4, help="Last retention sample time (s)")
+    parser.add_argument("--points-per-decade", type=int, default=10, help="Retention samples per decade")
+    parser.add_argument("--pulsed-read", action="store_true", help="Apply --vforce only around each read (0 V in between)")
+    parser.add_argument("--read-width", type=float, default=0.005, help="Read pulse settle time before each sample (s)")
+    parser.add_argument("--capture", action="store_true", help="Triggered capture: return only the event window and a summary trace")
+    parser.add_argument("--trigger-mode", type=int, choices=(0, 1), default=0, help="0 = |I| >= level (A), 1 = |dI/dt| >= level (A/s)")
+    parser.add_argument("--trigger-level", type=float, default=1e-5, help="Trigger level (A or A/s)")
+    parser.add_argument("--pre-trigger", type=int, default=200, help="Samples kept before the trigger")
+    parser.add_argument("--post-trigger", type=int, default=200, help="Samples recorded after the trigger")
+    parser.add_argument("--summary-points", type=int, default=500, help="Points in the whole-run summary trace")
     args = parser.parse_args()
 
+    if args.log:
+        try:
+            schedule = log_schedule(args.start_time, args.end_time, args.points_per_decade)
+        except ValueError as exc:
+            parser.error(str(exc))
+        command = build_ex_command_log(
+            args.vforce, args.start_time, args.end_time, args.points_per_decade, args.ilimit,
+            1 if args.pulsed_read else 0, args.read_width, 0.0, args.current_range,
+        )
+        if args.dry_run:
+            print(f"[DRY RUN] {len(schedule)} points, {schedule[0]:.3g} s to {schedule[-1]:.3g} s")
+            print(command)
+            return
+        result = run_bias_timed_read_log(
+            gpib_address=args.gpib_address,
+            timeout=args.timeout,
+            vread=args.vforce,
+            start_time_s=args.start_time,
+            end_time_s=args.end_time,
+            points_per_decade=args.points_per_decade,
+            ilimit=args.ilimit,
+            read_mode=1 if args.pulsed_read else 0,
+            read_width_s=args.read_width,
+            current_range_a=args.current_range,
+        )
+        print(f"[OK] Got {len(result['currents'])} retention points")
+        return
+
+    if args.pmu_trigger:
+        num_points = args.num_points or max(1, int(args.duration / args.sample_interval))
+        if args.dry_run:
+            print(build_ex_command_triggered(
+                args.vforce, args.duration, args.sample_interval, args.ilimit, num_points, args.trig_offset,
+                args.trig_vhigh, args.trig_width, args.trig_channel, args.pmu_id, current_range_a=args.current_range,
+            ))
+            return
+        result = run_bias_timed_read_triggered(
+            gpib_address=args.gpib_address,
+            timeout=args.timeout,
+            vforce=args.vforce,
+            duration_s=args.duration,
+            sample_interval_s=args.sample_interval,
+            ilimit=args.ilimit,
+            trig_offset_s=args.trig_offset,
+            trig_vhigh=args.trig_vhigh,
+            trig_width_s=args.trig_width,
+            trig_channel=args.trig_channel,
+            pmu_id=args.pmu_id,
+            num_points=num_points,
+            current_range_a=args.current_range,
+        )
+        print(f"[OK] Got {len(result['currents'])} points, trigger at {result['trigger_time']:.4f} s "
+              f"(pulse_exec latency {result['exec_latency'] * 1e3:.3f} ms)")
+        return
+
+    if args.capture:
+        if args.dry_run:
+            print(build_ex_command_capture(
+                args.vforce, args.duration, args.sample_interval, args.ilimit, args.trigger_level,
+                args.pre_trigger, args.post_trigger, args.trigger_mode, args.summary_points, args.current_range,
+            ))
+            return
+        result = run_bias_capture(
+            gpib_address=args.gpib_address,
+            timeout=args.timeout,
+            vforce=args.vforce,
+            duration_s=args.duration,
+            sample_interval_s=args.sample_interval,
+            ilimit=args.ilimit,
+            trigger_level=args.trigger_level,
+            pre_trigger=args.pre_trigger,
+            post_trigger=args.post_trigger,
+            trigger_mode=args.trigger_mode,
+            summary_points=args.summary_points,
+            current_range_a=args.current_range,
+        )
+        if result["trigger_index"] < 0:
+            print(f"[INFO] No trigger within {args.duration} s; last {len(result['currents'])} samples returned")
+        else:
+            print(f"[OK] Trigger at {result['trigger_time']:.4f} s, {len(result['currents'])} samples in window")
+        print(f"  Summary: {len(result['summary_currents'])} points")
+        return
+
     num_points = args.num_points
     if num_points is None:
         num_points = max(1, int(args.duration / args.sample_interval))
@@ -3,11 +3,45 @@ Shared helpers for the smu_check_connection UL module.
 
 This module exposes utility functions so both the CLI streamer and the GUI/IV
 controller can execute the same EX → GP workflow without duplicating code.
+
+Ring readout
+------------
+The UL module writes sample number ``s`` into slot ``s % buffer_size`` of
+Ibuffer/Vbuffer (GP 6/8) and publishes the ring state in the Control array
+(GP 10): ``[head, write_index, size, state, last_time, settled_current,
+settle_time]``. ``head`` is the
+number of samples written so far and only advances after the slot is filled,
+so the host can read new samples incrementally with no lock:
+
+1. read ``head_before`` (GP 10)
+2. read the buffers (GP 6/8)
+3. read ``head_after`` (GP 10)
+
+Samples ``max(last_seen + 1, head_after - size) <= seq < head_before`` are
+valid (complete before the read, not overwritten during it).
+
+KXCI does not service GP while an EX is running, so over GPIB the ring is only
+read after the module returns. ``execute_batch`` runs one bounded EX with
+``max_samples <= buffer_size`` and then reads every sample of that run.
+
+Stdout stream
+-------------
+``stream_mode`` picks what the module prints while it runs: ``DATA`` lines per
+sample (0), batched ``FRAME`` lines (1, decoded by ``parse_stream_frame``) or
+nothing (2, ring only).
+
+Stable-contact auto-stop
+------------------------
+With ``stable_count = N`` the module stops once the last N readings are above
+``min_current`` and within ``stable_tolerance`` x |mean| of each other, sets
+state 3 and reports the mean and time to settle in Control[5]/[6].
+``qualify_contact`` runs one such check per probe site.
 """
 
 from __future__ import annotations
 
-from typing import Dict, Optional
+from dataclasses import dataclass
+from typing import Dict, List, Optional, Sequence
 from pathlib import Path
 import sys
 
@@ -25,6 +59,64 @@ except ImportError as exc:  # pragma: no cover
     ) from exc
 
 
+LIBRARY_NAME = "Single_Point_Bias"
+
+# GP parameter positions (1-based) in smu_check_connection
+GP_IBUFFER = 6
+GP_VBUFFER = 8
+GP_CONTROL = 10
+
+# Control array layout (see smu_check_connection.c)
+CONTROL_SIZE = 7
+CTRL_HEAD = 0
+CTRL_WRITE_INDEX = 1
+CTRL_SIZE = 2
+CTRL_STATE = 3
+CTRL_LAST_TIME = 4
+CTRL_SETTLED_CURRENT = 5
+CTRL_SETTLE_TIME = 6
+
+STATE_RUNNING = 1
+STATE_FINISHED = 2
+STATE_STABLE = 3
+
+# StreamMode values
+STREAM_LINES = 0
+STREAM_FRAMES = 1
+STREAM_NONE = 2
+
+
+@dataclass
+class RingSnapshot:
+    """Newest sample in the ring plus the ring counters it was read with."""
+
+    voltage: float
+    current: float
+    total_samples: int
+    write_index: int
+
+    @property
+    def sequence(self) -> int:
+        return self.total_samples - 1
+
+
+@dataclass
+class RingSample:
+    sequence: int
+    voltage: float
+    current: float
+
+
+@dataclass
+class StreamSample:
+    """One sample decoded from a FRAME line; ``time`` is seconds since bias applied."""
+
+    sequence: int
+    time: float
+    voltage: float
+    current: float
+
+
 def build_check_connection_command(
     bias_voltage: float,
     sample_interval: float,
@@ -32,10 +124,23 @@ def build_check_connection_command(
     ilimit: float,
     integration_time: float,
     buffer_size: int,
-    max_samples: int,
-    clarius_debug: int,
+    max_samples: int = 1,
+    clarius_debug: int = 0,
+    control_size: int = CONTROL_SIZE,
+    stream_mode: int = STREAM_LINES,
+    batch_samples: int = 32,
+    batch_interval: float = 0.05,
+    stable_count: int = 0,
+    stable_tolerance: float = 0.05,
+    min_current: float = 0.0,
 ) -> str:
-    """Return the EX command string for smu_check_connection."""
+    """Return the EX command string for smu_check_connection.
+
+    ``max_samples = 0`` runs until aborted, so the EX never returns over KXCI;
+    only use it from Clarius. ``control_size`` must be >= 4.
+    ``batch_samples``/``batch_interval`` only apply to ``STREAM_FRAMES``.
+    ``stable_count = 0`` disables the stable-contact auto-stop.
+    """
 
     params = [
         format_param(bias_voltage),  # 1 BiasVoltage
@@ -47,10 +152,154 @@ def build_check_connection_command(
         format_param(buffer_size),  # 7 NumISamples
         "",  # 8 Vbuffer (D_ARRAY_T)
         format_param(buffer_size),  # 9 NumVSamples
-        format_param(max_samples),  # 10 MaxSamples
-        format_param(clarius_debug),  # 11 ClariusDebug
+        "",  # 10 Control (D_ARRAY_T)
+        format_param(control_size),  # 11 NumControl
+        format_param(stream_mode),  # 12 StreamMode
+        format_param(batch_samples),  # 13 BatchSamples
+        format_param(batch_interval),  # 14 BatchInterval
+        format_param(stable_count),  # 15 StableCount
+        format_param(stable_tolerance),  # 16 StableTolerance
+        format_param(min_current),  # 17 MinCurrent
+        format_param(max_samples),  # 18 MaxSamples
+        format_param(clarius_debug),  # 19 ClariusDebug
+    ]
+    return f"EX {LIBRARY_NAME} smu_check_connection({','.join(params)})"
+
+
+def latest_sample_from_buffers(
+    voltage: Sequence[float],
+    current: Sequence[float],
+    write_index: int,
+    total_samples: int,
+) -> RingSnapshot:
+    """Return the newest sample: the slot just before ``write_index``."""
+
+    size = min(len(voltage), len(current))
+    if size == 0 or total_samples <= 0:
+        raise RuntimeError("Ring is empty; no sample written yet")
+    idx = (int(write_index) - 1) % size
+    return RingSnapshot(
+        voltage=float(voltage[idx]),
+        current=float(current[idx]),
+        total_samples=int(total_samples),
+        write_index=int(write_index),
+    )
+
+
+def samples_since(
+    voltage: Sequence[float],
+    current: Sequence[float],
+    last_sequence: int,
+    head_before: int,
+    head_after: int,
+) -> List[RingSample]:
+    """Samples newer than ``last_sequence`` that are valid for a buffer read
+    taken between two reads of the head counter (see module docstring)."""
+
+    size = min(len(voltage), len(current))
+    if size == 0:
+        return []
+    first = max(int(last_sequence) + 1, int(head_after) - size, 0)
+    return [
+        RingSample(sequence=seq, voltage=float(voltage[seq % size]), current=float(current[seq % size]))
+        for seq in range(first, int(head_before))
+    ]
+
+
+def parse_stream_frame(line: str) -> List[StreamSample]:
+    """Decode ``FRAME <seq> <n> <t_ms> <bias> <dt>:<current>:<dv_uV> ... *<xx>``.
+
+    Raises ValueError on a malformed line or checksum mismatch.
+    """
+
+    line = line.strip()
+    body, sep, checksum_text = line.rpartition(" *")
+    if not sep or not body.startswith("FRAME "):
+        raise ValueError(f"Not a FRAME line: {line!r}")
+    checksum = 0
+    for char in body:
+        checksum ^= ord(char)
+    if checksum != int(checksum_text, 16):
+        raise ValueError(f"FRAME checksum mismatch ({checksum:02X} != {checksum_text})")
+
+    fields = body.split()
+    first_seq, count, t_ms = int(fields[1]), int(fields[2]), int(fields[3])
+    bias = float(fields[4])
+    tokens = fields[5:]
+    if len(tokens) != count:
+        raise ValueError(f"FRAME declares {count} samples, carries {len(tokens)}")
+
+    samples: List[StreamSample] = []
+    for offset, token in enumerate(tokens):
+        dt_text, current_text, dv_text = token.split(":")
+        t_ms += int(dt_text)
+        samples.append(
+            StreamSample(
+                sequence=first_seq + offset,
+                time=t_ms / 1000.0,
+                voltage=bias + int(dv_text) * 1e-6,
+                current=float(current_text),
+            )
+        )
+    return samples
+
+
+def execute_batch(
+    kxci_controller,
+    num_samples: int,
+    first_sequence: int = 0,
+    bias_voltage: float = 0.2,
+    sample_interval: float = 0.1,
+    settle_time: float = 0.01,
+    ilimit: float = 0.01,
+    integration_time: float = 0.01,
+    buffer_size: int = 8,
+    clarius_debug: int = 0,
+) -> List[RingSample]:
+    """
+    Run smu_check_connection for ``num_samples`` samples, then read them all.
+
+    ``num_samples`` must fit in the ring (<= ``buffer_size``) so none is
+    overwritten before the GP read. Sequence numbers start at
+    ``first_sequence`` so consecutive batches number on from each other.
+    """
+
+    if not 1 <= num_samples <= buffer_size:
+        raise ValueError("num_samples must be between 1 and buffer_size")
+
+    command = build_check_connection_command(
+        bias_voltage=bias_voltage,
+        sample_interval=sample_interval,
+        settle_time=settle_time,
+        ilimit=ilimit,
+        integration_time=integration_time,
+        buffer_size=buffer_size,
+        max_samples=num_samples,
+        clarius_debug=clarius_debug,
+        stream_mode=STREAM_NONE,
+    )
+
+    wait_seconds = settle_time + num_samples * (sample_interval + integration_time)
+    return_value, error = kxci_controller._execute_ex_command(  # pylint: disable=protected-access
+        command,
+        wait_seconds=wait_seconds,
+    )
+    if error:
+        raise RuntimeError(f"EX command failed: {error}")
+    if return_value not in (0, None):
+        raise RuntimeError(f"EX command returned error code {return_value}")
+
+    control = kxci_controller._query_gp(GP_CONTROL, CONTROL_SIZE)  # pylint: disable=protected-access
+    current = kxci_controller._query_gp(GP_IBUFFER, buffer_size)  # pylint: disable=protected-access
+    voltage = kxci_controller._query_gp(GP_VBUFFER, buffer_size)  # pylint: disable=protected-access
+    if len(control) <= CTRL_HEAD:
+        raise RuntimeError("Control array too short; rebuild the UL module")
+
+    head = int(control[CTRL_HEAD])
+    return [
+        RingSample(sequence=first_sequence + sample.sequence, voltage=sample.voltage, current=sample.current)
+        for sample in samples_since(voltage, current, -1, head, head)
     ]
-    return f"EX A_Check_Connection smu_check_connection({','.join(params)})"
 
 
 def _latest_non_zero(voltage, current) -> Optional[int]:
@@ -80,7 +329,7 @@ def execute_single_sample(
         kxci_controller: Connected `KXCIClient` instance (Keithley4200A_KXCI).
 
     Returns:
-        {"voltage": <float>, "current": <float>}
+        {"voltage": <float>, "current": <float>, "total_samples": <int>}
 
     Raises:
         RuntimeError if the command fails or no sample is returned.
@@ -107,12 +356,23 @@ def execute_single_sample(
     if return_value not in (0, None):
         raise RuntimeError(f"EX command returned error code {return_value}")
 
-    voltage = kxci_controller._query_gp(8, buffer_size)  # pylint: disable=protected-access
-    current = kxci_controller._query_gp(6, buffer_size)  # pylint: disable=protected-access
+    voltage = kxci_controller._query_gp(GP_VBUFFER, buffer_size)  # pylint: disable=protected-access
+    current = kxci_controller._query_gp(GP_IBUFFER, buffer_size)  # pylint: disable=protected-access
 
     if not voltage or not current:
         raise RuntimeError("No data returned from smu_check_connection buffers")
 
+    try:
+        control = kxci_controller._query_gp(GP_CONTROL, CONTROL_SIZE)  # pylint: disable=protected-access
+    except Exception:  # pragma: no cover - older UL build without Control
+        control = []
+
+    if len(control) > CTRL_WRITE_INDEX:
+        snapshot = latest_sample_from_buffers(
+            voltage, current, write_index=int(control[CTRL_WRITE_INDEX]), total_samples=int(control[CTRL_HEAD])
+        )
+        return {"voltage": snapshot.voltage, "current": snapshot.current, "total_samples": snapshot.total_samples}
+
     latest_index = _latest_non_zero(voltage, current)
     if latest_index is None:
         raise RuntimeError("Buffers contained only zeros; no valid sample found")
@@ -123,3 +383,71 @@ def execute_single_sample(
     }
 
 
+def qualify_contact(
+    kxci_controller,
+    stable_count: int = 5,
+    stable_tolerance: float = 0.05,
+    min_current: float = 1e-9,
+    max_samples: int = 200,
+    bias_voltage: float = 0.2,
+    sample_interval: float = 0.01,
+    settle_time: float = 0.001,
+    ilimit: float = 0.01,
+    integration_time: float = 0.01,
+    buffer_size: int = 64,
+    clarius_debug: int = 0,
+) -> Dict[str, float]:
+    """
+    Run smu_check_connection until the contact is stable or ``max_samples`` run out.
+
+    Returns:
+        {"stable": <bool>, "current": <float>, "settle_time": <float>, "total_samples": <int>}
+        ``current`` is the settled mean when stable, otherwise the newest reading;
+        ``settle_time`` is -1 when not stable.
+    """
+
+    if not 1 <= stable_count <= buffer_size:
+        raise ValueError("stable_count must be between 1 and buffer_size")
+
+    command = build_check_connection_command(
+        bias_voltage=bias_voltage,
+        sample_interval=sample_interval,
+        settle_time=settle_time,
+        ilimit=ilimit,
+        integration_time=integration_time,
+        buffer_size=buffer_size,
+        max_samples=max_samples,
+        clarius_debug=clarius_debug,
+        stream_mode=STREAM_NONE,
+        stable_count=stable_count,
+        stable_tolerance=stable_tolerance,
+        min_current=min_current,
+    )
+
+    # No fixed wait: the read blocks until the module stops, so the instrument
+    # timeout must cover max_samples × (sample_interval + settle_time)
+    return_value, error = kxci_controller._execute_ex_command(  # pylint: disable=protected-access
+        command,
+        wait_seconds=0.0,
+    )
+    if error:
+        raise RuntimeError(f"EX command failed: {error}")
+    if return_value not in (0, None):
+        raise RuntimeError(f"EX command returned error code {return_value}")
+
+    control = kxci_controller._query_gp(GP_CONTROL, CONTROL_SIZE)  # pylint: disable=protected-access
+    if len(control) < CONTROL_SIZE:
+        raise RuntimeError("Control array too short; rebuild the UL module")
+
+    stable = int(control[CTRL_STATE]) == STATE_STABLE
+    if stable:
+        current = float(control[CTRL_SETTLED_CURRENT])
+    else:
+        current_buffer = kxci_controller._query_gp(GP_IBUFFER, buffer_size)  # pylint: disable=protected-access
+        current = float(current_buffer[(int(control[CTRL_WRITE_INDEX]) - 1) % buffer_size]) if current_buffer else 0.0
+    return {
+        "stable": stable,
+        "current": current,
+        "settle_time": float(control[CTRL_SETTLE_TIME]),
+        "total_samples": int(control[CTRL_HEAD]),
+    }
@@ -7,15 +7,25 @@ instrument via `GP 8` (voltage) and `GP 6` (current), and prints the result.
 Implementation overview
 =======================
 1. The command is generated with ``build_check_connection_command`` and looks
-   like ``EX A_Check_Connection smu_check_connection(...)``.
+   like ``EX Single_Point_Bias smu_check_connection(...)``.
 2. ``CheckConnectionStreamer.run_batch`` sends the EX command using
    ``KXCIClient._execute_ex_command``. When the UL module finishes, we query
-   the output buffers (parameters 8 and 6) to retrieve the latest measurement.
+   the ring Control array (parameter 10) and the output buffers (parameters
+   8 and 6) to retrieve the newest measurement.
 3. By default the script loops forever, issuing EX → GP → print as quickly as
    allowed. This gives a near real-time feed while you probe or adjust a DUT.
    Press Ctrl+C to stop the stream. Use ``--once`` to capture a single sample.
 4. The script depends on the shared ``KXCIClient`` from ``run_smu_vi_sweep``,
    so it inherits the same visa connection handling, UL entry/exit, etc.
+5. ``--follow`` takes ``--max-samples`` readings in bounded batches: each EX
+   runs the module for up to ``--buffer-size`` samples (``StreamMode = 2``,
+   nothing printed), waits for it to return, then reads the whole batch from
+   the ring with GP 10/6/8. KXCI does not answer GP while an EX is running, so
+   the ring is never polled mid-run. Sequence numbers continue across batches;
+   the bias is re-applied (with ``--settle-time``) at the start of each one.
+6. ``--until-stable N`` qualifies a contact: the module stops by itself once N
+   consecutive readings agree within ``--stable-tolerance`` and exceed
+   ``--min-current``, and the settled current and time to settle are printed.
 
 Command-line usage
 ==================
@@ -29,6 +39,9 @@ Key options:
 * ``--once``: Take a single sample and exit (instead of continuous streaming)
 * ``--pause``: Delay between repeated EX commands when streaming (default 50ms)
 * ``--json``: Emit samples as JSON objects instead of human-readable text
+* ``--follow``: Read ``--max-samples`` samples in batches of ``--buffer-size``
+* ``--max-samples``: Total samples for ``--follow`` / limit for ``--until-stable``
+* ``--until-stable``: Stop on N stable readings and report settled current/time
 
 Example
 =======
@@ -62,7 +75,18 @@ except ImportError as exc:  # pragma: no cover
         "is present."
     ) from exc
 
-from connection_check_runner import build_check_connection_command, execute_single_sample
+from connection_check_runner import (  # noqa: F401  (re-exported for callers/tests)
+    RingSnapshot,
+    STREAM_LINES,
+    STREAM_NONE,
+    build_check_connection_command,
+    execute_batch,
+    execute_single_sample,
+    latest_sample_from_buffers,
+    parse_stream_frame,
+    qualify_contact,
+    samples_since,
+)
 
 
 class CheckConnectionStreamer:
@@ -98,6 +122,40 @@ class CheckConnectionStreamer:
 
         return True
 
+    def follow(self, config: dict, emit_json: bool, pause: float) -> None:
+        """Take ``config["max_samples"]`` samples as bounded EX → GP batches."""
+
+        total = config["max_samples"]
+        taken = 0
+        while taken < total:
+            try:
+                samples = execute_batch(
+                    self.controller,
+                    num_samples=min(config["buffer_size"], total - taken),
+                    first_sequence=taken,
+                    bias_voltage=config["bias"],
+                    sample_interval=config["sample_interval"],
+                    settle_time=config["settle_time"],
+                    ilimit=config["ilimit"],
+                    integration_time=config["integration_time"],
+                    buffer_size=config["buffer_size"],
+                    clarius_debug=config["debug"],
+                )
+            except Exception as exc:  # pragma: no cover
+                print(f"[WARN] Batch failed: {exc}")
+                return
+            if not samples:
+                print("[WARN] Batch returned no samples")
+                return
+            for sample in samples:
+                if emit_json:
+                    print(json.dumps({"seq": sample.sequence, "voltage": sample.voltage, "current": sample.current}))
+                else:
+                    print(f"[{sample.sequence:06d}] V={sample.voltage: .6f} V | I={sample.current: .6e} A")
+            taken = samples[-1].sequence + 1
+            if pause > 0 and taken < total:
+                time.sleep(pause)
+
 
 def main() -> None:
     parser = argparse.ArgumentParser(
@@ -112,6 +170,11 @@ def main() -> None:
     parser.add_argument("--ilimit", type=float, default=0.01)
     parser.add_argument("--integration-time", type=float, default=0.01)
     parser.add_argument("--buffer-size", type=int, default=8, help="Circular buffer size in the UL module")
+    parser.add_argument("--follow", action="store_true", help="Read --max-samples samples in EX/GP batches of --buffer-size")
+    parser.add_argument("--max-samples", type=int, default=200, help="Samples to take with --follow; sample limit for --until-stable")
+    parser.add_argument("--until-stable", type=int, default=0, help="Stop once N consecutive readings are stable (0 = off)")
+    parser.add_argument("--stable-tolerance", type=float, default=0.05, help="Allowed spread as a fraction of the mean current")
+    parser.add_argument("--min-current", type=float, default=1e-9, help="Readings below this |I| (A) never count as stable")
     parser.add_argument("--pause", type=float, default=0.05, help="Pause between batches when looping")
     parser.add_argument("--once", action="store_true", help="Take a single sample then exit")
     parser.add_argument("--debug", action="store_true")
@@ -122,8 +185,12 @@ def main() -> None:
 
     if args.buffer_size < 1:
         parser.error("buffer-size must be >= 1")
+    if args.max_samples < 1:
+        parser.error("max-samples must be >= 1")
     if args.pause < 0:
         parser.error("pause must be >= 0")
+    if args.until_stable and not 1 <= args.until_stable <= args.buffer_size:
+        parser.error("until-stable must be between 1 and buffer-size")
 
     sample_config = {
         "bias": args.bias_voltage,
@@ -133,6 +200,7 @@ def main() -> None:
         "integration_time": args.integration_time,
         "debug": 1 if args.debug else 0,
         "buffer_size": args.buffer_size,
+        "max_samples": args.max_samples,
     }
     preview = build_check_connection_command(
         bias_voltage=args.bias_voltage,
@@ -141,8 +209,12 @@ def main() -> None:
         ilimit=args.ilimit,
         integration_time=args.integration_time,
         buffer_size=args.buffer_size,
-        max_samples=1,
+        max_samples=args.max_samples if args.until_stable else (min(args.buffer_size, args.max_samples) if args.follow else 1),
         clarius_debug=sample_config["debug"],
+        stream_mode=STREAM_NONE if (args.follow or args.until_stable) else STREAM_LINES,
+        stable_count=args.until_stable,
+        stable_tolerance=args.stable_tolerance,
+        min_current=args.min_current,
     )
 
     if args.dry_run:
@@ -160,7 +232,31 @@ def main() -> None:
         streamer = CheckConnectionStreamer(controller=controller, buffer_size=args.buffer_size)
 
         try:
-            if args.once:
+            if args.until_stable:
+                result = qualify_contact(
+                    controller,
+                    stable_count=args.until_stable,
+                    stable_tolerance=args.stable_tolerance,
+                    min_current=args.min_current,
+                    max_samples=args.max_samples,
+                    bias_voltage=args.bias_voltage,
+                    sample_interval=args.sample_interval,
+                    settle_time=args.settle_time,
+                    ilimit=args.ilimit,
+                    integration_time=args.integration_time,
+                    buffer_size=args.buffer_size,
+                    clarius_debug=sample_config["debug"],
+                )
+                if args.json:
+                    print(json.dumps(result))
+                elif result["stable"]:
+                    print(f"[STABLE] I={result['current']: .6e} A after {result['settle_time']:.3f} s ({result['total_samples']} samples)")
+                else:
+                    print(f"[UNSTABLE] last I={result['current']: .6e} A after {result['total_samples']} samples")
+            elif args.follow:
+                print(f"[INFO] Reading {args.max_samples} samples in batches of {args.buffer_size} (Ctrl+C to stop)")
+                streamer.follow(sample_config, emit_json=args.json, pause=args.pause)
+            elif args.once:
                 streamer.run_batch(sample_config, emit_json=args.json)
             else:
                 print("[INFO] Streaming measurements (Ctrl+C to stop)")
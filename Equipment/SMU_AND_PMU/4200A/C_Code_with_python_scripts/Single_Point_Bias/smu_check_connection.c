@@ -2,7 +2,7 @@
 
 	MODULE NAME: smu_check_connection
 	MODULE RETURN TYPE: int
-	NUMBER OF PARMS: 11
+	NUMBER OF PARMS: 19
 	ARGUMENTS:
 		BiasVoltage,	double,	Input,	0.2,	-200,	200
 		SampleInterval,	double,	Input,	0.1,	0.0001,	10
@@ -13,6 +13,14 @@
 		NumISamples,	int,	Input,	256,	4,	4096
 		Vbuffer,	D_ARRAY_T,	Output,	,	,	
 		NumVSamples,	int,	Input,	256,	4,	4096
+		Control,	D_ARRAY_T,	Output,	,	,	
+		NumControl,	int,	Input,	7,	4,	16
+		StreamMode,	int,	Input,	0,	0,	2
+		BatchSamples,	int,	Input,	32,	1,	256
+		BatchInterval,	double,	Input,	0.05,	0,	10
+		StableCount,	int,	Input,	0,	0,	4096
+		StableTolerance,	double,	Input,	0.05,	0,	10
+		MinCurrent,	double,	Input,	0,	0,	1
 		MaxSamples,	int,	Input,	0,	0,	1000000
 		ClariusDebug,	int,	Input,	0,	0,	1
 	INCLUDES:
@@ -29,13 +37,31 @@ Continuous SMU Bias Monitor
 ===========================
 
 Applies a fixed DC bias (default 0.2 V) and repetitively measures current while
-printing each data point to stdout in the format:
+printing the data to stdout. These lines appear immediately in the KXCI console
+(and on the GPIB link), so an automation client can capture real-time readings
+without issuing GP commands while the UL program is still running.
 
-    DATA <voltage> <current>
+StreamMode selects the stdout format:
+- 0: one line per sample, flushed every sample (original format)
 
-These lines appear immediately in the KXCI console (and on the GPIB link), so an
-automation client can capture real-time readings without issuing GP commands
-while the UL program is still running.
+      DATA <voltage> <current>
+
+- 1: batched frames. Samples are collected and written as one line when
+  BatchSamples samples are pending or BatchInterval seconds have passed since
+  the first pending sample, whichever comes first (and once more on exit).
+  BatchInterval = 0 sends on sample count only:
+
+      FRAME <seq> <n> <t_ms> <bias> <dt>:<current>:<dv> ... *<xx>
+
+  seq is the sequence number of the first sample (same numbering as the ring,
+  so a gap between frames means lost output), n the number of samples, t_ms
+  the time of the first sample (ms since bias applied). Each sample is dt (ms
+  since the previous sample in the frame, 0 for the first), current (A) and
+  dv (measured voltage - bias, in uV). xx is the XOR of every character
+  before '*', in hex.
+- 2: no stdout data; read the ring (below) instead.
+
+In modes 0 and 1 an auto-stop (below) ends with `STABLE <current> <t_s> <samples>`.
 
 Parameters:
 - `SampleInterval` controls how often the measurement loop runs (seconds).
@@ -43,10 +69,34 @@ Parameters:
 - `MaxSamples = 0` means run indefinitely; any positive value limits the number
   of samples before the module exits automatically.
 
-Buffered Output:
-Measurements are still written into the supplied Ibuffer/Vbuffer circular
-buffers (NumISamples/NumVSamples) so that, after the module exits, the host can
-issue GP 6/8 to retrieve the latest samples if desired.
+Stable-contact auto-stop:
+With StableCount = N > 0 the module stops as soon as the last N readings all
+have |I| >= MinCurrent and lie within a band of StableTolerance x |mean|
+(max - min, e.g. 0.05 = 5 %). The mean of those N readings is reported in
+Control[5] and the time the criterion was met in Control[6]; Control[3] is
+set to 3. If MaxSamples runs out first, Control[3] is 2 and Control[6] stays
+-1. N must not exceed NumISamples and NumControl must be >= 7.
+
+Buffered Output (ring):
+Measurements are also written into the Ibuffer/Vbuffer ring (NumISamples
+slots). Sample number s (0, 1, 2, ...) lives in slot s % NumISamples. The
+Control array (GP 10) publishes the ring state:
+
+    Control[0]  head: number of samples written so far (next sequence number)
+    Control[1]  write index: slot the next sample goes into
+    Control[2]  ring size (NumISamples)
+    Control[3]  state: 1 = running, 2 = finished, 3 = stable (auto-stop),
+                < 0 = error code
+    Control[4]  time of the newest sample (s since bias applied), if NumControl >= 5
+    Control[5]  settled current (A), if NumControl >= 7
+    Control[6]  time to settle (s since bias applied, -1 = not settled)
+
+The slot is written before head is advanced, so every sample below head is
+complete. To pull only new samples while the monitor runs: read head, read
+GP 6/8, read head again; samples with sequence >= (head after - ring size)
+were not overwritten during the read and are valid. After the module exits
+the same rule gives the newest NumISamples samples and whether the ring
+wrapped (head > NumISamples).
 
 END USRLIB MODULE HELP DESCRIPTION */
 
@@ -55,6 +105,43 @@ END USRLIB MODULE HELP DESCRIPTION */
 #include <stdio.h>
 #include <string.h>
 
+/* Control array layout (GP 10) */
+#define RING_CTRL_HEAD 0
+#define RING_CTRL_WRITE_INDEX 1
+#define RING_CTRL_SIZE 2
+#define RING_CTRL_STATE 3
+#define RING_CTRL_LAST_TIME 4
+#define RING_CTRL_SETTLED_CURRENT 5
+#define RING_CTRL_SETTLE_TIME 6
+#define RING_CTRL_MIN 4
+#define RING_CTRL_MIN_STABLE 7
+
+#define RING_STATE_RUNNING 1.0
+#define RING_STATE_FINISHED 2.0
+#define RING_STATE_STABLE 3.0
+
+/* StreamMode */
+#define STREAM_LINES 0
+#define STREAM_FRAMES 1
+#define STREAM_NONE 2
+
+#define FRAME_MAX_SAMPLES 256
+#define FRAME_SAMPLE_CHARS 40
+#define FRAME_HEADER_CHARS 96
+
+typedef struct
+{
+    char text[FRAME_HEADER_CHARS + FRAME_MAX_SAMPLES * FRAME_SAMPLE_CHARS];
+    int len;
+    int count;
+    long first_seq;
+    DWORD first_ms;
+    DWORD last_ms;
+} stream_frame_t;
+
+/* Frame buffer is too large for the UL stack */
+static stream_frame_t g_frame;
+
 static void sleep_seconds(double seconds)
 {
     if (seconds <= 0.0)
@@ -71,6 +158,79 @@ static void sleep_seconds(double seconds)
     Sleep(ms);
 }
 
+static void frame_reset(stream_frame_t *frame)
+{
+    frame->len = 0;
+    frame->count = 0;
+}
+
+static void frame_add(stream_frame_t *frame, long seq, DWORD t_ms, double bias, double voltage, double current)
+{
+    if (frame->count == 0)
+    {
+        frame->first_seq = seq;
+        frame->first_ms = t_ms;
+        frame->last_ms = t_ms;
+    }
+    frame->len += sprintf(frame->text + frame->len, " %lu:%.4e:%ld",
+                          (unsigned long)(t_ms - frame->last_ms), current,
+                          (long)floor((voltage - bias) * 1e6 + 0.5));
+    frame->last_ms = t_ms;
+    frame->count++;
+}
+
+/* One line, one fflush per frame */
+static void frame_emit(stream_frame_t *frame, double bias)
+{
+    char header[FRAME_HEADER_CHARS];
+    unsigned int checksum = 0;
+    int i;
+
+    if (frame->count == 0)
+        return;
+
+    sprintf(header, "FRAME %ld %d %lu %.6f", frame->first_seq, frame->count,
+            (unsigned long)frame->first_ms, bias);
+    for (i = 0; header[i] != '\0'; i++)
+        checksum ^= (unsigned char)header[i];
+    for (i = 0; i < frame->len; i++)
+        checksum ^= (unsigned char)frame->text[i];
+
+    printf("%s%s *%02X\n", header, frame->text, checksum & 0xFF);
+    fflush(stdout);
+    frame_reset(frame);
+}
+
+/* Last `count` ring samples ending just before `write_index`: all |I| >= min_current
+   and max - min <= tolerance * |mean|. Returns 1 and the mean when stable. */
+static int ring_is_stable(volatile double *ring, int size, int write_index, int count,
+                          double tolerance, double min_current, double *mean_out)
+{
+    double lo = 0.0;
+    double hi = 0.0;
+    double sum = 0.0;
+    double mean;
+    int k;
+
+    for (k = 1; k <= count; k++)
+    {
+        double value = ring[(write_index - k + size) % size];
+        if (fabs(value) < min_current)
+            return 0;
+        if (k == 1 || value < lo)
+            lo = value;
+        if (k == 1 || value > hi)
+            hi = value;
+        sum += value;
+    }
+
+    mean = sum / count;
+    if (hi - lo > tolerance * fabs(mean))
+        return 0;
+    *mean_out = mean;
+    return 1;
+}
+
 int smu_check_connection(double BiasVoltage,
                          double SampleInterval,
                          double SettleTime,
@@ -80,6 +240,14 @@ int smu_check_connection(double BiasVoltage,
                          int NumISamples,
                          double *Vbuffer,
                          int NumVSamples,
+                         double *Control,
+                         int NumControl,
+                         int StreamMode,
+                         int BatchSamples,
+                         double BatchInterval,
+                         int StableCount,
+                         double StableTolerance,
+                         double MinCurrent,
                          int MaxSamples,
                          int ClariusDebug)
 {
@@ -87,8 +255,18 @@ int smu_check_connection(double BiasVoltage,
     int debug;
     int write_index = 0;
     long sample_count = 0;
+    /* Host may read the ring while we write: volatile keeps the store order */
+    volatile double *ring_i = Ibuffer;
+    volatile double *ring_v = Vbuffer;
+    volatile double *ring_ctrl = Control;
+    DWORD start_ticks;
+    DWORD sample_ms = 0;
+    DWORD batch_ms;
+    DWORD loop_ms;
     double measured_current = 0.0;
     double measured_voltage = 0.0;
+    double settled_current = 0.0;
+    int stable = 0;
     const double compliance_threshold = Ilimit * 0.99;
     long target_samples;
 
@@ -143,11 +321,51 @@ int smu_check_connection(double BiasVoltage,
         return -3;
     }
 
+    if (NumControl < RING_CTRL_MIN)
+    {
+        if (debug)
+            printf("smu_check_connection ERROR: NumControl (%d) must be >= %d\n", NumControl, RING_CTRL_MIN);
+        return -4;
+    }
+
+    if (StreamMode < STREAM_LINES || StreamMode > STREAM_NONE)
+    {
+        if (debug)
+            printf("smu_check_connection INFO: StreamMode %d unknown, using 0\n", StreamMode);
+        StreamMode = STREAM_LINES;
+    }
+
+    if (BatchSamples < 1 || BatchSamples > FRAME_MAX_SAMPLES)
+    {
+        if (debug)
+            printf("smu_check_connection INFO: BatchSamples clamped to [1, %d]\n", FRAME_MAX_SAMPLES);
+        BatchSamples = (BatchSamples < 1) ? 1 : FRAME_MAX_SAMPLES;
+    }
+
+    if (StableCount < 0)
+        StableCount = 0;
+    if (StableCount > NumISamples || (StableCount > 0 && NumControl < RING_CTRL_MIN_STABLE))
+    {
+        if (debug)
+            printf("smu_check_connection ERROR: StableCount (%d) needs <= NumISamples (%d) and NumControl >= %d\n",
+                   StableCount, NumISamples, RING_CTRL_MIN_STABLE);
+        return -8;
+    }
+    if (StableTolerance < 0.0)
+        StableTolerance = 0.0;
+
+    batch_ms = (BatchInterval > 0.0) ? (DWORD)(BatchInterval * 1000.0) : 0;
+    loop_ms = (DWORD)((SampleInterval + SettleTime) * 1000.0);
     target_samples = (MaxSamples <= 0) ? -1 : MaxSamples;
+    frame_reset(&g_frame);
 
     /* Initialize buffers */
     memset(Ibuffer, 0, sizeof(double) * NumISamples);
     memset(Vbuffer, 0, sizeof(double) * NumVSamples);
+    memset(Control, 0, sizeof(double) * NumControl);
+    ring_ctrl[RING_CTRL_SIZE] = (double)NumISamples;
+    if (NumControl > RING_CTRL_SETTLE_TIME)
+        ring_ctrl[RING_CTRL_SETTLE_TIME] = -1.0;
 
     status = setmode(SMU1, KI_INTGPLC, IntegrationTime);
     if (status != 0 && debug)
@@ -160,6 +378,7 @@ int smu_check_connection(double BiasVoltage,
     {
         if (debug)
             printf("smu_check_connection ERROR: limiti() failed with status %d\n", status);
+        ring_ctrl[RING_CTRL_STATE] = -5.0;
         return -5;
     }
 
@@ -172,9 +391,15 @@ int smu_check_connection(double BiasVoltage,
         printf("  Ilimit          : %.6e A\n", Ilimit);
         printf("  IntegrationTime : %.6f PLC\n", IntegrationTime);
         printf("  Buffer Size     : %d samples\n", NumISamples);
+        printf("  StreamMode      : %d (batch %d samples / %.3f s)\n", StreamMode, BatchSamples, BatchInterval);
+        if (StableCount > 0)
+            printf("  Auto-stop       : %d readings within %.3g, |I| >= %.3e A\n", StableCount, StableTolerance, MinCurrent);
         printf("======================================================\n");
     }
 
+    ring_ctrl[RING_CTRL_STATE] = RING_STATE_RUNNING;
+    start_ticks = GetTickCount();
+
     while ((target_samples < 0) || (sample_count < target_samples))
     {
         status = forcev(SMU1, BiasVoltage);
@@ -183,6 +408,8 @@ int smu_check_connection(double BiasVoltage,
             if (debug)
                 printf("smu_check_connection ERROR: forcev() failed with status %d\n", status);
             forcev(SMU1, 0.0);
+            frame_emit(&g_frame, BiasVoltage);
+            ring_ctrl[RING_CTRL_STATE] = -6.0;
             return -6;
         }
 
@@ -194,6 +421,8 @@ int smu_check_connection(double BiasVoltage,
             if (debug)
                 printf("smu_check_connection ERROR: measi() failed with status %d\n", status);
             forcev(SMU1, 0.0);
+            frame_emit(&g_frame, BiasVoltage);
+            ring_ctrl[RING_CTRL_STATE] = -7.0;
             return -7;
         }
 
@@ -210,8 +439,8 @@ int smu_check_connection(double BiasVoltage,
             printf("smu_check_connection WARNING: Compliance hit (|I|=%.6e A)\n", measured_current);
         }
 
-        Ibuffer[write_index] = measured_current;
-        Vbuffer[write_index] = measured_voltage;
+        ring_i[write_index] = measured_current;
+        ring_v[write_index] = measured_voltage;
 
         write_index++;
         if (write_index >= NumISamples)
@@ -219,10 +448,40 @@ int smu_check_connection(double BiasVoltage,
             write_index = 0;
         }
 
-        printf("DATA %.6f %.6e\n", measured_voltage, measured_current);
-        fflush(stdout);
+        /* Publish: data first, head last, so a reader never sees a head that
+           points past an unwritten slot */
+        sample_ms = GetTickCount() - start_ticks;
+        if (NumControl > RING_CTRL_LAST_TIME)
+            ring_ctrl[RING_CTRL_LAST_TIME] = (double)sample_ms / 1000.0;
+        ring_ctrl[RING_CTRL_WRITE_INDEX] = (double)write_index;
+        ring_ctrl[RING_CTRL_HEAD] = (double)(sample_count + 1);
+
+        if (StreamMode == STREAM_LINES)
+        {
+            printf("DATA %.6f %.6e\n", measured_voltage, measured_current);
+            fflush(stdout);
+        }
+        else if (StreamMode == STREAM_FRAMES)
+        {
+            frame_add(&g_frame, sample_count, sample_ms, BiasVoltage, measured_voltage, measured_current);
+            /* Send now if the next sample would land past the batch deadline,
+               so no sample waits longer than BatchInterval */
+            if (g_frame.count >= BatchSamples ||
+                (batch_ms > 0 && sample_ms + loop_ms - g_frame.first_ms > batch_ms))
+                frame_emit(&g_frame, BiasVoltage);
+        }
 
         sample_count++;
+
+        if (StableCount > 0 && sample_count >= StableCount &&
+            ring_is_stable(ring_i, NumISamples, write_index, StableCount, StableTolerance, MinCurrent, &settled_current))
+        {
+            ring_ctrl[RING_CTRL_SETTLED_CURRENT] = settled_current;
+            ring_ctrl[RING_CTRL_SETTLE_TIME] = (double)sample_ms / 1000.0;
+            stable = 1;
+            break;
+        }
+
         if ((target_samples < 0) || (sample_count < target_samples))
         {
             sleep_seconds(SampleInterval);
@@ -230,6 +489,13 @@ int smu_check_connection(double BiasVoltage,
     }
 
     forcev(SMU1, 0.0);
+    frame_emit(&g_frame, BiasVoltage);
+    if (stable && StreamMode != STREAM_NONE)
+    {
+        printf("STABLE %.6e %.3f %ld\n", settled_current, (double)sample_ms / 1000.0, sample_count);
+        fflush(stdout);
+    }
+    ring_ctrl[RING_CTRL_STATE] = stable ? RING_STATE_STABLE : RING_STATE_FINISHED;
     if (debug)
         printf("smu_check_connection INFO: Output disabled, returning\n");
 
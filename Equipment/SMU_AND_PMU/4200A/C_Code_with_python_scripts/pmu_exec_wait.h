@@ -0,0 +1,61 @@
+/* Adaptive pulse_exec() completion wait for the PMU waveform-capture modules.
+ * Copy next to the module source (or into the KULT include directory) and
+ * include from USRLIB modules only.
+ *
+ * Polling pulse_exec_status() every 100 ms and then sleeping 50 ms "for the
+ * data" costs every capture at least 150 ms, and a fixed poll count caps
+ * the capture length. The programmed duration is known before pulse_exec(),
+ * so pmu_exec_wait() sleeps through most of it in one go, then polls with
+ * an interval that starts at 1 ms and doubles up to PMU_EXEC_POLL_MAX_MS.
+ * The timeout scales with the duration. A 50 us capture returns after a
+ * millisecond or two; a 60 s capture no longer fails with -998.
+ *
+ * pulse_exec_status() reporting completion means the data can be fetched;
+ * no extra settling delay is added. */
+
+#ifndef PMU_EXEC_WAIT_H
+#define PMU_EXEC_WAIT_H
+
+#include <windows.h>
+
+#define PMU_EXEC_PREDICT_FRAC 0.9     /* part of the duration slept unpolled */
+#define PMU_EXEC_POLL_MAX_MS 20       /* longest poll interval */
+#define PMU_EXEC_TIMEOUT_FACTOR 2.0   /* timeout = factor * duration + min */
+#define PMU_EXEC_TIMEOUT_MIN_MS 2000  /* covers arming and setup overhead */
+
+/* Wait for the test started by pulse_exec() to finish. duration is the
+ * programmed run time in seconds (longest channel). *elapsed gets the wait
+ * in seconds. Returns 0, or -998 on timeout. */
+static inline int pmu_exec_wait(double duration, double *elapsed)
+{
+  DWORD start = GetTickCount();
+  DWORD poll = 1;
+  double predict_ms, timeout_ms;
+  double t;
+  int status = 0;
+
+  if (duration < 0.0)
+    duration = 0.0;
+  predict_ms = duration * 1000.0 * PMU_EXEC_PREDICT_FRAC;
+  timeout_ms = duration * 1000.0 * PMU_EXEC_TIMEOUT_FACTOR + PMU_EXEC_TIMEOUT_MIN_MS;
+
+  if (predict_ms >= 2.0)
+    Sleep((DWORD)predict_ms);
+
+  while (pulse_exec_status(&t) == 1)
+  {
+    if ((double)(GetTickCount() - start) > timeout_ms)
+    {
+      status = -998;
+      break;
+    }
+    Sleep(poll);
+    if (poll < PMU_EXEC_POLL_MAX_MS)
+      poll *= 2;
+  }
+
+  *elapsed = (GetTickCount() - start) / 1000.0;
+  return status;
+}
+
+#endif /* PMU_EXEC_WAIT_H */
@@ -0,0 +1,557 @@
+/* Per-pulse window averaging for the PMU waveform-capture modules.
+ * Copy next to the module source (or into the KULT include directory) and
+ * include from USRLIB modules only.
+ *
+ * A captured burst is burstCount identical pulses, one per period. Only the
+ * measured segments (rise, width, fall) are sampled, so the first sample is
+ * the start of the first rise and pulse k starts k * period later. The
+ * extractor reduces the fetched samples to one averaged V / I / t per pulse
+ * from a window inside the flat top (40-80% of the width by default) in a
+ * single forward pass, with no per-pulse rescan of the waveform:
+ *
+ *   time path:      a sample's pulse index and its offset inside the period
+ *                   follow directly from its timestamp, so each sample is
+ *                   either added to its pulse's window or skipped
+ *   threshold path: a pulse starts where |V| rises above the threshold; its
+ *                   window is the same programmed 40-80% span measured from
+ *                   that edge, and the pulse ends where |V| falls back
+ *
+ * Both paths run on every sample. The module keeps the threshold result when
+ * it found every pulse, and the time result otherwise. Samples can be fed in
+ * any number of consecutive blocks; pmu_pulse_extract_fetch() streams them
+ * from the card in fixed-size pulse_fetch() blocks, so memory does not grow
+ * with the capture length.
+ *
+ * Optionally (pmu_pulse_extract_features) the same pass fills a feature
+ * table with one row of PMU_FEATURE_COLS values per pulse k (time path):
+ *
+ *   [0] t_start   time of the pulse's first sample (s)
+ *   [1] I_peak    current of largest magnitude (A)
+ *   [2] t_switch  time of the steepest current step on the flat top,
+ *                 from the start of the flat top (s)
+ *   [3] Q         charge, trapezoidal integral of I dt over the pulse (C)
+ *   [4] t_rise    10-90% rise time of |I| up to the peak (s)
+ *
+ * so the host reads 5 values per pulse instead of the full waveform.
+ *
+ * For low-current captures pmu_wave_avg averages M runs of the same armed
+ * test sample by sample before extraction. Every run starts on the same
+ * trigger, so sample i of each pulse_fetch() is the same point of the
+ * waveform; the running mean (Welford, optionally with the variance of I)
+ * is kept in one set of buffers and only the averaged trace is extracted.
+ * Noise drops by sqrt(M) at the cost of M executions and one extraction.
+ * The running mean and m2 stay double: they are updated M times, and float
+ * rounding on every update would bias the variance of small currents. */
+
+#ifndef PMU_PULSE_EXTRACT_H
+#define PMU_PULSE_EXTRACT_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PMU_FETCH_CHUNK 10000     /* samples per pulse_fetch() block */
+#define PMU_FEATURE_COLS 5        /* feature table columns, see above */
+#define PMU_FEATURE_BUF 4096      /* |I| samples kept per pulse for t_rise */
+#define PMU_AVG_MAX_SAMPLES 1000000  /* longest capture pmu_wave_avg holds */
+
+typedef struct
+{
+  /* configuration */
+  double period;       /* pulse period (s) */
+  double win_start;    /* window start, from the start of the rise (s) */
+  double win_stop;     /* window stop, from the start of the rise (s) */
+  double edge_start;   /* window start, from the threshold crossing (s) */
+  double edge_stop;    /* window stop, from the threshold crossing (s) */
+  double threshold;    /* |V| threshold of the threshold path */
+  double rise, width;
+  double i_offset;     /* subtracted from every current sample (default 0) */
+  int num_pulses;
+  int max_out;
+
+  /* time path */
+  int started;
+  double t_first;
+  int t_pulse;
+  double t_sumV, t_sumI, t_sumT;
+  int t_count;
+  double *t_V, *t_I, *t_T;
+  int t_out;
+
+  /* threshold path */
+  int in_pulse;
+  double h_edge;
+  double h_firstV, h_firstI, h_firstT;
+  double h_sumV, h_sumI, h_sumT;
+  int h_count;
+  int h_pulses;
+  double *h_V, *h_I, *h_T;
+  int h_out;
+
+  /* features (f_table NULL when off) */
+  double *f_table;
+  int f_rows;
+  int f_pulse;         /* pulse the running values belong to, -1 = none */
+  double f_t0, f_prevT, f_prevI;
+  double f_peak, f_maxd, f_switch, f_q;
+  double *f_bufT, *f_bufI;  /* decimated |I| trace for the rise time */
+  int f_n, f_step, f_skip;
+} pmu_pulse_extract;
+
+/* Set up for num_pulses pulses of the given timing. The window is
+ * [start_frac, stop_frac] of width. Threshold results go to h_V/h_I/h_T,
+ * time results to t_V/t_I/t_T; each holds max_out values. */
+static inline void pmu_pulse_extract_init(pmu_pulse_extract *x, double period, double rise,
+                                          double width, double fall, double start_frac,
+                                          double stop_frac, double threshold, int num_pulses,
+                                          double *h_V, double *h_I, double *h_T,
+                                          double *t_V, double *t_I, double *t_T, int max_out)
+{
+  /* a 50% threshold crossing sits half way up the rise */
+  double edge_width = 0.5 * rise + width + 0.5 * fall;
+
+  x->period = period;
+  x->win_start = rise + width * start_frac;
+  x->win_stop = rise + width * stop_frac;
+  x->edge_start = edge_width * start_frac;
+  x->edge_stop = edge_width * stop_frac;
+  x->threshold = threshold;
+  x->rise = rise;
+  x->width = width;
+  x->i_offset = 0.0;
+  x->num_pulses = num_pulses;
+  x->max_out = max_out;
+
+  x->started = 0;
+  x->t_first = 0.0;
+  x->t_pulse = 0;
+  x->t_sumV = x->t_sumI = x->t_sumT = 0.0;
+  x->t_count = 0;
+  x->t_V = t_V;
+  x->t_I = t_I;
+  x->t_T = t_T;
+  x->t_out = 0;
+
+  x->in_pulse = 0;
+  x->h_edge = 0.0;
+  x->h_firstV = x->h_firstI = x->h_firstT = 0.0;
+  x->h_sumV = x->h_sumI = x->h_sumT = 0.0;
+  x->h_count = 0;
+  x->h_pulses = 0;
+  x->h_V = h_V;
+  x->h_I = h_I;
+  x->h_T = h_T;
+  x->h_out = 0;
+
+  x->f_table = NULL;
+  x->f_rows = 0;
+  x->f_pulse = -1;
+  x->f_t0 = x->f_prevT = x->f_prevI = 0.0;
+  x->f_peak = x->f_maxd = x->f_switch = x->f_q = 0.0;
+  x->f_bufT = NULL;
+  x->f_bufI = NULL;
+  x->f_n = 0;
+  x->f_step = 1;
+  x->f_skip = 0;
+}
+
+/* Fill table (rows x PMU_FEATURE_COLS, row-major, zeroed here) during the
+ * pass. Call after pmu_pulse_extract_init(); returns 0 or -999. */
+static inline int pmu_pulse_extract_features(pmu_pulse_extract *x, double *table, int rows)
+{
+  memset(table, 0, (size_t)rows * PMU_FEATURE_COLS * sizeof(double));
+  x->f_bufT = (double *)calloc(PMU_FEATURE_BUF, sizeof(double));
+  x->f_bufI = (double *)calloc(PMU_FEATURE_BUF, sizeof(double));
+  if (x->f_bufT == NULL || x->f_bufI == NULL)
+  {
+    if (x->f_bufT) free(x->f_bufT);
+    if (x->f_bufI) free(x->f_bufI);
+    x->f_bufT = x->f_bufI = NULL;
+    return -999;
+  }
+  x->f_table = table;
+  x->f_rows = rows;
+  return 0;
+}
+
+/* Write the feature row of the current pulse */
+static inline void pmu_pulse_extract_flush_features(pmu_pulse_extract *x)
+{
+  double *row, t10 = 0.0, t90 = 0.0, a;
+  int j, have10 = 0;
+
+  if (x->f_table == NULL || x->f_pulse < 0)
+    return;
+
+  /* 10% and 90% crossings of |I| before the peak */
+  a = fabs(x->f_peak);
+  for (j = 0; j < x->f_n; j++)
+  {
+    if (!have10 && x->f_bufI[j] >= 0.1 * a)
+    {
+      t10 = x->f_bufT[j];
+      have10 = 1;
+    }
+    if (x->f_bufI[j] >= 0.9 * a)
+    {
+      t90 = x->f_bufT[j];
+      break;
+    }
+  }
+
+  row = x->f_table + (size_t)x->f_pulse * PMU_FEATURE_COLS;
+  row[0] = x->f_t0;
+  row[1] = x->f_peak;
+  row[2] = x->f_switch;
+  row[3] = x->f_q;
+  row[4] = (have10 && t90 > t10) ? t90 - t10 : 0.0;
+  x->f_pulse = -1;
+}
+
+/* Add one sample of pulse k (offset = time from the start of its rise) */
+static inline void pmu_pulse_extract_add_feature(pmu_pulse_extract *x, int k, double offset,
+                                                 double I, double T)
+{
+  double d;
+  int j;
+
+  if (k != x->f_pulse)
+  {
+    pmu_pulse_extract_flush_features(x);
+    x->f_pulse = k;
+    x->f_t0 = T;
+    x->f_peak = I;
+    x->f_maxd = 0.0;
+    x->f_switch = 0.0;
+    x->f_q = 0.0;
+    x->f_n = 0;
+    x->f_step = 1;
+    x->f_skip = 0;
+  }
+  else
+  {
+    x->f_q += 0.5 * (I + x->f_prevI) * (T - x->f_prevT);
+    if (T > x->f_prevT && offset >= x->rise && offset <= x->rise + x->width)
+    {
+      d = fabs(I - x->f_prevI) / (T - x->f_prevT);
+      if (d > x->f_maxd)
+      {
+        x->f_maxd = d;
+        x->f_switch = 0.5 * (T + x->f_prevT) - x->f_t0 - x->rise;
+      }
+    }
+    if (fabs(I) > fabs(x->f_peak))
+      x->f_peak = I;
+  }
+  x->f_prevT = T;
+  x->f_prevI = I;
+
+  /* keep every f_step-th sample; when full, drop every other one */
+  if (x->f_skip == 0)
+  {
+    if (x->f_n == PMU_FEATURE_BUF)
+    {
+      for (j = 0; j < PMU_FEATURE_BUF / 2; j++)
+      {
+        x->f_bufT[j] = x->f_bufT[2 * j];
+        x->f_bufI[j] = x->f_bufI[2 * j];
+      }
+      x->f_n = PMU_FEATURE_BUF / 2;
+      x->f_step *= 2;
+    }
+    x->f_bufT[x->f_n] = T;
+    x->f_bufI[x->f_n] = fabs(I);
+    x->f_n++;
+  }
+  if (++x->f_skip >= x->f_step)
+    x->f_skip = 0;
+}
+
+/* Close the current time-path pulse; an empty window produces no output */
+static inline void pmu_pulse_extract_flush_time(pmu_pulse_extract *x)
+{
+  if (x->t_count > 0 && x->t_out < x->max_out)
+  {
+    x->t_V[x->t_out] = x->t_sumV / x->t_count;
+    x->t_I[x->t_out] = x->t_sumI / x->t_count;
+    x->t_T[x->t_out] = x->t_sumT / x->t_count;
+    x->t_out++;
+  }
+  x->t_sumV = x->t_sumI = x->t_sumT = 0.0;
+  x->t_count = 0;
+}
+
+/* Close the current threshold-path pulse. A pulse shorter than its window
+ * reports the first sample above the threshold. */
+static inline void pmu_pulse_extract_flush_edge(pmu_pulse_extract *x)
+{
+  if (x->h_out < x->max_out)
+  {
+    if (x->h_count > 0)
+    {
+      x->h_V[x->h_out] = x->h_sumV / x->h_count;
+      x->h_I[x->h_out] = x->h_sumI / x->h_count;
+      x->h_T[x->h_out] = x->h_sumT / x->h_count;
+    }
+    else
+    {
+      x->h_V[x->h_out] = x->h_firstV;
+      x->h_I[x->h_out] = x->h_firstI;
+      x->h_T[x->h_out] = x->h_firstT;
+    }
+    x->h_out++;
+  }
+  x->h_pulses++;
+  x->h_sumV = x->h_sumI = x->h_sumT = 0.0;
+  x->h_count = 0;
+  x->in_pulse = 0;
+}
+
+/* Feed n consecutive samples (timestamps increasing) */
+static inline void pmu_pulse_extract_feed(pmu_pulse_extract *x, const double *V, const double *I,
+                                          const double *T, int n)
+{
+  int i, k;
+  double offset, Ii;
+
+  for (i = 0; i < n; i++)
+  {
+    Ii = I[i] - x->i_offset;
+
+    if (!x->started)
+    {
+      x->t_first = T[i];
+      x->started = 1;
+    }
+
+    /* time path: pulse index and offset straight from the timestamp */
+    offset = T[i] - x->t_first;
+    k = (int)floor(offset / x->period);
+    if (k != x->t_pulse)
+    {
+      pmu_pulse_extract_flush_time(x);
+      x->t_pulse = k;
+    }
+    offset -= k * x->period;
+    if (k < x->num_pulses && offset >= x->win_start && offset <= x->win_stop)
+    {
+      x->t_sumV += V[i];
+      x->t_sumI += Ii;
+      x->t_sumT += T[i];
+      x->t_count++;
+    }
+    if (x->f_table != NULL && k < x->num_pulses && k < x->f_rows)
+      pmu_pulse_extract_add_feature(x, k, offset, Ii, T[i]);
+
+    /* threshold path */
+    if (x->h_pulses >= x->num_pulses)
+      continue;
+    if (!x->in_pulse)
+    {
+      if (fabs(V[i]) > x->threshold)
+      {
+        x->in_pulse = 1;
+        x->h_edge = T[i];
+        x->h_firstV = V[i];
+        x->h_firstI = Ii;
+        x->h_firstT = T[i];
+      }
+    }
+    else if (fabs(V[i]) < x->threshold)
+    {
+      pmu_pulse_extract_flush_edge(x);
+      continue;
+    }
+    if (x->in_pulse)
+    {
+      offset = T[i] - x->h_edge;
+      if (offset >= x->edge_start && offset <= x->edge_stop)
+      {
+        x->h_sumV += V[i];
+        x->h_sumI += Ii;
+        x->h_sumT += T[i];
+        x->h_count++;
+      }
+    }
+  }
+}
+
+/* Close the last time-path pulse after the final block and release the
+ * feature buffers. A threshold pulse still high at the end of the capture
+ * never ended and is not counted. */
+static inline void pmu_pulse_extract_finish(pmu_pulse_extract *x)
+{
+  pmu_pulse_extract_flush_time(x);
+  pmu_pulse_extract_flush_features(x);
+  if (x->f_bufT) free(x->f_bufT);
+  if (x->f_bufI) free(x->f_bufI);
+  x->f_bufT = x->f_bufI = NULL;
+  x->f_table = NULL;
+}
+
+/* Stream samples 0 .. max_samples-1 of chan through x in PMU_FETCH_CHUNK
+ * blocks, reducing each block before fetching the next. The capture ends at
+ * max_samples or at the first timestamp back at 0 after sample 0, whichever
+ * comes first. *num_samples is the number of samples fed. Returns 0, -999
+ * (no memory) or the pulse_fetch() status. */
+static inline int pmu_pulse_extract_fetch(pmu_pulse_extract *x, int pulserId, int chan,
+                                          double max_samples, double *num_samples)
+{
+  double *V, *I, *T;
+  double start = 0.0;
+  int i, n, status = 0, done = 0;
+
+  *num_samples = 0.0;
+  V = (double *)calloc(PMU_FETCH_CHUNK, sizeof(double));
+  I = (double *)calloc(PMU_FETCH_CHUNK, sizeof(double));
+  T = (double *)calloc(PMU_FETCH_CHUNK, sizeof(double));
+  if (V == NULL || I == NULL || T == NULL)
+  {
+    if (V) free(V);
+    if (I) free(I);
+    if (T) free(T);
+    pmu_pulse_extract_finish(x);
+    return -999;
+  }
+
+  while (!done && start < max_samples)
+  {
+    n = PMU_FETCH_CHUNK;
+    if (max_samples - start < n)
+      n = (int)(max_samples - start);
+
+    /* pulse_fetch stop index is inclusive */
+    status = pulse_fetch(pulserId, chan, (long)start, (long)(start + n - 1), V, I, T, NULL);
+    if (status)
+      break;
+
+    for (i = 0; i < n; i++)
+    {
+      if (T[i] == 0.0 && (start > 0.0 || i > 0))
+      {
+        done = 1;
+        break;
+      }
+    }
+    pmu_pulse_extract_feed(x, V, I, T, i);
+    *num_samples += i;
+    start += n;
+  }
+  pmu_pulse_extract_finish(x);
+
+  free(V);
+  free(I);
+  free(T);
+  return status;
+}
+
+typedef struct
+{
+  int max_samples;     /* buffer length */
+  int n;               /* samples present in every run so far */
+  int runs;
+  double *V, *I, *T;   /* running means (T from the first run) */
+  double *m2I;         /* sum of squared deviations of I, NULL when off */
+} pmu_wave_avg;
+
+static inline void pmu_wave_avg_free(pmu_wave_avg *a)
+{
+  if (a->V) free(a->V);
+  if (a->I) free(a->I);
+  if (a->T) free(a->T);
+  if (a->m2I) free(a->m2I);
+  a->V = a->I = a->T = a->m2I = NULL;
+}
+
+/* Buffers for captures of up to max_samples samples; with_var also tracks
+ * the variance of I. Returns 0 or -999. */
+static inline int pmu_wave_avg_init(pmu_wave_avg *a, int max_samples, int with_var)
+{
+  a->max_samples = max_samples;
+  a->n = 0;
+  a->runs = 0;
+  a->V = (double *)calloc(max_samples, sizeof(double));
+  a->I = (double *)calloc(max_samples, sizeof(double));
+  a->T = (double *)calloc(max_samples, sizeof(double));
+  a->m2I = with_var ? (double *)calloc(max_samples, sizeof(double)) : NULL;
+  if (a->V == NULL || a->I == NULL || a->T == NULL || (with_var && a->m2I == NULL))
+  {
+    pmu_wave_avg_free(a);
+    return -999;
+  }
+  return 0;
+}
+
+/* Fetch the capture of the run just executed in PMU_FETCH_CHUNK blocks and
+ * fold it into the running mean. The first run sets the length (up to
+ * max_samples, or the first timestamp back at 0); a later, shorter run
+ * shortens it. Returns 0, -999 (no memory) or the pulse_fetch() status. */
+static inline int pmu_wave_avg_fetch(pmu_wave_avg *a, int pulserId, int chan)
+{
+  double *V, *I, *T;
+  double d, r;
+  int i, n, start = 0, limit, status = 0, done = 0;
+
+  V = (double *)calloc(PMU_FETCH_CHUNK, sizeof(double));
+  I = (double *)calloc(PMU_FETCH_CHUNK, sizeof(double));
+  T = (double *)calloc(PMU_FETCH_CHUNK, sizeof(double));
+  if (V == NULL || I == NULL || T == NULL)
+  {
+    if (V) free(V);
+    if (I) free(I);
+    if (T) free(T);
+    return -999;
+  }
+
+  a->runs++;
+  r = (double)a->runs;
+  limit = (a->runs == 1) ? a->max_samples : a->n;
+  while (!done && start < limit)
+  {
+    n = PMU_FETCH_CHUNK;
+    if (limit - start < n)
+      n = limit - start;
+
+    /* pulse_fetch stop index is inclusive */
+    status = pulse_fetch(pulserId, chan, (long)start, (long)(start + n - 1), V, I, T, NULL);
+    if (status)
+      break;
+
+    for (i = 0; i < n; i++)
+    {
+      if (T[i] == 0.0 && (start > 0 || i > 0))
+      {
+        done = 1;
+        break;
+      }
+      if (a->runs == 1)
+        a->T[start + i] = T[i];
+      a->V[start + i] += (V[i] - a->V[start + i]) / r;
+      d = I[i] - a->I[start + i];
+      a->I[start + i] += d / r;
+      if (a->m2I)
+        a->m2I[start + i] += d * (I[i] - a->I[start + i]);
+    }
+    start += i;
+  }
+  if (status == 0)
+    a->n = start;
+
+  free(V);
+  free(I);
+  free(T);
+  return status;
+}
+
+/* Turn m2I into the sample variance of I over the runs (0 for one run) */
+static inline void pmu_wave_avg_variance(pmu_wave_avg *a)
+{
+  int i;
+
+  if (a->m2I == NULL)
+    return;
+  for (i = 0; i < a->n; i++)
+    a->m2I[i] = (a->runs > 1) ? a->m2I[i] / (a->runs - 1) : 0.0;
+}
+
+#endif /* PMU_PULSE_EXTRACT_H */
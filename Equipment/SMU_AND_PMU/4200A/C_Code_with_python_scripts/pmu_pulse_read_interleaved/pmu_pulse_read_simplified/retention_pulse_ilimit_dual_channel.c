@@ -32,6 +32,8 @@
 		npts,	int *,	Output,	,	,	
 	INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
+#include "pmu_wave_store.h"
 
 double *fstartv = NULL;
 double *fstopv = NULL;
@@ -44,11 +46,11 @@ long *ssrctrl = NULL;
 long *meastypes = NULL;
 long *trig = NULL;
 
-double *pulseV = NULL;
-double *pulseI = NULL; 
+pmu_wave_t *pulseV = NULL;
+pmu_wave_t *pulseI = NULL; 
 double *pulseT = NULL;
-double *MpulseV = NULL;
-double *MpulseI = NULL;
+pmu_wave_t *MpulseV = NULL;
+pmu_wave_t *MpulseI = NULL;
 double *MpulseT = NULL;
 
 static int not_init = 1;
@@ -131,6 +133,7 @@ MeasureIRange
 
 max_pts 
 : The maximum points to be used for data collection. Recommended 10000.
+  Fetched V and I are held as float (pmu_wave_store.h), T as double.
 
 MeasureBias 
 : The voltage bias to be applied on the low (MeasureCh) side.
@@ -213,6 +216,8 @@ Value  | Description
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
+#include "pmu_wave_store.h"
 
 double *fstartv = NULL;
 double *fstopv = NULL;
@@ -225,11 +230,11 @@ long *ssrctrl = NULL;
 long *meastypes = NULL;
 long *trig = NULL;
 
-double *pulseV = NULL;
-double *pulseI = NULL; 
+pmu_wave_t *pulseV = NULL;
+pmu_wave_t *pulseI = NULL; 
 double *pulseT = NULL;
-double *MpulseV = NULL;
-double *MpulseI = NULL;
+pmu_wave_t *MpulseV = NULL;
+pmu_wave_t *MpulseI = NULL;
 double *MpulseT = NULL;
 
 static int not_init = 1;
@@ -318,10 +323,10 @@ int retention_pulse_ilimit_dual_channel( char *InstrName, long ForceCh, double F
   {
       // NK added 24/10/2024
       // **************************************************************
-      status = rpm_config(InstId, ForceCh, KI_RPM_PATHWAY, KI_RPM_PULSE);
+      status = rpm_pathway_set(InstId, ForceCh, KI_RPM_PULSE);
       if(debug)printf("RPM is initialized for ForceCh! %s (0 or null is good)\n", status);
 
-      status = rpm_config(InstId, MeasureCh, KI_RPM_PATHWAY, KI_RPM_PULSE);
+      status = rpm_pathway_set(InstId, MeasureCh, KI_RPM_PULSE);
       if(debug)printf("RPM is initialized for MeasCh! %s (0 or null is good)\n", status);
 
      // **************************************************************
@@ -551,13 +556,13 @@ int retention_pulse_ilimit_dual_channel( char *InstrName, long ForceCh, double F
   // wait on pulse fetching
   //Sleep(5000);
   
-  status = pulse_fetch(InstId, ForceCh, 0, NumDataPts, pulseV, pulseI, pulseT, NULL);
+  status = pmu_wave_fetch(InstId, ForceCh, 0, NumDataPts, pulseV, pulseI, pulseT);
   if(status) { stat = -20; goto RETURN; }
 
   if(ForceCh != MeasureCh && MeasureCh > 0)
     {
       // wait on pulse fetching
-      status = pulse_fetch(InstId, MeasureCh, 0, NumDataPts, MpulseV, MpulseI, MpulseT, NULL);
+      status = pmu_wave_fetch(InstId, MeasureCh, 0, NumDataPts, MpulseV, MpulseI, MpulseT);
       if(status) { stat = -21; goto RETURN; }      
       //Sleep(5000);
     }
@@ -652,12 +657,12 @@ void ret_AllocateMemoryILimit(int npts)
 
 void ret_AllocateMeasArraysILimit(int npts)
 {
-    pulseV = (double *) calloc(npts, sizeof(double));
-    pulseI = (double *) calloc(npts, sizeof(double));
+    pulseV = (pmu_wave_t *) calloc(npts, sizeof(pmu_wave_t));
+    pulseI = (pmu_wave_t *) calloc(npts, sizeof(pmu_wave_t));
     pulseT = (double *) calloc(npts, sizeof(double));
 
-    MpulseV = (double *) calloc(npts, sizeof(double));
-    MpulseI = (double *) calloc(npts, sizeof(double));
+    MpulseV = (pmu_wave_t *) calloc(npts, sizeof(pmu_wave_t));
+    MpulseI = (pmu_wave_t *) calloc(npts, sizeof(pmu_wave_t));
     MpulseT = (double *) calloc(npts, sizeof(double));
 }
 
@@ -0,0 +1,76 @@
+/* Compact storage for fetched PMU waveforms.
+ * Copy next to the module source (or into the KULT include directory) and
+ * include from USRLIB modules only.
+ *
+ * Output-only buffers that hold a whole capture (the retention driver's
+ * fetch arrays) store V and I as pmu_wave_t, a float unless PMU_WAVE_DOUBLE
+ * is defined before the include. The 4225-PMU digitises with 14-bit ADCs, so
+ * the 24-bit float mantissa (~6e-8 relative) keeps every measured value, and
+ * those buffers take half the memory and cache traffic. Timestamps stay
+ * double: at 200 MSa/s a float cannot hold sample times past a few ms to
+ * 5 ns. Accumulators (the pmu_wave_avg running mean and m2 in
+ * pmu_pulse_extract.h) stay double.
+ *
+ * pulse_fetch() only writes doubles, so pmu_wave_fetch() fetches V and I in
+ * PMU_STORE_CHUNK blocks through a small double staging buffer. Sums and
+ * averages over stored samples are still accumulated in double. */
+
+#ifndef PMU_WAVE_STORE_H
+#define PMU_WAVE_STORE_H
+
+#include <stdlib.h>
+
+#ifdef PMU_WAVE_DOUBLE
+typedef double pmu_wave_t;
+#else
+typedef float pmu_wave_t;
+#endif
+
+#define PMU_STORE_CHUNK 10000     /* samples per staged pulse_fetch() block */
+
+/* pulse_fetch() samples first .. last (inclusive) of chan: V and I into
+ * pmu_wave_t arrays, T straight into a double array. Returns 0, -999 (no
+ * memory) or the pulse_fetch() status. */
+static inline int pmu_wave_fetch(int pulserId, int chan, long first, long last,
+                                 pmu_wave_t *V, pmu_wave_t *I, double *T)
+{
+#ifdef PMU_WAVE_DOUBLE
+  return pulse_fetch(pulserId, chan, first, last, V, I, T, NULL);
+#else
+  double *bufV, *bufI;
+  long start, stop;
+  int i, n, status = 0;
+
+  bufV = (double *)calloc(PMU_STORE_CHUNK, sizeof(double));
+  bufI = (double *)calloc(PMU_STORE_CHUNK, sizeof(double));
+  if (bufV == NULL || bufI == NULL)
+  {
+    if (bufV) free(bufV);
+    if (bufI) free(bufI);
+    return -999;
+  }
+
+  for (start = first; start <= last; start += PMU_STORE_CHUNK)
+  {
+    stop = start + PMU_STORE_CHUNK - 1;
+    if (stop > last)
+      stop = last;
+    n = (int)(stop - start + 1);
+
+    status = pulse_fetch(pulserId, chan, start, stop, bufV, bufI, T + (start - first), NULL);
+    if (status)
+      break;
+    for (i = 0; i < n; i++)
+    {
+      V[start - first + i] = (pmu_wave_t)bufV[i];
+      I[start - first + i] = (pmu_wave_t)bufI[i];
+    }
+  }
+
+  free(bufV);
+  free(bufI);
+  return status;
+#endif
+}
+
+#endif /* PMU_WAVE_STORE_H */
@@ -0,0 +1,114 @@
+/* Lazy RPM pathway switching shared by the PMU and SMU modules.
+ * Copy next to the module source (or into the KULT include directory) and
+ * include from USRLIB modules only.
+ *
+ * rpm_config() actuates the RPM relays and settles on every call, even when
+ * the channel is already on the requested pathway. rpm_pathway_set() keeps
+ * the last pathway set on each PMU channel and only calls rpm_config() when
+ * the next operation needs a different one, so back-to-back pulse modules,
+ * or back-to-back DC sweeps, cost no relay actuation after the first call.
+ *
+ * The cache lives in an environment variable of the KXCI process, which
+ * every user library loaded by KXCI shares, so it survives across EX calls
+ * and across libraries. A fresh process starts with an empty cache and
+ * switches on first use. Anything that can move the relays without going
+ * through rpm_pathway_set() (devint(), NVM library pulse routines, a test
+ * run from Clarius) must be followed by rpm_pathway_invalidate(). */
+
+#ifndef RPM_PATHWAY_H
+#define RPM_PATHWAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#define RPM_PATHWAY_ENV "KI_RPM_PATHWAY_CACHE"
+#define RPM_PATHWAY_BUF 256
+#define RPM_PATHWAY_UNKNOWN -1
+
+/* Cache format: ";<instId>.<chan>=<pathway>" per channel */
+
+/* Last pathway set on instId/chan, or RPM_PATHWAY_UNKNOWN */
+static inline int rpm_pathway_cached(int instId, int chan)
+{
+  char buf[RPM_PATHWAY_BUF];
+  char key[32];
+  char *p;
+  DWORD n;
+
+  n = GetEnvironmentVariableA(RPM_PATHWAY_ENV, buf, RPM_PATHWAY_BUF);
+  if (n == 0 || n >= RPM_PATHWAY_BUF)
+    return RPM_PATHWAY_UNKNOWN;
+
+  sprintf(key, ";%d.%d=", instId, chan);
+  p = strstr(buf, key);
+  if (p == NULL)
+    return RPM_PATHWAY_UNKNOWN;
+  return atoi(p + strlen(key));
+}
+
+/* Record pathway for instId/chan; RPM_PATHWAY_UNKNOWN removes the entry */
+static inline void rpm_pathway_store(int instId, int chan, int pathway)
+{
+  char buf[RPM_PATHWAY_BUF];
+  char out[RPM_PATHWAY_BUF];
+  char key[32];
+  char *entry;
+  char *next;
+  DWORD n;
+  size_t keylen, len = 0;
+
+  out[0] = '\0';
+  sprintf(key, ";%d.%d=", instId, chan);
+  keylen = strlen(key);
+
+  n = GetEnvironmentVariableA(RPM_PATHWAY_ENV, buf, RPM_PATHWAY_BUF);
+  if (n > 0 && n < RPM_PATHWAY_BUF)
+  {
+    /* Copy every other channel's entry */
+    entry = strchr(buf, ';');
+    while (entry != NULL)
+    {
+      next = strchr(entry + 1, ';');
+      if (next != NULL)
+        *next = '\0';
+      if (strncmp(entry, key, keylen) != 0 && len + strlen(entry) + 1 < RPM_PATHWAY_BUF)
+      {
+        strcpy(out + len, entry);
+        len += strlen(entry);
+      }
+      if (next != NULL)
+        *next = ';';
+      entry = next;
+    }
+  }
+
+  if (pathway != RPM_PATHWAY_UNKNOWN && len + keylen + 12 < RPM_PATHWAY_BUF)
+    sprintf(out + len, "%s%d", key, pathway);
+
+  SetEnvironmentVariableA(RPM_PATHWAY_ENV, out[0] != '\0' ? out : NULL);
+}
+
+/* rpm_config(instId, chan, KI_RPM_PATHWAY, pathway) only if the channel is
+ * not already there. Returns 0 when skipped, else the rpm_config() status;
+ * a failed switch leaves the channel unknown. */
+static inline int rpm_pathway_set(int instId, int chan, int pathway)
+{
+  int status;
+
+  if (rpm_pathway_cached(instId, chan) == pathway)
+    return 0;
+
+  status = rpm_config(instId, chan, KI_RPM_PATHWAY, pathway);
+  rpm_pathway_store(instId, chan, status == 0 ? pathway : RPM_PATHWAY_UNKNOWN);
+  return status;
+}
+
+/* Forget every cached pathway; the next rpm_pathway_set() always switches */
+static inline void rpm_pathway_invalidate(void)
+{
+  SetEnvironmentVariableA(RPM_PATHWAY_ENV, NULL);
+}
+
+#endif /* RPM_PATHWAY_H */
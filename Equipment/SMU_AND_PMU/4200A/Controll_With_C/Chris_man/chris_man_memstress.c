@@ -27,6 +27,7 @@
 		loop_num,	int,	Input,	1,	1,	1000
 	INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "nvm.h"
 #include <Windows.h>
 #include <stdint.h>
@@ -99,6 +100,7 @@ Function returns error status, where:
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "nvm.h"
 #include <Windows.h>
 #include <stdint.h>
@@ -275,6 +277,7 @@ while(prionia_counter < prionia_limit){
            ioffset, voffset);
     
         devint();
+        rpm_pathway_invalidate();
      
   //Determine the resistance of the device
   if(takeRmeas == 1) //delete in final
@@ -421,6 +424,7 @@ while(prionia_counter < prionia_limit){
                                        ioffset, voffset);
                                 
                                     devint();
+                                    rpm_pathway_invalidate();
                                  
                               //Determine the resistance of the device
                               if(takeRmeas == 1) //delete in final
@@ -31,6 +31,7 @@
 		stepIncrement,	double,	Input,	0,	-1,	1
 	INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "nvm.h"
 
 	END USRLIB MODULE INFORMATION
@@ -102,6 +103,7 @@ Function returns error status, where:
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "nvm.h"
 
 
@@ -294,6 +296,7 @@ for(int p = 0;p<loopNum;p++){
         if(0 > stat){stat = PULSE_TEST_FAILED; goto RETURN;};
       
         devint();
+        rpm_pathway_invalidate();
     }
     else //do PULSE sweep   //if(useSmu==1)
     {
@@ -477,6 +480,7 @@ for(int p = 0;p<loopNum;p++){
         numresetpts = ch1->out_pts;
       
         devint();
+        rpm_pathway_invalidate();
       
     }
     else //do PULSE sweep   //if(useSmu==1)
@@ -584,6 +588,7 @@ for(int p = 0;p<loopNum;p++){
       numsetpts = ch1->out_pts;
 
       devint();
+      rpm_pathway_invalidate();
 
     }
     else//use_smu = 1
@@ -22,6 +22,7 @@
 		Out_size_val,	int,	Input,	,	,	
 	INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "nvm.h"
 #include <Windows.h>
 #include <stdint.h>
@@ -94,6 +95,7 @@ Function returns error status, where:
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "nvm.h"
 #include <Windows.h>
 #include <stdint.h>
@@ -347,6 +349,7 @@ maxpts = 250;
         numresetpts = ch1->out_pts;
         */
         devint();
+        rpm_pathway_invalidate();
                } 
          nlog("-----------------------------------------------------------------\n");
 
@@ -23,6 +23,7 @@
 		ClariusDebug,	int,	Input,	0,	0,	1
 INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "nvm.h"
 
 	END USRLIB MODULE INFORMATION
@@ -63,11 +64,17 @@ The sweep performs:
 2. Hold at vamp for widthTime
 3. Second sweep: vamp → 0V (downward sweep)
 
+The RPMs are left on the SMU pathway with the SMUs at 0V. Modules that use
+rpm_pathway.h switch them back; before running a Clarius test or a module
+that does not, run devint() or EX A_RPM_Pathway rpm_pathway_reset() and
+switch the pathway explicitly.
+
 Data is returned via output arrays (KXCI compatible).
 
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include "nvm.h"
 #include <math.h>
 #include <stdio.h>
@@ -152,9 +159,9 @@ int ACraig12_DC_Sweep(
     
     if(debug) printf("Switching RPMs for SMU test\n");
     
-    // Configure RPMs for SMU mode
-    rpm_config(PMU1, 1, KI_RPM_PATHWAY, KI_RPM_SMU);
-    rpm_config(PMU1, 2, KI_RPM_PATHWAY, KI_RPM_SMU);
+    // Configure RPMs for SMU mode (skipped if already there)
+    rpm_pathway_set(PMU1, 1, KI_RPM_SMU);
+    rpm_pathway_set(PMU1, 2, KI_RPM_SMU);
     
     if(debug) printf("DC testing\n");
     
@@ -233,7 +240,9 @@ int ACraig12_DC_Sweep(
     forcev(SMU_high_Id, 0.0);
     forcev(SMU_low_Id, 0.0);
     
-    devint();
+    // Release the scan buffers instead of devint(): devint() can move the
+    // RPM relays, which would cost a switch back to SMU on the next DC sweep
+    clrscn();
     
     // Process data: correct vforce for voltage drop and adjust current sign
     for(i = 0; i < vamp_pts - 1; i++ )
@@ -251,11 +260,8 @@ int ACraig12_DC_Sweep(
         if(1 == measCH) imeasd[i] *= -1.0;
     }
     
-    if(debug) printf("Done, switching RPMs back to PMU mode\n");
-    
-    // Switch RPMs back to PMU mode
-    rpm_config(PMU1, 1, KI_RPM_PATHWAY, KI_RPM_PULSE);
-    rpm_config(PMU1, 2, KI_RPM_PATHWAY, KI_RPM_PULSE);
+    // RPMs stay on the SMU pathway (cached); the next pulse module's
+    // rpm_pathway_set() makes the single switch back
     
     if(debug) 
     {
@@ -36,7 +36,7 @@
 		Ch1SMU_ID,	char *,	Input,	"SMU1",	,	
 		Ch2SMU_ID,	char *,	Input,	"SMU2",	,	
 		PMU_ID,	char *,	Input,	"PMU1",	,	
-		ExecMode,	int,	Input,	0,	0,	2
+		ExecMode,	int,	Input,	0,	0,	3
 		Ch1_V_Ampl,	D_ARRAY_T,	Output,	,	,	
 		Ch1_V_Ampl_Size,	int,	Input,	100,	1,	10000
 		Ch1_I_Ampl,	D_ARRAY_T,	Output,	,	,	
@@ -76,6 +76,7 @@
 		ClariusDebug,	int,	Input,	0,	0,	1
 INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -87,6 +88,7 @@ BOOL LPTIsInCurrentConfiguration(char* hrid);
 #define PulseAndSMUMode 0
 #define PulseOnlyMode 1
 #define SMUOnlyMode 2
+#define InterleavedMode 3
 
 #define ERR_PMU_EXAMPLES_WRONGCARDID -17001
 #define ERR_PMU_EXAMPLES_CARDHANDLEFAIL -17002
@@ -104,6 +106,19 @@ execution modes:
 - Mode 0 (PulseAndSMUMode): Perform both PMU pulse test and SMU DC test
 - Mode 1 (PulseOnlyMode): Perform only PMU pulse test
 - Mode 2 (SMUOnlyMode): Perform only SMU DC test
+- Mode 3 (InterleavedMode): Pulse and DC measurement at each voltage point
+
+Mode 3 programs the PMU and SMU limits once, then for each Ch2 voltage runs
+one pulse (Ch2 amplitude = point voltage) and straight after it one DC
+point at the same voltage, switching only the RPM pathways (or SMU shield
+relays) in between. The device sees pulse, DC, pulse, DC... instead of the
+whole pulse sweep followed by the whole DC sweep, so each pulse/DC pair is
+taken in the same device state. PMU timestamps restart at each point's
+pulse, as every point is a separate pulse_exec().
+
+In every mode the Ch2 points are StartVCh2 + k*StepVCh2 (towards StopVCh2),
+for the pulse and the DC sweep alike; if StepVCh2 does not divide the range,
+the last point falls short of StopVCh2.
 
 PMU Pulse Test:
 - CH1: Fixed amplitude pulse train (constant voltage)
@@ -122,6 +137,21 @@ of PostDataDoubleBuffer().
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 
+/* Route both channels to the PMU (smuPath = 0) or the SMUs (smuPath = 1) */
+static void acraig12_select_path(int rpmPresent, int instId, int chan1, int chan2, int ch1SMUId, int ch2SMUId, int smuPath)
+{
+    if (rpmPresent)
+    {
+        rpm_pathway_set(instId, chan1, smuPath ? KI_RPM_SMU : KI_RPM_PULSE);
+        rpm_pathway_set(instId, chan2, smuPath ? KI_RPM_SMU : KI_RPM_PULSE);
+    }
+    else
+    {
+        setmode(ch1SMUId, KI_SHIELD_RELAY_STATE, smuPath);
+        setmode(ch2SMUId, KI_SHIELD_RELAY_STATE, smuPath);
+    }
+}
+
 int ACraig12_PMU_SMU_Sweep( 
     double PulseWidthCh1, double RiseTimeCh1, double FallTimeCh1, double DelayCh1, 
     double PulseWidthCh2, double RiseTimeCh2, double FallTimeCh2, double DelayCh2, 
@@ -218,6 +248,10 @@ int ACraig12_PMU_SMU_Sweep(
     int SMUPresent;
     int RPMPresent = 0;
     int memAllocated = 0;
+    int k;
+    double PointV;
+    double StepDirCh2;
+    double LastVCh2;
     
     if (ClariusDebug == 1) { debug = 1; } else { debug = 0; }
     if(debug) printf("\n\nACraig12_PMU_SMU_Sweep: starts\n");
@@ -274,9 +308,20 @@ int ACraig12_PMU_SMU_Sweep(
         return ERR_PMU_EXAMPLES_CARDHANDLEFAIL;
     }
     
+    if (ExecMode < 0 || ExecMode > 3)
+    {
+        if(debug) printf("ERROR: Invalid ExecMode (%d)\n", ExecMode);
+        return -99;
+    }
+    
     //Calculate the number of sweep points on the drain
     NumSweepPts = (int)(fabs((StopVCh2 - StartVCh2) / StepVCh2) + 1);
     
+    // One Ch2 grid for every mode: StartVCh2 + k*StepVCh2 towards StopVCh2,
+    // ending on LastVCh2 (= StopVCh2 when the step divides the range)
+    StepDirCh2 = (StopVCh2 >= StartVCh2) ? fabs(StepVCh2) : -fabs(StepVCh2);
+    LastVCh2 = StartVCh2 + (NumSweepPts - 1) * StepDirCh2;
+    
     if(debug) printf("Number of sweep points: %d\n", NumSweepPts);
     
     //Determine if return array sizes are big enough
@@ -292,8 +337,8 @@ int ACraig12_PMU_SMU_Sweep(
     
     // Check to see if RPMs are present
     status = pg2_init(InstId, PULSE_MODE_PULSE);
-    Stat = rpm_config(InstId, CardChannel1, KI_RPM_PATHWAY, KI_RPM_PULSE);
-    Stat = rpm_config(InstId, CardChannel2, KI_RPM_PATHWAY, KI_RPM_PULSE);
+    Stat = rpm_pathway_set(InstId, CardChannel1, KI_RPM_PULSE);
+    Stat = rpm_pathway_set(InstId, CardChannel2, KI_RPM_PULSE);
     RPMstat1 = pulse_ranges(InstId, CardChannel1, 10.0, PULSE_MEAS_FIXED, 10.0, PULSE_MEAS_FIXED, 100e-6);
     RPMstat2 = pulse_ranges(InstId, CardChannel2, 10, PULSE_MEAS_FIXED, 10, PULSE_MEAS_FIXED, 100e-6);
     if (RPMstat1 >= 0 && RPMstat2 >= 0) {
@@ -380,13 +425,13 @@ int ACraig12_PMU_SMU_Sweep(
         Stat = setmode(Ch2SMUId, KI_SHIELD_RELAY_STATE, 0);
     } else {
         if(debug) printf("Using RPM relays - pulse mode\n");
-        Stat = rpm_config(InstId, CardChannel1, KI_RPM_PATHWAY, KI_RPM_PULSE);
-        Stat = rpm_config(InstId, CardChannel2, KI_RPM_PATHWAY, KI_RPM_PULSE);
+        Stat = rpm_pathway_set(InstId, CardChannel1, KI_RPM_PULSE);
+        Stat = rpm_pathway_set(InstId, CardChannel2, KI_RPM_PULSE);
     }
     
-    if(debug) printf("ExecMode is %d (0=Pulse+SMU, 1=Pulse only, 2=SMU only)\n", ExecMode);
+    if(debug) printf("ExecMode is %d (0=Pulse+SMU, 1=Pulse only, 2=SMU only, 3=Interleaved)\n", ExecMode);
     
-    if (ExecMode == PulseOnlyMode || ExecMode == PulseAndSMUMode)
+    if (ExecMode == PulseOnlyMode || ExecMode == PulseAndSMUMode || ExecMode == InterleavedMode)
     {
         //Perform the Pulse-IV test
         status = pg2_init(InstId, PULSE_MODE_PULSE);
@@ -550,9 +595,17 @@ int ACraig12_PMU_SMU_Sweep(
             goto cleanup_error;
         }
         
-        status = pulse_sweep_linear(InstId, CardChannel2, PULSE_AMPLITUDE_SP, StartVCh2, StopVCh2, StepVCh2);
+        if (ExecMode == InterleavedMode)
+        {
+            // One pulse per point; the amplitude is reprogrammed before each exec
+            status = pulse_train(InstId, CardChannel2, BaseVCh2, StartVCh2);
+        }
+        else
+        {
+            status = pulse_sweep_linear(InstId, CardChannel2, PULSE_AMPLITUDE_SP, StartVCh2, LastVCh2, StepVCh2);
+        }
         if (status) {
-            if(debug) printf("pulse_sweep_linear CH2 failed: %d\n", status);
+            if(debug) printf("pulse_train/pulse_sweep_linear CH2 failed: %d\n", status);
             goto cleanup_error;
         }
         
@@ -576,30 +629,85 @@ int ACraig12_PMU_SMU_Sweep(
             TestMode = PULSE_MODE_ADVANCED;
         }
         
-        if(debug) printf("Executing pulse test (mode=%d)...\n", TestMode);
-        status = pulse_exec(TestMode);
-        if (status) {
-            if(debug) printf("pulse_exec failed: %d\n", status);
-            goto cleanup_error;
-        }
-        
-        while(pulse_exec_status(&elapsedt) == 1) {
-            Sleep(100);
-        }
-        
-        if(debug) printf("Pulse test complete, fetching data...\n");
-        
-        // Fetch PMU data
-        status = pulse_fetch(InstId, CardChannel1, 0, NumSweepPts*2, Ch1_V_All, Ch1_I_All, Ch1_T_All, Ch1_S_All);
-        if (status) {
-            if(debug) printf("pulse_fetch CH1 failed: %d\n", status);
-            goto cleanup_error;
+        if (ExecMode == InterleavedMode)
+        {
+            // SMU limits are set once; only the pathways switch per point
+            limiti(Ch2SMUId, SMU_Icomp);
+            rangei(Ch2SMUId, SMU_Irange);
+            
+            if(debug) printf("Interleaved pulse/DC test, %d points...\n", NumSweepPts);
+            for (k = 0; k < NumSweepPts; k++)
+            {
+                PointV = StartVCh2 + k * StepDirCh2;
+                
+                // Pulse phase
+                if (k > 0)
+                {
+                    acraig12_select_path(RPMPresent, InstId, CardChannel1, CardChannel2, Ch1SMUId, Ch2SMUId, 0);
+                    status = pulse_train(InstId, CardChannel2, BaseVCh2, PointV);
+                    if (status) {
+                        if(debug) printf("pulse_train CH2 failed at point %d: %d\n", k, status);
+                        goto cleanup_error;
+                    }
+                }
+                status = pulse_exec(TestMode);
+                if (status) {
+                    if(debug) printf("pulse_exec failed at point %d: %d\n", k, status);
+                    goto cleanup_error;
+                }
+                while(pulse_exec_status(&elapsedt) == 1) {
+                    Sleep(1);
+                }
+                status = pulse_fetch(InstId, CardChannel1, 0, 2, Ch1_V_All + 2*k, Ch1_I_All + 2*k, Ch1_T_All + 2*k, Ch1_S_All + 2*k);
+                if (status == 0)
+                    status = pulse_fetch(InstId, CardChannel2, 0, 2, Ch2_V_All + 2*k, Ch2_I_All + 2*k, Ch2_T_All + 2*k, Ch2_S_All + 2*k);
+                if (status) {
+                    if(debug) printf("pulse_fetch failed at point %d: %d\n", k, status);
+                    goto cleanup_error;
+                }
+                
+                // DC phase at the same voltage
+                acraig12_select_path(RPMPresent, InstId, CardChannel1, CardChannel2, Ch1SMUId, Ch2SMUId, 1);
+                forcev(Ch1SMUId, AmplVCh1);
+                forcev(Ch2SMUId, PointV);
+                Ch2_SMU_Voltage[k] = PointV;
+                measi(Ch2SMUId, &Ch2_SMU_Current[k]);
+                intgi(Ch1SMUId, &Ch1_SMU_Current[k]);
+                measv(Ch1SMUId, &Ch1_SMU_Voltage[k]);
+                forcev(Ch2SMUId, 0.0);
+                forcev(Ch1SMUId, 0.0);
+            }
+            
+            if(debug) printf("Interleaved test complete\n");
         }
-        
-        status = pulse_fetch(InstId, CardChannel2, 0, NumSweepPts*2, Ch2_V_All, Ch2_I_All, Ch2_T_All, Ch2_S_All);
-        if (status) {
-            if(debug) printf("pulse_fetch CH2 failed: %d\n", status);
-            goto cleanup_error;
+        else
+        {
+            if(debug) printf("Executing pulse test (mode=%d)...\n", TestMode);
+            status = pulse_exec(TestMode);
+            if (status) {
+                if(debug) printf("pulse_exec failed: %d\n", status);
+                goto cleanup_error;
+            }
+            
+            while(pulse_exec_status(&elapsedt) == 1) {
+                Sleep(100);
+            }
+            
+            if(debug) printf("Pulse test complete, fetching data...\n");
+            
+            // Fetch PMU data
+            status = pulse_fetch(InstId, CardChannel1, 0, NumSweepPts*2, Ch1_V_All, Ch1_I_All, Ch1_T_All, Ch1_S_All);
+            if (status) {
+                if(debug) printf("pulse_fetch CH1 failed: %d\n", status);
+                goto cleanup_error;
+            }
+            
+            status = pulse_fetch(InstId, CardChannel2, 0, NumSweepPts*2, Ch2_V_All, Ch2_I_All, Ch2_T_All, Ch2_S_All);
+            if (status) {
+                if(debug) printf("pulse_fetch CH2 failed: %d\n", status);
+                goto cleanup_error;
+            }
+            
         }
         
         // De-interleave amplitude and base measurements
@@ -657,8 +765,8 @@ int ACraig12_PMU_SMU_Sweep(
         else 
         {
             if(debug) printf("Using RPM relays - SMU mode\n");
-            Stat = rpm_config(InstId, CardChannel1, KI_RPM_PATHWAY, KI_RPM_SMU);
-            Stat = rpm_config(InstId, CardChannel2, KI_RPM_PATHWAY, KI_RPM_SMU);
+            Stat = rpm_pathway_set(InstId, CardChannel1, KI_RPM_SMU);
+            Stat = rpm_pathway_set(InstId, CardChannel2, KI_RPM_SMU);
         }
         
         // Set SMU ranges and limits
@@ -673,19 +781,12 @@ int ACraig12_PMU_SMU_Sweep(
         smeasi(Ch2SMUId, Ch2_SMU_Current);
         sintgi(Ch1SMUId, Ch1_SMU_Current);
         smeasv(Ch1SMUId, Ch1_SMU_Voltage);
-        sweepv(Ch2SMUId, StartVCh2, StopVCh2, NumSweepPts-1, sweepdelay);
+        sweepv(Ch2SMUId, StartVCh2, LastVCh2, NumSweepPts-1, sweepdelay);
         inshld();
         
         if(debug) printf("SMU DC test complete, data in output arrays\n");
     }
     
-    if (ExecMode < 0 || ExecMode > 2)
-    {
-        if(debug) printf("ERROR: Invalid ExecMode (%d)\n", ExecMode);
-        ExecStatus = -99;
-        goto cleanup_error;
-    }
-    
     // Cleanup and return
     if (memAllocated)
     {
@@ -739,6 +840,7 @@ cleanup_error:
         free(Ch2_T_Low);
     }
     devint();
+    rpm_pathway_invalidate();
     return (ExecStatus != 0) ? ExecStatus : status;
 /* USRLIB MODULE END  */
 } 		/* End ACraig12_PMU_SMU_Sweep.c */
@@ -4,10 +4,12 @@ This script wraps the `EX ACraig12 ACraig12_PMU_SMU_Sweep(...)` command,
 executes it on a Keithley 4200A via KXCI, and retrieves the voltage/current
 data from combined PMU pulse and SMU DC measurements.
 
-This module supports three execution modes:
+This module supports four execution modes:
 - Mode 0 (Pulse+SMU): Perform both PMU pulse test and SMU DC test
 - Mode 1 (Pulse only): Perform only PMU pulse test
 - Mode 2 (SMU only): Perform only SMU DC test
+- Mode 3 (Interleaved): Pulse point then DC point at each CH2 voltage, with
+  the PMU/SMU set up once and only the RPM pathways switched per point
 
 PMU Pulse Test:
 - CH1: Fixed amplitude pulse train
@@ -30,6 +32,9 @@ Usage examples:
     # Both tests
     python run_acraig12_pmu_smu_sweep.py --exec-mode 0 --start-v-ch2 0.0 --stop-v-ch2 5.0 --step-v-ch2 0.1
 
+    # Both tests, pulse and DC interleaved per point
+    python run_acraig12_pmu_smu_sweep.py --exec-mode 3 --start-v-ch2 0.0 --stop-v-ch2 5.0 --step-v-ch2 0.1
+
 Pass `--dry-run` to print the generated EX command without contacting the instrument.
 """
 
@@ -46,6 +51,10 @@ try:
 except ImportError:
     PLOTTING_AVAILABLE = False
 
+# ExecMode values that return PMU pulse data / SMU DC data
+PULSE_EXEC_MODES = (0, 1, 3)
+DC_EXEC_MODES = (0, 2, 3)
+
 
 class KXCIClient:
     """Minimal KXCI helper for sending EX/GP commands."""
@@ -358,8 +367,9 @@ def parse_arguments() -> argparse.Namespace:
                        help="PMU ID (default: PMU1)")
     
     # Execution mode
-    parser.add_argument("--exec-mode", type=int, default=0, choices=[0, 1, 2],
-                       help="Execution mode (0=Pulse+SMU, 1=Pulse only, 2=SMU only, default: 0)")
+    parser.add_argument("--exec-mode", type=int, default=0, choices=[0, 1, 2, 3],
+                       help="Execution mode (0=Pulse+SMU, 1=Pulse only, 2=SMU only, "
+                            "3=Interleaved pulse/DC per point, default: 0)")
     
     # Array size
     parser.add_argument("--array-size", type=int, default=100,
@@ -452,16 +462,16 @@ def run_measurement(args, enable_plot: bool) -> None:
         if not controller.connect():
             raise RuntimeError("Unable to connect to instrument")
         
-        exec_mode_names = {0: "Pulse+SMU", 1: "Pulse only", 2: "SMU only"}
+        exec_mode_names = {0: "Pulse+SMU", 1: "Pulse only", 2: "SMU only", 3: "Interleaved"}
         print(f"\n[KXCI] Execution mode: {args.exec_mode} ({exec_mode_names[args.exec_mode]})")
         
-        if args.exec_mode in [0, 1]:
+        if args.exec_mode in PULSE_EXEC_MODES:
             print(f"[KXCI] PMU Pulse Test:")
             print(f"  CH1: Fixed amplitude {args.ampl_v_ch1}V (base {args.base_v_ch1}V)")
             print(f"  CH2: Sweep {args.start_v_ch2}V to {args.stop_v_ch2}V (base {args.base_v_ch2}V)")
             print(f"  Period: {args.period*1e6:.2f}µs, Pulse average: {args.pulse_average}")
         
-        if args.exec_mode in [0, 2]:
+        if args.exec_mode in DC_EXEC_MODES:
             print(f"[KXCI] SMU DC Test:")
             print(f"  CH1 SMU: Fixed bias {args.ampl_v_ch1}V")
             print(f"  CH2 SMU: Sweep {args.start_v_ch2}V to {args.stop_v_ch2}V")
@@ -485,7 +495,7 @@ def run_measurement(args, enable_plot: bool) -> None:
         print(f"[KXCI] Requesting {num_points} points")
         
         # Retrieve PMU data if pulse test was performed
-        if args.exec_mode in [0, 1]:
+        if args.exec_mode in PULSE_EXEC_MODES:
             print("\n[KXCI] Retrieving PMU pulse data...")
             ch1_v_ampl = controller.safe_query(34, num_points, "Ch1_V_Ampl")
             ch1_i_ampl = controller.safe_query(36, num_points, "Ch1_I_Ampl")
@@ -499,7 +509,7 @@ def run_measurement(args, enable_plot: bool) -> None:
             print(f"[KXCI] PMU data: CH1 ampl={len(ch1_v_ampl)} pts, CH2 ampl={len(ch2_v_ampl)} pts")
         
         # Retrieve SMU data if DC test was performed
-        if args.exec_mode in [0, 2]:
+        if args.exec_mode in DC_EXEC_MODES:
             print("\n[KXCI] Retrieving SMU DC data...")
             ch2_smu_voltage = controller.safe_query(62, num_points, "Ch2_SMU_Voltage")
             ch2_smu_current = controller.safe_query(64, num_points, "Ch2_SMU_Current")
@@ -510,18 +520,18 @@ def run_measurement(args, enable_plot: bool) -> None:
         
         # Print summary
         print(f"\n[Summary]")
-        if args.exec_mode in [0, 1]:
+        if args.exec_mode in PULSE_EXEC_MODES:
             if ch1_v_ampl:
                 print(f"  CH1 Pulse Ampl: {len(ch1_v_ampl)} points, V range: {min(ch1_v_ampl):.6g} to {max(ch1_v_ampl):.6g} V")
             if ch2_v_ampl:
                 print(f"  CH2 Pulse Ampl: {len(ch2_v_ampl)} points, V range: {min(ch2_v_ampl):.6g} to {max(ch2_v_ampl):.6g} V")
-        if args.exec_mode in [0, 2]:
+        if args.exec_mode in DC_EXEC_MODES:
             if ch2_smu_voltage:
                 print(f"  CH2 SMU: {len(ch2_smu_voltage)} points, V range: {min(ch2_smu_voltage):.6g} to {max(ch2_smu_voltage):.6g} V")
         
         # Plot if requested
         if enable_plot and PLOTTING_AVAILABLE:
-            if args.exec_mode in [0, 1] and ch2_v_ampl and ch2_i_ampl:
+            if args.exec_mode in PULSE_EXEC_MODES and ch2_v_ampl and ch2_i_ampl:
                 # Plot PMU IV curve
                 fig1, ax1 = plt.subplots(1, 1, figsize=(8, 6))
                 ax1.plot(ch2_v_ampl, ch2_i_ampl, 'b-', linewidth=1.5, label='CH2 Pulse Ampl')
@@ -533,7 +543,7 @@ def run_measurement(args, enable_plot: bool) -> None:
                 plt.tight_layout()
                 plt.show()
             
-            if args.exec_mode in [0, 2] and ch2_smu_voltage and ch2_smu_current:
+            if args.exec_mode in DC_EXEC_MODES and ch2_smu_voltage and ch2_smu_current:
                 # Plot SMU IV curve
                 fig2, ax2 = plt.subplots(1, 1, figsize=(8, 6))
                 ax2.plot(ch2_smu_voltage, ch2_smu_current, 'r-', linewidth=1.5, label='CH2 SMU DC')
@@ -2,7 +2,7 @@
 
 	MODULE NAME: ACraig13_PMU_Waveform_FlexSegArb
 	MODULE RETURN TYPE: int 
-	NUMBER OF PARMS: 40
+	NUMBER OF PARMS: 45
 	ARGUMENTS:
 		width,	double,	Input,	500e-9,	40e-9,	.999999
 		rise,	double,	Input,	100e-9,	20e-9,	.033
@@ -43,10 +43,18 @@
 		Ch2MeasType,	char *,	Input,	"0,0,0",	,	
 		Ch2MeasStart,	char *,	Input,	"0,0,0",	,	
 		Ch2MeasStop,	char *,	Input,	"0,0,0",	,	
+		Ch2Program,	char *,	Input,	"",	,	
+		Ch2SeqList,	char *,	Input,	"",	,	
 		Ch2LoopCount,	double,	Input,	1.0,	1.0,	100000.0
 		ClariusDebug,	int,	Input,	0,	0,	1
+		Features,	D_ARRAY_T,	Output,	,	,	
+		size_Features,	int,	Input,	1,	1,	500000
 	INCLUDES:
 #include "keithley.h"
+#include "rpm_pathway.h"
+#include "pmu_pulse_extract.h"
+#include "flex_seg_program.h"
+#include "pmu_exec_wait.h"
 	END USRLIB MODULE INFORMATION
 */
 /* USRLIB MODULE HELP DESCRIPTION
@@ -73,6 +81,16 @@ Why 40-80%?
 - Stable region: The 40-80% window captures the most stable, flat portion of the
   pulse where voltage and current have fully settled
 
+Pulses are located in one pass while the waveform is fetched in blocks of
+10000 samples (pmu_pulse_extract.h): threshold detection (|V| > |startV|/2)
+with a time-based (pulse k at k * the programmed CH1 loop length) fallback.
+
+PER-PULSE FEATURES (Features / size_Features):
+- With size_Features >= 5 the same pass fills one row of 5 values per pulse:
+  t_start, I_peak, t_switch (from flat-top start), Q = integral of I dt,
+  t_rise (10-90% of |I|); row k = Features[5*k .. 5*k+4]
+- Rows = min(burstCount, size_Features / 5); size_Features = 1 disables it
+
 CH2 FLEXIBLE SEG_ARB PARAMETERS:
 - Ch2NumSegments: Number of segments (3-2048)
 - Ch2StartV[]: Array of start voltages for each segment
@@ -84,16 +102,49 @@ CH2 FLEXIBLE SEG_ARB PARAMETERS:
 - Ch2MeasStart[]: Array of measurement start times within each segment
 - Ch2MeasStop[]: Array of measurement stop times within each segment
 
+COMPACT CH2 PROGRAM (Ch2Program, flex_seg_program.h):
+- When Ch2Program is not empty it replaces Ch2NumSegments and the arrays
+- One ';'-separated item per segment; startV is always the previous stopV:
+    =V       start level (default 0 V)
+    T        flat at the present level for T seconds
+    V@T      ramp to V in T seconds
+    *N       repeat the item N times;  flags T (trigger out), O (SSR open),
+             M (waveform measurement over the segment)
+- Number suffixes p, n, u, m. Example: "5u;1.5@100n;10u;0@100n;5u"
+- A 2048-segment waveform is a few kB instead of nine full arrays
+
+MULTIPLE SEQUENCES (Ch2Program blocks + Ch2SeqList):
+- '|' in Ch2Program starts a new block; block b is seg_arb sequence b
+  (at least 3 segments each, 2048 segments and 512 blocks in total)
+- Ch2SeqList plays blocks in any order with a loop count each:
+  "seq[*loops]" items separated by ';', e.g. "1*1000;2*1000;3"
+- Empty Ch2SeqList plays every block once, in order (the arrays are block 1)
+- Each entry must start at the level the previous entry stopped
+- Ch2LoopCount multiplies a single entry's loop count; a longer list is
+  repeated Ch2LoopCount times (integer, 512 entries after repeating)
+- Repeated structure is looped by the card, never unrolled into segments
+
 CRITICAL REQUIREMENTS:
 - Segment voltages must be continuous: stopV[i] == startV[i+1]
 - First segment MUST have Ch2SegTrigOut[0] = 1
 - All segment times must be >= 20ns (minimum segment time)
 - Ch2LoopCount must be >= 1.0
+- Error codes: -122 bad program / list, -831 too many segments or sequences
+
+COMPLETION WAIT (pmu_exec_wait.h):
+- The module sleeps through ~90% of the programmed run time (the longer of
+  CH1 loop length * burstCount and the CH2 sequence duration), then polls
+  pulse_exec_status() at 1-20 ms; short captures return in milliseconds
+- Timeout (-998) is 2 x the programmed run time + 2 s, not a fixed 20 s
 
 	END USRLIB MODULE HELP DESCRIPTION */
 /* USRLIB MODULE PARAMETER LIST */
 #include "keithley.h"
-#include <math.h>  // For fabs
+#include "rpm_pathway.h"
+#include "pmu_pulse_extract.h"
+#include "flex_seg_program.h"  /* Compact Ch2Program parser */
+#include "pmu_exec_wait.h"     /* Completion wait from the programmed duration */
+#include <math.h>  // For fabs, floor
 #include <stdlib.h>  // For calloc, free
 #include <string.h>  // For strtok, strtod
 
@@ -169,8 +220,11 @@ int ACraig13_PMU_Waveform_FlexSegArb(
     char *Ch2MeasType,
     char *Ch2MeasStart,
     char *Ch2MeasStop,
+    char *Ch2Program,
+    char *Ch2SeqList,
     double Ch2LoopCount,
-    int ClariusDebug )
+    int ClariusDebug,
+    double *Features, int size_Features )
 {
 /* USRLIB MODULE CODE */
     int debug = 0;
@@ -179,11 +233,7 @@ int ACraig13_PMU_Waveform_FlexSegArb(
     int pulserId;
     int TestMode;
     double DIFF = 1.0e-9;
-    int i, j;
-    
-    double *waveformV = NULL;
-    double *waveformI = NULL;
-    double *waveformT = NULL;
+    int i;
 
     if (ClariusDebug == 1) { debug = 1; } else { debug = 0; }
     if(debug) printf("\n\nACraig13_PMU_Waveform_FlexSegArb: starts\n");
@@ -233,9 +283,9 @@ int ACraig13_PMU_Waveform_FlexSegArb(
     if(debug) printf("Number of sweep points: %g\n", dSweeps);
 
     // Ensure that 4225-RPMs (if attached) are in pulse mode for CH1
-    status = rpm_config(pulserId, chan, KI_RPM_PATHWAY, KI_RPM_PULSE);
+    status = rpm_pathway_set(pulserId, chan, KI_RPM_PULSE);
     if ( status && debug )
-       printf("rpm_config CH1 returned: %d\n", status);
+       printf("rpm_pathway_set CH1 returned: %d\n", status);
 
     // Put card into SARB mode (required for seg_arb functions)
     int pulse_mode = PULSE_MODE_SARB;
@@ -459,7 +509,13 @@ int ACraig13_PMU_Waveform_FlexSegArb(
     idx++;
     
     // Segment 4: Post-delay (at baseV)
+    // Segment 5 (and segment 0 when delay is 0) adds min_seg_time the period
+    // does not include; take it out of the post-delay where it fits, so one
+    // loop of the sequence is exactly one period
     double seg4_time = (ch1_post_delay > 0) ? ch1_post_delay : min_seg_time;
+    double seq_extra = (seg0_time - delay) + min_seg_time;
+    if (seg4_time - seq_extra >= min_seg_time)
+        seg4_time -= seq_extra;
     ch1_startv[idx] = baseV; ch1_stopv[idx] = baseV; ch1_segtime[idx] = seg4_time;
     ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;
     ch1_meastype[idx] = 0; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;
@@ -470,6 +526,13 @@ int ACraig13_PMU_Waveform_FlexSegArb(
     ch1_ssrctrl[idx] = 1; ch1_segtrigout[idx] = 0;
     ch1_meastype[idx] = 0; ch1_measstart[idx] = 0.0; ch1_measstop[idx] = 0.0;
     
+    // Actual length of one loop: pulse k starts k * ch1_loop_time after the
+    // first one. Near the minimum period the padding does not fit and the
+    // loop is longer than period, so timing below uses this, never period.
+    double ch1_loop_time = seg0_time + rise + width + fall + seg4_time + min_seg_time;
+    if(debug && fabs(ch1_loop_time - period) > 1e-12)
+        printf("NOTE: CH1 loop is %.6g s, %.6g s longer than period\n", ch1_loop_time, ch1_loop_time - period);
+    
     // Configure seg_arb sequence for CH1
     if(debug) printf("Configuring seg_arb_sequence for CH%d (%d segments)...\n", chan, ch1_num_segments);
     
@@ -507,6 +570,9 @@ int ACraig13_PMU_Waveform_FlexSegArb(
     
     if(debug) printf("Configured CH1 for %d pulses with waveform capture\n", burstCount);
 
+    // Programmed run time of the longest channel, for the completion wait
+    double exec_duration = ch1_loop_time * burstCount;
+    
     // ============================================================
     // CH2 Setup for flexible seg_arb waveform (segments from Python)
     // ============================================================
@@ -524,106 +590,119 @@ int ACraig13_PMU_Waveform_FlexSegArb(
             printf("========================================\n");
         }
         
-        // Validate CH2 segment count
-        if (Ch2NumSegments < 3 || Ch2NumSegments > 2048)
-        {
-            if(debug) printf("ERROR: Ch2NumSegments (%d) must be between 3 and 2048\n", Ch2NumSegments);
-            return -122;
-        }
-        
-        // Validate segment strings are not NULL
-        if (Ch2StartV == NULL || Ch2StopV == NULL || Ch2SegTime == NULL ||
-            Ch2SSRCtrl == NULL || Ch2SegTrigOut == NULL || Ch2MeasType == NULL ||
-            Ch2MeasStart == NULL || Ch2MeasStop == NULL)
-        {
-            if(debug) printf("ERROR: CH2 segment strings are NULL\n");
-            return -122;
-        }
-        
-        // Parse segment strings into arrays
-        double *ch2_startv = (double *)calloc(Ch2NumSegments, sizeof(double));
-        double *ch2_stopv = (double *)calloc(Ch2NumSegments, sizeof(double));
-        double *ch2_segtime = (double *)calloc(Ch2NumSegments, sizeof(double));
-        long *ch2_ssrctrl = (long *)calloc(Ch2NumSegments, sizeof(long));
-        long *ch2_segtrigout = (long *)calloc(Ch2NumSegments, sizeof(long));
-        long *ch2_meastype = (long *)calloc(Ch2NumSegments, sizeof(long));
-        double *ch2_measstart = (double *)calloc(Ch2NumSegments, sizeof(double));
-        double *ch2_measstop = (double *)calloc(Ch2NumSegments, sizeof(double));
-        
-        if (!ch2_startv || !ch2_stopv || !ch2_segtime || !ch2_ssrctrl ||
-            !ch2_segtrigout || !ch2_meastype || !ch2_measstart || !ch2_measstop)
+        // Segments come from the compact Ch2Program when given, else from the arrays
+        fsp_program *ch2_prog = (fsp_program *)calloc(1, sizeof(fsp_program));
+        if (ch2_prog == NULL)
         {
             if(debug) printf("ERROR: Failed to allocate memory for CH2 segment arrays\n");
-            if (ch2_startv) free(ch2_startv);
-            if (ch2_stopv) free(ch2_stopv);
-            if (ch2_segtime) free(ch2_segtime);
-            if (ch2_ssrctrl) free(ch2_ssrctrl);
-            if (ch2_segtrigout) free(ch2_segtrigout);
-            if (ch2_meastype) free(ch2_meastype);
-            if (ch2_measstart) free(ch2_measstart);
-            if (ch2_measstop) free(ch2_measstop);
             return -999;
         }
         
-        // Parse strings
-        int parsed_startv = parse_array_string(Ch2StartV, ch2_startv, Ch2NumSegments);
-        int parsed_stopv = parse_array_string(Ch2StopV, ch2_stopv, Ch2NumSegments);
-        int parsed_segtime = parse_array_string(Ch2SegTime, ch2_segtime, Ch2NumSegments);
-        int parsed_ssrctrl = parse_array_string_long(Ch2SSRCtrl, ch2_ssrctrl, Ch2NumSegments);
-        int parsed_segtrigout = parse_array_string_long(Ch2SegTrigOut, ch2_segtrigout, Ch2NumSegments);
-        int parsed_meastype = parse_array_string_long(Ch2MeasType, ch2_meastype, Ch2NumSegments);
-        int parsed_measstart = parse_array_string(Ch2MeasStart, ch2_measstart, Ch2NumSegments);
-        int parsed_measstop = parse_array_string(Ch2MeasStop, ch2_measstop, Ch2NumSegments);
-        
-        if (parsed_startv != Ch2NumSegments || parsed_stopv != Ch2NumSegments ||
-            parsed_segtime != Ch2NumSegments || parsed_ssrctrl != Ch2NumSegments ||
-            parsed_segtrigout != Ch2NumSegments || parsed_meastype != Ch2NumSegments ||
-            parsed_measstart != Ch2NumSegments || parsed_measstop != Ch2NumSegments)
+        if (Ch2Program != NULL && Ch2Program[0] != '\0')
         {
-            if(debug) printf("ERROR: Failed to parse CH2 segment strings (expected %d values)\n", Ch2NumSegments);
-            free(ch2_startv); free(ch2_stopv); free(ch2_segtime);
-            free(ch2_ssrctrl); free(ch2_segtrigout); free(ch2_meastype);
-            free(ch2_measstart); free(ch2_measstop);
-            return -122;
+            status = fsp_parse(ch2_prog, Ch2Program);
+            if (status)
+            {
+                if(debug) printf("ERROR: Ch2Program invalid at character %d (%d): %s\n",
+                                 ch2_prog->error_pos, status, Ch2Program + ch2_prog->error_pos);
+                free(ch2_prog);
+                return status;
+            }
+            Ch2NumSegments = ch2_prog->num_segments;
+            if(debug) printf("  Ch2Program: %d characters -> %d segments\n", (int)strlen(Ch2Program), Ch2NumSegments);
         }
-        
-        // Validate segment times meet minimum (20ns)
-        for (i = 0; i < Ch2NumSegments; i++)
+        else
         {
-            if (ch2_segtime[i] < min_seg_time)
+            // Validate CH2 segment count
+            if (Ch2NumSegments < 3 || Ch2NumSegments > FSP_MAX_SEGMENTS)
+            {
+                if(debug) printf("ERROR: Ch2NumSegments (%d) must be between 3 and 2048\n", Ch2NumSegments);
+                free(ch2_prog);
+                return -122;
+            }
+            
+            // Validate segment strings are not NULL
+            if (Ch2StartV == NULL || Ch2StopV == NULL || Ch2SegTime == NULL ||
+                Ch2SSRCtrl == NULL || Ch2SegTrigOut == NULL || Ch2MeasType == NULL ||
+                Ch2MeasStart == NULL || Ch2MeasStop == NULL)
             {
-                if(debug) printf("ERROR: CH2 segment %d time (%.6g) < minimum (%.6g)\n", i, ch2_segtime[i], min_seg_time);
-                free(ch2_startv); free(ch2_stopv); free(ch2_segtime);
-                free(ch2_ssrctrl); free(ch2_segtrigout); free(ch2_meastype);
-                free(ch2_measstart); free(ch2_measstop);
+                if(debug) printf("ERROR: CH2 segment strings are NULL\n");
+                free(ch2_prog);
                 return -122;
             }
+            
+            // Parse strings
+            int parsed_startv = parse_array_string(Ch2StartV, ch2_prog->startv, Ch2NumSegments);
+            int parsed_stopv = parse_array_string(Ch2StopV, ch2_prog->stopv, Ch2NumSegments);
+            int parsed_segtime = parse_array_string(Ch2SegTime, ch2_prog->segtime, Ch2NumSegments);
+            int parsed_ssrctrl = parse_array_string_long(Ch2SSRCtrl, ch2_prog->ssrctrl, Ch2NumSegments);
+            int parsed_segtrigout = parse_array_string_long(Ch2SegTrigOut, ch2_prog->segtrigout, Ch2NumSegments);
+            int parsed_meastype = parse_array_string_long(Ch2MeasType, ch2_prog->meastype, Ch2NumSegments);
+            int parsed_measstart = parse_array_string(Ch2MeasStart, ch2_prog->measstart, Ch2NumSegments);
+            int parsed_measstop = parse_array_string(Ch2MeasStop, ch2_prog->measstop, Ch2NumSegments);
+            
+            if (parsed_startv != Ch2NumSegments || parsed_stopv != Ch2NumSegments ||
+                parsed_segtime != Ch2NumSegments || parsed_ssrctrl != Ch2NumSegments ||
+                parsed_segtrigout != Ch2NumSegments || parsed_meastype != Ch2NumSegments ||
+                parsed_measstart != Ch2NumSegments || parsed_measstop != Ch2NumSegments)
+            {
+                if(debug) printf("ERROR: Failed to parse CH2 segment strings (expected %d values)\n", Ch2NumSegments);
+                free(ch2_prog);
+                return -122;
+            }
+            ch2_prog->num_segments = Ch2NumSegments;
+            fsp_single_block(ch2_prog);
         }
         
-        // Validate first segment has trigger
-        if (ch2_segtrigout[0] != 1)
+        // Validate segment times meet minimum (20ns)
+        for (i = 0; i < Ch2NumSegments; i++)
         {
-            if(debug) printf("WARNING: CH2 first segment does not have segtrigout=1, fixing...\n");
-            ch2_segtrigout[0] = 1;
+            if (ch2_prog->segtime[i] < min_seg_time)
+            {
+                if(debug) printf("ERROR: CH2 segment %d time (%.6g) < minimum (%.6g)\n", i, ch2_prog->segtime[i], min_seg_time);
+                free(ch2_prog);
+                return -122;
+            }
         }
         
         // Validate loop count
         if (Ch2LoopCount <= 0 || Ch2LoopCount < 1.0)
         {
             if(debug) printf("ERROR: Ch2LoopCount (%.6g) must be >= 1.0\n", Ch2LoopCount);
+            free(ch2_prog);
             return -122;
         }
         
+        // Sequence list (default: every block once) with Ch2LoopCount over it;
+        // also sets trigger out on the first segment played
+        status = fsp_parse_list(ch2_prog, Ch2SeqList, Ch2LoopCount);
+        if (status)
+        {
+            if(debug) printf("ERROR: Ch2SeqList invalid (%d): sequence out of range, bad loop count, "
+                             "non-integer Ch2LoopCount over several entries, or a level jump between entries\n", status);
+            free(ch2_prog);
+            return status;
+        }
+        
+        if(debug) 
+        {
+            printf("  CH2 program: %d segments in %d sequences, %d list entries\n",
+                   ch2_prog->num_segments, ch2_prog->num_sequences, ch2_prog->num_list);
+            for (i = 0; i < ch2_prog->num_list && i < 20; i++)
+                printf("    list %d: sequence %ld x %.6g\n", i, ch2_prog->seq_list[i], ch2_prog->loop_list[i]);
+        }
+        
         // Ensure RPM in pulse mode for CH2
-        status = rpm_config(pulserId, ch2, KI_RPM_PATHWAY, KI_RPM_PULSE);
+        status = rpm_pathway_set(pulserId, ch2, KI_RPM_PULSE);
         if ( status && debug )
-           printf("rpm_config CH2 returned: %d\n", status);
+           printf("rpm_pathway_set CH2 returned: %d\n", status);
         
         // Set load for CH2
         status = pulse_load(pulserId, ch2, 1e6);
         if ( status )
         {
             if(debug) printf("pulse_load CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
@@ -632,6 +711,7 @@ int ACraig13_PMU_Waveform_FlexSegArb(
         if ( status )
         {
             if(debug) printf("pulse_ranges CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
@@ -640,6 +720,7 @@ int ACraig13_PMU_Waveform_FlexSegArb(
         if ( status )
         {
             if(debug) printf("pulse_burst_count CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
@@ -648,59 +729,61 @@ int ACraig13_PMU_Waveform_FlexSegArb(
         if ( status )
         {
             if(debug) printf("pulse_output CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
-        // Configure seg_arb sequence for CH2
+        // Configure one seg_arb sequence per block for CH2
         if(debug) 
         {
-            printf("Configuring seg_arb_sequence for CH%d (%d segments)...\n", ch2, Ch2NumSegments);
+            printf("Configuring seg_arb_sequence for CH%d (%d segments, %d sequences)...\n",
+                   ch2, Ch2NumSegments, ch2_prog->num_sequences);
             printf("  First segment: %.6g V -> %.6g V, time=%.6g s\n", 
-                   ch2_startv[0], ch2_stopv[0], ch2_segtime[0]);
+                   ch2_prog->startv[0], ch2_prog->stopv[0], ch2_prog->segtime[0]);
         }
         
-        status = seg_arb_sequence(pulserId, ch2, 1, Ch2NumSegments,
-                                  ch2_startv, ch2_stopv, ch2_segtime,
-                                  ch2_segtrigout, ch2_ssrctrl,
-                                  ch2_meastype, ch2_measstart, ch2_measstop);
-        if ( status )
+        for (i = 0; i < ch2_prog->num_sequences; i++)
         {
-            if(debug) 
+            int first = ch2_prog->seq_first[i];
+            status = seg_arb_sequence(pulserId, ch2, i + 1, ch2_prog->seq_count[i],
+                                      ch2_prog->startv + first, ch2_prog->stopv + first, ch2_prog->segtime + first,
+                                      ch2_prog->segtrigout + first, ch2_prog->ssrctrl + first,
+                                      ch2_prog->meastype + first, ch2_prog->measstart + first, ch2_prog->measstop + first);
+            if ( status )
             {
-                printf("ERROR: seg_arb_sequence CH2 failed: %d\n", status);
-                if (status == -804)
-                    printf("  Error -804: seg_arb function not valid in present pulse mode\n");
+                if(debug) 
+                {
+                    printf("ERROR: seg_arb_sequence CH2 sequence %d failed: %d\n", i + 1, status);
+                    if (status == -804)
+                        printf("  Error -804: seg_arb function not valid in present pulse mode\n");
+                }
+                free(ch2_prog);
+                return status;
             }
-            return status;
         }
         
-        // Configure seg_arb waveform for CH2
-        long seqList[1] = {1};
-        double loopCount[1] = {Ch2LoopCount};
-        
+        // Configure seg_arb waveform for CH2 (the sequence list carries Ch2LoopCount)
         if(debug) 
         {
-            printf("Configuring seg_arb_waveform for CH%d (loop count=%.6g)...\n", ch2, Ch2LoopCount);
+            printf("Configuring seg_arb_waveform for CH%d (%d list entries, Ch2LoopCount=%.6g)...\n",
+                   ch2, ch2_prog->num_list, Ch2LoopCount);
         }
         
-        status = seg_arb_waveform(pulserId, ch2, 1, seqList, loopCount);
+        status = seg_arb_waveform(pulserId, ch2, ch2_prog->num_list, ch2_prog->seq_list, ch2_prog->loop_list);
         if ( status )
         {
             if(debug) printf("ERROR: seg_arb_waveform CH2 failed: %d\n", status);
+            free(ch2_prog);
             return status;
         }
         
-        if(debug) printf("CH2 seg_arb configured: %d segments, loop count=%.6g\n", Ch2NumSegments, Ch2LoopCount);
+        if(debug) printf("CH2 seg_arb configured: %d segments, %d sequences, loop count=%.6g\n",
+                         Ch2NumSegments, ch2_prog->num_sequences, Ch2LoopCount);
+        
+        if (fsp_duration(ch2_prog) > exec_duration) exec_duration = fsp_duration(ch2_prog);
         
-        // Free parsed arrays
-        free(ch2_startv);
-        free(ch2_stopv);
-        free(ch2_segtime);
-        free(ch2_ssrctrl);
-        free(ch2_segtrigout);
-        free(ch2_meastype);
-        free(ch2_measstart);
-        free(ch2_measstop);
+        // Free the program now (seg_arb_sequence has copied data to hardware)
+        free(ch2_prog);
     }
 
     // Set test execute mode
@@ -719,23 +802,16 @@ int ACraig13_PMU_Waveform_FlexSegArb(
         return status;
     }
 
-    // Wait until test is complete
-    i = 0;
-    while ( pulse_exec_status(&t) == 1 && i < 200 )
-    {
-        Sleep(100);
-        i++;
-    }
-    
-    if (i >= 200)
+    // Wait until test is complete: sleep through the programmed duration,
+    // then poll finely (see pmu_exec_wait.h)
+    status = pmu_exec_wait(exec_duration, &t);
+    if (status)
     {
-        if(debug) printf("ERROR: Pulse execution timed out after 20 seconds\n");
-        return -998;
+        if(debug) printf("ERROR: Pulse execution timed out after %.3f s (programmed %.6g s)\n", t, exec_duration);
+        return status;
     }
     
-    if(debug) printf("Pulse execution complete after %d waits (%.1f seconds)\n", i, i * 0.1);
-
-    Sleep(50);  // Small delay to ensure data is ready
+    if(debug) printf("Pulse execution complete after %.3f s (programmed %.6g s)\n", t, exec_duration);
     
     // Turn off CH2 if it was enabled
     if (Ch2Enable)
@@ -750,23 +826,32 @@ int ACraig13_PMU_Waveform_FlexSegArb(
     // ============================================================
     
     // Calculate expected number of samples
-    double total_measurement_time = period * burstCount;
-    int expectedSamples = (int)(total_measurement_time * SampleRate + 1);
+    // The waveform is streamed from the card in PMU_FETCH_CHUNK blocks and
+    // reduced per block, so the capture is not clamped to a buffer size
+    double total_measurement_time = ch1_loop_time * burstCount;
+    double expectedSamples = floor(total_measurement_time * SampleRate) + 1;
+    if (expectedSamples < 100) expectedSamples = 100;
     
-    int maxSamples = expectedSamples;
-    if (maxSamples < 100) maxSamples = 100;
-    if (maxSamples > 100000) maxSamples = 100000;
+    // Extract one averaged value per pulse (from 40-80% of pulse width)
+    // Single pass: threshold and time-based detection, see pmu_pulse_extract.h
+    int outputIdx = 0;
+    double measurementStartFrac = 0.4;
+    double measurementEndFrac = 0.8;
+    double voltageThreshold = fabs(startV) * 0.5;
     
-    waveformV = (double *)calloc(maxSamples, sizeof(double));
-    waveformI = (double *)calloc(maxSamples, sizeof(double));
-    waveformT = (double *)calloc(maxSamples, sizeof(double));
+    int maxOutput = size_V_Meas;
+    if (size_I_Meas < maxOutput) maxOutput = size_I_Meas;
+    if (size_T_Stamp < maxOutput) maxOutput = size_T_Stamp;
     
-    if (waveformV == NULL || waveformI == NULL || waveformT == NULL)
+    double *timeV = (double *)calloc(maxOutput, sizeof(double));
+    double *timeI = (double *)calloc(maxOutput, sizeof(double));
+    double *timeT = (double *)calloc(maxOutput, sizeof(double));
+    if (timeV == NULL || timeI == NULL || timeT == NULL)
     {
-        if(debug) printf("Failed to allocate memory for waveform buffers\n");
-        if (waveformV) free(waveformV);
-        if (waveformI) free(waveformI);
-        if (waveformT) free(waveformT);
+        if(debug) printf("Failed to allocate memory for pulse extraction\n");
+        if (timeV) free(timeV);
+        if (timeI) free(timeI);
+        if (timeT) free(timeT);
         return -999;
     }
     
@@ -774,139 +859,64 @@ int ACraig13_PMU_Waveform_FlexSegArb(
     {
         printf("Fetching waveform:\n");
         printf("  Total measurement time: %.6g s\n", total_measurement_time);
-        printf("  Expected samples: %d\n", expectedSamples);
-        printf("  Buffer size: %d\n", maxSamples);
+        printf("  Expected samples: %.0f (fetched in blocks of %d)\n", expectedSamples, PMU_FETCH_CHUNK);
     }
     
-    // Fetch waveform data
-    status = pulse_fetch(pulserId, chan, 0, maxSamples-1, waveformV, waveformI, waveformT, NULL);
-    if (status)
-    {
-        if(debug) printf("pulse_fetch failed with error: %d\n", status);
-        free(waveformV);
-        free(waveformI);
-        free(waveformT);
-        return status;
-    }
+    pmu_pulse_extract extract;
+    pmu_pulse_extract_init(&extract, ch1_loop_time, rise, width, fall,
+                           measurementStartFrac, measurementEndFrac, voltageThreshold, burstCount,
+                           V_Meas, I_Meas, T_Stamp, timeV, timeI, timeT, maxOutput);
     
-    // Find actual number of samples
-    int numWaveformSamples = 0;
-    for (i = 0; i < maxSamples; i++)
+    // Optional per-pulse feature table, filled during the same pass
+    if (size_Features >= PMU_FEATURE_COLS)
     {
-        if (waveformT[i] == 0.0 && i > 0) break;
-        numWaveformSamples++;
+        int featureRows = size_Features / PMU_FEATURE_COLS;
+        if (featureRows > burstCount) featureRows = burstCount;
+        if (pmu_pulse_extract_features(&extract, Features, featureRows))
+        {
+            if(debug) printf("Failed to allocate memory for feature extraction\n");
+            free(timeV);
+            free(timeI);
+            free(timeT);
+            return -999;
+        }
+        if(debug) printf("  Feature table: %d rows x %d columns\n", featureRows, PMU_FEATURE_COLS);
     }
     
-    if(debug) printf("Fetched %d waveform samples, extracting averaged values per pulse...\n", numWaveformSamples);
-    
-    // Extract one averaged value per pulse (from 40-80% of pulse width)
-    int outputIdx = 0;
-    double measurementStartFrac = 0.4;
-    double measurementEndFrac = 0.8;
-    double voltageThreshold = fabs(startV) * 0.5;
-    
-    int pulseStartIdx = -1;
-    int pulseEndIdx = -1;
-    int pulseNum = 0;
-    
-    for (i = 0; i < numWaveformSamples && pulseNum < burstCount && outputIdx < size_V_Meas; i++)
+    double numWaveformSamples = 0.0;
+    status = pmu_pulse_extract_fetch(&extract, pulserId, chan, expectedSamples, &numWaveformSamples);
+    if (status)
     {
-        // Detect pulse start
-        if (pulseStartIdx < 0 && fabs(waveformV[i]) > voltageThreshold)
-        {
-            pulseStartIdx = i;
-        }
-        
-        // Detect pulse end
-        if (pulseStartIdx >= 0 && fabs(waveformV[i]) < voltageThreshold)
-        {
-            pulseEndIdx = i;
-            
-            int pulseWidthSamples = pulseEndIdx - pulseStartIdx;
-            int measStartSample = pulseStartIdx + (int)(pulseWidthSamples * measurementStartFrac);
-            int measEndSample = pulseStartIdx + (int)(pulseWidthSamples * measurementEndFrac);
-            
-            if (measEndSample > pulseEndIdx) measEndSample = pulseEndIdx;
-            if (measStartSample < pulseStartIdx) measStartSample = pulseStartIdx;
-            
-            // Average samples in measurement window
-            double sumV = 0.0, sumI = 0.0, sumT = 0.0;
-            int count = 0;
-            
-            for (j = measStartSample; j <= measEndSample && j < numWaveformSamples; j++)
-            {
-                sumV += waveformV[j];
-                sumI += waveformI[j];
-                sumT += waveformT[j];
-                count++;
-            }
-            
-            if (count > 0)
-            {
-                V_Meas[outputIdx] = sumV / count;
-                I_Meas[outputIdx] = sumI / count;
-                T_Stamp[outputIdx] = sumT / count;
-                outputIdx++;
-            }
-            
-            pulseNum++;
-            pulseStartIdx = -1;
-            pulseEndIdx = -1;
-        }
+        if(debug) printf("pulse_fetch failed with error: %d (after %.0f samples)\n", status, numWaveformSamples);
+        free(timeV);
+        free(timeI);
+        free(timeT);
+        return status;
     }
+    outputIdx = extract.h_out;
     
+    if(debug) printf("Fetched %.0f waveform samples\n", numWaveformSamples);
     if(debug) printf("Threshold-based detection found %d pulses (expected %d)\n", outputIdx, burstCount);
     
-    // If we didn't find enough pulses, try alternative: assume evenly spaced pulses
+    // If we didn't find enough pulses, use the evenly-spaced (period-based) result
     if (outputIdx < burstCount && numWaveformSamples > 0)
     {
-        if(debug) printf("Only found %d pulses via threshold detection, trying evenly-spaced detection...\n", outputIdx);
-        
-        // Reset output
-        for (i = 0; i < outputIdx; i++)
-        {
-            V_Meas[i] = 0.0;
-            I_Meas[i] = 0.0;
-            T_Stamp[i] = 0.0;
-        }
-        outputIdx = 0;
-        
-        // Use time-based detection assuming pulses are evenly spaced
-        double totalTime = waveformT[numWaveformSamples-1] - waveformT[0];
-        double estimatedPeriod = totalTime / burstCount;
+        if(debug) printf("Only found %d pulses via threshold detection, using evenly-spaced detection (%d pulses, loop %.6g s)\n",
+                         outputIdx, extract.t_out, ch1_loop_time);
         
-        if(debug) printf("Estimated period: %.6g s (total time: %.6g s)\n", estimatedPeriod, totalTime);
-        
-        for (int pulseIdx = 0; pulseIdx < burstCount && outputIdx < size_V_Meas; pulseIdx++)
+        for (i = 0; i < extract.t_out; i++)
         {
-            double pulseStartTime = waveformT[0] + pulseIdx * estimatedPeriod;
-            double measStartTime = pulseStartTime + delay + rise + width * measurementStartFrac;
-            double measEndTime = pulseStartTime + delay + rise + width * measurementEndFrac;
-            
-            double sumV = 0.0, sumI = 0.0, sumT = 0.0;
-            int count = 0;
-            
-            for (i = 0; i < numWaveformSamples; i++)
-            {
-                if (waveformT[i] >= measStartTime && waveformT[i] <= measEndTime)
-                {
-                    sumV += waveformV[i];
-                    sumI += waveformI[i];
-                    sumT += waveformT[i];
-                    count++;
-                }
-            }
-            
-            if (count > 0)
-            {
-                V_Meas[outputIdx] = sumV / count;
-                I_Meas[outputIdx] = sumI / count;
-                T_Stamp[outputIdx] = sumT / count;
-                outputIdx++;
-            }
+            V_Meas[i] = timeV[i];
+            I_Meas[i] = timeI[i];
+            T_Stamp[i] = timeT[i];
         }
+        outputIdx = extract.t_out;
     }
     
+    free(timeV);
+    free(timeI);
+    free(timeT);
+    
     // Zero out remaining array elements
     for (i = outputIdx; i < size_V_Meas && i < size_I_Meas && i < size_T_Stamp; i++)
     {
@@ -915,10 +925,6 @@ int ACraig13_PMU_Waveform_FlexSegArb(
         T_Stamp[i] = 0.0;
     }
     
-    free(waveformV);
-    free(waveformI);
-    free(waveformT);
-    
     if(debug) 
     {
         printf("Extracted %d averaged measurements (one per pulse from 40-80%% window).\n", outputIdx);
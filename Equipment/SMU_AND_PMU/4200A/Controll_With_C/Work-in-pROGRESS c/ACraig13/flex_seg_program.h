@@ -0,0 +1,382 @@
+/* Compact CH2 segment program for ACraig13_PMU_Waveform_FlexSegArb.
+ * Include from USRLIB modules only.
+ *
+ * The nine parallel Ch2 arrays repeat what seg_arb already implies: every
+ * segment starts where the previous one stopped, SSR is almost always
+ * closed and CH2 rarely measures. Ch2Program states only what changes,
+ * one segment per ';'-separated item:
+ *
+ *   =V          start level before the first segment (default 0 V)
+ *   T           flat segment of duration T at the present level
+ *   V@T         ramp from the present level to V in T
+ *   ...*N       the item N times in a row (run length)
+ *   ...T O M    flags after the time: T = trigger out, O = SSR open,
+ *               M = waveform measurement over the whole segment
+ *
+ * Numbers take an optional p, n, u or m suffix (100n = 100e-9). Commas are
+ * never needed, so the program is a single EX parameter. Example, 5 us at
+ * 0 V, 100 ns rise to 1.5 V, 10 us high, 100 ns fall, 5 us low:
+ *
+ *   5u;1.5@100n;10u;0@100n;5u
+ *
+ * is the same waveform as the 5-segment arrays.
+ *
+ * '|' starts a new block; block b (1-based) becomes seg_arb sequence b. A
+ * block starts where the previous block in the text stopped unless it opens
+ * with =V. The sequence list (fsp_parse_list) plays blocks in any order with
+ * a loop count each, "seq[*loops]" separated by ';':
+ *
+ *   =0;1.5@100n;1u;0@100n;1u | 1.5@100n;1u;0@100n;5u     with list "1*1000;2"
+ *
+ * plays the first pulse pair 1000 times, then the second once, with no
+ * unrolling. Every block needs 3 segments (seg_arb_sequence minimum), and
+ * each list entry must start at the level the entry before it stopped. The
+ * first segment of the first entry always gets trigger out, as the module
+ * requires. */
+
+#ifndef FLEX_SEG_PROGRAM_H
+#define FLEX_SEG_PROGRAM_H
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FSP_MAX_SEGMENTS 2048     /* seg_arb segments per channel, all blocks */
+#define FSP_MAX_SEQUENCES 512     /* blocks and sequence-list entries */
+#define FSP_MIN_SEQ_SEGMENTS 3    /* seg_arb_sequence minimum */
+#define FSP_LEVEL_EPS 1e-6
+
+/* Return codes */
+#define FSP_OK 0
+#define FSP_ERR_PARAM -122        /* syntax error or discontinuity, see error_pos */
+#define FSP_ERR_SIZE -831         /* too many segments, blocks or list entries */
+
+typedef struct
+{
+  int num_segments;
+  double startv[FSP_MAX_SEGMENTS];
+  double stopv[FSP_MAX_SEGMENTS];
+  double segtime[FSP_MAX_SEGMENTS];
+  long ssrctrl[FSP_MAX_SEGMENTS];
+  long segtrigout[FSP_MAX_SEGMENTS];
+  long meastype[FSP_MAX_SEGMENTS];
+  double measstart[FSP_MAX_SEGMENTS];
+  double measstop[FSP_MAX_SEGMENTS];
+
+  /* block b is segments seq_first[b] .. + seq_count[b] - 1 */
+  int num_sequences;
+  int seq_first[FSP_MAX_SEQUENCES];
+  int seq_count[FSP_MAX_SEQUENCES];
+
+  /* seg_arb_waveform() sequence list (1-based sequence numbers) */
+  int num_list;
+  long seq_list[FSP_MAX_SEQUENCES];
+  double loop_list[FSP_MAX_SEQUENCES];
+
+  int error_pos;                  /* offset of the offending character */
+} fsp_program;
+
+/* strtod() with an optional p/n/u/m suffix; NULL end on failure */
+static inline double fsp_number(const char *s, const char **end)
+{
+  char *e;
+  double v = strtod(s, &e);
+
+  if (e == s || v != v)
+  {
+    *end = NULL;
+    return 0.0;
+  }
+  switch (*e)
+  {
+    case 'p': v *= 1e-12; e++; break;
+    case 'n': v *= 1e-9; e++; break;
+    case 'u': v *= 1e-6; e++; break;
+    case 'm': v *= 1e-3; e++; break;
+    default: break;
+  }
+  *end = e;
+  return v;
+}
+
+static inline const char *fsp_skip_space(const char *s)
+{
+  while (*s != '\0' && isspace((unsigned char)*s))
+    s++;
+  return s;
+}
+
+/* Close the block that started at segment seq_first[num_sequences] */
+static inline int fsp_close_block(fsp_program *p)
+{
+  int b = p->num_sequences;
+
+  if (b >= FSP_MAX_SEQUENCES)
+    return FSP_ERR_SIZE;
+  p->seq_count[b] = p->num_segments - p->seq_first[b];
+  if (p->seq_count[b] < FSP_MIN_SEQ_SEGMENTS)
+    return FSP_ERR_PARAM;
+  p->num_sequences++;
+  if (p->num_sequences < FSP_MAX_SEQUENCES)
+    p->seq_first[p->num_sequences] = p->num_segments;
+  return FSP_OK;
+}
+
+/* Parse text into p: segments and blocks; the sequence list defaults to
+ * every block once, in order. Returns FSP_OK, FSP_ERR_PARAM or FSP_ERR_SIZE. */
+static inline int fsp_parse(fsp_program *p, const char *text)
+{
+  const char *s = text, *e;
+  double level = 0.0, v, t;
+  long repeat, trig, ssr, meas;
+  int n, status, b;
+
+  p->num_segments = 0;
+  p->num_sequences = 0;
+  p->seq_first[0] = 0;
+  p->num_list = 0;
+  p->error_pos = 0;
+  if (text == NULL)
+    return FSP_ERR_PARAM;
+
+  while (*s != '\0')
+  {
+    s = fsp_skip_space(s);
+    if (*s == ';')
+    {
+      s++;
+      continue;
+    }
+    if (*s == '|')
+    {
+      status = fsp_close_block(p);
+      if (status)
+        goto FAIL;
+      s++;
+      continue;
+    }
+    if (*s == '\0')
+      break;
+
+    /* =V: start level, only before the first segment of a block */
+    if (*s == '=')
+    {
+      v = fsp_number(s + 1, &e);
+      if (e == NULL || p->num_segments > p->seq_first[p->num_sequences])
+        goto SYNTAX;
+      level = v;
+      s = e;
+    }
+    else
+    {
+      /* [V@]T */
+      v = fsp_number(s, &e);
+      if (e == NULL)
+        goto SYNTAX;
+      e = fsp_skip_space(e);
+      if (*e == '@')
+      {
+        t = fsp_number(fsp_skip_space(e + 1), &e);
+        if (e == NULL)
+          goto SYNTAX;
+      }
+      else
+      {
+        t = v;
+        v = level;
+      }
+      if (!(t > 0.0))
+        goto SYNTAX;
+      s = e;
+
+      /* *N and flags, in any order */
+      repeat = 1;
+      trig = 0;
+      ssr = 1;
+      meas = 0;
+      for (;;)
+      {
+        s = fsp_skip_space(s);
+        if (*s == '*')
+        {
+          repeat = strtol(s + 1, (char **)&e, 10);
+          if (e == s + 1 || repeat < 1)
+            goto SYNTAX;
+          s = e;
+        }
+        else if (*s == 'T') { trig = 1; s++; }
+        else if (*s == 'O') { ssr = 0; s++; }
+        else if (*s == 'M') { meas = 2; s++; }
+        else
+          break;
+      }
+
+      if (repeat > FSP_MAX_SEGMENTS - p->num_segments)
+      {
+        status = FSP_ERR_SIZE;
+        goto FAIL;
+      }
+      while (repeat-- > 0)
+      {
+        n = p->num_segments++;
+        p->startv[n] = level;
+        p->stopv[n] = v;
+        p->segtime[n] = t;
+        p->ssrctrl[n] = ssr;
+        p->segtrigout[n] = trig;
+        p->meastype[n] = meas;
+        p->measstart[n] = 0.0;
+        p->measstop[n] = meas ? t : 0.0;
+        level = v;
+      }
+    }
+
+    s = fsp_skip_space(s);
+    if (*s != ';' && *s != '|' && *s != '\0')
+      goto SYNTAX;
+  }
+
+  status = fsp_close_block(p);
+  if (status)
+    goto FAIL;
+
+  for (b = 0; b < p->num_sequences; b++)
+  {
+    p->seq_list[b] = b + 1;
+    p->loop_list[b] = 1.0;
+  }
+  p->num_list = p->num_sequences;
+  return FSP_OK;
+
+SYNTAX:
+  status = FSP_ERR_PARAM;
+FAIL:
+  p->error_pos = (int)(s - text);
+  return status;
+}
+
+/* Segments already in p (num_segments, e.g. from the arrays) as block 1 */
+static inline int fsp_single_block(fsp_program *p)
+{
+  p->num_sequences = 0;
+  p->seq_first[0] = 0;
+  if (fsp_close_block(p))
+    return FSP_ERR_PARAM;
+  p->seq_list[0] = 1;
+  p->loop_list[0] = 1.0;
+  p->num_list = 1;
+  return FSP_OK;
+}
+
+/* Replace the default sequence list with text ("seq[*loops]" items, ';'
+ * separated; empty keeps the default), then apply loop_count to the whole
+ * list: a single entry takes it as its own loop count, a longer list is
+ * repeated loop_count times (which must then be an integer). Checks that
+ * every entry starts where the one before it stopped (a loop back to the
+ * start of an entry or of the list is not checked, as with the single
+ * looped sequence), then sets trigger out on the first segment played.
+ * Returns FSP_OK, FSP_ERR_PARAM or FSP_ERR_SIZE. */
+static inline int fsp_parse_list(fsp_program *p, const char *text, double loop_count)
+{
+  const char *s = text, *e;
+  long seq;
+  double loops, reps;
+  int i, n, first, prev;
+
+  p->error_pos = 0;
+  if (text != NULL && *fsp_skip_space(text) != '\0')
+  {
+    p->num_list = 0;
+    while (*s != '\0')
+    {
+      s = fsp_skip_space(s);
+      if (*s == ';')
+      {
+        s++;
+        continue;
+      }
+      if (*s == '\0')
+        break;
+      seq = strtol(s, (char **)&e, 10);
+      if (e == s || seq < 1 || seq > p->num_sequences)
+        goto SYNTAX;
+      s = fsp_skip_space(e);
+      loops = 1.0;
+      if (*s == '*')
+      {
+        loops = strtod(s + 1, (char **)&e);
+        if (e == s + 1 || !(loops >= 1.0) || loops != floor(loops))
+          goto SYNTAX;
+        s = fsp_skip_space(e);
+      }
+      if (*s != ';' && *s != '\0')
+        goto SYNTAX;
+      if (p->num_list >= FSP_MAX_SEQUENCES)
+      {
+        p->error_pos = (int)(s - text);
+        return FSP_ERR_SIZE;
+      }
+      p->seq_list[p->num_list] = seq;
+      p->loop_list[p->num_list] = loops;
+      p->num_list++;
+    }
+    if (p->num_list == 0)
+      goto SYNTAX;
+  }
+
+  /* Continuity between consecutive entries */
+  for (i = 1; i < p->num_list; i++)
+  {
+    first = p->seq_first[p->seq_list[i] - 1];
+    prev = p->seq_first[p->seq_list[i - 1] - 1] + p->seq_count[p->seq_list[i - 1] - 1] - 1;
+    if (fabs(p->stopv[prev] - p->startv[first]) > FSP_LEVEL_EPS)
+      return FSP_ERR_PARAM;
+  }
+
+  /* Ch2LoopCount over the whole list */
+  if (!(loop_count >= 1.0))
+    return FSP_ERR_PARAM;
+  if (p->num_list == 1)
+    p->loop_list[0] *= loop_count;
+  else if (loop_count > 1.0)
+  {
+    reps = floor(loop_count + 0.5);
+    if (fabs(loop_count - reps) > 1e-9)
+      return FSP_ERR_PARAM;
+    if (reps * p->num_list > FSP_MAX_SEQUENCES)
+      return FSP_ERR_SIZE;
+    n = p->num_list;
+    for (i = n; i < (int)reps * n; i++)
+    {
+      p->seq_list[i] = p->seq_list[i - n];
+      p->loop_list[i] = p->loop_list[i - n];
+    }
+    p->num_list = (int)reps * n;
+  }
+
+  p->segtrigout[p->seq_first[p->seq_list[0] - 1]] = 1;
+  return FSP_OK;
+
+SYNTAX:
+  p->error_pos = (int)(s - text);
+  return FSP_ERR_PARAM;
+}
+
+/* Run time of the sequence list in seconds, loop counts included */
+static inline double fsp_duration(const fsp_program *p)
+{
+  int e, k;
+  double seq_time, total = 0.0;
+
+  for (e = 0; e < p->num_list; e++)
+  {
+    seq_time = 0.0;
+    for (k = 0; k < p->seq_count[p->seq_list[e] - 1]; k++)
+      seq_time += p->segtime[p->seq_first[p->seq_list[e] - 1] + k];
+    total += seq_time * p->loop_list[e];
+  }
+  return total;
+}
+
+#endif /* FLEX_SEG_PROGRAM_H */
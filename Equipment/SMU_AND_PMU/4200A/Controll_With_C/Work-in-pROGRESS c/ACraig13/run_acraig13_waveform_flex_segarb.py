@@ -25,6 +25,12 @@ Why 40-80%?
 - Stable region: The 40-80% window captures the most stable, flat portion of
   the pulse where voltage and current have fully settled
 
+PER-PULSE FEATURES (--features):
+================================
+The same single pass in C can reduce every pulse to 5 features (t_start,
+I_peak, t_switch, Q = integral of I dt, t_rise 10-90%), returned as one row
+per pulse in the Features array (GP 44) instead of the full waveform.
+
 CH2 SEGMENT DESIGN:
 ===================
 Design CH2 segments in Python by creating arrays:
@@ -37,6 +43,34 @@ Design CH2 segments in Python by creating arrays:
 - Ch2MeasStart: Measurement start time within segment
 - Ch2MeasStop: Measurement stop time within segment
 
+COMPACT CH2 PROGRAM:
+====================
+By default the segment arrays are sent as one compact Ch2Program string
+(see flex_seg_program.h): one ';'-separated item per segment, startV implied
+by the previous stopV, defaults (SSR closed, no trigger, no measurement)
+omitted and identical segments run-length encoded:
+
+    5u;1.5@100n;10u;0@100n;20n      (=V start level, T flat, V@T ramp,
+                                     *N repeat, flags T / O / M)
+
+--ch2-arrays sends the nine arrays instead. Waveforms the program cannot
+express (partial measurement windows, discontinuous levels) fall back to
+the arrays automatically.
+
+MULTIPLE SEQUENCES (--ch2-program / --ch2-seq-list):
+=====================================================
+--ch2-program sends a hand-written Ch2Program in place of the built pulse.
+'|' splits it into blocks, each uploaded as its own seg_arb sequence, and
+--ch2-seq-list plays them with a loop count each, so repeated structure is
+looped by the card instead of unrolled into segments:
+
+    --ch2-program "=0;1.5@100n;1u;0@100n;1u | 1.5@100n;1u;0@100n;5u" \
+    --ch2-seq-list "1*1000;2"        (1000 pulse pairs, then one closing pair)
+
+An empty list plays every block once. Each entry must start at the level
+the previous one stopped. --ch2-loop-count multiplies a single entry, or
+repeats a longer list (integer count).
+
 CRITICAL REQUIREMENTS:
 - Segment voltages must be continuous: stopV[i] == startV[i+1]
 - First segment MUST have Ch2SegTrigOut[0] = 1
@@ -286,6 +320,64 @@ def build_ch2_segments_simple(
     return startV, stopV, segTime, ssrCtrl, segTrigOut, measType, measStart, measStop
 
 
+def format_program_number(value: float) -> str:
+    """Shortest Ch2Program number: 6 significant digits with a p/n/u/m suffix."""
+    if value == 0.0:
+        return "0"
+    for scale, suffix in ((1e-12, "p"), (1e-9, "n"), (1e-6, "u"), (1e-3, "m")):
+        if abs(value) < scale * 1000.0:
+            return f"{value / scale:.6g}{suffix}"
+    return f"{value:.6g}"
+
+
+def encode_ch2_program(
+    startv: List[float], stopv: List[float], segtime: List[float],
+    ssrctrl: List[int], segtrigout: List[int], meastype: List[int],
+    measstart: List[float], measstop: List[float]
+) -> Optional[str]:
+    """Encode CH2 segments as a compact Ch2Program string.
+
+    Returns None when the segments need the full arrays: a level that does
+    not continue from the previous segment, or a measurement that is not
+    a waveform over the whole segment.
+    """
+    items: List[str] = []
+    level = 0.0
+    if startv and abs(startv[0]) > 1e-12:
+        items.append("=" + format_program_number(startv[0]))
+        level = startv[0]
+
+    previous = None
+    count = 0
+    for k in range(len(segtime)):
+        if abs(startv[k] - level) > 1e-9:
+            return None
+        if meastype[k] not in (0, 2):
+            return None
+        if meastype[k] == 2 and (abs(measstart[k]) > 1e-12 or abs(measstop[k] - segtime[k]) > 1e-12):
+            return None
+        item = format_program_number(segtime[k])
+        if abs(stopv[k] - level) > 1e-12:
+            item = format_program_number(stopv[k]) + "@" + item
+        # The module always triggers on segment 0
+        flags = ("T" if segtrigout[k] and k > 0 else "") + ("O" if not ssrctrl[k] else "") + ("M" if meastype[k] == 2 else "")
+        item += flags
+        level = stopv[k]
+        if item == previous:
+            count += 1
+            continue
+        if previous is not None:
+            items.append(previous + (f"*{count}" if count > 1 else ""))
+        previous, count = item, 1
+    if previous is not None:
+        items.append(previous + (f"*{count}" if count > 1 else ""))
+    return ";".join(items)
+
+
+FEATURE_COLUMNS = 5
+FEATURE_NAMES = ["t_start_s", "I_peak_A", "t_switch_s", "charge_C", "t_rise_s"]
+
+
 def build_ex_command(
     # CH1 parameters
     width: float, rise: float, fall: float, delay: float, period: float,
@@ -299,9 +391,15 @@ def build_ex_command(
     ch2_startv: List[float], ch2_stopv: List[float], ch2_segtime: List[float],
     ch2_ssrctrl: List[int], ch2_segtrigout: List[int], ch2_meastype: List[int],
     ch2_measstart: List[float], ch2_measstop: List[float], ch2_loop_count: float,
-    clarius_debug: int = 1
+    clarius_debug: int = 1,
+    feature_rows: int = 0,
+    ch2_program: str = "",
+    ch2_seq_list: str = ""
 ) -> str:
     """Build EX command for ACraig13_PMU_Waveform_FlexSegArb."""
+
+    def join_array(values) -> str:
+        return "" if ch2_program else ",".join(format_param(v) for v in values)
     
     params = [
         # CH1 parameters (1-27)
@@ -333,21 +431,25 @@ def build_ex_command(
         format_param(array_size),
         "",  # T_Stamp output array
         format_param(array_size),
-        # CH2 parameters (28-40)
-        format_param(ch2_enable),           # 28: Ch2Enable
-        format_param(ch2_vrange),          # 29: Ch2VRange
-        format_param(ch2_num_segments),    # 30: Ch2NumSegments
-        # CH2 segment arrays (passed as comma-separated strings)
-        ",".join(format_param(v) for v in ch2_startv),      # 31: Ch2StartV
-        ",".join(format_param(v) for v in ch2_stopv),       # 32: Ch2StopV
-        ",".join(format_param(v) for v in ch2_segtime),     # 33: Ch2SegTime
-        ",".join(format_param(v) for v in ch2_ssrctrl),     # 34: Ch2SSRCtrl
-        ",".join(format_param(v) for v in ch2_segtrigout),  # 35: Ch2SegTrigOut
-        ",".join(format_param(v) for v in ch2_meastype),    # 36: Ch2MeasType
-        ",".join(format_param(v) for v in ch2_measstart),   # 37: Ch2MeasStart
-        ",".join(format_param(v) for v in ch2_measstop),    # 38: Ch2MeasStop
-        format_param(ch2_loop_count),       # 39: Ch2LoopCount
-        format_param(clarius_debug),        # 40: ClariusDebug
+        # CH2 parameters (29-42)
+        format_param(ch2_enable),           # 29: Ch2Enable
+        format_param(ch2_vrange),          # 30: Ch2VRange
+        format_param(ch2_num_segments),    # 31: Ch2NumSegments
+        # CH2 segment arrays (passed as comma-separated strings, empty when Ch2Program is used)
+        join_array(ch2_startv),             # 32: Ch2StartV
+        join_array(ch2_stopv),              # 33: Ch2StopV
+        join_array(ch2_segtime),            # 34: Ch2SegTime
+        join_array(ch2_ssrctrl),            # 35: Ch2SSRCtrl
+        join_array(ch2_segtrigout),         # 36: Ch2SegTrigOut
+        join_array(ch2_meastype),           # 37: Ch2MeasType
+        join_array(ch2_measstart),          # 38: Ch2MeasStart
+        join_array(ch2_measstop),           # 39: Ch2MeasStop
+        ch2_program,                        # 40: Ch2Program (compact, replaces the arrays)
+        ch2_seq_list,                       # 41: Ch2SeqList (empty = every block once)
+        format_param(ch2_loop_count),       # 42: Ch2LoopCount
+        format_param(clarius_debug),        # 43: ClariusDebug
+        "",                                 # 44: Features output array
+        format_param(max(1, feature_rows * FEATURE_COLUMNS)),  # 45: size_Features (1 = off)
     ]
 
     return f"EX ACraig13 ACraig13_PMU_Waveform_FlexSegArb({','.join(params)})"
@@ -380,6 +482,20 @@ def run_measurement(args, enable_plot: bool) -> None:
         ch2_ssrctrl = ch2_segtrigout = ch2_meastype = []
         ch2_measstart = ch2_measstop = []
     
+    ch2_program = ""
+    if args.ch2_enable and args.ch2_program:
+        ch2_program = args.ch2_program
+        print(f"[CH2] Ch2Program from --ch2-program ({len(ch2_program)} chars): {ch2_program}")
+    elif args.ch2_enable and not args.ch2_arrays:
+        ch2_program = encode_ch2_program(
+            ch2_startv, ch2_stopv, ch2_segtime, ch2_ssrctrl, ch2_segtrigout,
+            ch2_meastype, ch2_measstart, ch2_measstop
+        ) or ""
+        if ch2_program:
+            print(f"[CH2] Ch2Program ({len(ch2_program)} chars): {ch2_program}")
+    if args.ch2_seq_list:
+        print(f"[CH2] Ch2SeqList: {args.ch2_seq_list}")
+    
     # Validate CH2 loop count
     ch2_loop_count = args.ch2_loop_count
     if ch2_loop_count <= 0:
@@ -398,7 +514,10 @@ def run_measurement(args, enable_plot: bool) -> None:
         ch2_startv, ch2_stopv, ch2_segtime,
         ch2_ssrctrl, ch2_segtrigout, ch2_meastype,
         ch2_measstart, ch2_measstop, ch2_loop_count,
-        1  # debug enabled
+        1,  # debug enabled
+        feature_rows=args.burst_count if args.features else 0,
+        ch2_program=ch2_program,
+        ch2_seq_list=args.ch2_seq_list
     )
     
     print("\n" + "="*80)
@@ -465,6 +584,9 @@ def run_measurement(args, enable_plot: bool) -> None:
         
         print(f"[KXCI] Received: {len(voltage)} voltage, {len(current)} current, {len(time_axis)} time samples")
 
+        if args.features:
+            print_features(safe_query(44, args.burst_count * FEATURE_COLUMNS, "features"))
+
         usable = min(len(voltage), len(current), len(time_axis))
         voltage = voltage[:usable]
         current = current[:usable]
@@ -565,6 +687,17 @@ def run_measurement(args, enable_plot: bool) -> None:
         controller.disconnect()
 
 
+def print_features(values: List[float]) -> None:
+    """Print the per-pulse feature table (one row of FEATURE_COLUMNS per pulse)."""
+    rows = [values[k:k + FEATURE_COLUMNS] for k in range(0, len(values) - FEATURE_COLUMNS + 1, FEATURE_COLUMNS)]
+    print(f"\n[KXCI] Per-pulse features: {len(rows)} rows")
+    print("  pulse  " + "  ".join(f"{name:>12}" for name in FEATURE_NAMES))
+    for k, row in enumerate(rows[:20]):
+        print(f"  {k:5d}  " + "  ".join(f"{value:12.4e}" for value in row))
+    if len(rows) > 20:
+        print(f"  ... ({len(rows) - 20} more rows)")
+
+
 def parse_arguments() -> argparse.Namespace:
     """Parse command-line arguments."""
     parser = argparse.ArgumentParser(
@@ -616,6 +749,8 @@ Examples:
     parser.add_argument("--chan", type=int, default=1, choices=[1, 2], help="PMU channel for DUT measurement")
     parser.add_argument("--pmu-id", type=str, default="PMU1", help="PMU instrument ID")
     parser.add_argument("--array-size", type=int, default=0, help="Output array size (0=auto)")
+    parser.add_argument("--features", action="store_true",
+                       help="Also return per-pulse features (t_start, I_peak, t_switch, Q, t_rise)")
 
     # CH2 flexible seg_arb parameters
     parser.add_argument("--ch2-enable", type=int, default=1, choices=[0, 1], 
@@ -631,6 +766,12 @@ Examples:
                        help="CH2 delay before pulse starts (s). Default 5µs")
     parser.add_argument("--ch2-loop-count", type=float, default=1.0, 
                        help="CH2 loop count (must be >= 1.0)")
+    parser.add_argument("--ch2-arrays", action="store_true",
+                       help="Send CH2 as the nine segment arrays instead of the compact Ch2Program")
+    parser.add_argument("--ch2-program", type=str, default="",
+                       help="Raw Ch2Program ('|' separates sequence blocks); replaces the built CH2 pulse")
+    parser.add_argument("--ch2-seq-list", type=str, default="",
+                       help="Ch2SeqList, e.g. \"1*1000;2\" (empty = every block once)")
 
     return parser.parse_args()
 
@@ -662,6 +803,14 @@ def main() -> None:
             ch2_measstart = ch2_measstop = []
         
         ch2_loop_count = args.ch2_loop_count if args.ch2_loop_count > 0 else 1.0
+        ch2_program = ""
+        if args.ch2_enable and args.ch2_program:
+            ch2_program = args.ch2_program
+        elif args.ch2_enable and not args.ch2_arrays:
+            ch2_program = encode_ch2_program(
+                ch2_startv, ch2_stopv, ch2_segtime, ch2_ssrctrl, ch2_segtrigout,
+                ch2_meastype, ch2_measstart, ch2_measstop
+            ) or ""
         
         command = build_ex_command(
             args.width, args.rise, args.fall, args.delay, args.period,
@@ -674,7 +823,10 @@ def main() -> None:
             ch2_startv, ch2_stopv, ch2_segtime,
             ch2_ssrctrl, ch2_segtrigout, ch2_meastype,
             ch2_measstart, ch2_measstop, ch2_loop_count,
-            1
+            1,
+            feature_rows=args.burst_count if args.features else 0,
+            ch2_program=ch2_program,
+            ch2_seq_list=args.ch2_seq_list
         )
         print("\nGenerated EX command:\n" + command)
         return
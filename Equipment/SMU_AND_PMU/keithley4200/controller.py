@@ -34,6 +34,7 @@ if str(PROJECT_ROOT) not in sys.path:
     sys.path.insert(0, str(PROJECT_ROOT))
 
 from Equipment.SMU_AND_PMU.ProxyClass import Proxy
+from Equipment.SMU_AND_PMU.keithley4200 import rpm_pathway_cache
 
 
 class Keithley4200AController:
@@ -128,6 +129,7 @@ class Keithley4200AController:
             # For safety, reset and select test station
             self.lpt.tstsel(1)
             self.lpt.devint()
+            rpm_pathway_cache.mark_stale()  # devint can move the RPM relays
 
             self._instr_id = self.lpt.getinstid(self._card_name)
 
@@ -211,6 +213,7 @@ class Keithley4200AController:
                 except Exception:
                     pass
             self.lpt.devint()
+            rpm_pathway_cache.mark_stale()  # devint can move the RPM relays
             try:
                 self.lpt.tstdsl()
             except Exception:
@@ -412,6 +415,7 @@ class Keithley4200A_PMUDualChannel:
             sys.exit() # force close 
 
         self.lpt.devint()
+        rpm_pathway_cache.mark_stale()  # devint can move the RPM relays
         self.lpt.dev_abort()
 
         self.card_id = self.lpt.getinstid(self.card)
@@ -445,6 +449,14 @@ class Keithley4200A_PMUDualChannel:
         except Exception: pass
         try: self.lpt.devint()
         except Exception: pass
+        rpm_pathway_cache.mark_stale()
+
+    def _rpm_to_pulse(self, ch: int) -> None:
+        """Put the RPM on ``ch`` on the pulse path and mark the KXCI cache stale."""
+        try:
+            self.lpt.rpm_config(self.card_id, ch, self.param.KI_RPM_PATHWAY, self.param.KI_RPM_PULSE)
+        finally:
+            rpm_pathway_cache.mark_stale()  # relays moved outside rpm_pathway_set()
 
 
     def _configure_both_channels(self,
@@ -469,7 +481,7 @@ class Keithley4200A_PMUDualChannel:
         """"configures both channels"with the ranges limits and timing!"""
         # Configure pathway, measurement, ranges, limits, timing, and load for both channels
         for ch in self.channels:
-            self.lpt.rpm_config(self.card_id, ch, self.param.KI_RPM_PATHWAY, self.param.KI_RPM_PULSE)
+            self._rpm_to_pulse(ch)
             self.lpt.pulse_meas_sm(self.card_id, ch,
                                    acquire_type=0,
                                    acquire_meas_v_ampl=1,
@@ -945,6 +957,7 @@ class Keithley4200A_PMUDualChannel:
             pass
         try:
             self.lpt.devint()
+            rpm_pathway_cache.mark_stale()  # devint can move the RPM relays
             self.lpt.tstdsl()
         except Exception:
             pass
@@ -1044,7 +1057,7 @@ class Keithley4200A_PMUDualChannel:
 
         # Configure both channels; set bias as constant by sweeping start=stop= bias
         for ch in self.channels:
-            self.lpt.rpm_config(self.card_id, ch, self.param.KI_RPM_PATHWAY, self.param.KI_RPM_PULSE)
+            self._rpm_to_pulse(ch)
             self.lpt.pulse_meas_sm(self.card_id, ch,
                                    acquire_type=0,
                                    acquire_meas_v_ampl=1,
@@ -1113,7 +1126,7 @@ class Keithley4200A_PMUDualChannel:
         # Configure pathway/measurement
         for ch in self.channels:
             try:
-                self.lpt.rpm_config(self.card_id, ch, self.param.KI_RPM_PATHWAY, self.param.KI_RPM_PULSE)
+                self._rpm_to_pulse(ch)
             except Exception:
                 pass
             try:
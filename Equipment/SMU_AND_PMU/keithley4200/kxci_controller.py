@@ -77,6 +77,14 @@ import time
 from typing import Optional, Dict, List, Any, Tuple
 import re
 
+try:
+    from Equipment.SMU_AND_PMU.keithley4200 import rpm_pathway_cache
+except ImportError:  # loaded by file path (4200A/scripts smoke tests)
+    import sys
+    from pathlib import Path
+    sys.path.insert(0, str(Path(__file__).resolve().parent))
+    import rpm_pathway_cache  # type: ignore
+
 
 class Keithley4200A_KXCI:
     """
@@ -177,6 +185,8 @@ class Keithley4200A_KXCI:
             
             self._ul_mode_active = True
             print("✓ Entered User Library (UL) mode")
+            # Relays may have moved since the last EX (new session, LPT devint)
+            rpm_pathway_cache.reset_if_stale(self._execute_ex_command)
             return True
             
         except Exception as e:
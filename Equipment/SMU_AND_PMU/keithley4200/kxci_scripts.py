@@ -95,6 +95,14 @@ import math
 from dataclasses import dataclass, replace
 from typing import Any, Dict, List, Optional, Sequence, Tuple, Callable
 
+try:
+    from Equipment.SMU_AND_PMU.keithley4200 import rpm_pathway_cache
+except ImportError:  # loaded by file path (4200A/scripts smoke tests)
+    import sys
+    from pathlib import Path
+    sys.path.insert(0, str(Path(__file__).resolve().parent))
+    import rpm_pathway_cache  # type: ignore
+
 
 # ═══════════════════════════════════════════════════════════════════════════════
 # AVAILABLE TEST FUNCTIONS
@@ -630,6 +638,8 @@ class KXCIClient:
         self.inst.write("UL")
         time.sleep(0.03)
         self._ul_mode_active = True
+        # Relays may have moved since the last EX (new session, LPT devint)
+        rpm_pathway_cache.reset_if_stale(self._execute_ex_command)
         return True
 
     def _exit_ul_mode(self) -> bool:
@@ -5128,7 +5138,10 @@ class Keithley4200_KXCI_Scripts:
             ch2_fall=laser_fall_time_s,
             ch2_period=laser_delay_s,  # Delay before laser pulse starts
             ch2_loop_count=1.0,  # Single laser pulse
-            clarius_debug=1  # Enable debug output
+            clarius_debug=1,  # Enable debug output
+            feature_rows=0,  # No per-pulse feature table
+            num_averages=1,  # Single capture
+            variance_rows=0  # No current variance output
         )
         
         controller = self._get_controller()
@@ -5190,9 +5203,18 @@ class Keithley4200_KXCI_Scripts:
         ch2_enable: int, ch2_vrange: float,
         ch2_vlow: float, ch2_vhigh: float, ch2_width: float,
         ch2_rise: float, ch2_fall: float, ch2_period: float, ch2_loop_count: float,
-        clarius_debug: int = 1
+        clarius_debug: int = 1,
+        feature_rows: int = 0,
+        num_averages: int = 1,
+        variance_rows: int = 0
     ) -> str:
-        """Build EX command for ACraig10_PMU_Waveform_SegArb (laser read)."""
+        """Build EX command for ACraig10_PMU_Waveform_SegArb (laser read).
+
+        feature_rows > 0 also requests the per-pulse feature table (5 values
+        per pulse, GP 56); 0 leaves it off. num_averages repeats the capture
+        and averages it point by point; variance_rows > 0 (with num_averages
+        > 1) also returns the per-pulse current variance (GP 59).
+        """
         ch2_num_segments = 0  # 0 = auto-build mode
         
         params = [
@@ -5253,6 +5275,11 @@ class Keithley4200_KXCI_Scripts:
             format_param(10),                  # 53: Ch2MeasStop_size
             format_param(ch2_loop_count),      # 54: Ch2LoopCount
             format_param(clarius_debug),       # 55: ClariusDebug
+            "",                                 # 56: Features output array
+            format_param(max(1, feature_rows * 5)),  # 57: size_Features (1 = off)
+            format_param(num_averages),        # 58: NumAverages
+            "",                                 # 59: I_Var output array
+            format_param(max(1, variance_rows)),  # 60: size_I_Var (1 = off)
         ]
         
         return f"EX A_Ch1Read_Ch2Laser_Pulse ACraig10_PMU_Waveform_SegArb({','.join(params)})"
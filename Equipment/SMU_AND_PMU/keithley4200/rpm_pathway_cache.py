@@ -0,0 +1,43 @@
+"""
+Host-side tracking of the KXCI RPM pathway cache.
+
+The C modules skip RPM relay actuation when the cache in the KXCI process
+(rpm_pathway.h) says a channel is already on the requested pathway. Anything
+in this Python process that can move the relays behind KXCI's back (an LPT
+``devint()`` or ``rpm_config()``) calls ``mark_stale()``; KXCI clients call ``reset_if_stale()``
+on entering UL mode, which runs the ``rpm_pathway_reset`` module once.
+
+A fresh process starts stale, so the first UL entry after connecting always
+clears the cache (Clarius or another host may have moved the relays).
+"""
+
+from __future__ import annotations
+
+RESET_COMMAND = "EX A_RPM_Pathway rpm_pathway_reset()"
+
+_stale = True
+
+
+def mark_stale() -> None:
+    """Record that the RPM relays may have moved outside rpm_pathway_set()."""
+    global _stale
+    _stale = True
+
+
+def reset_if_stale(execute_ex) -> None:
+    """Clear the KXCI cache if it may be stale.
+
+    ``execute_ex`` is the client's ``_execute_ex_command``; UL mode must be
+    active. A failed reset (library not loaded) only warns and stays stale.
+    """
+    global _stale
+    if not _stale:
+        return
+    try:
+        return_value, error = execute_ex(RESET_COMMAND, wait_seconds=0.01)
+    except Exception as exc:  # noqa: BLE001
+        return_value, error = None, str(exc)
+    if error or return_value not in (0, None):
+        print(f"[WARN] RPM pathway cache reset failed ({error or return_value}); load A_RPM_Pathway")
+        return
+    _stale = False
@@ -0,0 +1,86 @@
+"""Tests for the SMU_BiasTimedRead_Capture / _Triggered / _Log runner helpers."""
+
+from __future__ import annotations
+
+import sys
+from pathlib import Path
+
+MODULE_DIR = (
+    Path(__file__).resolve().parents[1]
+    / "Equipment" / "SMU_AND_PMU" / "4200A" / "C_Code_with_python_scripts" / "SMU_BiasTimedRead"
+)
+if str(MODULE_DIR) not in sys.path:
+    sys.path.insert(0, str(MODULE_DIR))
+
+import run_smu_bias_timed_read as runner  # type: ignore  # noqa: E402
+
+
+def test_capture_command_sizes_window_and_leaves_outputs_empty() -> None:
+    command = runner.build_ex_command_capture(
+        vforce=3.0,
+        duration_s=600.0,
+        sample_interval_s=0.01,
+        ilimit=1e-3,
+        trigger_level=1e-5,
+        pre_trigger=50,
+        post_trigger=20,
+        trigger_mode=1,
+        summary_points=256,
+    )
+    assert command.startswith("EX A_SMU_BiasTimedRead_Capture SMU_BiasTimedRead_Capture(")
+    params = command[command.index("(") + 1:-1].split(",")
+
+    assert len(params) == 20
+    assert params[5] == "1"
+    assert params[10] == params[12] == "71"  # 50 + 1 + 20
+    assert params[14] == params[16] == "256"
+    for position in (
+        runner.GP_CAPTURE_IMEAS,
+        runner.GP_CAPTURE_TIMESTAMPS,
+        runner.GP_CAPTURE_SUMMARY_I,
+        runner.GP_CAPTURE_SUMMARY_T,
+        runner.GP_CAPTURE_TRIGGER_INDEX,
+        runner.GP_CAPTURE_NUM_POINTS,
+        runner.GP_CAPTURE_NUM_SUMMARY,
+    ):
+        assert params[position - 1] == ""
+
+
+def test_triggered_command_places_pmu_and_outputs() -> None:
+    command = runner.build_ex_command_triggered(
+        vforce=0.5,
+        duration_s=5.0,
+        sample_interval_s=0.005,
+        ilimit=1e-4,
+        num_points=1000,
+        trig_offset_s=0.5,
+        trig_width_s=0.01,
+    )
+    assert command.startswith("EX A_SMU_BiasTimedRead_Triggered SMU_BiasTimedRead_Triggered(")
+    params = command[command.index("(") + 1:-1].split(",")
+
+    assert len(params) == 18
+    assert params[6] == "PMU1"
+    assert params[13] == params[15] == "1000"
+    for position in (
+        runner.GP_TRIGGERED_IMEAS,
+        runner.GP_TRIGGERED_TIMESTAMPS,
+        runner.GP_TRIGGERED_EXEC_LATENCY,
+        runner.GP_TRIGGERED_NUM_POINTS,
+    ):
+        assert params[position - 1] == ""
+
+
+def test_log_schedule_includes_decade_end_and_sizes_command() -> None:
+    schedule = runner.log_schedule(0.01, 1e4, 10)
+
+    assert len(schedule) == 61
+    assert schedule[0] == 0.01
+    assert abs(schedule[-1] - 1e4) < 1e-6
+    assert abs(schedule[10] / schedule[0] - 10.0) < 1e-9
+
+    params = runner.build_ex_command_log(0.1, 0.01, 1e4, 10, 1e-4, read_mode=1).split("(", 1)[1][:-1].split(",")
+    assert len(params) == 14
+    assert params[6] == "1"
+    assert params[runner.GP_LOG_IMEAS] == params[runner.GP_LOG_TIMESTAMPS] == "61"
+
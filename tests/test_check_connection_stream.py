@@ -43,3 +43,54 @@ def test_latest_sample_from_buffers_calculates_last_index() -> None:
     assert snapshot.write_index == 2
 
 
+def test_samples_since_drops_slots_overwritten_during_read() -> None:
+    from run_check_connection_stream import samples_since  # type: ignore  # pylint: disable=import-error
+
+    # Ring of 4: sequences 4..7 in slots 0..3, head advanced to 9 while reading
+    voltage = [0.4, 0.5, 0.6, 0.7]
+    current = [4e-9, 5e-9, 6e-9, 7e-9]
+    samples = samples_since(voltage, current, last_sequence=3, head_before=8, head_after=9)
+
+    assert [s.sequence for s in samples] == [5, 6, 7]
+    assert samples[0].current == 5e-9
+
+
+def test_parse_stream_frame_decodes_sequence_time_and_checksum() -> None:
+    import pytest
+    from connection_check_runner import parse_stream_frame  # type: ignore  # pylint: disable=import-error
+
+    line = "FRAME 4 4 45 0.200000 0:1.0400e-06:3 11:1.0500e-06:3 11:1.0600e-06:3 11:1.0700e-06:3 *70"
+    samples = parse_stream_frame(line)
+
+    assert [s.sequence for s in samples] == [4, 5, 6, 7]
+    assert [round(s.time, 3) for s in samples] == [0.045, 0.056, 0.067, 0.078]
+    assert samples[1].current == 1.05e-06
+    assert abs(samples[0].voltage - 0.200003) < 1e-12
+
+    with pytest.raises(ValueError):
+        parse_stream_frame(line.replace("1.0500e-06", "1.0500e-05"))
+
+
+def test_qualify_contact_reports_settled_current() -> None:
+    from connection_check_runner import qualify_contact  # type: ignore  # pylint: disable=import-error
+
+    class FakeController:
+        def __init__(self) -> None:
+            self.commands = []
+
+        def _execute_ex_command(self, command, wait_seconds=1.0):
+            self.commands.append(command)
+            return 0, None
+
+        def _query_gp(self, param, count):
+            assert param == 10
+            return [12.0, 12.0, 64.0, 3.0, 0.122, 1.02e-06, 0.122]
+
+    controller = FakeController()
+    result = qualify_contact(controller, stable_count=5, stable_tolerance=0.02, min_current=1e-7)
+
+    assert result == {"stable": True, "current": 1.02e-06, "settle_time": 0.122, "total_samples": 12}
+    params = controller.commands[0].split("(", 1)[1].rstrip(")").split(",")
+    assert len(params) == 19
+    assert params[14] == "5"
+
@@ -0,0 +1,61 @@
+"""Unit tests for smu_plan_sweep helpers (Python mirror of C smu_sweep_plan.h)."""
+
+from __future__ import annotations
+
+from pathlib import Path
+import sys
+
+import pytest
+
+PROJECT_ROOT = Path(__file__).resolve().parents[1]
+MODULE_DIR = PROJECT_ROOT / "Equipment" / "SMU_AND_PMU" / "4200A" / "C_Code_with_python_scripts" / "A_Iv_Sweep"
+
+if str(MODULE_DIR) not in sys.path:
+    sys.path.append(str(MODULE_DIR))
+
+from run_smu_plan_sweep import (  # type: ignore  # pylint: disable=import-error
+    build_ex_command,
+    plan_point_count,
+    shape_vertices,
+    sweep_plan_voltages,
+)
+
+
+def test_loop_matches_full_iv_sweep_point_count() -> None:
+    # SMU_FullIVsweep: 4 × PointsPerSegment + 1
+    assert plan_point_count(shape_vertices("loop", vhigh=5, vlow=-5), 10) == 41
+
+
+def test_closed_loop_cycles_share_zero_vertex() -> None:
+    voltages = sweep_plan_voltages("0;2;0;-2;0", 2, num_cycles=2)
+    assert voltages == [0.0, 1.0, 2.0, 1.0, 0.0, -1.0, -2.0, -1.0, 0.0, 1.0, 2.0, 1.0, 0.0, -1.0, -2.0, -1.0, 0.0]
+
+
+def test_open_list_restarts_each_cycle_at_first_vertex() -> None:
+    voltages = sweep_plan_voltages([-1.0, 1.0], 2, num_cycles=2)
+    assert voltages == [-1.0, 0.0, 1.0, -1.0, 0.0, 1.0]
+
+
+def test_per_leg_points_and_hold_leg() -> None:
+    voltages = sweep_plan_voltages("0;1.5;1.5;0", "3;1;3")
+    assert voltages == pytest.approx([0.0, 0.5, 1.0, 1.5, 1.5, 1.0, 0.5, 0.0])
+
+
+def test_per_leg_list_length_must_match() -> None:
+    with pytest.raises(ValueError):
+        sweep_plan_voltages("0;1;0", "3;4;5")
+
+
+def test_ex_command_uses_semicolon_lists() -> None:
+    command = build_ex_command("0;2;0", "5;5", num_points=11, leg_ilimit=[1e-4, 1e-2])
+    assert command.startswith("EX A_Iv_Sweep smu_plan_sweep(0;2;0,5;5,,1.00E-4;1.00E-2,,1,,11,,11,,11,")
+    assert command.count(",") == 15
+
+
+def test_multi_sweep_command_and_channel_split() -> None:
+    from run_smu_multi_sweep import build_ex_command as build_multi, split_channels  # type: ignore  # pylint: disable=import-error
+
+    command = build_multi(["SMU1", "SMU2"], ["0;2;0", "0;1;0"], 5, num_points=11)
+    assert command.startswith("EX A_Iv_Sweep smu_multi_sweep(SMU1;SMU2,0;2;0|0;1;0,5,")
+    assert ",22,,22,,11," in command
+    assert split_channels([0.0, 10.0, 1.0, 11.0, 2.0, 12.0], 2) == [[0.0, 1.0, 2.0], [10.0, 11.0, 12.0]]
@@ -0,0 +1,48 @@
+"""Tests for the run_smu_pulses argument builders (SMU_pulse_train_craig and
+SMU_pulse_engine_craig)."""
+
+from __future__ import annotations
+
+import sys
+from pathlib import Path
+
+import pytest
+
+MODULE_DIR = (
+    Path(__file__).resolve().parents[1]
+    / "Equipment" / "SMU_AND_PMU" / "4200A" / "C_Code_with_python_scripts" / "SMU"
+)
+if str(MODULE_DIR) not in sys.path:
+    sys.path.insert(0, str(MODULE_DIR))
+
+import run_smu_pulses as runner  # type: ignore  # noqa: E402
+
+
+def test_train_args_pack_lists_and_size_outputs() -> None:
+    args = runner.build_train_args([1.5, -1.5], [1e-4], [1e-3, 2e-3], num_pulses=1000, bias_v=0.1)
+
+    assert len(args) == 14
+    assert args[2] == "1.500000e+00;-1.500000e+00"
+    assert args[3] == "1.000000e-04"
+    assert args[5] == "1000"
+    # Output placeholders and their sizes, matching the GP positions
+    assert args[runner.GP_TRAIN_RESISTANCE - 1] == ""
+    assert args[runner.GP_TRAIN_CURRENT - 1] == ""
+    assert args[runner.GP_TRAIN_COUNT - 1] == ""
+    assert args[10] == args[12] == "1000"
+
+    with pytest.raises(ValueError):
+        runner.build_train_args([], [1e-4], [1e-3], num_pulses=10)
+
+
+def test_engine_args_size_outputs_to_measured_records() -> None:
+    # program 3 times, read once; 10 records -> reads at records 3 and 7
+    assert runner.count_measured([0, 0, 0, 1], 10) == 2
+    args = runner.build_engine_args([1.5, 1.5, 1.5, 0.2], [1e-4], [0, 0, 0, 1], [0.0], num_records=10)
+
+    assert len(args) == runner.GP_ENGINE_RECORD_COUNT
+    assert args[4] == "0;0;0;1"
+    assert args[6] == "10"
+    for position in (runner.GP_ENGINE_RESISTANCE, runner.GP_ENGINE_CURRENT, runner.GP_ENGINE_RECORD):
+        assert args[position - 1] == ""
+        assert args[position] == "2"